@@ -0,0 +1,175 @@
+/** ACPIテーブルからのCPU列挙
+ * - Linux 2.6.11のarch/i386/kernel/acpi/boot.cに相当（MADTの解析のみ）
+ * - RSDP → RSDT → MADTとたどり，CPUとI/O APICをmpparse.cの表に登録する
+ */
+
+#include <asm-i386/acpi.h>
+#include <asm-i386/io.h>
+#include <asm-i386/mpspec.h>
+#include <asm-i386/page.h>
+#include <kfs/printk.h>
+#include <kfs/stddef.h>
+#include <kfs/string.h>
+
+/* バイト列の和（ACPIのテーブルは0なら正しい） */
+static uint8_t acpi_checksum(const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+	uint8_t sum = 0;
+
+	while (len--)
+	{
+		sum += *p++;
+	}
+	return sum;
+}
+
+/** MADTからCPUとI/O APICを登録する
+ * @param madt MADTの先頭（header.length分アクセスできること）
+ * @return 登録したCPUの数，テーブルが壊れていれば-1
+ */
+int acpi_parse_madt(struct acpi_table_madt *madt)
+{
+	uint8_t *p = (uint8_t *)(madt + 1);
+	uint8_t *end = (uint8_t *)madt + madt->header.length;
+	int before = num_processors;
+
+	if (memcmp(madt->header.signature, "APIC", 4) != 0 || acpi_checksum(madt, madt->header.length) != 0)
+	{
+		printk(KERN_WARNING "ACPI: bad MADT\n");
+		return -1;
+	}
+
+	while (p + sizeof(struct acpi_subtable_header) <= end)
+	{
+		struct acpi_subtable_header *h = (struct acpi_subtable_header *)p;
+
+		if (h->length < sizeof(*h) || p + h->length > end)
+		{
+			printk(KERN_WARNING "ACPI: bad MADT entry length %u\n", h->length);
+			break;
+		}
+
+		if (h->type == ACPI_MADT_TYPE_LOCAL_APIC)
+		{
+			struct acpi_madt_local_apic *lapic = (struct acpi_madt_local_apic *)h;
+
+			mp_register_lapic(lapic->id, lapic->lapic_flags & ACPI_MADT_ENABLED);
+		}
+		else if (h->type == ACPI_MADT_TYPE_IO_APIC)
+		{
+			struct acpi_madt_io_apic *ioapic = (struct acpi_madt_io_apic *)h;
+
+			mp_register_ioapic(ioapic->id, ioapic->address);
+		}
+		p += h->length;
+	}
+	return num_processors - before;
+}
+
+/** 物理アドレスの範囲からRSDPを探す
+ * @param base   探す範囲の物理アドレス（1MB未満）
+ * @param length 探す範囲の長さ
+ * @return 見つかったRSDP（仮想アドレス），なければNULL
+ */
+static struct acpi_table_rsdp *acpi_scan_rsdp(unsigned long base, unsigned long length)
+{
+	uint8_t *p = __va(base);
+	uint8_t *end = p + length;
+
+	for (; p + sizeof(struct acpi_table_rsdp) <= end; p += 16)
+	{
+		if (memcmp(p, "RSD PTR ", 8) == 0 && acpi_checksum(p, sizeof(struct acpi_table_rsdp)) == 0)
+		{
+			return (struct acpi_table_rsdp *)p;
+		}
+	}
+	return NULL;
+}
+
+/** テーブルを全体の長さでマップする
+ * @param phys テーブルの物理アドレス
+ * @return マップしたテーブル（iounmap()で解放する），失敗時NULL
+ * @note ACPIテーブルはRAMの末尾付近にあり直接マップの外のため，ヘッダで長さを知ってからマップし直す
+ */
+static struct acpi_table_header *acpi_map_table(uint32_t phys)
+{
+	struct acpi_table_header *h;
+	uint32_t length;
+
+	h = ioremap(phys, sizeof(*h), IOREMAP_UC);
+	if (h == NULL)
+	{
+		return NULL;
+	}
+	length = h->length;
+	iounmap(h);
+
+	if (length < sizeof(*h))
+	{
+		return NULL;
+	}
+	return ioremap(phys, length, IOREMAP_UC);
+}
+
+/** ACPIのMADTからCPUとI/O APICを登録する
+ * @return 0=成功，-1=ACPIがないかMADTが見つからない（MPテーブルを使う）
+ * @note XSDTは64ビットの物理アドレスを持つため，ACPI 1.0互換のRSDTだけをたどる
+ */
+int acpi_boot_init(void)
+{
+	struct acpi_table_rsdp *rsdp = NULL;
+	struct acpi_table_header *rsdt;
+	unsigned long ebda = (unsigned long)(*(uint16_t *)__va(0x40E)) << 4;
+	uint32_t i, nr_entries;
+	int ret = -1;
+
+	if (ebda)
+	{
+		rsdp = acpi_scan_rsdp(ebda, 1024);
+	}
+	if (rsdp == NULL)
+	{
+		rsdp = acpi_scan_rsdp(0xE0000, 0x20000);
+	}
+	if (rsdp == NULL)
+	{
+		return -1;
+	}
+
+	rsdt = acpi_map_table(rsdp->rsdt_address);
+	if (rsdt == NULL)
+	{
+		return -1;
+	}
+	if (memcmp(rsdt->signature, "RSDT", 4) != 0 || acpi_checksum(rsdt, rsdt->length) != 0)
+	{
+		printk(KERN_WARNING "ACPI: bad RSDT\n");
+		iounmap(rsdt);
+		return -1;
+	}
+
+	nr_entries = (rsdt->length - sizeof(*rsdt)) / sizeof(uint32_t);
+	for (i = 0; i < nr_entries && ret < 0; i++)
+	{
+		uint32_t phys = ((uint32_t *)(rsdt + 1))[i];
+		struct acpi_table_header *table = acpi_map_table(phys);
+
+		if (table == NULL)
+		{
+			continue;
+		}
+		if (memcmp(table->signature, "APIC", 4) == 0 && acpi_parse_madt((struct acpi_table_madt *)table) >= 0)
+		{
+			ret = 0;
+		}
+		iounmap(table);
+	}
+	iounmap(rsdt);
+
+	if (ret == 0)
+	{
+		printk("ACPI: MADT found, %d CPU(s), %d I/O APIC(s)\n", num_processors, nr_ioapics);
+	}
+	return ret;
+}
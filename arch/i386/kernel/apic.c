@@ -0,0 +1,251 @@
+/** Local APIC
+ * - Linux 2.6.11のarch/i386/kernel/apic.cに相当
+ * - Local APICを有効化し，8259Aの割り込みはLINT0（ExtINT）で従来通り受け取る（virtual wireモード）
+ * - Local APICタイマーをPITで較正し，CPUごとのクロックイベントデバイスとして登録する
+ */
+
+#include <asm-i386/apic.h>
+#include <asm-i386/desc.h>
+#include <asm-i386/i8253.h>
+#include <asm-i386/io.h>
+#include <asm-i386/msr.h>
+#include <asm-i386/page.h>
+#include <asm-i386/processor.h>
+#include <asm-i386/ptrace.h>
+#include <asm-i386/system.h>
+#include <kfs/clockchips.h>
+#include <kfs/printk.h>
+#include <kfs/smp.h>
+#include <kfs/stddef.h>
+
+/* 較正にかける時間（ミリ秒） */
+#define LAPIC_CAL_MS 10
+
+/* 割り込みエントリポイント（entry.Sで定義） */
+extern void apic_timer_interrupt(void);
+extern void spurious_interrupt(void);
+extern void reschedule_interrupt(void);
+extern void invalidate_interrupt(void);
+
+/* Local APICのMMIO領域 */
+volatile uint32_t *lapic_mmio;
+
+/* 16分周後のLocal APICタイマー周波数（Hz） */
+static uint32_t lapic_timer_frequency;
+
+/* スプリアス割り込みの回数 */
+static unsigned long spurious_count;
+
+/* タイマーを止める */
+static int lapic_timer_shutdown(struct clock_event_device *dev)
+{
+	(void)dev;
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TMICT, 0);
+	return 0;
+}
+
+/* HZ回/秒の周期割り込みを設定する */
+static int lapic_timer_set_periodic(struct clock_event_device *dev)
+{
+	(void)dev;
+	apic_write(APIC_TDCR, APIC_TDR_DIV_16);
+	apic_write(APIC_LVTT, APIC_LVT_TIMER_PERIODIC | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TMICT, lapic_timer_frequency / HZ);
+	return 0;
+}
+
+/* ワンショットモードにする（カウントはlapic_next_event()で書き込む） */
+static int lapic_timer_set_oneshot(struct clock_event_device *dev)
+{
+	(void)dev;
+	apic_write(APIC_TDCR, APIC_TDR_DIV_16);
+	apic_write(APIC_LVTT, LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TMICT, 0);
+	return 0;
+}
+
+/* deltaサイクル後に割り込むよう初期カウントを書き込む */
+static int lapic_next_event(unsigned long delta, struct clock_event_device *dev)
+{
+	(void)dev;
+	apic_write(APIC_TMICT, delta);
+	return 0;
+}
+
+/* ワンショットの残りカウントを読む */
+static unsigned long lapic_read_remaining(struct clock_event_device *dev)
+{
+	(void)dev;
+	return apic_read(APIC_TMCCT);
+}
+
+/** Local APICタイマーの雛形
+ * @note 各CPUは自分のLocal APICのタイマーを持つため，CPUごとにlapic_events[]へ写して登録する
+ */
+static const struct clock_event_device lapic_clockevent = {
+	.name = "lapic",
+	.features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT,
+	.rating = 100,
+	.min_delta_ticks = 0xF,
+	.max_delta_ticks = 0x7FFFFFFF,
+	.set_state_periodic = lapic_timer_set_periodic,
+	.set_state_oneshot = lapic_timer_set_oneshot,
+	.set_state_shutdown = lapic_timer_shutdown,
+	.set_next_event = lapic_next_event,
+	.read_remaining = lapic_read_remaining,
+};
+
+/* CPUごとのLocal APICタイマー */
+static struct clock_event_device lapic_events[NR_CPUS];
+
+/** Local APICタイマー割り込みのハンドラ
+ * @param regs 割り込み発生時のレジスタ状態
+ * @note entry.Sのapic_timer_interruptから呼ばれる
+ */
+void smp_apic_timer_interrupt(struct pt_regs *regs)
+{
+	struct clock_event_device *evt = &lapic_events[smp_processor_id()];
+
+	(void)regs;
+
+	ack_APIC_irq();
+	evt->event_handler(evt);
+}
+
+/** スプリアス割り込みのハンドラ
+ * @note スプリアス割り込みにはEOIを送らない
+ */
+void smp_spurious_interrupt(struct pt_regs *regs)
+{
+	(void)regs;
+	spurious_count++;
+}
+
+/** Local APICを有効化する
+ * @return 0: 成功, -1: Local APICがない，またはBIOSで無効化されている
+ * @details MMIO領域をキャッシュ無効でマップし，ソフトウェア有効化したうえで
+ *          LINT0をExtINT，LINT1をNMIに設定する．これにより8259Aからの割り込みは
+ *          有効化前と同じように届く
+ */
+int lapic_init(void)
+{
+	uint32_t lo, hi;
+	unsigned long flags;
+
+	if (!cpu_has(X86_FEATURE_APIC) || !cpu_has(X86_FEATURE_MSR))
+	{
+		return -1;
+	}
+
+	rdmsr(MSR_IA32_APICBASE, lo, hi);
+	(void)hi;
+	if (!(lo & MSR_IA32_APICBASE_ENABLE))
+	{
+		return -1;
+	}
+
+	lapic_mmio = ioremap(lo & MSR_IA32_APICBASE_BASE, PAGE_SIZE, IOREMAP_UC);
+	if (!lapic_mmio)
+	{
+		printk(KERN_WARNING "lapic: failed to map registers\n");
+		return -1;
+	}
+
+	set_intr_gate(LOCAL_TIMER_VECTOR, apic_timer_interrupt);
+	set_intr_gate(SPURIOUS_APIC_VECTOR, spurious_interrupt);
+	set_intr_gate(RESCHEDULE_VECTOR, reschedule_interrupt);
+	set_intr_gate(INVALIDATE_TLB_VECTOR, invalidate_interrupt);
+
+	/* ソフトウェア無効の間はLVTのマスクを外せないため，先に有効化する */
+	local_irq_save(flags);
+	apic_write(APIC_SPIV, APIC_SPIV_APIC_ENABLED | SPURIOUS_APIC_VECTOR);
+	apic_write(APIC_TASKPRI, 0);
+	apic_write(APIC_LVT0, APIC_DM_EXTINT);
+	apic_write(APIC_LVT1, APIC_DM_NMI);
+	apic_write(APIC_LVTERR, APIC_LVT_MASKED);
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+/** APのLocal APICを有効化する
+ * @details MMIO領域とIDTはBSPが設定したものを共有する．
+ *          8259Aの割り込みはBSPだけが受け取るため，LINT0はマスクする
+ * @note start_secondary()から割り込み禁止で呼ばれる
+ */
+void lapic_setup_ap(void)
+{
+	apic_write(APIC_SPIV, APIC_SPIV_APIC_ENABLED | SPURIOUS_APIC_VECTOR);
+	apic_write(APIC_TASKPRI, 0);
+	apic_write(APIC_LVT0, APIC_LVT_MASKED | APIC_DM_EXTINT);
+	apic_write(APIC_LVT1, APIC_DM_NMI);
+	apic_write(APIC_LVTERR, APIC_LVT_MASKED);
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+}
+
+/** Local APICタイマーの周波数をPITで測る
+ * @return 16分周後の周波数（Hz）
+ */
+static uint32_t lapic_calibrate(void)
+{
+	uint32_t start, elapsed;
+
+	apic_write(APIC_TDCR, APIC_TDR_DIV_16);
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TMICT, 0xFFFFFFFF);
+
+	pit_ch2_start(LAPIC_CAL_MS);
+	start = apic_read(APIC_TMCCT);
+	pit_ch2_wait();
+
+	elapsed = start - apic_read(APIC_TMCCT);
+	apic_write(APIC_TMICT, 0);
+
+	return elapsed * (1000 / LAPIC_CAL_MS);
+}
+
+/** 自CPUのLocal APICタイマーをクロックイベントデバイスとして登録する
+ * @note 登録したCPUのtickデバイスになる
+ */
+static void register_lapic_timer(void)
+{
+	struct clock_event_device *evt = &lapic_events[smp_processor_id()];
+
+	*evt = lapic_clockevent;
+	clockevents_config(evt, lapic_timer_frequency);
+	clockevents_register_device(evt);
+}
+
+/** Local APICタイマーを較正してクロックイベントデバイスとして登録する
+ * @note BSPで呼ぶ．PITより優先度が高いため，登録するとtickデバイスが置き換わる
+ */
+void setup_lapic_timer(void)
+{
+	lapic_timer_frequency = lapic_calibrate();
+	if (lapic_timer_frequency < HZ)
+	{
+		printk(KERN_WARNING "lapic: timer calibration failed\n");
+		lapic_timer_frequency = 0;
+		return;
+	}
+
+	printk("lapic: timer %u Hz (bus / 16)\n", lapic_timer_frequency);
+	register_lapic_timer();
+}
+
+/** APのLocal APICタイマーを登録する
+ * @details 全CPUのバスクロックは同じため，BSPで較正した周波数をそのまま使う．
+ *          APのtickはこのタイマーだけが発生させる（PITの割り込みはBSPにしか届かない）
+ * @note start_secondary()から割り込み禁止で呼ばれる
+ */
+void setup_secondary_lapic_timer(void)
+{
+	if (lapic_timer_frequency == 0)
+	{
+		printk(KERN_WARNING "lapic: CPU%d has no timer, scheduler ticks only on wakeups\n", smp_processor_id());
+		return;
+	}
+	register_lapic_timer();
+}
@@ -1,7 +1,10 @@
 /*
  * グローバルディスクリプタテーブル（GDT）の構築とロード
+ * - BSPのGDTは物理アドレス0x800に，APのGDTはCPUごとの配列に置く
+ * - GDTはCPUごとに別で，__KERNEL_PDAセグメントのベースが各CPUのPDAを指す
  */
 #include <asm-i386/desc.h>
+#include <asm-i386/pda.h>
 #include <kfs/printk.h>
 #include <kfs/stdint.h>
 
@@ -42,48 +45,70 @@ static inline uint8_t access_data(uint8_t dpl)
 	return ACC_P | (dpl << 5) | ACC_S | ACC_DATA_RDWR;
 }
 
-/* GDTを初期化してCPUに宣言する．メモリセグメント管理を有効化するために必要 */
-void gdt_init(void)
+/* フラグニブル: G=0(バイト粒度), D=1(32ビット) -> 0100b (0x4)．PDAのように小さなセグメント用 */
+#define SEG_FLAG_BYTE_32 0x4
+
+/* BSPの最初のタスク（kernel/sched/core.c） */
+extern struct task_struct init_task;
+
+/** 全CPUのPDA（CPUごとのデータ領域）
+ * @note BSPのPDAはgdt_init()の直後から使うため静的に初期化しておく．APのPDAはsmpboot.cが起動前に設定する
+ */
+struct i386_pda _cpu_pda[NR_CPUS] = {
+	[0] = {._pda = &_cpu_pda[0], .cpu_number = 0, .pcurrent = &init_task},
+};
+
+/* APのGDT（BSPのGDTは物理アドレス0x800に置く） */
+static uint64_t cpu_gdt_table[NR_CPUS][GDT_ENTRIES] __attribute__((aligned(8)));
+
+/** GDTエントリを構築する
+ * @param gdt 書き込み先（GDT_ENTRIES個）
+ * @param pda __KERNEL_PDAセグメントのベースにするPDA
+ * @details PDAセグメント以外は全CPUで同じフラットメモリモデル
+ */
+static void build_gdt(volatile uint64_t *gdt, struct i386_pda *pda)
 {
 	/* フラットメモリモデル: base=0, limit=0xFFFFF（4K粒度で実質4GiB全域をカバー） */
 	const uint32_t base = 0x00000000;
 	const uint32_t limit = 0x000FFFFF; /* 20ビット最大値 */
 
-	/* 一時バッファでGDTエントリを構築（7エントリ: NULL + カーネル3 + ユーザ3） */
-	uint64_t gdt_build[GDT_ENTRIES];
-	gdt_build[GDT_ENTRY_NULL] = 0x0000000000000000ULL; /* NULLディスクリプタ（x86仕様で必須） */
-	gdt_build[GDT_ENTRY_KERNEL_CS] =
+	/* 8エントリ: NULL + カーネル3 + ユーザ3 + PDA */
+	gdt[GDT_ENTRY_NULL] = 0x0000000000000000ULL; /* NULLディスクリプタ（x86仕様で必須） */
+	gdt[GDT_ENTRY_KERNEL_CS] =
 		make_seg_desc(base, limit, access_code(0), SEG_FLAG_GRAN_4K_32); /* カーネルコード（DPL=0） */
-	gdt_build[GDT_ENTRY_KERNEL_DS] =
+	gdt[GDT_ENTRY_KERNEL_DS] =
 		make_seg_desc(base, limit, access_data(0), SEG_FLAG_GRAN_4K_32); /* カーネルデータ（DPL=0） */
-	gdt_build[GDT_ENTRY_KERNEL_SS] =
+	gdt[GDT_ENTRY_KERNEL_SS] =
 		make_seg_desc(base, limit, access_data(0), SEG_FLAG_GRAN_4K_32); /* カーネルスタック専用セグメント（DPL=0） */
-	gdt_build[GDT_ENTRY_USER_CS] =
+	gdt[GDT_ENTRY_USER_CS] =
 		make_seg_desc(base, limit, access_code(3), SEG_FLAG_GRAN_4K_32); /* ユーザコード（DPL=3） */
-	gdt_build[GDT_ENTRY_USER_DS] =
+	gdt[GDT_ENTRY_USER_DS] =
 		make_seg_desc(base, limit, access_data(3), SEG_FLAG_GRAN_4K_32); /* ユーザデータ（DPL=3） */
-	gdt_build[GDT_ENTRY_USER_SS] =
+	gdt[GDT_ENTRY_USER_SS] =
 		make_seg_desc(base, limit, access_data(3), SEG_FLAG_GRAN_4K_32); /* ユーザスタック専用セグメント（DPL=3） */
+	gdt[GDT_ENTRY_PDA] = make_seg_desc((uint32_t)pda, sizeof(*pda) - 1, access_data(0),
+									   SEG_FLAG_BYTE_32); /* このCPUのPDA（DPL=0） */
+}
 
-	/* 仕様で要求された物理アドレス0x800にGDTをコピー */
-	volatile uint64_t *gdt_phys = (volatile uint64_t *)KFS_GDT_PHYS;
-	for (int i = 0; i < GDT_ENTRIES; ++i)
-	{
-		gdt_phys[i] = gdt_build[i];
-	}
-
+/** GDTをロードしてセグメントレジスタを再ロードする
+ * @param address GDTの線形アドレス
+ * @note %fsには自CPUのPDAセグメントを入れる（read_pda()/currentが使う）
+ */
+static void load_gdt(uint32_t address)
+{
 	/* GDTR（GDTレジスタ）用の構造体を準備 */
 	struct desc_ptr gdtp;
 	gdtp.size = (uint16_t)(GDT_ENTRIES * 8 - 1); /* GDTサイズ-1（CPUの仕様） */
-	gdtp.address = (uint32_t)KFS_GDT_PHYS;		 /* GDTの物理アドレス */
+	gdtp.address = address;						 /* GDTのアドレス */
 
 	/* GDTRをロードし、セグメントレジスタを新しいセレクタで再ロード．far jumpでCSを更新 */
 	asm volatile("lgdt %[gdtp]\n\t" /* GDTRにGDTのアドレスとサイズを登録 */
 				 "mov %[ds_sel], %%ax\n\t"
 				 "mov %%ax, %%ds\n\t" /* データセグメントレジスタを更新 */
 				 "mov %%ax, %%es\n\t" /* 拡張セグメントレジスタを更新 */
-				 "mov %%ax, %%fs\n\t" /* 追加セグメントレジスタFSを更新 */
 				 "mov %%ax, %%gs\n\t" /* 追加セグメントレジスタGSを更新 */
+				 "mov %[pda_sel], %%ax\n\t"
+				 "mov %%ax, %%fs\n\t" /* FSは自CPUのPDAを指す */
 				 "mov %[ss_sel], %%ax\n\t"
 				 "mov %%ax, %%ss\n\t" /* スタックセグメントレジスタを更新 */
 				 /* far jumpでCSを強制リロード（CPUの命令キャッシュをフラッシュ） */
@@ -91,6 +116,24 @@ void gdt_init(void)
 				 "1:\n\t"
 				 :
 				 : [gdtp] "m"(gdtp), [ds_sel] "r"((uint16_t)__KERNEL_DS), [ss_sel] "r"((uint16_t)__KERNEL_SS),
-				   [cs_sel] "i"(__KERNEL_CS)
+				   [pda_sel] "r"((uint16_t)__KERNEL_PDA), [cs_sel] "i"(__KERNEL_CS)
 				 : "ax");
 }
+
+/* GDTを初期化してCPUに宣言する．メモリセグメント管理を有効化するために必要 */
+void gdt_init(void)
+{
+	/* 仕様で要求された物理アドレス0x800にBSPのGDTを構築してロード */
+	build_gdt((volatile uint64_t *)KFS_GDT_PHYS, cpu_pda(0));
+	load_gdt((uint32_t)KFS_GDT_PHYS);
+}
+
+/** APのGDTを構築してロードする
+ * @param cpu 論理CPU番号
+ * @note trampoline.Sの一時的なGDTから切り替えるため，start_secondary()の最初に呼ぶ
+ */
+void cpu_gdt_init(int cpu)
+{
+	build_gdt(cpu_gdt_table[cpu], cpu_pda(cpu));
+	load_gdt((uint32_t)cpu_gdt_table[cpu]);
+}
@@ -0,0 +1,151 @@
+/** 8253/8254 PIT (Programmable Interval Timer) ドライバ
+ * - Linux 6.18のdrivers/clocksource/i8253.cに相当
+ * - チャネル0をクロックイベントデバイスとしてIRQ0で使う
+ * - チャネル2はLocal APICタイマー等の較正用のビジーウェイトに使う
+ */
+
+#include <asm-i386/i8253.h>
+#include <asm-i386/io.h>
+#include <asm-i386/processor.h>
+#include <asm-i386/ptrace.h>
+#include <kfs/clockchips.h>
+#include <kfs/irq.h>
+#include <kfs/printk.h>
+
+/* モード/コマンドレジスタの値（チャネル0，下位→上位バイトの順にアクセス） */
+#define PIT_CMD_CH0_MODE0 0x30 /* モード0: カウント終了で割り込み（停止用） */
+#define PIT_CMD_CH0_MODE2 0x34 /* モード2: レートジェネレータ（周期） */
+#define PIT_CMD_CH0_MODE4 0x38 /* モード4: ソフトウェアストローブ（ワンショット） */
+#define PIT_CMD_CH0_LATCH 0x00 /* チャネル0のカウント値をラッチする */
+#define PIT_CMD_CH2_MODE0 0xB0 /* チャネル2，モード0 */
+
+/* カウンタを止める（カウント0のモード0は，1周して1回割り込んだ後は何もしない） */
+static int pit_shutdown(struct clock_event_device *dev)
+{
+	(void)dev;
+	outb(PIT_MODE, PIT_CMD_CH0_MODE0);
+	outb(PIT_CH0, 0);
+	outb(PIT_CH0, 0);
+	return 0;
+}
+
+/* HZ回/秒の周期割り込みを設定する */
+static int pit_set_periodic(struct clock_event_device *dev)
+{
+	(void)dev;
+	outb(PIT_MODE, PIT_CMD_CH0_MODE2);
+	outb(PIT_CH0, LATCH & 0xFF);
+	outb(PIT_CH0, LATCH >> 8);
+	return 0;
+}
+
+/* ワンショットモードにする（カウント値はpit_next_event()で書き込む） */
+static int pit_set_oneshot(struct clock_event_device *dev)
+{
+	(void)dev;
+	outb(PIT_MODE, PIT_CMD_CH0_MODE4);
+	return 0;
+}
+
+/* deltaサイクル後に割り込むようカウント値を書き込む */
+static int pit_next_event(unsigned long delta, struct clock_event_device *dev)
+{
+	(void)dev;
+	outb(PIT_CH0, delta & 0xFF);
+	outb(PIT_CH0, (delta >> 8) & 0xFF);
+	return 0;
+}
+
+/* ワンショットの残りカウントを読む */
+static unsigned long pit_read_remaining(struct clock_event_device *dev)
+{
+	uint8_t lo, hi;
+
+	(void)dev;
+	outb(PIT_MODE, PIT_CMD_CH0_LATCH);
+	lo = inb(PIT_CH0);
+	hi = inb(PIT_CH0);
+	return ((unsigned long)hi << 8) | lo;
+}
+
+static struct clock_event_device pit_ce = {
+	.name = "pit",
+	.features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT,
+	.rating = 50,
+	.min_delta_ticks = 0xF,
+	.max_delta_ticks = 0x7FFF,
+	.set_state_periodic = pit_set_periodic,
+	.set_state_oneshot = pit_set_oneshot,
+	.set_state_shutdown = pit_shutdown,
+	.set_next_event = pit_next_event,
+	.read_remaining = pit_read_remaining,
+};
+
+/** IRQ0のハンドラ
+ * @note tick層が設定したevent_handlerに処理を委ねる
+ */
+static int timer_interrupt(int irq, struct pt_regs *regs)
+{
+	(void)irq;
+	(void)regs;
+
+	pit_ce.event_handler(&pit_ce);
+	return IRQ_HANDLED;
+}
+
+/** PITをクロックイベントデバイスとして登録する
+ * @note 登録（周期モードの設定）を済ませてからIRQ0を有効にする
+ */
+void setup_pit_timer(void)
+{
+	clockevents_config(&pit_ce, PIT_TICK_RATE);
+	clockevents_register_device(&pit_ce);
+
+	if (request_irq(PIT_IRQ, timer_interrupt, "timer", &pit_ce) < 0)
+	{
+		printk(KERN_WARNING "pit: IRQ%d is already in use\n", PIT_IRQ);
+	}
+}
+
+/** チャネル2でmsミリ秒のカウントを開始する
+ * @param ms 計測する時間（最大50ミリ秒）
+ * @details チャネル2をモード0で設定する．カウントが0になると出力（ポート0x61のbit5）が立つ．
+ *          割り込みを使わないため，他のタイマーの較正に使える
+ * @note 較正ではカウント開始後に計測対象を読み，pit_ch2_wait()の後にもう一度読む．
+ *       ポートへの書き込み時間が計測区間に入らないようにするため，開始と待機を分けている
+ */
+void pit_ch2_start(unsigned int ms)
+{
+	unsigned long latch;
+
+	if (ms > 50)
+	{
+		ms = 50;
+	}
+	latch = PIT_TICK_RATE * ms / 1000;
+
+	/* ゲートを開き，スピーカー出力は切る */
+	outb(PIT_GATE2, (inb(PIT_GATE2) & ~0x02) | 0x01);
+
+	outb(PIT_MODE, PIT_CMD_CH2_MODE0);
+	outb(PIT_CH2, latch & 0xFF);
+	outb(PIT_CH2, (latch >> 8) & 0xFF);
+}
+
+/* pit_ch2_start()で開始したカウントが0になるまで待つ */
+void pit_ch2_wait(void)
+{
+	while ((inb(PIT_GATE2) & 0x20) == 0)
+	{
+		cpu_relax();
+	}
+}
+
+/** チャネル2を使ってmsミリ秒ビジーウェイトする
+ * @param ms 待つ時間（最大50ミリ秒）
+ */
+void pit_busy_wait_ms(unsigned int ms)
+{
+	pit_ch2_start(ms);
+	pit_ch2_wait();
+}
@@ -0,0 +1,228 @@
+/** MPテーブルの解析
+ * - Linux 2.6.11のarch/i386/kernel/mpparse.cに相当
+ * - BIOS領域からMP Floating Pointerを探し，MP Configuration TableからCPUとI/O APICを列挙する
+ * - ACPI MADT（acpi.c）からもmp_register_*()で同じ表に登録する
+ */
+
+#include <asm-i386/io.h>
+#include <asm-i386/mpspec.h>
+#include <asm-i386/page.h>
+#include <kfs/printk.h>
+#include <kfs/stddef.h>
+#include <kfs/string.h>
+
+/* 使用可能なCPUのLocal APIC ID */
+uint8_t mp_lapic_ids[NR_CPUS];
+int num_processors;
+
+/* I/O APIC */
+struct mp_ioapic mp_ioapics[MAX_IO_APICS];
+int nr_ioapics;
+
+/** バイト列の和を計算する
+ * @return 和（下位8ビット）．MP/ACPIのテーブルは0なら正しい
+ */
+static uint8_t mpf_checksum(const unsigned char *mp, int len)
+{
+	uint8_t sum = 0;
+
+	while (len--)
+	{
+		sum += *mp++;
+	}
+	return sum;
+}
+
+/** CPUを登録する
+ * @param id      Local APIC ID
+ * @param enabled 0ならBIOSが無効にしたCPUとして無視する
+ * @note 同じIDの二重登録とNR_CPUSを超える分は無視する
+ */
+void mp_register_lapic(uint8_t id, int enabled)
+{
+	int i;
+
+	if (!enabled)
+	{
+		return;
+	}
+	for (i = 0; i < num_processors; i++)
+	{
+		if (mp_lapic_ids[i] == id)
+		{
+			return;
+		}
+	}
+	if (num_processors >= NR_CPUS)
+	{
+		printk(KERN_WARNING "SMP: NR_CPUS (%d) reached, ignoring APIC %u\n", NR_CPUS, id);
+		return;
+	}
+	mp_lapic_ids[num_processors++] = id;
+}
+
+/** I/O APICを登録する
+ * @param id      I/O APIC ID
+ * @param address MMIOの物理アドレス
+ */
+void mp_register_ioapic(uint8_t id, uint32_t address)
+{
+	if (nr_ioapics >= MAX_IO_APICS)
+	{
+		printk(KERN_WARNING "SMP: too many I/O APICs, ignoring APIC %u\n", id);
+		return;
+	}
+	mp_ioapics[nr_ioapics].id = id;
+	mp_ioapics[nr_ioapics].address = address;
+	nr_ioapics++;
+}
+
+/** MP Configuration Tableを読む
+ * @param mpc テーブルの先頭（mpc_length分アクセスできること）
+ * @return 登録したCPUの数，テーブルが壊れていれば-1
+ */
+int smp_read_mpc(struct mp_config_table *mpc)
+{
+	unsigned char *p = (unsigned char *)(mpc + 1);
+	unsigned char *end = (unsigned char *)mpc + mpc->mpc_length;
+	int before = num_processors;
+
+	if (memcmp(mpc->mpc_signature, "PCMP", 4) != 0)
+	{
+		printk(KERN_WARNING "SMP: bad MP table signature\n");
+		return -1;
+	}
+	if (mpf_checksum((unsigned char *)mpc, mpc->mpc_length) != 0)
+	{
+		printk(KERN_WARNING "SMP: MP table checksum error\n");
+		return -1;
+	}
+
+	while (p < end)
+	{
+		switch (*p)
+		{
+		case MP_PROCESSOR:
+		{
+			struct mpc_config_processor *m = (struct mpc_config_processor *)p;
+
+			mp_register_lapic(m->mpc_apicid, m->mpc_cpuflag & CPU_ENABLED);
+			p += sizeof(*m);
+			break;
+		}
+		case MP_IOAPIC:
+		{
+			struct mpc_config_ioapic *m = (struct mpc_config_ioapic *)p;
+
+			if (m->mpc_flags & MPC_APIC_USABLE)
+			{
+				mp_register_ioapic(m->mpc_apicid, m->mpc_apicaddr);
+			}
+			p += sizeof(*m);
+			break;
+		}
+		case MP_BUS:
+		case MP_INTSRC:
+		case MP_LINTSRC:
+			p += 8;
+			break;
+		default:
+			/* 未知のエントリは長さがわからないため，ここで打ち切る */
+			printk(KERN_WARNING "SMP: unknown MP table entry type %u\n", *p);
+			return num_processors - before;
+		}
+	}
+	return num_processors - before;
+}
+
+/** 物理アドレスの範囲からMP Floating Pointerを探す
+ * @param base   探す範囲の物理アドレス（1MB未満）
+ * @param length 探す範囲の長さ
+ * @return 見つかったMP Floating Pointer（仮想アドレス），なければNULL
+ */
+static struct intel_mp_floating *smp_scan_config(unsigned long base, unsigned long length)
+{
+	unsigned char *p = __va(base);
+	unsigned char *end = p + length;
+
+	for (; p + sizeof(struct intel_mp_floating) <= end; p += 16)
+	{
+		struct intel_mp_floating *mpf = (struct intel_mp_floating *)p;
+
+		if (memcmp(mpf->mpf_signature, "_MP_", 4) == 0 && mpf->mpf_length == 1 &&
+			mpf_checksum(p, sizeof(*mpf)) == 0)
+		{
+			return mpf;
+		}
+	}
+	return NULL;
+}
+
+/** MP Floating Pointerを探す
+ * @details 仕様の順に，EBDAの先頭1KB，基本メモリの最後の1KB，BIOS ROM（0xF0000-0xFFFFF）を探す
+ */
+static struct intel_mp_floating *find_smp_config(void)
+{
+	struct intel_mp_floating *mpf;
+	unsigned long ebda = (unsigned long)(*(uint16_t *)__va(0x40E)) << 4;
+
+	if (ebda && (mpf = smp_scan_config(ebda, 1024)) != NULL)
+	{
+		return mpf;
+	}
+	if ((mpf = smp_scan_config(0x9FC00, 1024)) != NULL)
+	{
+		return mpf;
+	}
+	return smp_scan_config(0xF0000, 0x10000);
+}
+
+/** MPテーブルからCPUとI/O APICを登録する
+ * @return 0=成功，-1=MPテーブルがないか使えない
+ * @note テーブルは高位の物理アドレスにありうるため，ioremapで読む
+ */
+int get_smp_config(void)
+{
+	struct intel_mp_floating *mpf = find_smp_config();
+	struct mp_config_table *mpc;
+	uint16_t length;
+	int ret;
+
+	if (mpf == NULL)
+	{
+		return -1;
+	}
+	if (mpf->mpf_feature1 != 0 || mpf->mpf_physptr == 0)
+	{
+		printk(KERN_WARNING "SMP: MP default configuration %u not supported\n", mpf->mpf_feature1);
+		return -1;
+	}
+
+	mpc = ioremap(mpf->mpf_physptr, sizeof(*mpc), IOREMAP_UC);
+	if (mpc == NULL)
+	{
+		return -1;
+	}
+	length = mpc->mpc_length;
+	iounmap(mpc);
+
+	mpc = ioremap(mpf->mpf_physptr, length, IOREMAP_UC);
+	if (mpc == NULL)
+	{
+		return -1;
+	}
+	ret = smp_read_mpc(mpc);
+	iounmap(mpc);
+
+	printk("SMP: MP table v1.%u found, %d CPU(s)\n", mpf->mpf_specification, num_processors);
+	return ret < 0 ? -1 : 0;
+}
+
+/**
+ * テスト用: 検出したCPUとI/O APICを忘れる
+ */
+void mp_reset_for_test(void)
+{
+	num_processors = 0;
+	nr_ioapics = 0;
+}
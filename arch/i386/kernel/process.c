@@ -0,0 +1,152 @@
+/** プロセスのCPU状態
+ * - Linux 2.6.11のarch/i386/kernel/process.cに相当
+ * - 新しいタスクの初期スタックの構築と，コンテキストスイッチの後半，アイドルループを担う
+ */
+
+#include <asm-i386/processor.h>
+#include <asm-i386/system.h>
+#include <kfs/clockchips.h>
+#include <kfs/cpuidle.h>
+#include <kfs/linkage.h>
+#include <kfs/preempt.h>
+#include <kfs/printk.h>
+#include <kfs/sched.h>
+
+/* arch/i386/kernel/entry.S */
+extern void ret_from_fork(void);
+
+/** 新しいタスクの初期スタックとthread_structを設定する
+ * @param p   新しいタスク（p->stackが割り当て済みであること）
+ * @param fn  最初に実行する関数（NULLなら即座に終了する）
+ * @param arg fnに渡す引数
+ * @details スタックの最上位に[fn][arg]を積み，再開アドレスをret_from_forkにする．
+ *          初めてスケジュールされると，switch_to()はret_from_forkへ戻る．
+ */
+void copy_thread(struct task_struct *p, int (*fn)(void *), void *arg)
+{
+	unsigned long *sp = (unsigned long *)((char *)p->stack + THREAD_SIZE);
+
+	*--sp = (unsigned long)arg;
+	*--sp = (unsigned long)fn;
+
+	p->thread.esp = (unsigned long)sp;
+	p->thread.eip = (unsigned long)ret_from_fork;
+}
+
+/** コンテキストスイッチの後半
+ * @param prev 直前まで実行していたタスク
+ * @param next これから実行するタスク
+ * @return prev（switch_to()のlastになる）
+ * @details switch_to()からジャンプで呼ばれ，nextのスタック上でretしてnextを再開する．
+ *          ここではこのCPUのcurrent（PDAのpcurrent）の更新のみを行う．
+ * @note EAX/EDXで引数を受け取るためfastcallにする
+ */
+struct task_struct *fastcall __switch_to(struct task_struct *prev, struct task_struct *next)
+{
+	write_pda(pcurrent, next);
+	return prev;
+}
+
+/* HLTで割り込みまで休止する */
+static void default_idle(void)
+{
+	safe_halt();
+}
+
+/** MONITOR/MWAITで休止する
+ * @details 再スケジュール要求のフラグ（thread_info.flags）を監視するため，
+ *          他のCPUがフラグを立てるだけでIPIなしに起きる．割り込みでも起きる．
+ *          監視している間はTIF_POLLING_NRFLAGを立て，resched_curr()にIPIを省かせる
+ */
+static void mwait_idle(void)
+{
+	set_tsk_thread_flag(current, TIF_POLLING_NRFLAG);
+	__monitor(&current->thread_info.flags, 0, 0);
+	if (!need_resched())
+	{
+		__sti_mwait(0, 0);
+	}
+	else
+	{
+		local_irq_enable();
+	}
+	clear_tsk_thread_flag(current, TIF_POLLING_NRFLAG);
+}
+
+/** 休止に使う関数
+ * @note 割り込み禁止で呼ばれ，割り込みを許可して休止し，起きたら割り込み許可のまま戻る
+ */
+void (*pm_idle)(void) = default_idle;
+
+/** 休止に使う命令を選ぶ
+ * @details CPUIDがMONITOR/MWAITを報告し，leaf 5がC1のサブステートを持つと報告すればMWAITを，
+ *          そうでなければHLTを使う
+ * @note Linux 2.6.11のselect_idle_routine()に相当する．全CPUが同じ種類であることを前提に，BSPで1度だけ呼ぶ
+ */
+void select_idle_routine(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	pm_idle = default_idle;
+	if (!cpu_has_mwait)
+	{
+		return;
+	}
+	cpuid(0, &eax, &ebx, &ecx, &edx);
+	if (eax < CPUID_MWAIT_LEAF)
+	{
+		return;
+	}
+	cpuid(CPUID_MWAIT_LEAF, &eax, &ebx, &ecx, &edx);
+	if (MWAIT_C1_SUBSTATES(edx) != 0)
+	{
+		pm_idle = mwait_idle;
+		printk("cpuidle: using mwait in idle threads\n");
+	}
+}
+
+/* 選んだ休止命令の名前（表示用） */
+const char *idle_routine_name(void)
+{
+	return pm_idle == mwait_idle ? "mwait" : "hlt";
+}
+
+/** アイドルループ
+ * @details 実行可能なタスクがない間は，登録された後回しの仕事を片付けてから，tickを止めてCPUを休止する．
+ *          再スケジュール要求が来たら切り替える．判定から休止までを割り込み禁止で行い，
+ *          割り込みの許可と休止を1続きの命令（sti; hlt，sti; mwait）で行うため，その間の起床を取りこぼさない
+ * @note BSPではinit_task（PID 0）が最後に呼び，APでは起動したアイドルタスクが呼ぶ．tickを止めたまま他のタスクに切り替わらないよう，
+ *       ループ中はプリエンプトを禁止する．Linux 2.6.11のcpu_idle()に相当する
+ */
+void cpu_idle(void)
+{
+	for (;;)
+	{
+		preempt_disable();
+		while (!need_resched())
+		{
+			/* 仕事が残っていれば，眠らずに再スケジュール要求を確かめ直す */
+			if (run_idle_work())
+			{
+				continue;
+			}
+
+			local_irq_disable();
+			tick_nohz_idle_enter();
+			if (!need_resched())
+			{
+				cpuidle_account_enter();
+				pm_idle();
+				cpuidle_account_exit();
+			}
+			else
+			{
+				local_irq_enable();
+			}
+			tick_nohz_idle_exit();
+		}
+		cpuidle_account_wakeup();
+		preempt_enable_no_resched();
+		schedule();
+	}
+}
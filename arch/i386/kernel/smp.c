@@ -0,0 +1,139 @@
+/** CPU間割り込み（IPI）
+ * - Linux 2.6.11のarch/i386/kernel/smp.cに相当
+ * - 他のCPUのランキューにタスクを置いたときや，アイドル中のCPUに負荷分散を促すときに，
+ *   そのCPUに再スケジュールを促す
+ * - カーネルのマッピングを外したときに，他のCPUのTLBも無効化させる（TLBシュートダウン）
+ */
+
+#include <asm-i386/apic.h>
+#include <asm-i386/pgtable.h>
+#include <asm-i386/processor.h>
+#include <asm-i386/ptrace.h>
+#include <asm-i386/smp.h>
+#include <asm-i386/system.h>
+#include <kfs/smp.h>
+#include <kfs/spinlock.h>
+#include <kfs/stddef.h>
+
+/* これより多くのページを無効化するときは1ページずつではなくTLB全体をフラッシュする */
+#define FLUSH_TLB_SINGLE_MAX 32
+
+/** TLBシュートダウンの要求
+ * @note flush_lockを持つCPUだけが書き込む．flush_cpumaskのビットは各CPUが無効化を終えたら落とす
+ */
+static DEFINE_SPINLOCK(flush_lock);
+static volatile unsigned long flush_cpumask;
+static unsigned long flush_start;
+static unsigned long flush_end;
+
+/** 再スケジュールを促すIPIを送る
+ * @param cpu 宛先の論理CPU番号
+ * @details 呼び出し元が宛先の実行中タスクにTIF_NEED_RESCHEDを立てておく．
+ *          IPIはそのCPUを休止から起こし，割り込みからの復帰（ret_from_intr）でフラグを見させるためだけに送る
+ * @note Local APICがなければAPも起動していないため，何もしない．
+ *       ICR2とICRの書き込みの間に割り込みハンドラから別のIPIを送られないよう，割り込みを禁止して送る
+ */
+void smp_send_reschedule(int cpu)
+{
+	unsigned long flags;
+
+	if (lapic_mmio == NULL || !cpu_online(cpu))
+	{
+		return;
+	}
+	local_irq_save(flags);
+	apic_icr_write(cpu_to_apicid[cpu], APIC_DM_FIXED | RESCHEDULE_VECTOR);
+	local_irq_restore(flags);
+}
+
+/** 再スケジュールIPIのハンドラ
+ * @note 切り替えはentry.Sのret_from_intrで行うため，ここではEOIを送るだけでよい
+ */
+void smp_reschedule_interrupt(struct pt_regs *regs)
+{
+	(void)regs;
+	ack_APIC_irq();
+}
+
+/** 自分のCPUのTLBから[start, end)を無効化する
+ * @note 範囲が広ければTLB全体をフラッシュする．カーネルはグローバルページを使わないため，CR3の再ロードで足りる
+ */
+static void local_flush_tlb_range(unsigned long start, unsigned long end)
+{
+	unsigned long addr;
+
+	if ((end - start) >> PAGE_SHIFT > FLUSH_TLB_SINGLE_MAX)
+	{
+		__flush_tlb();
+		return;
+	}
+	for (addr = start; addr < end; addr += PAGE_SIZE)
+	{
+		__flush_tlb_one(addr);
+	}
+}
+
+/** 全CPUのTLBから[start, end)を無効化する
+ * @param start 無効化する範囲の先頭（ページ境界）
+ * @param end   無効化する範囲の終端（ページ境界，startを含まない）
+ * @details 自分のCPUを無効化してから他の起動済みCPUにINVALIDATE_TLB_VECTORのIPIを送り，
+ *          全CPUが無効化を終えるまで待つ．戻った後は，外したマッピングの仮想アドレスや
+ *          ページテーブルを再利用してよい
+ * @note 割り込みを許可した状態で呼ぶこと（2つのCPUが割り込み禁止で互いの応答を待つとデッドロックする）．
+ *       Local APICがなければAPも起動していないため，自分のCPUだけを無効化する
+ * @note Linux 2.6.11のflush_tlb_others()に相当する
+ */
+void flush_tlb_kernel_range(unsigned long start, unsigned long end)
+{
+	unsigned long mask;
+	int cpu;
+
+	spin_lock(&flush_lock);
+	local_flush_tlb_range(start, end);
+
+	mask = cpu_online_map & ~(1UL << smp_processor_id());
+	if (lapic_mmio == NULL || mask == 0)
+	{
+		spin_unlock(&flush_lock);
+		return;
+	}
+
+	flush_start = start;
+	flush_end = end;
+	flush_cpumask = mask;
+	for_each_online_cpu(cpu)
+	{
+		unsigned long flags;
+
+		if (!(mask & (1UL << cpu)))
+		{
+			continue;
+		}
+		local_irq_save(flags);
+		apic_icr_write(cpu_to_apicid[cpu], APIC_DM_FIXED | INVALIDATE_TLB_VECTOR);
+		local_irq_restore(flags);
+	}
+
+	while (flush_cpumask != 0)
+	{
+		cpu_relax();
+	}
+	spin_unlock(&flush_lock);
+}
+
+/* 全CPUのTLB全体を無効化する */
+void flush_tlb_all(void)
+{
+	flush_tlb_kernel_range(0, ~0UL & PAGE_MASK);
+}
+
+/** TLB無効化IPIのハンドラ
+ * @note 無効化してからflush_cpumaskの自分のビットを落とし，要求したCPUに終わったことを知らせる
+ */
+void smp_invalidate_interrupt(struct pt_regs *regs)
+{
+	(void)regs;
+	local_flush_tlb_range(flush_start, flush_end);
+	clear_bit(smp_processor_id(), &flush_cpumask);
+	ack_APIC_irq();
+}
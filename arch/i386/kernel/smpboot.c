@@ -0,0 +1,163 @@
+/** APの起動
+ * - Linux 2.6.11のarch/i386/kernel/smpboot.cに相当
+ * - ACPI MADT（なければMPテーブル）からCPUを列挙し，INIT-SIPI-SIPIでAP（Application Processor）を1つずつ起動する
+ * - APはtrampoline.Sでリアルモードから保護モードとページングに入り，start_secondary()でGDT・IDT・PDAを設定する
+ */
+
+#include <asm-i386/acpi.h>
+#include <asm-i386/apic.h>
+#include <asm-i386/desc.h>
+#include <asm-i386/i8253.h>
+#include <asm-i386/io.h>
+#include <asm-i386/mpspec.h>
+#include <asm-i386/page.h>
+#include <asm-i386/pda.h>
+#include <asm-i386/processor.h>
+#include <asm-i386/smp.h>
+#include <asm-i386/system.h>
+#include <kfs/printk.h>
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/string.h>
+
+/* APが起動を報告するまで待つ時間（10ミリ秒単位） */
+#define AP_CALLIN_TIMEOUT 100
+
+/* 起動済みCPU（BSPは最初から起動済み） */
+volatile unsigned long cpu_online_map = 1;
+
+/* 論理CPU番号からLocal APIC IDへの対応 */
+uint8_t cpu_to_apicid[NR_CPUS];
+
+/* 起動中のAPのスタックの先頭と論理CPU番号（APは1つずつ起動するため1組で足りる） */
+unsigned long stack_start;
+static volatile int booting_cpu;
+
+/** APの最初のCの関数
+ * @details trampoline.Sの一時的なGDTから自分のGDTに切り替えて%fsに自分のPDAを入れ，
+ *          IDTとLocal APICとそのタイマーを設定してから起動済みを報告し，アイドルループに入る
+ * @note 起動済みを報告した時点から，起床やforkしたタスクが置かれ，負荷分散で引き取りに行く．
+ *       jiffiesと時刻はBSPだけが進め，APのタイマーはスケジューラのtickにだけ使う．
+ *       LINT0はマスクしてあるため，8259の割り込みはBSPにだけ届く
+ */
+void start_secondary(void)
+{
+	int cpu = booting_cpu;
+
+	cpu_gdt_init(cpu);
+	cpu_idt_init();
+	lapic_setup_ap();
+	pat_init();
+	setup_secondary_lapic_timer();
+	current->on_cpu = 1;
+
+	/* BSPはこのビットを見て次のAPの起動に進む */
+	barrier();
+	set_bit(cpu, &cpu_online_map);
+
+	cpu_idle();
+}
+
+/** INIT-SIPI-SIPIでAPを起動する
+ * @param apicid  起動するAPのLocal APIC ID
+ * @param start_eip 実行を始める物理アドレス（1MB未満の4KB境界）
+ * @details Intel MP仕様B.4の手順: INITをアサート・デアサートして10ms待ち，Startup IPIを2回送る
+ */
+static void wakeup_secondary_cpu(uint8_t apicid, unsigned long start_eip)
+{
+	int i;
+
+	apic_icr_write(apicid, APIC_INT_LEVELTRIG | APIC_INT_ASSERT | APIC_DM_INIT);
+	apic_icr_write(apicid, APIC_INT_LEVELTRIG | APIC_DM_INIT);
+	apic_wait_icr_idle();
+	pit_busy_wait_ms(10);
+
+	for (i = 0; i < 2; i++)
+	{
+		apic_icr_write(apicid, APIC_DM_STARTUP | (start_eip >> 12));
+		apic_wait_icr_idle();
+		pit_busy_wait_ms(1);
+	}
+}
+
+/** APを1つ起動する
+ * @param apicid 起動するAPのLocal APIC ID
+ * @param cpu    割り当てる論理CPU番号
+ * @return 0=起動した，-1=失敗
+ * @note 応答しなかったAPが後から起動してもよいよう，アイドルタスクとスタックは解放しない
+ */
+static int do_boot_cpu(uint8_t apicid, int cpu)
+{
+	struct task_struct *idle;
+	struct i386_pda *pda = cpu_pda(cpu);
+	int timeout;
+
+	idle = fork_idle(cpu);
+	if (idle == NULL)
+	{
+		printk(KERN_WARNING "SMP: no memory for CPU%d idle task\n", cpu);
+		return -1;
+	}
+
+	pda->_pda = pda;
+	pda->cpu_number = cpu;
+	pda->pcurrent = idle;
+	cpu_to_apicid[cpu] = apicid;
+	init_idle(idle, cpu);
+
+	stack_start = (unsigned long)idle->stack + THREAD_SIZE;
+	booting_cpu = cpu;
+	wakeup_secondary_cpu(apicid, TRAMPOLINE_BASE);
+
+	for (timeout = 0; timeout < AP_CALLIN_TIMEOUT && !cpu_online(cpu); timeout++)
+	{
+		pit_busy_wait_ms(10);
+	}
+	if (!cpu_online(cpu))
+	{
+		printk(KERN_WARNING "SMP: CPU%d (APIC %u) not responding\n", cpu, apicid);
+		return -1;
+	}
+
+	printk("SMP: CPU%d (APIC %u) online\n", cpu, apicid);
+	return 0;
+}
+
+/** 全てのAPを起動する
+ * @details ACPI MADT，なければMPテーブルからCPUを列挙し，BSP以外を順に起動する．
+ *          論理CPU番号はBSPを0として起動できた順に振る
+ * @note Local APICのMMIOとioremapを使うため，time_init()の後に呼ぶこと
+ */
+void smp_init(void)
+{
+	int i, cpu = 1;
+
+	if (lapic_mmio == NULL)
+	{
+		printk("SMP: no local APIC, using 1 CPU\n");
+		return;
+	}
+
+	cpu_to_apicid[0] = read_apic_id();
+	if (acpi_boot_init() < 0 && get_smp_config() < 0)
+	{
+		printk("SMP: no MP configuration found, using 1 CPU\n");
+		return;
+	}
+
+	memcpy(__va(TRAMPOLINE_BASE), trampoline_data, trampoline_end - trampoline_data);
+
+	for (i = 0; i < num_processors && cpu < NR_CPUS; i++)
+	{
+		if (mp_lapic_ids[i] == cpu_to_apicid[0])
+		{
+			continue;
+		}
+		if (do_boot_cpu(mp_lapic_ids[i], cpu) == 0)
+		{
+			cpu++;
+		}
+	}
+
+	printk("SMP: %u CPU(s) online\n", num_online_cpus());
+}
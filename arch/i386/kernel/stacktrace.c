@@ -1,14 +1,39 @@
+#include <asm-i386/processor.h>
 #include <kfs/printk.h>
+#include <kfs/sched.h>
 #include <kfs/stdint.h>
 
 /* boot.Sで定義されたスタック領域の境界。スタックのオーバーフロー検出に必要 */
 extern char stack_bottom[]; /* スタック領域の下限アドレス */
 extern char stack_top[];	/* スタック領域の上限アドレス */
 
+/* 調べるスタック領域の境界（show_stack()の開始時に決める） */
+static char *stack_lo;
+static char *stack_hi;
+
+/** spを含むスタック領域を選ぶ
+ * @note カーネルスレッドは自分のスタック（task->stack）で動き，init_taskはboot.Sのスタックで動く
+ */
+static void select_stack_bounds(const void *sp)
+{
+	char *task_stack = current->stack;
+
+	if (task_stack && (const char *)sp >= task_stack && (const char *)sp < task_stack + THREAD_SIZE)
+	{
+		stack_lo = task_stack;
+		stack_hi = task_stack + THREAD_SIZE;
+	}
+	else
+	{
+		stack_lo = stack_bottom;
+		stack_hi = stack_top;
+	}
+}
+
 /* ポインタpがスタック領域内にあるか確認する。不正なメモリアクセスを防ぐために必要 */
 static int in_stack_bounds(const void *p)
 {
-	return (const char *)p >= stack_bottom && (const char *)p < stack_top;
+	return (const char *)p >= stack_lo && (const char *)p < stack_hi;
 }
 
 /* スタックの内容を人間が読める形式でダンプする。デバッグ時にスタック状態を確認するために必要 */
@@ -20,10 +45,11 @@ void show_stack(unsigned long *esp)
 	{
 		asm volatile("mov %%esp, %0" : "=r"(sp));
 	}
+	select_stack_bounds(sp);
 
 	printk("\n========== Stack Trace ==========\n");
-	printk("Stack pointer: %p (bottom=%p, top=%p, size=%d bytes)\n", sp, stack_bottom, stack_top,
-		   (int)((char *)stack_top - (char *)stack_bottom));
+	printk("Stack pointer: %p (bottom=%p, top=%p, size=%d bytes)\n", sp, stack_lo, stack_hi,
+		   (int)(stack_hi - stack_lo));
 
 	/* EBP(ベースポインタ)を辿って関数呼び出し履歴を追跡する */
 	unsigned long *bp;
@@ -66,7 +92,7 @@ void show_stack(unsigned long *esp)
 	printk("\n--- Stack Dump (first 32 words) ---\n");
 	printk("Address       Value      Possible Interpretation\n");
 	int words = 0;
-	for (unsigned long *p = sp; p < (unsigned long *)stack_top && words < 32; ++p, ++words)
+	for (unsigned long *p = sp; p < (unsigned long *)stack_hi && words < 32; ++p, ++words)
 	{
 		if (!in_stack_bounds(p))
 		{
@@ -84,7 +110,7 @@ void show_stack(unsigned long *esp)
 		{
 			printk("  <code>");
 		}
-		else if (val >= (unsigned int)stack_bottom && val < (unsigned int)stack_top)
+		else if (val >= (unsigned int)stack_lo && val < (unsigned int)stack_hi)
 		{
 			printk("  <stack>");
 		}
@@ -0,0 +1,25 @@
+/** タイマーの初期化
+ * - Linux 2.6.11のarch/i386/kernel/time.cに相当
+ */
+
+#include <asm-i386/apic.h>
+#include <asm-i386/i8253.h>
+#include <asm-i386/tsc.h>
+#include <kfs/ktime.h>
+
+/** 時刻の読み出しとtickを発生させるタイマーを初期化する
+ * @details 時刻はjiffiesから始めてTSCに切り替える．
+ *          tickはまずPITで周期tickを開始し，Local APICがあればそのタイマーに切り替える
+ * @note ioremapを使うため，vmalloc_init()の後に呼ぶこと
+ */
+void time_init(void)
+{
+	timekeeping_init();
+	setup_pit_timer();
+	tsc_init();
+
+	if (lapic_init() == 0)
+	{
+		setup_lapic_timer();
+	}
+}
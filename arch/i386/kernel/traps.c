@@ -1,6 +1,7 @@
 #include <asm-i386/desc.h>
 #include <asm-i386/ptrace.h>
 #include <kfs/irq.h>
+#include <kfs/mm.h>
 #include <kfs/panic.h>
 #include <kfs/printk.h>
 #include <kfs/string.h>
@@ -102,11 +103,31 @@ void do_exception(struct pt_regs *regs)
 	}
 }
 
+/** エラーコード付き共通例外ハンドラ（entry.Sから呼び出される）
+ * @param regs       例外発生時のレジスタ状態（orig_eaxにtrap番号）
+ * @param error_code CPUがpushしたエラーコード
+ * @note Page Fault(0x0E)はdo_page_fault()に委譲し，それ以外はdo_exception()で処理する
+ */
+void do_exception_errcode(struct pt_regs *regs, unsigned long error_code)
+{
+	unsigned int trap_no = regs->orig_eax;
+
+	if (trap_no == 14)
+	{
+		do_page_fault(regs, error_code);
+		return;
+	}
+
+	printk("Error code: 0x%08lx\n", error_code);
+	do_exception(regs);
+}
+
 /* ========== 初期化 ========== */
 
 /** 例外ハンドラをIDTに登録する
- * @note CPU例外(0x00-0x13)はすべてTrap Gateを使用
+ * @note CPU例外(0x00-0x13)はPage Faultを除きTrap Gateを使用
  * @note Trap Gate: IFフラグを変更しない (割り込み許可のまま)
+ * @note Page FaultはCR2を読む前に別の割り込みで上書きされないようInterrupt Gateを使用
  * @note ハードウェア割り込み(IRQ)はinit_IRQ()でInterrupt Gateとして登録
  */
 void trap_init(void)
@@ -125,7 +146,7 @@ void trap_init(void)
 	set_trap_gate(11, segment_not_present);		   /* 0x0B: Segment Not Present */
 	set_trap_gate(12, stack_segment);			   /* 0x0C: Stack Fault */
 	set_trap_gate(13, general_protection);		   /* 0x0D: General Protection */
-	set_trap_gate(14, page_fault);				   /* 0x0E: Page Fault */
+	set_intr_gate(14, page_fault);				   /* 0x0E: Page Fault (CR2保護のためInterrupt Gate) */
 	/* 0x0F: Reserved (Intel予約) */
 	set_trap_gate(16, coprocessor_error);	   /* 0x10: x87 FPU Error */
 	set_trap_gate(17, alignment_check);		   /* 0x11: Alignment Check */
@@ -162,6 +183,14 @@ void idt_init(void)
 	printk("IDT loaded at 0x%08lx (%d entries)\n", (unsigned long)&idt[0], IDT_ENTRIES);
 }
 
+/** APにIDTをロードする
+ * @note IDTは全CPUで共有するため，BSPのidt_init()で作ったものをそのまま使う
+ */
+void cpu_idt_init(void)
+{
+	__asm__ __volatile__("lidt %0" : : "m"(idt_ptr));
+}
+
 /** テスト用: IDTエントリを取得する */
 struct idt_entry *idt_get_entry(int n)
 {
@@ -0,0 +1,127 @@
+/** TSC (Time Stamp Counter)
+ * - Linux 6.18のarch/x86/kernel/tsc.cに相当
+ * - 起動時にPITのチャネル2でTSCの周波数を測り，クロックソースとsched_clock()に使う
+ */
+
+#include <asm-i386/div64.h>
+#include <asm-i386/i8253.h>
+#include <asm-i386/processor.h>
+#include <asm-i386/system.h>
+#include <asm-i386/tsc.h>
+#include <kfs/clocksource.h>
+#include <kfs/jiffies.h>
+#include <kfs/math64.h>
+#include <kfs/printk.h>
+#include <kfs/sched.h>
+#include <kfs/time.h>
+
+/* 1回の較正にかける時間（ミリ秒）と試行回数 */
+#define TSC_CAL_MS 10
+#define TSC_CAL_LOOPS 3
+
+/* 較正したTSCの周波数（kHz） */
+uint32_t tsc_khz;
+
+/** sched_clock()用の変換パラメータ
+ * @details ns = ns_base + ((tsc - tsc_base) * mult) >> shift
+ *          tsc_init()以前のjiffiesベースの値から連続するよう基準点を持つ
+ */
+static struct
+{
+	uint32_t mult;
+	uint32_t shift;
+	uint64_t tsc_base;
+	uint64_t ns_base;
+	int ready;
+} cyc2ns;
+
+/** PITでTSCの周波数を測る
+ * @return TSCの周波数（kHz）
+ * @details TSC_CAL_MSミリ秒の間に進んだTSCをTSC_CAL_LOOPS回測り，最小値を採る．
+ *          PITの出力を見逃して計測区間が延びることはあっても縮むことはないため，最小値が最も正確
+ */
+static uint32_t pit_calibrate_tsc(void)
+{
+	uint64_t best = ~0ULL;
+	unsigned long flags;
+	int i;
+
+	local_irq_save(flags);
+	for (i = 0; i < TSC_CAL_LOOPS; i++)
+	{
+		uint64_t t1, t2;
+
+		pit_ch2_start(TSC_CAL_MS);
+		t1 = rdtsc();
+		pit_ch2_wait();
+		t2 = rdtsc();
+
+		if (t2 - t1 < best)
+		{
+			best = t2 - t1;
+		}
+	}
+	local_irq_restore(flags);
+
+	do_div(best, TSC_CAL_MS);
+	return (uint32_t)best;
+}
+
+static uint64_t tsc_read(struct clocksource *cs)
+{
+	(void)cs;
+	return rdtsc();
+}
+
+static struct clocksource clocksource_tsc = {
+	.name = "tsc",
+	.rating = 300,
+	.read = tsc_read,
+	.mask = CLOCKSOURCE_MASK(64),
+};
+
+/** スケジューラ向けの高速な時刻（ナノ秒）
+ * @return 起動からのおおよそのナノ秒
+ * @details TSCがあればTSCを1回読んで変換するだけで，シーケンスカウンタの読み直しもない．
+ *          TSCがなければtick単位の精度しかない
+ * @note ktime_get_ns()と異なり，クロックソースの切り替えやtickless idle中の更新を待たない
+ */
+uint64_t sched_clock(void)
+{
+	if (!cyc2ns.ready)
+	{
+		return (uint64_t)jiffies * TICK_NSEC;
+	}
+	return cyc2ns.ns_base + mul_u64_u32_shr(rdtsc() - cyc2ns.tsc_base, cyc2ns.mult, cyc2ns.shift);
+}
+
+/** TSCを較正してクロックソースとsched_clock()に使う
+ * @note PITのチャネル2を使うため，チャネル0がtickを出していても較正できる
+ */
+void tsc_init(void)
+{
+	unsigned long flags;
+
+	if (!cpu_has(X86_FEATURE_TSC))
+	{
+		return;
+	}
+
+	tsc_khz = pit_calibrate_tsc();
+	if (tsc_khz == 0)
+	{
+		printk(KERN_WARNING "tsc: calibration failed\n");
+		return;
+	}
+	printk("tsc: %u.%03u MHz\n", tsc_khz / 1000, tsc_khz % 1000);
+
+	/* sched_clock()は96ビットの中間値で変換するため，桁あふれを気にせず精度を優先する */
+	local_irq_save(flags);
+	clocks_calc_mult_shift(&cyc2ns.mult, &cyc2ns.shift, tsc_khz, NSEC_PER_MSEC, 0);
+	cyc2ns.ns_base = sched_clock();
+	cyc2ns.tsc_base = rdtsc();
+	cyc2ns.ready = 1;
+	local_irq_restore(flags);
+
+	clocksource_register_khz(&clocksource_tsc, tsc_khz);
+}
@@ -0,0 +1,84 @@
+/** ページフォルト処理
+ * - Linux 2.6.11のarch/i386/mm/fault.cに相当
+ * - CR2からフォルトアドレスを取得し，VMAに応じてページを遅延割り当てする
+ * - ユーザーページへの書き込みによる保護違反はCOWでページをコピーする
+ */
+
+#include <asm-i386/pgtable.h>
+#include <asm-i386/ptrace.h>
+#include <kfs/mm.h>
+#include <kfs/panic.h>
+#include <kfs/printk.h>
+#include <kfs/sched.h>
+#include <kfs/spinlock.h>
+
+/* ページフォルトのエラーコード（CPUがpushする値のビット） */
+#define PF_PROT 0x1	 /* 0=ページ不在，1=保護違反 */
+#define PF_WRITE 0x2 /* 0=読み込み，1=書き込み */
+#define PF_USER 0x4	 /* 0=カーネルモード，1=ユーザーモード */
+
+/** フォルトアドレスとエラーコードからページフォルトを解決する
+ * @param regs       例外発生時のレジスタ状態
+ * @param error_code CPUがpushしたエラーコード
+ * @param address    フォルトを起こした線形アドレス
+ * @return 0=解決済み，-1=解決不能
+ * @note CR2の読み取りとpanicを分離し，テストから直接呼び出せるようにする
+ */
+int __do_page_fault(struct pt_regs *regs, unsigned long error_code, unsigned long address)
+{
+	struct vm_area_struct *vma;
+	int write = (error_code & PF_WRITE) != 0;
+	unsigned long flags;
+	int ret = -1;
+
+	(void)regs;
+
+	/** 保護違反（ページは存在する）は遅延割り当てでは解決できない
+	 * @note ユーザー空間への書き込みはfork()で共有したページかもしれないため，COWを試す
+	 */
+	if (error_code & PF_PROT)
+	{
+		if (write && address < PAGE_OFFSET && current->mm)
+		{
+			return do_wp_page(current->mm, address);
+		}
+		return -1;
+	}
+
+	/** 他のCPUがvfree()でVMAを外して解放しないよう，解決し終わるまでvma_lockを持つ
+	 * @note 同じアドレスへの同時のフォルトもここで直列になり，ページを二重にマップしない
+	 */
+	spin_lock_irqsave(&vma_lock, flags);
+	vma = find_vma(address);
+	if (vma != NULL && (vma->vm_flags & VM_DEMAND))
+	{
+		/* 書き込み不可の領域への書き込みは解決しない */
+		if (!write || (vma->vm_flags & VM_WRITE))
+		{
+			ret = handle_mm_fault(vma, address, write);
+		}
+	}
+	spin_unlock_irqrestore(&vma_lock, flags);
+
+	return ret;
+}
+
+/** ページフォルト例外ハンドラ（Linux 2.6.11: do_page_fault()相当）
+ * @param regs       例外発生時のレジスタ状態
+ * @param error_code CPUがpushしたエラーコード
+ * @note 解決できないフォルトはレジスタを表示してpanicする
+ */
+void do_page_fault(struct pt_regs *regs, unsigned long error_code)
+{
+	unsigned long address = read_cr2();
+
+	if (__do_page_fault(regs, error_code, address) == 0)
+	{
+		return;
+	}
+
+	printk("Page Fault at 0x%08lx (%s %s, %s)\n", address, (error_code & PF_USER) ? "user" : "kernel",
+		   (error_code & PF_WRITE) ? "write" : "read", (error_code & PF_PROT) ? "protection" : "not-present");
+	show_regs(regs);
+	panic("Unable to handle page fault");
+}
@@ -2,14 +2,109 @@
 #include <asm-i386/pgtable.h>
 #include <kfs/errno.h>
 #include <kfs/gfp.h>
+#include <kfs/list.h>
 #include <kfs/mm.h>
+#include <kfs/mm_types.h>
 #include <kfs/panic.h>
 #include <kfs/printk.h>
+#include <kfs/spinlock.h>
 #include <kfs/string.h>
 
 /* External page directory set up by boot.S */
 extern pde_t boot_page_directory[];
 
+/** ページテーブル用のクイックリスト
+ * @details ゼロクリア済みのページテーブル用ページを最大PGTABLE_QUICKLIST_MAX個キャッシュする．
+ *          空になったページテーブルは全PTEがクリア済みなので，そのまま戻せる．
+ *          リストのリンクには先頭ワード（PTE[0]）を使い，取り出すときにだけクリアする．
+ * @note Linux 2.6.11のpgtable_quicklistに相当する
+ */
+#define PGTABLE_QUICKLIST_MAX 8
+
+static unsigned long *pgtable_quicklist = NULL;
+static unsigned int pgtable_cache_size = 0;
+
+/* ページテーブルごとの使用中PTE数（ページディレクトリのインデックスで引く） */
+static unsigned short pte_table_used[PTRS_PER_PGD];
+
+/** vmalloc領域のページテーブル（カーネル部分のPDEとPTE），pte_table_used[]とクイックリストを守るロック
+ * @details vmalloc/vfree（vmap_mutexの内側）とページフォルトハンドラ（vma_lockの内側）の両方から
+ *          ページテーブルを作成・回収するため，どちらの外側のロックにも頼らずここで直列にする．
+ *          フォルトハンドラは割り込み禁止で来るので，割り込みも禁止して取る
+ * @note Linux 2.6.11のinit_mm.page_table_lockに相当する．pgd_lockより先に取る
+ * @note 保持したまま全CPUのTLBシュートダウン（flush_tlb_kernel_range()）を行ってはならない
+ */
+static DEFINE_SPINLOCK(page_table_lock);
+
+/** プロセスごとのページディレクトリのリスト
+ * @details カーネル部分のPDEは全ページディレクトリで同じでなければならない．
+ *          vmalloc領域のページテーブルを作成・回収したときは，ここに並ぶ全ページディレクトリに反映する
+ * @note Linux 2.6.11のpgd_listに相当する
+ */
+static LIST_HEAD(pgd_list);
+
+/** pgd_listと，そこに並ぶページディレクトリのカーネル部分を守るロック
+ * @details fork（pgd_alloc()）とmmの解放（pgd_free()）はどのCPUでも起こり，
+ *          mmの解放は割り込み禁止のfinish_task_switch()からも来るため，割り込みも禁止して取る
+ * @note Linux 2.6.11のpgd_lockに相当する
+ */
+static DEFINE_SPINLOCK(pgd_lock);
+
+/** カーネル部分のPDEを全ページディレクトリに反映する
+ * @param pde_idx boot_page_directoryで書き換えたエントリのインデックス
+ */
+static void sync_kernel_pde(int pde_idx)
+{
+	struct mm_struct *mm;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pgd_lock, flags);
+	list_for_each_entry(mm, &pgd_list, pgd_list)
+	{
+		mm->pgd[pde_idx] = boot_page_directory[pde_idx];
+	}
+	spin_unlock_irqrestore(&pgd_lock, flags);
+}
+
+/** ページテーブル用のゼロクリア済みページを取得する
+ * @return ページテーブル（物理アドレス＝恒等マッピングのポインタ）、失敗時NULL
+ * @note page_table_lockを持って呼ぶ
+ */
+static pte_t *pte_alloc_one(void)
+{
+	unsigned long *table = pgtable_quicklist;
+
+	if (table != NULL)
+	{
+		pgtable_quicklist = (unsigned long *)table[0];
+		table[0] = 0;
+		pgtable_cache_size--;
+		return (pte_t *)table;
+	}
+
+	return (pte_t *)alloc_pages(GFP_ZERO, 0);
+}
+
+/** 空になったページテーブルを返却する
+ * @param table 全PTEがクリア済みのページテーブル
+ * @note クイックリストが満杯ならページアロケータに返す
+ * @note page_table_lockを持って呼ぶ
+ */
+static void pte_free(pte_t *table)
+{
+	unsigned long *entry = (unsigned long *)table;
+
+	if (pgtable_cache_size >= PGTABLE_QUICKLIST_MAX)
+	{
+		free_pages((struct page *)table, 0);
+		return;
+	}
+
+	entry[0] = (unsigned long)pgtable_quicklist;
+	pgtable_quicklist = entry;
+	pgtable_cache_size++;
+}
+
 /** 仮想アドレスに対応するPTEを取得する
  * @param vaddr 仮想アドレス
  * @return PTEへのポインタ、エラー時NULL
@@ -41,13 +136,14 @@ pte_t *get_pte(unsigned long vaddr)
 /** 仮想アドレスから対応するページテーブルを取得または作成する
  * @param vaddr 仮想アドレス
  * @return ページテーブルへのポインタ、エラー時NULL
+ * @note page_table_lockを持って呼ぶ．PDEの有無の確認から設定までを1区間で行い，
+ *       2つのCPUが同じPDEに別々のページテーブルを設定しないようにする
  */
 static pte_t *get_or_create_page_table(unsigned long vaddr)
 {
 	int pde_idx;
 	pde_t *pde;
 	pte_t *pte_table;
-	struct page *page;
 	unsigned long pte_table_phys;
 
 	pde_idx = pgd_index(vaddr);
@@ -60,22 +156,20 @@ static pte_t *get_or_create_page_table(unsigned long vaddr)
 		return (pte_t *)__va(pte_table_phys);
 	}
 
-	/* 新しいページテーブルを割り当て */
-	page = alloc_pages(GFP_KERNEL, 0);
-	if (page == NULL)
+	/* 新しいページテーブルを割り当て（クイックリストのページは全エントリがクリア済み） */
+	pte_table = pte_alloc_one();
+	if (pte_table == NULL)
 	{
 		printk(KERN_WARNING "Failed to allocate page table\n");
 		return NULL;
 	}
+	pte_table_used[pde_idx] = 0;
 
-	pte_table = (pte_t *)page;
-
-	/* ページテーブルを初期化（全エントリをクリア） */
-	memset(pte_table, 0, PAGE_SIZE);
-
-	/* ページディレクトリエントリを設定（カーネル用、物理アドレスを使用） */
-	pte_table_phys = __pa((unsigned long)pte_table);
+	/* ページディレクトリエントリを設定（カーネル用、物理アドレスを使用）
+	 * alloc_pages()は物理アドレスを返すため，__pa()で変換してはならない */
+	pte_table_phys = (unsigned long)pte_table;
 	set_pde(pde, pte_table_phys, _PAGE_KERNEL);
+	sync_kernel_pde(pde_idx);
 
 	return pte_table;
 }
@@ -89,6 +183,7 @@ static pte_t *get_or_create_page_table(unsigned long vaddr)
 int map_page(unsigned long vaddr, unsigned long paddr, unsigned long flags)
 {
 	pte_t *pte;
+	int was_present;
 
 	/* アライメントチェック */
 	if ((vaddr & ~PAGE_MASK) || (paddr & ~PAGE_MASK))
@@ -104,25 +199,38 @@ int map_page(unsigned long vaddr, unsigned long paddr, unsigned long flags)
 	}
 
 	/* ページをマップ */
+	was_present = pte_present(*pte);
 	set_pte(pte, paddr, flags | _PAGE_PRESENT);
 
 	// PTEを書き換えた後にCPUのTLBを無効化しないと，
-	// 新しいマッピングがCPUに反映されず予期せぬアクセスが起こる可能性があるため
-	__flush_tlb();
+	// 新しいマッピングがCPUに反映されず予期せぬアクセスが起こる可能性があるため．
+	// 既存のマッピングを置き換えたときは，他のCPUも古い変換を持っている可能性がある
+	if (was_present)
+	{
+		flush_tlb_kernel_range(vaddr, vaddr + PAGE_SIZE);
+	}
+	else
+	{
+		__flush_tlb();
+	}
 
 	return 0;
 }
 
-/** 仮想アドレスと物理アドレスを動的にマップ（vmalloc用）
- * @param vaddr 仮想アドレス（4KBアライメント）
- * @param paddr 物理アドレス（4KBアライメント）
- * @param flags ページフラグ
- * @return 0=成功、負数=エラー
+/** page_table_lockを持ってvmalloc領域のPTEを設定する（map_page_vmalloc()系の本体）
+ * @param vaddr   仮想アドレス（4KBアライメント）
+ * @param paddr   物理アドレス（4KBアライメント）
+ * @param flags   ページフラグ
+ * @param replace 非0なら既存のマッピングを置き換える．0なら既存のマッピングには触れない
+ * @return 0=新しくマップした、1=既にマップされていた（replaceなら置き換えた）、負数=エラー
+ * @note TLBの無効化は行わない．呼び出し元がロックを放してから行う
  */
-int map_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long flags)
+static int __map_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long flags, int replace)
 {
 	pte_t *pte_table;
 	int pte_idx;
+	int was_present;
+	unsigned long irqflags;
 
 	/** ページ境界（4KB）でアラインされているかを調べる
 	 * @details
@@ -141,10 +249,13 @@ int map_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long fla
 		return -1;
 	}
 
+	spin_lock_irqsave(&page_table_lock, irqflags);
+
 	/* vaddrから対応するページテーブルを取得または作成する */
 	pte_table = get_or_create_page_table(vaddr);
 	if (pte_table == NULL)
 	{
+		spin_unlock_irqrestore(&page_table_lock, irqflags);
 		return -1;
 	}
 
@@ -155,11 +266,190 @@ int map_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long fla
 	 * @details 仮想アドレスvaddrから取得したページテーブルpte_tableのエントリpte_table[pte_idx]と
 	 *          物理アドレスpaddrをマッピングする
 	 */
-	set_pte(&pte_table[pte_idx], paddr, flags | _PAGE_PRESENT);
+	was_present = pte_present(pte_table[pte_idx]);
+	if (!was_present)
+	{
+		pte_table_used[pgd_index(vaddr)]++;
+	}
+	if (!was_present || replace)
+	{
+		set_pte(&pte_table[pte_idx], paddr, flags | _PAGE_PRESENT);
+	}
+
+	spin_unlock_irqrestore(&page_table_lock, irqflags);
+
+	return was_present ? 1 : 0;
+}
+
+/** 仮想アドレスと物理アドレスを動的にマップ（vmalloc用）
+ * @param vaddr 仮想アドレス（4KBアライメント）
+ * @param paddr 物理アドレス（4KBアライメント）
+ * @param flags ページフラグ
+ * @return 0=成功、負数=エラー
+ * @note 既存のマッピングを置き換えたときは全CPUのTLBを無効化するので，割り込みを許可して呼ぶ
+ */
+int map_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long flags)
+{
+	int ret = __map_page_vmalloc(vaddr, paddr, flags, 1);
+
+	if (ret < 0)
+	{
+		return ret;
+	}
 
 	// PTEを書き換えた後にCPUのTLBを無効化しないと，
-	// 新しいマッピングがCPUに反映されず予期せぬアクセスが起こる可能性があるため
-	__flush_tlb();
+	// 新しいマッピングがCPUに反映されず予期せぬアクセスが起こる可能性があるため．
+	// 既存のマッピングを置き換えたときは，他のCPUも古い変換を持っている可能性がある
+	if (ret == 1)
+	{
+		flush_tlb_kernel_range(vaddr, vaddr + PAGE_SIZE);
+	}
+	else
+	{
+		__flush_tlb();
+	}
+
+	return 0;
+}
+
+/** マップされていない仮想アドレスだけを物理アドレスにマップする（ページフォルト用）
+ * @param vaddr 仮想アドレス（4KBアライメント）
+ * @param paddr 物理アドレス（4KBアライメント）
+ * @param flags ページフラグ
+ * @return 0=マップした、1=他のCPUが既にマップしていた（何も変更しない）、負数=エラー
+ * @details 既存のマッピングを置き換えないので他のCPUのTLBは古くならず，自CPUのTLBの無効化だけで済む．
+ *          そのため割り込み禁止のページフォルトハンドラからも呼べる
+ */
+int map_new_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long flags)
+{
+	int ret = __map_page_vmalloc(vaddr, paddr, flags, 0);
+
+	if (ret == 0)
+	{
+		__flush_tlb();
+	}
+
+	return ret;
+}
+
+/** map_page_vmalloc()でマップしたページのPTEをクリアする
+ * @param vaddr 仮想アドレス（4KBアライメント）
+ * @return クリア前のPTEの値（マップされていなければ0）
+ * @note 最後のPTEがクリアされたページテーブルはページディレクトリから外して回収する
+ * @note ページのTLBフラッシュは呼び出し元の責任で行う
+ * @note ページテーブルを回収するときは全CPUのTLBを無効化するので，割り込みを許可して呼ぶ
+ */
+unsigned long unmap_page_vmalloc(unsigned long vaddr)
+{
+	int pde_idx = pgd_index(vaddr);
+	pde_t *pde = &boot_page_directory[pde_idx];
+	pte_t *table = NULL;
+	pte_t *pte;
+	pte_t old;
+	unsigned long flags;
+
+	spin_lock_irqsave(&page_table_lock, flags);
+
+	pte = get_pte(vaddr);
+	if (pte == NULL || !pte_present(*pte))
+	{
+		spin_unlock_irqrestore(&page_table_lock, flags);
+		return 0;
+	}
+
+	old = ptep_get_and_clear(pte);
+	if (--pte_table_used[pde_idx] == 0)
+	{
+		/* ページテーブルを外す．以後このPDEを見たCPUは新しいページテーブルを作成する */
+		table = (pte_t *)pde_page(*pde);
+		pde_clear(pde);
+		sync_kernel_pde(pde_idx);
+	}
+
+	spin_unlock_irqrestore(&page_table_lock, flags);
+
+	if (table != NULL)
+	{
+		/** このアドレスに関するページング構造のキャッシュも無効化する
+		 * @note 他のCPUが外したページテーブルを辿らないよう，全CPUの無効化を待ってから再利用に回す
+		 */
+		flush_tlb_kernel_range(vaddr, vaddr + PAGE_SIZE);
+
+		spin_lock_irqsave(&page_table_lock, flags);
+		pte_free(table);
+		spin_unlock_irqrestore(&page_table_lock, flags);
+	}
+
+	return old;
+}
 
+/** mmにプロセス用のページディレクトリを割り当てる
+ * @param mm ページディレクトリを持たせるmm
+ * @return 0=成功、-ENOMEM=メモリ不足
+ * @details カーネル部分（PDE 0の恒等マッピングと3GB以上）はboot_page_directoryからコピーし，
+ *          ユーザー部分は空にする．以後のカーネル部分の変更はsync_kernel_pde()で反映される
+ */
+int pgd_alloc(struct mm_struct *mm)
+{
+	struct page *page = alloc_pages(GFP_KERNEL, 0);
+	unsigned long flags;
+	pgd_t *pgd;
+
+	if (page == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	/* コピーしてからリストに並ぶまでに反映されたPDEを取りこぼさないよう，両方をpgd_lockの中で行う */
+	pgd = (pgd_t *)__va((unsigned long)page);
+	spin_lock_irqsave(&pgd_lock, flags);
+	memcpy(pgd, boot_page_directory, PAGE_SIZE);
+	memset(&pgd[FIRST_USER_PGD_NR], 0, (USER_PTRS_PER_PGD - FIRST_USER_PGD_NR) * sizeof(pgd_t));
+	mm->pgd = pgd;
+	list_add(&mm->pgd_list, &pgd_list);
+	spin_unlock_irqrestore(&pgd_lock, flags);
 	return 0;
 }
+
+/** pgd_alloc()で割り当てたページディレクトリを解放する
+ * @param mm ページディレクトリを持つmm
+ * @note ユーザー部分のページテーブルはexit_mmap()で解放済みであること
+ */
+void pgd_free(struct mm_struct *mm)
+{
+	unsigned long flags;
+
+	if (mm->pgd == NULL)
+	{
+		return;
+	}
+
+	spin_lock_irqsave(&pgd_lock, flags);
+	list_del(&mm->pgd_list);
+	spin_unlock_irqrestore(&pgd_lock, flags);
+	free_pages((struct page *)__pa(mm->pgd), 0);
+	mm->pgd = NULL;
+}
+
+/** テスト用: vmalloc領域のページテーブルを初期状態に戻す
+ * @param start vmalloc領域の開始仮想アドレス
+ * @details ページアロケータのリセットでページテーブルのページは空き扱いになるため，
+ *          ページディレクトリエントリ・使用数・クイックリストをすべて破棄する
+ */
+void pgtable_reset_for_test(unsigned long start)
+{
+	unsigned long i;
+
+	for (i = pgd_index(start); i < PTRS_PER_PGD; i++)
+	{
+		pde_clear(&boot_page_directory[i]);
+		pte_table_used[i] = 0;
+	}
+	flush_tlb_all();
+
+	pgtable_quicklist = NULL;
+	pgtable_cache_size = 0;
+
+	/* プロセス用のページディレクトリもページアロケータのリセットで無効になる */
+	INIT_LIST_HEAD(&pgd_list);
+}
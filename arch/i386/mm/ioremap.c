@@ -0,0 +1,141 @@
+/** デバイスメモリのマッピング（ioremap/iounmap）
+ * - Linux 2.6.11のarch/i386/mm/ioremap.cに相当
+ * - 物理アドレス範囲をvmalloc領域にマップし，メモリタイプ（キャッシュ属性）を設定する
+ */
+
+#include <asm-i386/io.h>
+#include <asm-i386/msr.h>
+#include <asm-i386/page.h>
+#include <asm-i386/pgtable.h>
+#include <asm-i386/processor.h>
+#include <kfs/mm.h>
+#include <kfs/printk.h>
+#include <kfs/vmalloc.h>
+
+/** PATのメモリタイプ
+ * @note PATの8エントリ(PA0-PA7)はPTEの PAT:PCD:PWT ビットで選択される
+ */
+#define PAT_UC 0x00ULL		 /* Uncacheable */
+#define PAT_WC 0x01ULL		 /* Write Combining */
+#define PAT_WT 0x04ULL		 /* Write Through */
+#define PAT_WB 0x06ULL		 /* Write Back */
+#define PAT_UC_MINUS 0x07ULL /* Uncacheable（MTRRでWCに上書き可能） */
+
+#define PAT(x, y) ((unsigned long long)PAT_##y << ((x) * 8))
+
+/* PATが使用可能でPA4をWCに書き換え済みなら1 */
+static int pat_enabled = 0;
+
+/** PATを初期化する
+ * @details 電源投入時のPATは PA0-3 と PA4-7 が同じ並び（WB, WT, UC-, UC）であり，
+ *          PATビットを立てたエントリは使われていない．PA4をWCに置き換えて，
+ *          PATビットのみを立てたPTEでライトコンバインを選べるようにする．
+ * @note PA0-PA3は変更しないため，既存のPCD/PWTの意味は変わらない
+ */
+void pat_init(void)
+{
+	unsigned long long pat;
+
+	if (!cpu_has_pat)
+	{
+		printk(KERN_INFO "PAT: not supported, write-combining falls back to UC\n");
+		return;
+	}
+
+	pat = PAT(0, WB) | PAT(1, WT) | PAT(2, UC_MINUS) | PAT(3, UC) | PAT(4, WC) | PAT(5, WT) | PAT(6, UC_MINUS) |
+		  PAT(7, UC);
+
+	/** Intel SDM: PAT変更の前後でキャッシュとTLBをフラッシュする
+	 * @note PATはCPUごとのMSRで，各CPUが起動時に自分で呼ぶため，自分のTLBだけをフラッシュすればよい
+	 */
+	__asm__ __volatile__("wbinvd" ::: "memory");
+	wrmsr(MSR_IA32_CR_PAT, (uint32_t)pat, (uint32_t)(pat >> 32));
+	__asm__ __volatile__("wbinvd" ::: "memory");
+	__flush_tlb();
+
+	pat_enabled = 1;
+	printk(KERN_INFO "PAT: write-combining enabled (PA4)\n");
+}
+
+/** ioremap()のメモリタイプをPTEフラグに変換する
+ * @param attr IOREMAP_UC / IOREMAP_WT / IOREMAP_WC
+ * @return PTEに追加するキャッシュ制御フラグ
+ */
+static unsigned long ioremap_prot(int attr)
+{
+	switch (attr)
+	{
+	case IOREMAP_WT:
+		return _PAGE_PWT;
+	case IOREMAP_WC:
+		if (pat_enabled)
+		{
+			return _PAGE_PAT;
+		}
+		return _PAGE_PCD | _PAGE_PWT;
+	case IOREMAP_UC:
+	default:
+		return _PAGE_PCD | _PAGE_PWT;
+	}
+}
+
+/** 物理アドレス範囲をvmalloc領域にマップする
+ * @param phys_addr マップする物理アドレス（ページ境界でなくてもよい）
+ * @param size      マップするサイズ（バイト単位）
+ * @param attr      メモリタイプ（IOREMAP_UC / IOREMAP_WT / IOREMAP_WC）
+ * @return phys_addrに対応する仮想アドレス、失敗時はNULL
+ * @note Linux 2.6.11の__ioremap()に相当する
+ */
+void *ioremap(unsigned long phys_addr, unsigned long size, int attr)
+{
+	struct vm_struct *vm;
+	unsigned long offset;
+	unsigned long last_addr;
+	unsigned long addr;
+	unsigned long flags;
+	unsigned long i;
+
+	last_addr = phys_addr + size - 1;
+	if (size == 0 || last_addr < phys_addr)
+	{
+		return NULL;
+	}
+
+	/* ページ境界に揃える（戻り値には元のオフセットを足す） */
+	offset = phys_addr & ~PAGE_MASK;
+	phys_addr &= PAGE_MASK;
+	size = PAGE_ALIGN(last_addr + 1) - phys_addr;
+
+	vm = get_vm_area(size, VM_READ | VM_WRITE | VM_IOREMAP);
+	if (vm == NULL)
+	{
+		return NULL;
+	}
+	addr = (unsigned long)vm->addr;
+
+	flags = _PAGE_KERNEL | ioremap_prot(attr);
+	for (i = 0; i < size; i += PAGE_SIZE)
+	{
+		if (map_page_vmalloc(addr + i, phys_addr + i, flags) != 0)
+		{
+			vunmap(vm->addr);
+			printk(KERN_WARNING "ioremap: failed to map 0x%lx\n", phys_addr + i);
+			return NULL;
+		}
+	}
+
+	return (void *)(addr + offset);
+}
+
+/** ioremap()で作成したマッピングを解除する
+ * @param addr ioremap()が返した仮想アドレス
+ * @note 仮想アドレスはvunmap()の遅延解放に積まれ，全CPUのTLBを無効化してから再利用される
+ */
+void iounmap(void *addr)
+{
+	if (addr == NULL)
+	{
+		return;
+	}
+	vunmap((void *)((unsigned long)addr & PAGE_MASK));
+}
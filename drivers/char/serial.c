@@ -1,4 +1,5 @@
 #include <asm-i386/io.h>
+#include <kfs/irq.h>
 #include <kfs/serial.h>
 #include <kfs/stddef.h>
 #include <kfs/stdint.h>
@@ -8,6 +9,10 @@
  */
 #define COM1_PORT 0x3F8
 #define COM2_PORT 0x2F8 /* 入力用として2つ目のシリアルポートを使用 */
+#define COM2_IRQ 3
+
+/* 受信割り込みで呼ぶハンドラ */
+static serial_rx_handler_t rx_handler;
 
 /* I/O indirection layer */
 void kfs_io_outb(uint16_t port, uint8_t val)
@@ -52,6 +57,46 @@ int serial_read(void)
 	return (int)kfs_io_inb(COM2_PORT);
 }
 
+/** COM2の受信割り込みハンドラ（IRQ3から呼ばれる）
+ * @details FIFOに溜まった文字をすべて読み出し，登録されたハンドラに渡す
+ */
+static int serial_interrupt(int irq, struct pt_regs *regs)
+{
+	int c;
+
+	(void)irq;
+	(void)regs;
+
+	while ((c = serial_read()) != -1)
+	{
+		if (rx_handler)
+		{
+			rx_handler((char)c);
+		}
+	}
+	return IRQ_HANDLED;
+}
+
+/** 受信割り込みで呼ぶハンドラを設定する
+ * @param handler 受信した文字を受け取るハンドラ
+ * @return 成功時0，IRQ3が使用中なら-1
+ * @details 初回の設定でIRQ3を登録し，COM2の受信割り込みを有効にする．
+ *          これにより入力を待つ側はポーリングせずに眠っていられる
+ */
+int serial_set_rx_handler(serial_rx_handler_t handler)
+{
+	if (!rx_handler)
+	{
+		if (request_irq(COM2_IRQ, serial_interrupt, "serial", NULL) != 0)
+		{
+			return -1;
+		}
+		kfs_io_outb(COM2_PORT + 1, 0x01); /*受信データ割り込みを有効化*/
+	}
+	rx_handler = handler;
+	return 0;
+}
+
 /* シリアル通信の初期化 */
 void serial_init(void)
 {
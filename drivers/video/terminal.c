@@ -1,3 +1,4 @@
+#include <asm-i386/io.h>
 #include <kfs/console.h>
 #include <kfs/printk.h>
 #include <kfs/serial.h>
@@ -248,6 +249,29 @@ void terminal_initialize(void)
 	kfs_terminal_set_cursor_shape(CURSOR_BLOCK);
 }
 
+/** VGAテキストバッファをライトコンバインでマップし直す
+ * @details 起動直後は恒等マッピング（ライトバック）経由でVGAメモリに書き込んでいるため，
+ *          メモリ管理の初期化後にioremap()したアドレスへ切り替える
+ * @note バッファが差し替えられている場合（テスト用スタブなど）は何もしない
+ */
+void terminal_ioremap(void)
+{
+	uint16_t *vga;
+
+	if (kfs_terminal_buffer != (uint16_t *)VGA_MEMORY)
+	{
+		return;
+	}
+
+	vga = (uint16_t *)ioremap(VGA_MEMORY, VGA_WIDTH * VGA_HEIGHT * sizeof(uint16_t), IOREMAP_WC);
+	if (vga == NULL)
+	{
+		printk(KERN_WARNING "terminal: ioremap of VGA memory failed, keeping identity mapping\n");
+		return;
+	}
+	kfs_terminal_buffer = vga;
+}
+
 void terminal_setcolor(uint8_t color)
 {
 	kfs_terminal_set_color(color);
@@ -0,0 +1,79 @@
+/**
+ * acpi.h - CPUの列挙に使うACPIテーブル（RSDP, RSDT, MADT）
+ *
+ * @see Linux 2.6.11: include/acpi/actbl.h, include/acpi/actbl1.h
+ * @see ACPI Specification 6.5: 5.2 ACPI System Description Tables
+ */
+#ifndef _ASM_I386_ACPI_H
+#define _ASM_I386_ACPI_H
+
+#include <kfs/stdint.h>
+
+/* RSDP（Root System Description Pointer）: EBDAかBIOS ROMに16バイト境界で置かれる */
+struct acpi_table_rsdp
+{
+	char signature[8];	   /* "RSD PTR " */
+	uint8_t checksum;	   /* 先頭20バイトの和が0になるよう調整した値 */
+	char oem_id[6];
+	uint8_t revision;	   /* 0: ACPI 1.0，2: ACPI 2.0以降（XSDTあり） */
+	uint32_t rsdt_address; /* RSDTの物理アドレス */
+} __attribute__((packed));
+
+/* 全テーブル共通のヘッダ */
+struct acpi_table_header
+{
+	char signature[4]; /* "RSDT", "APIC"等 */
+	uint32_t length;   /* ヘッダを含むテーブル全体の長さ */
+	uint8_t revision;
+	uint8_t checksum; /* 全バイトの和が0になるよう調整した値 */
+	char oem_id[6];
+	char oem_table_id[8];
+	uint32_t oem_revision;
+	char asl_compiler_id[4];
+	uint32_t asl_compiler_revision;
+} __attribute__((packed));
+
+/* MADT（Multiple APIC Description Table, 署名"APIC"）: この後ろにサブテーブルが並ぶ */
+struct acpi_table_madt
+{
+	struct acpi_table_header header;
+	uint32_t address; /* Local APICの物理アドレス */
+	uint32_t flags;
+} __attribute__((packed));
+
+/* MADTサブテーブルの共通ヘッダ */
+struct acpi_subtable_header
+{
+	uint8_t type;
+	uint8_t length;
+} __attribute__((packed));
+
+#define ACPI_MADT_TYPE_LOCAL_APIC 0
+#define ACPI_MADT_TYPE_IO_APIC 1
+
+/* Processor Local APIC */
+struct acpi_madt_local_apic
+{
+	struct acpi_subtable_header header;
+	uint8_t processor_id; /* ACPIのプロセッサID */
+	uint8_t id;			  /* Local APIC ID */
+	uint32_t lapic_flags; /* ACPI_MADT_ENABLED */
+} __attribute__((packed));
+
+#define ACPI_MADT_ENABLED 1
+
+/* I/O APIC */
+struct acpi_madt_io_apic
+{
+	struct acpi_subtable_header header;
+	uint8_t id;
+	uint8_t reserved;
+	uint32_t address;		  /* MMIOの物理アドレス */
+	uint32_t global_irq_base; /* 最初の入力に対応するGSI番号 */
+} __attribute__((packed));
+
+/* arch/i386/kernel/acpi.c */
+int acpi_parse_madt(struct acpi_table_madt *madt);
+int acpi_boot_init(void);
+
+#endif /* _ASM_I386_ACPI_H */
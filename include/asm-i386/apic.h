@@ -0,0 +1,107 @@
+/**
+ * apic.h - Local APIC
+ *
+ * @see Linux 2.6.11: include/asm-i386/apic.h, include/asm-i386/apicdef.h
+ */
+#ifndef _ASM_I386_APIC_H
+#define _ASM_I386_APIC_H
+
+#include <kfs/stdint.h>
+
+/* Local APICレジスタ（MMIOベースからのオフセット） */
+#define APIC_ID 0x20						/* Local APIC ID */
+#define APIC_LVR 0x30						/* バージョン */
+#define APIC_TASKPRI 0x80					/* タスク優先度 */
+#define APIC_EOI 0xB0						/* End Of Interrupt */
+#define APIC_SPIV 0xF0						/* スプリアス割り込みベクタ */
+#define APIC_SPIV_APIC_ENABLED (1 << 8)		/* ソフトウェア有効化ビット */
+#define APIC_ICR 0x300						/* 割り込みコマンド（下位32ビット，書き込みで送信） */
+#define APIC_ICR2 0x310						/* 割り込みコマンド（上位32ビット，宛先） */
+#define APIC_LVTT 0x320						/* LVT タイマー */
+#define APIC_LVT0 0x350						/* LVT LINT0 */
+#define APIC_LVT1 0x360						/* LVT LINT1 */
+#define APIC_LVTERR 0x370					/* LVT エラー */
+#define APIC_TMICT 0x380					/* タイマー初期カウント */
+#define APIC_TMCCT 0x390					/* タイマー現在カウント */
+#define APIC_TDCR 0x3E0						/* タイマー分周設定 */
+#define APIC_TDR_DIV_16 0x3					/* バスクロックを16分周 */
+
+/* LVTエントリのビット */
+#define APIC_LVT_MASKED (1 << 16)		  /* 割り込みをマスク */
+#define APIC_LVT_TIMER_PERIODIC (1 << 17) /* タイマーを周期モードにする */
+#define APIC_DM_NMI 0x400				  /* 配送モード: NMI */
+#define APIC_DM_EXTINT 0x700			  /* 配送モード: ExtINT（8259A経由の割り込み） */
+
+/* ICRのビット */
+#define APIC_DM_FIXED 0x000				   /* 配送モード: 指定したベクタの割り込み */
+#define APIC_DM_INIT 0x500				   /* 配送モード: INIT */
+#define APIC_DM_STARTUP 0x600			   /* 配送モード: Startup IPI（ベクタ=開始物理ページ番号） */
+#define APIC_ICR_BUSY (1 << 12)			   /* 送信中 */
+#define APIC_INT_ASSERT (1 << 14)		   /* レベル: アサート */
+#define APIC_INT_LEVELTRIG (1 << 15)	   /* トリガ: レベル */
+#define SET_APIC_DEST_FIELD(x) ((x) << 24) /* ICR2の宛先APIC ID */
+
+/* MSR_IA32_APICBASEのビット */
+#define MSR_IA32_APICBASE_ENABLE (1 << 11) /* Local APICのハードウェア有効化 */
+#define MSR_IA32_APICBASE_BASE 0xFFFFF000  /* MMIOベースアドレス */
+
+/* Local APICが使う割り込みベクタ（8259AのIRQ 0x20-0x2Fと重ならない上位を使う） */
+#define LOCAL_TIMER_VECTOR 0xEF
+#define INVALIDATE_TLB_VECTOR 0xFB
+#define RESCHEDULE_VECTOR 0xFC
+#define SPURIOUS_APIC_VECTOR 0xFF
+
+/* Local APICのMMIO領域（lapic_init()でioremapする） */
+extern volatile uint32_t *lapic_mmio;
+
+/* Local APICレジスタを読む */
+static inline uint32_t apic_read(uint32_t reg)
+{
+	return lapic_mmio[reg / 4];
+}
+
+/* Local APICレジスタに書き込む */
+static inline void apic_write(uint32_t reg, uint32_t val)
+{
+	lapic_mmio[reg / 4] = val;
+}
+
+/* Local APICに割り込み処理の完了を通知する */
+static inline void ack_APIC_irq(void)
+{
+	apic_write(APIC_EOI, 0);
+}
+
+/* 自CPUのLocal APIC IDを読む */
+static inline uint8_t read_apic_id(void)
+{
+	return apic_read(APIC_ID) >> 24;
+}
+
+/* 前のIPIの送信が終わるまで待つ */
+static inline void apic_wait_icr_idle(void)
+{
+	while (apic_read(APIC_ICR) & APIC_ICR_BUSY)
+	{
+		__asm__ __volatile__("rep; nop");
+	}
+}
+
+/** IPIを送る
+ * @param apicid 宛先のLocal APIC ID
+ * @param low    ICRの下位32ビット（配送モード，ベクタ等）
+ * @note ICR2を先に書き，ICRへの書き込みで送信が始まる
+ */
+static inline void apic_icr_write(uint8_t apicid, uint32_t low)
+{
+	apic_wait_icr_idle();
+	apic_write(APIC_ICR2, SET_APIC_DEST_FIELD((uint32_t)apicid));
+	apic_write(APIC_ICR, low);
+}
+
+int lapic_init(void);
+void lapic_setup_ap(void);
+void setup_lapic_timer(void);
+void setup_secondary_lapic_timer(void);
+
+#endif /* _ASM_I386_APIC_H */
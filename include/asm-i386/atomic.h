@@ -0,0 +1,117 @@
+/**
+ * atomic.h - アトミック操作
+ *
+ * lockプレフィックス付きの読み出し・変更・書き込み命令で整数を更新する．
+ * 他のCPUや割り込みハンドラと同時に更新しても，途中の値を見られたり更新を失ったりしない．
+ * @see Linux 2.6.11: include/asm-i386/atomic.h, include/asm-i386/system.h (cmpxchg)
+ */
+#ifndef _ASM_I386_ATOMIC_H
+#define _ASM_I386_ATOMIC_H
+
+/* 命令の実行中にメモリバスを占有し，他のCPUからのアクセスを待たせる */
+#define LOCK_PREFIX "lock; "
+
+/** アトミック変数
+ * @note counterは必ずatomic_*()で読み書きすること
+ */
+typedef struct
+{
+	volatile int counter;
+} atomic_t;
+
+#define ATOMIC_INIT(i) {(i)}
+
+/* 値を読む */
+#define atomic_read(v) ((v)->counter)
+
+/* 値を設定する（32ビットの整列したストアはそれ自体がアトミック） */
+#define atomic_set(v, i) (((v)->counter) = (i))
+
+/* vにiを加える */
+static inline void atomic_add(int i, atomic_t *v)
+{
+	__asm__ __volatile__(LOCK_PREFIX "addl %1,%0" : "+m"(v->counter) : "ir"(i));
+}
+
+/* vからiを引く */
+static inline void atomic_sub(int i, atomic_t *v)
+{
+	__asm__ __volatile__(LOCK_PREFIX "subl %1,%0" : "+m"(v->counter) : "ir"(i));
+}
+
+/* vに1を加える */
+static inline void atomic_inc(atomic_t *v)
+{
+	__asm__ __volatile__(LOCK_PREFIX "incl %0" : "+m"(v->counter));
+}
+
+/* vから1を引く */
+static inline void atomic_dec(atomic_t *v)
+{
+	__asm__ __volatile__(LOCK_PREFIX "decl %0" : "+m"(v->counter));
+}
+
+/** vからiを引き，結果が0か調べる
+ * @return 0になったら非0
+ */
+static inline int atomic_sub_and_test(int i, atomic_t *v)
+{
+	unsigned char c;
+
+	__asm__ __volatile__(LOCK_PREFIX "subl %2,%0; sete %1" : "+m"(v->counter), "=qm"(c) : "ir"(i) : "memory");
+	return c;
+}
+
+/** vから1を引き，結果が0か調べる
+ * @return 0になったら非0（参照カウントの最後の参照を外した側だけが真になる）
+ */
+static inline int atomic_dec_and_test(atomic_t *v)
+{
+	unsigned char c;
+
+	__asm__ __volatile__(LOCK_PREFIX "decl %0; sete %1" : "+m"(v->counter), "=qm"(c) : : "memory");
+	return c;
+}
+
+/** vにiを加え，加えた後の値を返す
+ * @note xaddは加える前の値をレジスタに返すため，iを足し直す
+ */
+static inline int atomic_add_return(int i, atomic_t *v)
+{
+	int old = i;
+
+	__asm__ __volatile__(LOCK_PREFIX "xaddl %0,%1" : "+r"(old), "+m"(v->counter) : : "memory");
+	return old + i;
+}
+
+#define atomic_sub_return(i, v) atomic_add_return(-(i), (v))
+#define atomic_inc_return(v) atomic_add_return(1, (v))
+#define atomic_dec_return(v) atomic_add_return(-1, (v))
+
+/** *ptrがoldならnewに置き換える
+ * @return 置き換える前の*ptr（oldと等しければ置き換えた）
+ */
+static inline unsigned long __cmpxchg(volatile void *ptr, unsigned long old, unsigned long new)
+{
+	unsigned long prev;
+
+	__asm__ __volatile__(LOCK_PREFIX "cmpxchgl %2,%1"
+						 : "=a"(prev), "+m"(*(volatile unsigned long *)ptr)
+						 : "r"(new), "0"(old)
+						 : "memory");
+	return prev;
+}
+
+/* 32ビットの値に対するcmpxchg */
+#define cmpxchg(ptr, o, n)                                                                                             \
+	((__typeof__(*(ptr)))__cmpxchg((ptr), (unsigned long)(o), (unsigned long)(n)))
+
+/** vがoldならnewに置き換える
+ * @return 置き換える前の値
+ */
+static inline int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	return (int)__cmpxchg(&v->counter, (unsigned long)old, (unsigned long)new);
+}
+
+#endif /* _ASM_I386_ATOMIC_H */
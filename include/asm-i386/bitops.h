@@ -0,0 +1,123 @@
+/**
+ * bitops.h - ビット操作
+ *
+ * unsigned long配列をビット列とみなして操作する．
+ * ビット番号nrは配列全体での通し番号（addr[nr / BITS_PER_LONG]の下位からnr % BITS_PER_LONGビット目）．
+ * @see Linux 2.6.11: include/asm-i386/bitops.h
+ */
+#ifndef _ASM_I386_BITOPS_H
+#define _ASM_I386_BITOPS_H
+
+#include <asm-i386/atomic.h>
+
+/* unsigned longのビット数 */
+#define BITS_PER_LONG 32
+
+/* ビット番号nrを含むワードの添字 */
+#define BIT_WORD(nr) ((nr) / BITS_PER_LONG)
+
+/* ワード内でビット番号nrを表すマスク */
+#define BIT_MASK(nr) (1UL << ((nr) % BITS_PER_LONG))
+
+/** ビットを立てる
+ * @note 割り込みハンドラと共有するビット列には使わない（読み書きが不可分でない）
+ */
+static inline void __set_bit(unsigned long nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+/* ビットを落とす（__set_bit()と同じく不可分でない） */
+static inline void __clear_bit(unsigned long nr, unsigned long *addr)
+{
+	addr[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+}
+
+/** ビットを不可分に立てる
+ * @note 他のCPUや割り込みハンドラが同じワードの別のビットを同時に変えても失わない．
+ *       lockプレフィックス付きの命令はメモリバリアも兼ねる
+ */
+static inline void set_bit(unsigned long nr, volatile unsigned long *addr)
+{
+	__asm__ __volatile__(LOCK_PREFIX "btsl %1,%0" : "+m"(*addr) : "Ir"(nr) : "memory");
+}
+
+/* ビットを不可分に落とす */
+static inline void clear_bit(unsigned long nr, volatile unsigned long *addr)
+{
+	__asm__ __volatile__(LOCK_PREFIX "btrl %1,%0" : "+m"(*addr) : "Ir"(nr) : "memory");
+}
+
+/** ビットを調べる
+ * @return 立っていれば1，落ちていれば0
+ */
+static inline int test_bit(unsigned long nr, const unsigned long *addr)
+{
+	return (addr[BIT_WORD(nr)] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+/** 最下位の立っているビットの位置を求める
+ * @param word 調べる値（0は不可）
+ * @return ビット位置（0〜31）
+ * @note bsfは入力が0のとき結果が未定義のため，呼び出し元で0を除外する
+ */
+static inline unsigned long __ffs(unsigned long word)
+{
+	__asm__("bsfl %1,%0" : "=r"(word) : "rm"(word));
+	return word;
+}
+
+/** 最上位の立っているビットの位置を求める
+ * @param word 調べる値（0は不可）
+ * @return ビット位置（0〜31）
+ */
+static inline unsigned long __fls(unsigned long word)
+{
+	__asm__("bsrl %1,%0" : "=r"(word) : "rm"(word));
+	return word;
+}
+
+/** リアルタイム優先度のビットマップで最初に立っているビットを探す
+ * @param b 100ビット（MAX_RT_PRIO）以上のビットマップ（最初の4ワードのどこかにビットが立っていること）
+ * @return ビット番号
+ * @details ループせずにワードごとにbsf 1命令で調べるため，優先度の数によらず一定時間で求まる
+ * @note 呼び出し元は番兵として100番ビットを立てておく
+ */
+static inline unsigned long sched_find_first_bit(const unsigned long *b)
+{
+	if (b[0])
+	{
+		return __ffs(b[0]);
+	}
+	if (b[1])
+	{
+		return __ffs(b[1]) + 32;
+	}
+	if (b[2])
+	{
+		return __ffs(b[2]) + 64;
+	}
+	return __ffs(b[3]) + 96;
+}
+
+/** 最下位の落ちているビットの位置を求める
+ * @param word 調べる値（~0ULは不可）
+ */
+static inline unsigned long ffz(unsigned long word)
+{
+	return __ffs(~word);
+}
+
+/** 立っているビットの数を数える
+ * @details 2ビット，4ビット，8ビットごとの和を並列に求め，最後に乗算で4バイトを合計する
+ * @note popcntはi386にないため使わない
+ */
+static inline unsigned int hweight32(unsigned int w)
+{
+	w -= (w >> 1) & 0x55555555;
+	w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+	w = (w + (w >> 4)) & 0x0f0f0f0f;
+	return (w * 0x01010101) >> 24;
+}
+
+#endif /* _ASM_I386_BITOPS_H */
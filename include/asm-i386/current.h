@@ -0,0 +1,21 @@
+/**
+ * current.h - 実行中のタスク
+ *
+ * currentはCPUごとに異なるため，グローバル変数ではなく自CPUのPDAから読む．
+ * @see Linux 2.6.20: include/asm-i386/current.h
+ */
+#ifndef _ASM_I386_CURRENT_H
+#define _ASM_I386_CURRENT_H
+
+#include <asm-i386/pda.h>
+
+struct task_struct;
+
+static inline struct task_struct *get_current(void)
+{
+	return read_pda(pcurrent);
+}
+
+#define current get_current()
+
+#endif /* _ASM_I386_CURRENT_H */
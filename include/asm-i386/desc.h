@@ -14,8 +14,9 @@
 #define GDT_ENTRY_USER_CS 4
 #define GDT_ENTRY_USER_DS 5
 #define GDT_ENTRY_USER_SS 6
+#define GDT_ENTRY_PDA 7 /* CPUごとのデータ領域（ベースはCPUごとに異なる） */
 
-#define GDT_ENTRIES 7
+#define GDT_ENTRIES 8
 
 /* Selectors (RPL bits appended where needed) */
 #define __KERNEL_CS ((GDT_ENTRY_KERNEL_CS) << 3)
@@ -24,6 +25,7 @@
 #define __USER_CS (((GDT_ENTRY_USER_CS) << 3) | 0x3)
 #define __USER_DS (((GDT_ENTRY_USER_DS) << 3) | 0x3)
 #define __USER_SS (((GDT_ENTRY_USER_SS) << 3) | 0x3)
+#define __KERNEL_PDA ((GDT_ENTRY_PDA) << 3)
 
 /* Descriptor pointer structure (lgdt/lidt operand) */
 struct desc_ptr
@@ -105,7 +107,9 @@ struct idt_entry
 extern struct idt_entry idt[];
 
 void gdt_init(void);
+void cpu_gdt_init(int cpu);
 void idt_init(void);
+void cpu_idt_init(void);
 void trap_init(void);
 
 #endif /* _ASM_I386_DESC_H */
@@ -0,0 +1,47 @@
+/**
+ * div64.h - 64ビット÷32ビット除算
+ *
+ * -nostdlibでlibgccをリンクしないため，uint64_tの除算（__udivdi3）は使えない．
+ * divl命令を2回使って64ビットの被除数を32ビットの除数で割る．
+ * @see Linux 2.6.11: include/asm-i386/div64.h
+ */
+#ifndef _ASM_I386_DIV64_H
+#define _ASM_I386_DIV64_H
+
+#include <kfs/stdint.h>
+
+/** 64ビット値を32ビット値で割る
+ * @param n    被除数（uint64_t の左辺値，商で上書きされる）
+ * @param base 除数（32ビット，0は不可）
+ * @return 余り
+ * @example
+ * uint64_t ns = 1234567890123ULL;
+ * uint32_t rem = do_div(ns, 1000);   // ns = 1234567890, rem = 123
+ */
+#define do_div(n, base)                                                                                                \
+	({                                                                                                                 \
+		unsigned long __upper, __low, __high, __mod, __base;                                                           \
+		__base = (base);                                                                                               \
+		__asm__("" : "=a"(__low), "=d"(__high) : "A"(n));                                                              \
+		__upper = __high;                                                                                              \
+		if (__high)                                                                                                    \
+		{                                                                                                              \
+			__upper = __high % (__base);                                                                               \
+			__high = __high / (__base);                                                                                \
+		}                                                                                                              \
+		__asm__("divl %2" : "=a"(__low), "=d"(__mod) : "rm"(__base), "0"(__low), "1"(__upper));                        \
+		__asm__("" : "=A"(n) : "a"(__low), "d"(__high));                                                               \
+		__mod;                                                                                                         \
+	})
+
+/** 64ビット値を32ビット値で割った商を返す
+ * @param dividend 被除数
+ * @param divisor  除数（0は不可）
+ */
+static inline uint64_t div_u64(uint64_t dividend, uint32_t divisor)
+{
+	do_div(dividend, divisor);
+	return dividend;
+}
+
+#endif /* _ASM_I386_DIV64_H */
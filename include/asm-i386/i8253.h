@@ -0,0 +1,31 @@
+/**
+ * i8253.h - 8253/8254 PIT (Programmable Interval Timer)
+ *
+ * @see Linux 2.6.11: include/asm-i386/timex.h, arch/i386/kernel/i8253.c
+ */
+#ifndef _ASM_I386_I8253_H
+#define _ASM_I386_I8253_H
+
+#include <asm-i386/param.h>
+
+/* I/Oポート */
+#define PIT_CH0 0x40  /* チャネル0（IRQ0に接続） */
+#define PIT_CH2 0x42  /* チャネル2（スピーカーに接続．較正用に使う） */
+#define PIT_MODE 0x43 /* モード/コマンドレジスタ */
+#define PIT_GATE2 0x61 /* チャネル2のゲート(bit0)と出力(bit5) */
+
+/* PITの入力クロック周波数（Hz） */
+#define PIT_TICK_RATE 1193182UL
+
+/* HZ回/秒の割り込みに必要なカウント値 */
+#define LATCH ((PIT_TICK_RATE + HZ / 2) / HZ)
+
+/* PITのIRQ番号 */
+#define PIT_IRQ 0
+
+void setup_pit_timer(void);
+void pit_busy_wait_ms(unsigned int ms);
+void pit_ch2_start(unsigned int ms);
+void pit_ch2_wait(void);
+
+#endif /* _ASM_I386_I8253_H */
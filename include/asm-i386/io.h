@@ -17,4 +17,14 @@ static inline uint8_t inb(uint16_t port)
 	return r;
 }
 
+/** メモリマップドI/O **/
+/* ioremap()のメモリタイプ */
+#define IOREMAP_UC 0 /* キャッシュ無効（PCD|PWT）: MMIOレジスタ向け */
+#define IOREMAP_WT 1 /* ライトスルー（PWT） */
+#define IOREMAP_WC 2 /* ライトコンバイン（PAT）: フレームバッファ向け，PATがなければUC */
+
+void *ioremap(unsigned long phys_addr, unsigned long size, int attr);
+void iounmap(void *addr);
+void pat_init(void);
+
 #endif /* ASM_I386_IO_H */
@@ -0,0 +1,28 @@
+/**
+ * mmu_context.h - アドレス空間の切り替え
+ *
+ * @see Linux 2.6.11: include/asm-i386/mmu_context.h
+ */
+#ifndef _ASM_I386_MMU_CONTEXT_H
+#define _ASM_I386_MMU_CONTEXT_H
+
+#include <asm-i386/page.h>
+#include <asm-i386/pgtable.h>
+#include <kfs/mm_types.h>
+
+/** アドレス空間を切り替える
+ * @param prev 切り替え前のmm（NULLならカーネル空間のみ）
+ * @param next 切り替え後のmm
+ * @details nextのページディレクトリをCR3にロードする．同じmmならTLBを保つため何もしない．
+ * @note ページディレクトリを持たないmm（pgd == NULL）は現在のCR3をそのまま使う
+ */
+static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next)
+{
+	if (prev == next || !next || !next->pgd)
+	{
+		return;
+	}
+	load_cr3(__pa(next->pgd));
+}
+
+#endif /* _ASM_I386_MMU_CONTEXT_H */
@@ -0,0 +1,102 @@
+/**
+ * mpspec.h - Intel MultiProcessor Specification 1.4のテーブルと，検出したCPU・I/O APIC
+ *
+ * @see Linux 2.6.11: include/asm-i386/mpspec.h, include/asm-i386/mpspec_def.h
+ */
+#ifndef _ASM_I386_MPSPEC_H
+#define _ASM_I386_MPSPEC_H
+
+#include <kfs/stdint.h>
+#include <kfs/threads.h>
+
+/* MP Floating Pointer Structure（BIOS領域に16バイト境界で置かれる） */
+struct intel_mp_floating
+{
+	char mpf_signature[4];	   /* "_MP_" */
+	uint32_t mpf_physptr;	   /* MP Configuration Tableの物理アドレス */
+	uint8_t mpf_length;		   /* 構造体の長さ（16バイト単位，常に1） */
+	uint8_t mpf_specification; /* 仕様のリビジョン（1.1または1.4） */
+	uint8_t mpf_checksum;	   /* 全バイトの和が0になるよう調整した値 */
+	uint8_t mpf_feature1;	   /* 0ならMP Configuration Tableがある．非0はデフォルト構成の番号 */
+	uint8_t mpf_feature2;	   /* bit7: IMCRがある */
+	uint8_t mpf_feature3;
+	uint8_t mpf_feature4;
+	uint8_t mpf_feature5;
+} __attribute__((packed));
+
+/* MP Configuration Tableのヘッダ（この後ろにエントリが並ぶ） */
+struct mp_config_table
+{
+	char mpc_signature[4]; /* "PCMP" */
+	uint16_t mpc_length;   /* ヘッダを含むテーブル全体の長さ */
+	uint8_t mpc_spec;
+	uint8_t mpc_checksum;
+	char mpc_oem[8];
+	char mpc_productid[12];
+	uint32_t mpc_oemptr;
+	uint16_t mpc_oemsize;
+	uint16_t mpc_oemcount; /* エントリ数 */
+	uint32_t mpc_lapic;	   /* Local APICの物理アドレス */
+	uint32_t reserved;
+} __attribute__((packed));
+
+/* エントリの種類（先頭1バイト） */
+#define MP_PROCESSOR 0 /* 20バイト */
+#define MP_BUS 1	   /* 以下8バイト */
+#define MP_IOAPIC 2
+#define MP_INTSRC 3
+#define MP_LINTSRC 4
+
+/* プロセッサエントリ */
+struct mpc_config_processor
+{
+	uint8_t mpc_type;
+	uint8_t mpc_apicid; /* Local APIC ID */
+	uint8_t mpc_apicver;
+	uint8_t mpc_cpuflag; /* CPU_ENABLED | CPU_BOOTPROCESSOR */
+	uint32_t mpc_cpufeature;
+	uint32_t mpc_featureflag;
+	uint32_t mpc_reserved[2];
+} __attribute__((packed));
+
+#define CPU_ENABLED 1		/* 使用可能 */
+#define CPU_BOOTPROCESSOR 2 /* BSP */
+
+/* I/O APICエントリ */
+struct mpc_config_ioapic
+{
+	uint8_t mpc_type;
+	uint8_t mpc_apicid;
+	uint8_t mpc_apicver;
+	uint8_t mpc_flags; /* MPC_APIC_USABLE */
+	uint32_t mpc_apicaddr;
+} __attribute__((packed));
+
+#define MPC_APIC_USABLE 1
+
+/* 記録するI/O APICの最大数 */
+#define MAX_IO_APICS 4
+
+/* 検出したI/O APIC */
+struct mp_ioapic
+{
+	uint8_t id;		  /* I/O APIC ID */
+	uint32_t address; /* MMIOの物理アドレス */
+};
+
+/* 検出した使用可能なCPUのLocal APIC ID（検出順） */
+extern uint8_t mp_lapic_ids[NR_CPUS];
+extern int num_processors;
+
+/* 検出したI/O APIC（まだ使わず，8259Aで割り込みを受ける） */
+extern struct mp_ioapic mp_ioapics[MAX_IO_APICS];
+extern int nr_ioapics;
+
+/* arch/i386/kernel/mpparse.c */
+void mp_register_lapic(uint8_t id, int enabled);
+void mp_register_ioapic(uint8_t id, uint32_t address);
+int smp_read_mpc(struct mp_config_table *mpc);
+int get_smp_config(void);
+void mp_reset_for_test(void);
+
+#endif /* _ASM_I386_MPSPEC_H */
@@ -0,0 +1,29 @@
+/**
+ * msr.h - モデル固有レジスタ（MSR）アクセス
+ *
+ * @see Linux 2.6.11: include/asm-i386/msr.h
+ */
+#ifndef _ASM_I386_MSR_H
+#define _ASM_I386_MSR_H
+
+#include <kfs/stdint.h>
+
+/* MSR番号 */
+#define MSR_IA32_APICBASE 0x1B /* Local APICのベースアドレス */
+#define MSR_IA32_CR_PAT 0x277  /* Page Attribute Table */
+
+/** MSRを読み出す
+ * @param msr MSR番号
+ * @param lo  下位32ビットの格納先
+ * @param hi  上位32ビットの格納先
+ */
+#define rdmsr(msr, lo, hi) __asm__ __volatile__("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr))
+
+/** MSRに書き込む
+ * @param msr MSR番号
+ * @param lo  下位32ビット
+ * @param hi  上位32ビット
+ */
+#define wrmsr(msr, lo, hi) __asm__ __volatile__("wrmsr" : : "c"(msr), "a"(lo), "d"(hi) : "memory")
+
+#endif /* _ASM_I386_MSR_H */
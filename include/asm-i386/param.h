@@ -0,0 +1,12 @@
+#ifndef _ASM_I386_PARAM_H
+#define _ASM_I386_PARAM_H
+
+/** タイマー割り込みの周波数（1秒あたりのtick数）
+ * @see Linux 2.6.11: include/asm-i386/param.h
+ */
+#define HZ 100
+
+/* 1 tickあたりのナノ秒 */
+#define TICK_NSEC (1000000000UL / HZ)
+
+#endif /* _ASM_I386_PARAM_H */
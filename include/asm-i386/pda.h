@@ -0,0 +1,60 @@
+/**
+ * pda.h - CPUごとのデータ領域（PDA: Per-processor Data Area）
+ *
+ * 各CPUは自分のPDAをベースとするセグメント（__KERNEL_PDA）を%fsに持ち，
+ * %fs:オフセットで自分のデータを1命令で読み書きする．
+ * @see Linux 2.6.20: include/asm-i386/pda.h（2.6.20は%gs，2.6.21以降は%fsを使う）
+ */
+#ifndef _ASM_I386_PDA_H
+#define _ASM_I386_PDA_H
+
+/* entry.S用のフィールドオフセット（struct i386_pdaと一致させる） */
+#define PDA_pcurrent 8
+
+#ifndef __ASSEMBLER__
+
+#include <kfs/threads.h>
+
+struct task_struct;
+
+/** CPUごとのデータ
+ * @note メンバはすべて4バイト（read_pda()/write_pda()はmovlで読み書きする）．
+ *       メンバの順序を変えたらPDA_*も変えること
+ */
+struct i386_pda
+{
+	struct i386_pda *_pda;		  /* 自分自身へのポインタ（PDAのアドレスを得るため） */
+	int cpu_number;				  /* 論理CPU番号（BSPは0） */
+	struct task_struct *pcurrent; /* このCPUで実行中のタスク */
+};
+
+_Static_assert(__builtin_offsetof(struct i386_pda, pcurrent) == PDA_pcurrent, "PDA_pcurrent mismatch");
+
+/* 全CPUのPDA（arch/i386/kernel/gdt.c） */
+extern struct i386_pda _cpu_pda[NR_CPUS];
+#define cpu_pda(cpu) (&_cpu_pda[cpu])
+
+/** 自CPUのPDAのメンバを読む
+ * @note コンテキストスイッチをまたいで値を使い回さないよう，毎回読み直す
+ */
+#define read_pda(field)                                                                                                \
+	({                                                                                                                 \
+		__typeof__(((struct i386_pda *)0)->field) __ret;                                                               \
+		__asm__ __volatile__("movl %%fs:%c1, %0" : "=r"(__ret) : "i"(__builtin_offsetof(struct i386_pda, field)));     \
+		__ret;                                                                                                         \
+	})
+
+/* 自CPUのPDAのメンバに書き込む */
+#define write_pda(field, val)                                                                                          \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		__typeof__(((struct i386_pda *)0)->field) __val = (val);                                                       \
+		__asm__ __volatile__("movl %0, %%fs:%c1"                                                                       \
+							 :                                                                                         \
+							 : "r"(__val), "i"(__builtin_offsetof(struct i386_pda, field))                             \
+							 : "memory");                                                                              \
+	} while (0)
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _ASM_I386_PDA_H */
@@ -16,6 +16,8 @@
 #define _PAGE_DIRTY 0x040	 /* D: ページが書き込まれた（PTEのみ） */
 #define _PAGE_PSE 0x080		 /* PS: ページサイズ（0=4KB, 1=4MB、PDEのみ） */
 #define _PAGE_GLOBAL 0x100	 /* G: グローバルページ（TLBフラッシュ時も保持） */
+#define _PAGE_PAT 0x080		 /* PAT: 4KBページのPATインデックス上位ビット（PTEのみ，PSEと同じ位置） */
+#define _PAGE_COW 0x200		 /* AVL: 書き込み時にコピーする（fork()で共有した書き込み可能ページ，PTEのみ） */
 
 /* ページディレクトリ/テーブルエントリの型 */
 typedef uint32_t pte_t; /* ページテーブルエントリ */
@@ -32,6 +34,13 @@ typedef pde_t pgd_t; /* ページグローバルディレクトリ（i386では
  */
 #define PTRS_PER_PGD 1024
 
+/** ユーザー空間のページディレクトリエントリの範囲
+ * @details PAGE_OFFSET(3GB)より下がユーザー空間．ただしPDE 0はカーネルが使う0〜4MBの恒等マッピングなので，
+ *          プロセスごとのページディレクトリでもカーネル部分として共有する
+ */
+#define FIRST_USER_PGD_NR 1
+#define USER_PTRS_PER_PGD (PAGE_OFFSET >> 22)
+
 /* 1ページテーブルがカバーするアドレス範囲（4MB） */
 #define PGDIR_SIZE (1UL << 22) /* 4MB = 1024エントリ × 4KB/エントリ */
 #define PGDIR_MASK (~(PGDIR_SIZE - 1))
@@ -162,21 +171,46 @@ static inline unsigned long read_cr3(void)
 	return cr3;
 }
 
+/** CR2レジスタを読み取る
+ * @brief ページフォルトを起こした線形アドレスを取得する
+ * @note CR2はページフォルト発生時にCPUが自動で書き込む
+ */
+static inline unsigned long read_cr2(void)
+{
+	unsigned long cr2;
+	__asm__ __volatile__("movl %%cr2, %0" : "=r"(cr2));
+	return cr2;
+}
+
 /* ========== ページング有効化 ========== */
 
-/** CR0のPGビットを設定してページングを有効化する
- * @brief CR0のPGビットが1のとき，ページングが有効になりCR3レジスタが使用されるようになる
+/* CR0のビット */
+#define X86_CR0_WP 0x00010000 /* リング0からの書き込みでも読み取り専用ページを保護する */
+#define X86_CR0_PG 0x80000000 /* ページングを有効にする */
+
+/* CR0レジスタを読み取る */
+static inline unsigned long read_cr0(void)
+{
+	unsigned long cr0;
+	__asm__ __volatile__("movl %%cr0, %0" : "=r"(cr0));
+	return cr0;
+}
+
+/** CR0のPGビットとWPビットを設定してページングを有効化する
+ * @brief CR0のPGビットが1のとき，ページングが有効になりCR3レジスタが使用されるようになる．
+ *        WPビットが1のとき，カーネルからの書き込みでもCOWページでフォルトする
  * @see Section 4.1.3(Control Registers) of
  *      https://pdos.csail.mit.edu/6.828/2018/readings/i386.pdf
+ * @note 起動時はarch/i386/boot/boot.SとAPのtrampoline.Sが同じビットを設定する
  */
 static inline void enable_paging(void)
 {
 	unsigned long cr0;
 	__asm__ __volatile__("movl %%cr0, %0\n"
-						 "orl $0x80000000, %0\n" /* PGビット(bit 31)を設定 */
+						 "orl %1, %0\n"
 						 "movl %0, %%cr0\n"
-						 : "=r"(cr0)
-						 :
+						 : "=&r"(cr0)
+						 : "i"(X86_CR0_PG | X86_CR0_WP)
 						 : "memory");
 }
 
@@ -229,6 +263,34 @@ static inline void pte_clear(pte_t *pte)
 	*pte = 0;
 }
 
+/** PTEを読み出してからクリアする
+ * @param ptep 対象のPTEポインタ
+ * @return クリア前のPTEの値
+ * @note TLBのフラッシュは呼び出し元の責任で行う
+ */
+static inline pte_t ptep_get_and_clear(pte_t *ptep)
+{
+	pte_t pte = *ptep;
+	pte_clear(ptep);
+	return pte;
+}
+
+/** 単一ページのTLBエントリを無効化する
+ * @param addr 無効化する仮想アドレス
+ * @note __flush_tlb()がTLB全体を捨てるのに対し，指定ページのみを無効化する
+ */
+static inline void __flush_tlb_one(unsigned long addr)
+{
+	__asm__ __volatile__("invlpg (%0)" ::"r"(addr) : "memory");
+}
+
+/** 全CPUのTLBを無効化する (arch/i386/kernel/smp.c)
+ * @note __flush_tlb()/__flush_tlb_one()は自分のCPUだけを無効化する．
+ *       カーネルのマッピングを外した後，仮想アドレスやページテーブルを再利用する前にはこちらを使う
+ */
+void flush_tlb_all(void);
+void flush_tlb_kernel_range(unsigned long start, unsigned long end);
+
 /* ページディレクトリエントリをクリア */
 static inline void pde_clear(pde_t *pde)
 {
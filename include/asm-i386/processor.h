@@ -0,0 +1,103 @@
+/**
+ * processor.h - CPU識別（CPUID）と機能フラグ
+ *
+ * @see Linux 2.6.11: include/asm-i386/processor.h, include/asm-i386/cpufeature.h
+ */
+#ifndef _ASM_I386_PROCESSOR_H
+#define _ASM_I386_PROCESSOR_H
+
+#include <kfs/stdint.h>
+
+/* CPUID(EAX=1)のEDXで報告される機能ビット */
+#define X86_FEATURE_TSC (1U << 4)	/* Time Stamp Counter */
+#define X86_FEATURE_MSR (1U << 5)	/* RDMSR/WRMSR命令 */
+#define X86_FEATURE_APIC (1U << 9)	/* オンチップLocal APIC */
+#define X86_FEATURE_PAT (1U << 16)	/* Page Attribute Table */
+
+/* CPUID(EAX=1)のECXで報告される機能ビット */
+#define X86_FEATURE_MWAIT (1U << 3) /* MONITOR/MWAIT命令 */
+
+/** CPUID命令を実行する
+ * @param op   EAXに設定する機能番号（leaf）
+ * @param eax  EAXの結果の格納先
+ * @param ebx  EBXの結果の格納先
+ * @param ecx  ECXの結果の格納先
+ * @param edx  EDXの結果の格納先
+ * @note i486以前のCPUIDを持たないCPUは対象外とする
+ */
+static inline void cpuid(uint32_t op, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+	__asm__ __volatile__("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "0"(op), "2"(0));
+}
+
+/* 指定したleafのCPUIDを実行してEDXを返す */
+static inline uint32_t cpuid_edx(uint32_t op)
+{
+	uint32_t eax, ebx, ecx, edx;
+	cpuid(op, &eax, &ebx, &ecx, &edx);
+	return edx;
+}
+
+/* 指定したleafのCPUIDを実行してECXを返す */
+static inline uint32_t cpuid_ecx(uint32_t op)
+{
+	uint32_t eax, ebx, ecx, edx;
+	cpuid(op, &eax, &ebx, &ecx, &edx);
+	return ecx;
+}
+
+#define cpu_has(feature) ((cpuid_edx(1) & (feature)) != 0)
+#define cpu_has_pat cpu_has(X86_FEATURE_PAT)
+#define cpu_has_mwait ((cpuid_ecx(1) & X86_FEATURE_MWAIT) != 0)
+
+/* MONITOR/MWAITの情報を報告するCPUIDのleaf（EDXのビット7:4がC1のサブステート数） */
+#define CPUID_MWAIT_LEAF 5
+#define MWAIT_C1_SUBSTATES(edx) (((edx) >> 4) & 0xf)
+
+/** アドレスの書き込みを監視する（MONITOR命令）
+ * @param addr 監視するアドレス（このアドレスを含むキャッシュラインへの書き込みでMWAITから起きる）
+ * @param ecx  拡張（0）
+ * @param edx  ヒント（0）
+ */
+static inline void __monitor(const void *addr, unsigned long ecx, unsigned long edx)
+{
+	__asm__ __volatile__("monitor" ::"a"(addr), "c"(ecx), "d"(edx));
+}
+
+/** 割り込みを許可してMONITORしたアドレスへの書き込みか割り込みまで休止する（sti; mwait）
+ * @param eax ヒント（0ならC1）
+ * @param ecx 拡張（0）
+ * @note stiの直後の1命令は割り込みを受け付けないため，許可から休止までの間の割り込みを取りこぼさない
+ */
+static inline void __sti_mwait(unsigned long eax, unsigned long ecx)
+{
+	__asm__ __volatile__("sti; mwait" ::"a"(eax), "c"(ecx) : "memory");
+}
+
+/** カーネルスタックサイズ（8KB = 2ページ）
+ * @note task_struct->stackの先頭からTHREAD_SIZEバイトがスタック領域となる
+ * @note vmalloc領域にマップするため，物理的に連続したページは要らない
+ */
+#define THREAD_SIZE 8192
+
+/** タスクごとのCPU状態
+ * @details コンテキストスイッチで保存・復元するレジスタ．
+ *          汎用レジスタのうちcallee-savedなものとEFLAGSは切り替え前のスタックに積まれるため，
+ *          ここにはスタックポインタと再開アドレスだけを持つ．
+ * @see Linux 2.6.11: include/asm-i386/processor.h
+ */
+struct thread_struct
+{
+	unsigned long esp; /* 切り替え時のカーネルスタックポインタ */
+	unsigned long eip; /* 次にスケジュールされたときの再開アドレス */
+};
+
+/** CPUをビジーウェイトループ中であることをCPUに伝える
+ * @note Linux 2.6.11のcpu_relax()（rep; nop = PAUSE命令）に相当
+ */
+static inline void cpu_relax(void)
+{
+	__asm__ __volatile__("rep; nop" ::: "memory");
+}
+
+#endif /* _ASM_I386_PROCESSOR_H */
@@ -0,0 +1,33 @@
+/**
+ * smp.h - APの起動
+ *
+ * @see Linux 2.6.11: include/asm-i386/smp.h
+ */
+#ifndef _ASM_I386_SMP_H
+#define _ASM_I386_SMP_H
+
+/** APの起動コード（trampoline.S）をコピーする物理アドレス
+ * @note Startup IPIのベクタは開始アドレス/4KBのため，1MB未満の4KB境界に置く
+ */
+#define TRAMPOLINE_BASE 0x7000
+
+#ifndef __ASSEMBLER__
+
+#include <kfs/stdint.h>
+#include <kfs/threads.h>
+
+/* APの起動コード（arch/i386/kernel/trampoline.S） */
+extern char trampoline_data[];
+extern char trampoline_end[];
+
+/* 起動中のAPが使うスタックの先頭（trampoline.Sが読む） */
+extern unsigned long stack_start;
+
+/* 論理CPU番号からLocal APIC IDへの対応（arch/i386/kernel/smpboot.c） */
+extern uint8_t cpu_to_apicid[NR_CPUS];
+
+void start_secondary(void);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _ASM_I386_SMP_H */
@@ -0,0 +1,99 @@
+/**
+ * spinlock.h - チケットスピンロック
+ *
+ * 取得するCPUはnextを1つ進めて番号札を受け取り，ownerが自分の番号になるまで回って待つ．
+ * 解放するCPUはownerを1つ進める．待っているCPUは到着順にロックを得るため，
+ * 単純なtest-and-setのロックと違い，特定のCPUだけが待たされ続けることがない．
+ * @note ここはロック変数の操作だけを行う．プリエンプションと割り込みの禁止はkfs/spinlock.hで行う
+ * @see Linux 2.6.25: include/asm-x86/spinlock.h
+ */
+#ifndef _ASM_I386_SPINLOCK_H
+#define _ASM_I386_SPINLOCK_H
+
+#include <asm-i386/atomic.h>
+#include <asm-i386/processor.h>
+#include <kfs/compiler.h>
+#include <kfs/stdint.h>
+
+/** ロック変数
+ * @details slockの下位16ビットがowner，上位16ビットがnext．
+ *          取得はslockに1 << TICKET_SHIFTをxaddで加え，番号札の受け取りと現在のownerの読み出しを1命令で行う
+ */
+typedef struct
+{
+	union
+	{
+		uint32_t slock;
+		struct
+		{
+			uint16_t owner; /* ロックを持っている番号札 */
+			uint16_t next;	/* 次に配る番号札 */
+		} tickets;
+	};
+} arch_spinlock_t;
+
+#define TICKET_SHIFT 16
+
+#define __ARCH_SPIN_LOCK_UNLOCKED {{0}}
+
+/* ロックされているか */
+static inline int arch_spin_is_locked(arch_spinlock_t *lock)
+{
+	arch_spinlock_t tmp;
+
+	tmp.slock = READ_ONCE(lock->slock);
+	return tmp.tickets.owner != tmp.tickets.next;
+}
+
+/* 保持しているCPUの他に待っているCPUがあるか */
+static inline int arch_spin_is_contended(arch_spinlock_t *lock)
+{
+	arch_spinlock_t tmp;
+
+	tmp.slock = READ_ONCE(lock->slock);
+	return (uint16_t)(tmp.tickets.next - tmp.tickets.owner) > 1;
+}
+
+/* ロックを取得する（取れるまで回る） */
+static inline void arch_spin_lock(arch_spinlock_t *lock)
+{
+	uint32_t inc = 1 << TICKET_SHIFT;
+	uint16_t owner, ticket;
+
+	__asm__ __volatile__(LOCK_PREFIX "xaddl %0,%1" : "+r"(inc), "+m"(lock->slock) : : "memory");
+	ticket = (uint16_t)(inc >> TICKET_SHIFT);
+	owner = (uint16_t)inc;
+	while (owner != ticket)
+	{
+		cpu_relax();
+		owner = READ_ONCE(lock->tickets.owner);
+	}
+	barrier();
+}
+
+/** ロックの取得を1度だけ試みる
+ * @return 取得できたら非0
+ * @note 空いているときだけnextを進める．待ち行列に並ばないため，失敗しても後始末はいらない
+ */
+static inline int arch_spin_trylock(arch_spinlock_t *lock)
+{
+	arch_spinlock_t old;
+
+	old.slock = READ_ONCE(lock->slock);
+	if (old.tickets.owner != old.tickets.next)
+	{
+		return 0;
+	}
+	return cmpxchg(&lock->slock, old.slock, old.slock + (1 << TICKET_SHIFT)) == old.slock;
+}
+
+/** ロックを解放する
+ * @note ownerを書き換えるのは保持しているCPUだけなので，lockプレフィックスはいらない．
+ *       x86のストアは先行するロード・ストアを追い越さないため，保護していた書き込みは解放前に見える
+ */
+static inline void arch_spin_unlock(arch_spinlock_t *lock)
+{
+	__asm__ __volatile__("incw %0" : "+m"(lock->tickets.owner) : : "memory");
+}
+
+#endif /* _ASM_I386_SPINLOCK_H */
@@ -0,0 +1,101 @@
+/**
+ * system.h - コンテキストスイッチと割り込みフラグ操作
+ *
+ * @see Linux 2.6.11: include/asm-i386/system.h
+ */
+#ifndef _ASM_I386_SYSTEM_H
+#define _ASM_I386_SYSTEM_H
+
+#include <kfs/linkage.h>
+
+struct task_struct;
+
+/* arch/i386/kernel/process.c */
+extern struct task_struct *fastcall __switch_to(struct task_struct *prev, struct task_struct *next);
+
+/** prevからnextへ実行を切り替える
+ * @param prev 現在実行中のタスク
+ * @param next 次に実行するタスク
+ * @param last prevが再びスケジュールされたとき，直前まで実行していたタスクが格納される
+ * @details EFLAGSとEBPをprevのスタックに積み，ESPと再開アドレス（ラベル1）を
+ *          prev->threadに保存する．次にnextのESPを復元し，nextの再開アドレスを
+ *          戻りアドレスとして積んで__switch_to()へジャンプする．
+ *          __switch_to()のretでnextの実行が再開される．
+ * @note EBX, ESI, EDIは出力として宣言し，コンパイラに切り替え前後で値が壊れることを伝える．
+ *       これによりcallee-savedレジスタは呼び出し元のスタックフレームに退避される．
+ */
+#define switch_to(prev, next, last)                                                                                    \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		unsigned long ebx, ecx, edx, esi, edi;                                                                         \
+		__asm__ __volatile__("pushfl\n\t"                                                                              \
+							 "pushl %%ebp\n\t"                                                                         \
+							 "movl %%esp, %[prev_sp]\n\t"                                                              \
+							 "movl %[next_sp], %%esp\n\t"                                                              \
+							 "movl $1f, %[prev_ip]\n\t"                                                                \
+							 "pushl %[next_ip]\n\t"                                                                    \
+							 "jmp __switch_to\n"                                                                       \
+							 "1:\t"                                                                                    \
+							 "popl %%ebp\n\t"                                                                          \
+							 "popfl\n"                                                                                 \
+							 : [prev_sp] "=m"((prev)->thread.esp), [prev_ip] "=m"((prev)->thread.eip), "=a"(last),     \
+							   "=b"(ebx), "=c"(ecx), "=d"(edx), "=S"(esi), "=D"(edi)                                   \
+							 : [next_sp] "m"((next)->thread.esp), [next_ip] "m"((next)->thread.eip), "a"(prev),        \
+							   "d"(next)                                                                               \
+							 : "memory");                                                                              \
+	} while (0)
+
+/* ========== 割り込みフラグ操作 ========== */
+
+/* 割り込みを禁止する */
+static inline void local_irq_disable(void)
+{
+	__asm__ __volatile__("cli" ::: "memory");
+}
+
+/* 割り込みを許可する */
+static inline void local_irq_enable(void)
+{
+	__asm__ __volatile__("sti" ::: "memory");
+}
+
+/* EFLAGSを読み取る */
+static inline unsigned long local_save_flags(void)
+{
+	unsigned long flags;
+	__asm__ __volatile__("pushfl; popl %0" : "=g"(flags) : : "memory");
+	return flags;
+}
+
+/* EFLAGSを復元する（IFビットも元に戻る） */
+static inline void local_irq_restore(unsigned long flags)
+{
+	__asm__ __volatile__("pushl %0; popfl" : : "g"(flags) : "memory", "cc");
+}
+
+/** 現在のEFLAGSを保存して割り込みを禁止する
+ * @param flags 保存先の変数（unsigned long）
+ */
+#define local_irq_save(flags)                                                                                          \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		(flags) = local_save_flags();                                                                                  \
+		local_irq_disable();                                                                                           \
+	} while (0)
+
+/** 割り込みを許可して次の割り込みまでCPUを休止する
+ * @note stiの直後の1命令までは割り込みが受け付けられないため，
+ *       sti; hltの間に割り込みが入って起床を取りこぼすことはない
+ */
+static inline void safe_halt(void)
+{
+	__asm__ __volatile__("sti; hlt" ::: "memory");
+}
+
+/* 割り込みが禁止されているか */
+static inline int irqs_disabled(void)
+{
+	return !(local_save_flags() & (1 << 9));
+}
+
+#endif /* _ASM_I386_SYSTEM_H */
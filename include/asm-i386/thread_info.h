@@ -0,0 +1,38 @@
+/**
+ * thread_info.h - アセンブリからも参照するタスクの低レベル情報
+ *
+ * task_structの先頭に置き，entry.Sがcurrentから固定オフセットで読めるようにする
+ * @see Linux 2.6.11: include/asm-i386/thread_info.h
+ * @note Linux 6.18と同様にtask_struct内に置く（CONFIG_THREAD_INFO_IN_TASK相当）
+ */
+#ifndef _ASM_I386_THREAD_INFO_H
+#define _ASM_I386_THREAD_INFO_H
+
+/* thread_info->flagsのビット番号 */
+#define TIF_NEED_RESCHED 3	/* 再スケジュールが必要 */
+#define TIF_POLLING_NRFLAG 16 /* アイドルループがMWAITでTIF_NEED_RESCHEDを監視している（立てるだけで起きる） */
+
+#define _TIF_NEED_RESCHED (1 << TIF_NEED_RESCHED)
+#define _TIF_POLLING_NRFLAG (1 << TIF_POLLING_NRFLAG)
+
+/* entry.S用のフィールドオフセット（struct thread_infoと一致させる） */
+#define TI_flags 0
+#define TI_preempt_count 4
+
+#ifndef __ASSEMBLER__
+
+/** タスクの低レベル情報
+ * @note メンバの順序を変えたらTI_*も変えること
+ */
+struct thread_info
+{
+	unsigned long flags; /* TIF_*フラグ */
+	int preempt_count;	 /* 0ならプリエンプト可能，正ならプリエンプト禁止 */
+};
+
+_Static_assert(__builtin_offsetof(struct thread_info, flags) == TI_flags, "TI_flags mismatch");
+_Static_assert(__builtin_offsetof(struct thread_info, preempt_count) == TI_preempt_count, "TI_preempt_count mismatch");
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _ASM_I386_THREAD_INFO_H */
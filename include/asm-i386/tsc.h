@@ -0,0 +1,27 @@
+/**
+ * tsc.h - TSC (Time Stamp Counter)
+ *
+ * @see Linux 2.6.11: include/asm-i386/msr.h (rdtscll), include/asm-i386/timex.h
+ */
+#ifndef _ASM_I386_TSC_H
+#define _ASM_I386_TSC_H
+
+#include <kfs/stdint.h>
+
+/** TSCを読む
+ * @return リセットからのCPUクロック数
+ * @note rdtscは前の命令の完了を待たないため，計測区間の境界は数十サイクルずれうる
+ */
+static inline uint64_t rdtsc(void)
+{
+	uint64_t val;
+	__asm__ __volatile__("rdtsc" : "=A"(val));
+	return val;
+}
+
+/* 較正したTSCの周波数（kHz）．TSCがなければ0 */
+extern uint32_t tsc_khz;
+
+void tsc_init(void);
+
+#endif /* _ASM_I386_TSC_H */
@@ -0,0 +1,64 @@
+/**
+ * bitmap.h - ビットマップ
+ *
+ * unsigned long配列で表した任意長のビット列を，ワード単位でまとめて走査・操作する．
+ * PIDビットマップやページビットマップのように，空きを探す処理が1ビットずつにならないようにするためのもの．
+ * @see Linux 6.18: include/linux/bitmap.h, include/linux/find.h
+ */
+#ifndef _KFS_BITMAP_H
+#define _KFS_BITMAP_H
+
+#include <asm-i386/bitops.h>
+#include <kfs/string.h>
+
+/* nbitsビットを格納するのに必要なunsigned longの数 */
+#define BITS_TO_LONGS(nbits) (((nbits) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+/** nbitsビットのビットマップを宣言する
+ * @example
+ * static DECLARE_BITMAP(map, 1024);   // unsigned long map[32];
+ */
+#define DECLARE_BITMAP(name, nbits) unsigned long name[BITS_TO_LONGS(nbits)]
+
+/* startを含むワードで，start以上のビットを表すマスク */
+#define BITMAP_FIRST_WORD_MASK(start) (~0UL << ((start) & (BITS_PER_LONG - 1)))
+
+/* 最後のワードで，nbits未満のビットを表すマスク */
+#define BITMAP_LAST_WORD_MASK(nbits) (~0UL >> (-(nbits) & (BITS_PER_LONG - 1)))
+
+unsigned long find_next_bit(const unsigned long *addr, unsigned long size, unsigned long offset);
+unsigned long find_next_zero_bit(const unsigned long *addr, unsigned long size, unsigned long offset);
+unsigned long find_last_bit(const unsigned long *addr, unsigned long size);
+void bitmap_set(unsigned long *map, unsigned long start, unsigned long len);
+void bitmap_clear(unsigned long *map, unsigned long start, unsigned long len);
+unsigned long bitmap_weight(const unsigned long *map, unsigned long nbits);
+
+/** 最初に立っているビットを探す
+ * @return ビット番号（見つからなければsize）
+ */
+static inline unsigned long find_first_bit(const unsigned long *addr, unsigned long size)
+{
+	return find_next_bit(addr, size, 0);
+}
+
+/** 最初に落ちているビットを探す
+ * @return ビット番号（見つからなければsize）
+ */
+static inline unsigned long find_first_zero_bit(const unsigned long *addr, unsigned long size)
+{
+	return find_next_zero_bit(addr, size, 0);
+}
+
+/* ビットマップ全体を0にする */
+static inline void bitmap_zero(unsigned long *dst, unsigned long nbits)
+{
+	memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(unsigned long));
+}
+
+/* ビットマップ全体を1にする（最後のワードのnbits以上のビットも立つ） */
+static inline void bitmap_fill(unsigned long *dst, unsigned long nbits)
+{
+	memset(dst, 0xff, BITS_TO_LONGS(nbits) * sizeof(unsigned long));
+}
+
+#endif /* _KFS_BITMAP_H */
@@ -0,0 +1,72 @@
+/**
+ * clockchips.h - クロックイベントデバイス
+ *
+ * 指定した時刻に割り込みを発生させるハードウェアタイマーの抽象化．
+ * tick層はデバイスの種類（PIT/Local APIC）を意識せずに周期tickやワンショットを設定できる．
+ * @see Linux 6.18: include/linux/clockchips.h
+ */
+#ifndef _KFS_CLOCKCHIPS_H
+#define _KFS_CLOCKCHIPS_H
+
+#include <kfs/stdint.h>
+
+/* デバイスの機能（clock_event_device->features） */
+#define CLOCK_EVT_FEAT_PERIODIC 0x01 /* 周期モードに対応 */
+#define CLOCK_EVT_FEAT_ONESHOT 0x02	 /* ワンショットモードに対応 */
+
+/* デバイスの状態（clock_event_device->state） */
+#define CLOCK_EVT_STATE_DETACHED 0 /* 未使用 */
+#define CLOCK_EVT_STATE_SHUTDOWN 1 /* 停止中 */
+#define CLOCK_EVT_STATE_PERIODIC 2 /* 周期割り込み */
+#define CLOCK_EVT_STATE_ONESHOT 3  /* 1回だけ割り込み */
+
+/** クロックイベントデバイス
+ * @details ナノ秒とデバイスのサイクル数はmult/shiftで相互変換する．
+ *          cycles = (ns * mult) >> shift
+ */
+struct clock_event_device
+{
+	const char *name;
+	unsigned int features; /* CLOCK_EVT_FEAT_* */
+	int rating;			   /* 優先度（高いほど優先して使う） */
+	int state;			   /* CLOCK_EVT_STATE_* */
+
+	uint32_t mult;				   /* ナノ秒→サイクルの乗数 */
+	uint32_t shift;				   /* ナノ秒→サイクルのシフト量 */
+	uint64_t min_delta_ns;		   /* ワンショットで設定できる最短時間 */
+	uint64_t max_delta_ns;		   /* ワンショットで設定できる最長時間 */
+	unsigned long min_delta_ticks; /* min_delta_nsのサイクル数 */
+	unsigned long max_delta_ticks; /* max_delta_nsのサイクル数 */
+
+	/* 割り込み発生時にデバイスドライバから呼ばれる（tick層が設定する） */
+	void (*event_handler)(struct clock_event_device *dev);
+
+	/* 状態遷移（ドライバが実装する） */
+	int (*set_state_periodic)(struct clock_event_device *dev);
+	int (*set_state_oneshot)(struct clock_event_device *dev);
+	int (*set_state_shutdown)(struct clock_event_device *dev);
+
+	/* deltaサイクル後に割り込みを発生させる（ワンショットモード） */
+	int (*set_next_event)(unsigned long delta, struct clock_event_device *dev);
+
+	/* ワンショットの残りサイクル数を返す（省略可．tickless idleの経過時間計算に使う） */
+	unsigned long (*read_remaining)(struct clock_event_device *dev);
+};
+
+/* kernel/time/clockevents.c */
+void clockevents_config(struct clock_event_device *dev, uint32_t freq);
+void clockevents_register_device(struct clock_event_device *dev);
+void clockevents_switch_state(struct clock_event_device *dev, int state);
+int clockevents_program_event(struct clock_event_device *dev, uint64_t delta_ns);
+uint64_t clockevent_delta2ns(unsigned long cycles, const struct clock_event_device *dev);
+void clockevents_handle_noop(struct clock_event_device *dev);
+
+/* kernel/time/tick.c */
+void tick_check_new_device(struct clock_event_device *dev);
+struct clock_event_device *tick_get_device(void);
+void tick_handle_periodic(struct clock_event_device *dev);
+void tick_nohz_idle_enter(void);
+void tick_nohz_idle_exit(void);
+void tick_reset_for_test(void);
+
+#endif /* _KFS_CLOCKCHIPS_H */
@@ -0,0 +1,51 @@
+/**
+ * clocksource.h - クロックソース
+ *
+ * 単調に増加するハードウェアカウンタ（TSC等）の抽象化．
+ * timekeeping層は最も優先度の高いクロックソースを読んで現在時刻（ナノ秒）を求める．
+ * @see Linux 6.18: include/linux/clocksource.h
+ */
+#ifndef _KFS_CLOCKSOURCE_H
+#define _KFS_CLOCKSOURCE_H
+
+#include <kfs/math64.h>
+#include <kfs/stdint.h>
+
+/** クロックソース
+ * @details サイクル数はmult/shiftでナノ秒に変換する．
+ *          ns = (cycles * mult) >> shift
+ */
+struct clocksource
+{
+	const char *name;
+	int rating;								   /* 優先度（高いほど優先して使う） */
+	uint64_t (*read)(struct clocksource *cs); /* カウンタを読む */
+	uint64_t mask;							   /* カウンタの有効ビット（ラップアラウンド処理用） */
+	uint32_t mult;							   /* サイクル→ナノ秒の乗数 */
+	uint32_t shift;							   /* サイクル→ナノ秒のシフト量 */
+	struct clocksource *next;				   /* 登録済みクロックソースのリスト */
+};
+
+/* 下位bitsビットが有効なカウンタのマスク */
+#define CLOCKSOURCE_MASK(bits) ((bits) < 64 ? ((1ULL << (bits)) - 1) : ~0ULL)
+
+/** サイクル数をナノ秒に変換する
+ * @note 96ビットの中間値で計算するため，cyclesが大きくても桁あふれしない
+ */
+static inline uint64_t clocksource_cyc2ns(uint64_t cycles, uint32_t mult, uint32_t shift)
+{
+	return mul_u64_u32_shr(cycles, mult, shift);
+}
+
+/* kernel/time/clocksource.c */
+void clocks_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from, uint32_t to, uint32_t maxsec);
+void clocksource_register(struct clocksource *cs);
+void clocksource_register_khz(struct clocksource *cs, uint32_t khz);
+void clocksource_unregister(struct clocksource *cs);
+
+/* kernel/time/timekeeping.c */
+void timekeeping_notify(struct clocksource *cs);
+struct clocksource *timekeeping_get_clocksource(void);
+void update_wall_time(void);
+
+#endif /* _KFS_CLOCKSOURCE_H */
@@ -0,0 +1,22 @@
+/**
+ * compiler.h - コンパイラ向けの補助マクロ
+ *
+ * @see Linux 6.18: include/linux/compiler.h, include/asm-generic/rwonce.h
+ */
+#ifndef _KFS_COMPILER_H
+#define _KFS_COMPILER_H
+
+/** コンパイラによるメモリアクセスの並べ替えを禁止する
+ * @note CPUの並べ替えは防がない（x86ではストア同士，ロード同士は並べ替えられない）
+ */
+#define barrier() __asm__ __volatile__("" ::: "memory")
+
+/* 変数を1回だけ読み書きさせる（最適化によるキャッシュや分割を防ぐ） */
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *)&(x) = (val))
+
+/* 分岐予測のヒント */
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#endif /* _KFS_COMPILER_H */
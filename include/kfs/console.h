@@ -14,6 +14,7 @@ uint16_t kfs_vga_make_entry(char c, uint8_t color);
 
 /* 初期化ルーチン (従来 umbrella 経由で公開) */
 void terminal_initialize(void);
+void terminal_ioremap(void);
 
 /* 端末出力 API */
 void terminal_putchar(char c);
@@ -0,0 +1,58 @@
+/**
+ * cpuidle.h - アイドル中のCPUの休止と統計
+ *
+ * アイドルループは眠る前に登録された後回しの仕事（idle_work）を片付け，
+ * 起動時に選んだ休止命令（HLTまたはMONITOR/MWAIT）で休止する．
+ * CPUごとに休止した回数と時間，アイドル中の再スケジュール要求からアイドルループを抜けるまでの時間を数える
+ * @see Linux 6.18: include/linux/cpuidle.h, kernel/sched/idle.c
+ */
+#ifndef _KFS_CPUIDLE_H
+#define _KFS_CPUIDLE_H
+
+#include <kfs/list.h>
+#include <kfs/stdint.h>
+
+/** CPUごとの休止の統計
+ * @note 時刻はsched_clock()（ナノ秒）
+ */
+struct cpuidle_stats
+{
+	unsigned long usage;		  /* 休止した回数 */
+	uint64_t time_ns;			  /* 休止していた時間の合計 */
+	unsigned long nr_wakeups;	  /* アイドル中に再スケジュールを要求された回数 */
+	uint64_t wake_latency_ns;	  /* 要求からアイドルループを抜けるまでの時間の合計 */
+	uint64_t max_wake_latency_ns; /* 要求からアイドルループを抜けるまでの時間の最大 */
+	uint64_t enter_stamp;		  /* 今回休止し始めた時刻 */
+	uint64_t wake_stamp;		  /* 再スケジュールを要求された時刻（要求がなければ0．ランキューのロックで守る） */
+};
+
+/** アイドル中に片付ける後回しの仕事
+ * @details fnは短い単位の仕事を1つだけ行い，行ったら非0，残っていなければ0を返す．
+ *          アイドルループは眠る前に，どれも0を返すか再スケジュールを要求されるまで繰り返し呼ぶ
+ * @note fnは割り込み許可・プリエンプト禁止で呼ばれるため，眠ってはならない
+ */
+struct idle_work
+{
+	struct list_head list;
+	const char *name;
+	int (*fn)(void);
+};
+
+/* アイドル中の仕事 (kernel/sched/idle.c) */
+void idle_work_register(struct idle_work *work);
+int run_idle_work(void);
+
+/* 休止の統計 (kernel/sched/idle.c) */
+void cpuidle_account_enter(void);
+void cpuidle_account_exit(void);
+void cpuidle_wake_request(int cpu);
+void cpuidle_account_wakeup(void);
+void cpuidle_get_stats(int cpu, struct cpuidle_stats *stats);
+void cpuidle_reset_for_test(void);
+
+/* 休止命令の選択 (arch/i386/kernel/process.c) */
+extern void (*pm_idle)(void);
+void select_idle_routine(void);
+const char *idle_routine_name(void);
+
+#endif /* _KFS_CPUIDLE_H */
@@ -1,8 +1,17 @@
 #ifndef _KFS_ERRNO_H
 #define _KFS_ERRNO_H
 
+#define EPERM 1	  /* Operation not permitted */
+#define ESRCH 3	  /* No such process */
+#define EINTR 4	  /* Interrupted system call */
+#define ECHILD 10 /* No child processes */
 #define EAGAIN 11 /* Try again (リソース一時的に利用不可) */
 #define ENOMEM 12 /* Out of memory */
+#define EACCES 13 /* Permission denied */
+#define EINVAL 22 /* Invalid argument */
 #define ENOSYS 38 /* Function not implemented */
 
+/* カーネル内部専用（ユーザー空間には返らない） */
+#define ERESTARTSYS 512 /* シグナルで中断した（シグナル処理後に再実行する） */
+
 #endif /* _KFS_ERRNO_H */
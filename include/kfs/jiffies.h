@@ -0,0 +1,27 @@
+/**
+ * jiffies.h - tickカウンタ
+ *
+ * @see Linux 2.6.11: include/linux/jiffies.h
+ */
+#ifndef _KFS_JIFFIES_H
+#define _KFS_JIFFIES_H
+
+#include <asm-i386/param.h>
+
+/** 起動からのtick数
+ * @note タイマー割り込み（またはtickless idleからの復帰）で更新される
+ */
+extern volatile unsigned long jiffies;
+
+/** aがbより後の時刻か
+ * @note jiffiesのラップアラウンドを考慮して差の符号で比較する
+ */
+#define time_after(a, b) ((long)((b) - (a)) < 0)
+#define time_before(a, b) time_after(b, a)
+#define time_after_eq(a, b) ((long)((a) - (b)) >= 0)
+#define time_before_eq(a, b) time_after_eq(b, a)
+
+/* ミリ秒をtick数に変換する（切り上げ） */
+#define msecs_to_jiffies(m) (((unsigned long)(m) * HZ + 999) / 1000)
+
+#endif /* _KFS_JIFFIES_H */
@@ -0,0 +1,26 @@
+/**
+ * ktime.h - カーネル内の時刻
+ *
+ * @see Linux 6.18: include/linux/ktime.h, include/linux/timekeeping.h
+ */
+#ifndef _KFS_KTIME_H
+#define _KFS_KTIME_H
+
+#include <kfs/stdint.h>
+
+/** 起動からのナノ秒
+ * @note 符号付きにして差を取りやすくする（約292年でラップアラウンド）
+ */
+typedef int64_t ktime_t;
+
+#define ktime_sub(a, b) ((a) - (b))
+#define ktime_add_ns(kt, ns) ((kt) + (ktime_t)(ns))
+#define ktime_to_ns(kt) ((int64_t)(kt))
+#define ns_to_ktime(ns) ((ktime_t)(ns))
+
+/* kernel/time/timekeeping.c */
+ktime_t ktime_get(void);
+uint64_t ktime_get_ns(void);
+void timekeeping_init(void);
+
+#endif /* _KFS_KTIME_H */
@@ -0,0 +1,15 @@
+/**
+ * linkage.h - 関数の呼び出し規約
+ *
+ * @see Linux 2.6.11: include/linux/linkage.h, include/asm-i386/linkage.h
+ */
+#ifndef _KFS_LINKAGE_H
+#define _KFS_LINKAGE_H
+
+/* 引数をすべてスタックで渡す（アセンブリから呼ばれる関数） */
+#define asmlinkage __attribute__((regparm(0)))
+
+/* 先頭3引数をEAX, EDX, ECXで渡す（アセンブリからレジスタ渡しで呼ばれる関数） */
+#define fastcall __attribute__((regparm(3)))
+
+#endif /* _KFS_LINKAGE_H */
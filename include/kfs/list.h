@@ -88,6 +88,16 @@ static inline void list_del(struct list_head *entry)
 	entry->prev = NULL;
 }
 
+/** リストからノードを削除し，空のリストとして初期化する
+ * @param entry 削除するノード
+ * @note 削除後もlist_empty()で調べたり，もう一度list_del_init()したりできる
+ */
+static inline void list_del_init(struct list_head *entry)
+{
+	__list_del(entry->prev, entry->next);
+	INIT_LIST_HEAD(entry);
+}
+
 /** リストが空かチェックする
  * @param head チェックするリストヘッド
  * @return リストが空なら1、要素があれば0
@@ -97,6 +107,24 @@ static inline int list_empty(const struct list_head *head)
 	return head->next == head;
 }
 
+/** リストの全要素を別のリストの先頭につなぎ替え，元のリストを空にする
+ * @param list つなぎ替える要素を持つリストヘッド
+ * @param head つなぎ先のリストヘッド
+ * @note 要素数によらずポインタの付け替え4回で済む
+ */
+static inline void list_splice_init(struct list_head *list, struct list_head *head)
+{
+	if (list_empty(list))
+	{
+		return;
+	}
+	list->next->prev = head;
+	list->prev->next = head->next;
+	head->next->prev = list->prev;
+	head->next = list->next;
+	INIT_LIST_HEAD(list);
+}
+
 /** メンバのアドレスから構造体のアドレスを取得する
  * @param ptr メンバへのポインタ
  * @param type メンバを含む構造体の型
@@ -162,4 +190,126 @@ static inline int list_empty(const struct list_head *head)
 	for (pos = list_entry((head)->next, typeof(*pos), member); &pos->member != (head);                                 \
 		 pos = list_entry(pos->member.next, typeof(*pos), member))
 
+/** リストの各要素に対して，要素の削除を許してループ処理を行う
+ * @param pos 反復用の構造体ポインタ
+ * @param n 次の要素を先に読んでおく一時ポインタ
+ * @param head リストヘッド
+ * @param member 構造体内のlist_headメンバ名
+ * @note posをリストから外したり解放したりしても反復を続けられる
+ */
+#define list_for_each_entry_safe(pos, n, head, member)                                                                 \
+	for (pos = list_entry((head)->next, typeof(*pos), member), n = list_entry(pos->member.next, typeof(*pos), member); \
+		 &pos->member != (head); pos = n, n = list_entry(n->member.next, typeof(*n), member))
+
+/* ハッシュリストのノード */
+struct hlist_node
+{
+	struct hlist_node *next;   /* 次のノード */
+	struct hlist_node **pprev; /* 前のノードのnextポインタへのポインタ */
+};
+
+/** ハッシュリストのヘッド
+ * @note ポインタ1つ分の大きさなので，大きなハッシュテーブルのバケットに使う
+ */
+struct hlist_head
+{
+	struct hlist_node *first; /* 最初のノードへのポインタ */
+};
+
+/* 空のハッシュリストを作る */
+#define HLIST_HEAD_INIT                                                                                                \
+	{                                                                                                                  \
+		.first = NULL                                                                                                  \
+	}
+
+/* ハッシュリストヘッドを実行時に初期化する */
+static inline void INIT_HLIST_HEAD(struct hlist_head *h)
+{
+	h->first = NULL;
+}
+
+/* どのリストにもつながっていないノードとして初期化する */
+static inline void INIT_HLIST_NODE(struct hlist_node *n)
+{
+	n->next = NULL;
+	n->pprev = NULL;
+}
+
+/** ノードがリストから外れているかチェックする
+ * @return 外れていれば1，つながっていれば0
+ */
+static inline int hlist_unhashed(const struct hlist_node *n)
+{
+	return !n->pprev;
+}
+
+/* ハッシュリストが空かチェックする */
+static inline int hlist_empty(const struct hlist_head *h)
+{
+	return !h->first;
+}
+
+/** ハッシュリストからノードを切り離す
+ * @details pprevが前のノードのnext（先頭ならヘッドのfirst）を指すため，ヘッドを知らなくても外せる
+ */
+static inline void __hlist_del(struct hlist_node *n)
+{
+	struct hlist_node *next = n->next;
+	struct hlist_node **pprev = n->pprev;
+
+	*pprev = next;
+	if (next)
+	{
+		next->pprev = pprev;
+	}
+}
+
+/** ハッシュリストからノードを削除し，外れた状態に初期化する
+ * @note 既に外れているノードに対しては何もしない
+ */
+static inline void hlist_del_init(struct hlist_node *n)
+{
+	if (!hlist_unhashed(n))
+	{
+		__hlist_del(n);
+		INIT_HLIST_NODE(n);
+	}
+}
+
+/** ハッシュリストの先頭にノードを追加する
+ * @param n 追加するノード
+ * @param h ハッシュリストヘッド
+ */
+static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	if (first)
+	{
+		first->pprev = &n->next;
+	}
+	h->first = n;
+	n->pprev = &h->first;
+}
+
+/* ハッシュリストノードから含む構造体へのポインタを取得する */
+#define hlist_entry(ptr, type, member) container_of(ptr, type, member)
+
+/* hlist_entry()のNULL許容版（ptrがNULLならNULLを返す） */
+#define hlist_entry_safe(ptr, type, member)                                                                            \
+	({                                                                                                                 \
+		typeof(ptr) ____ptr = (ptr);                                                                                   \
+		____ptr ? hlist_entry(____ptr, type, member) : NULL;                                                           \
+	})
+
+/** ハッシュリストの各要素に対してループ処理を行う
+ * @param pos 反復用の構造体ポインタ
+ * @param head ハッシュリストヘッド
+ * @param member 構造体内のhlist_nodeメンバ名
+ */
+#define hlist_for_each_entry(pos, head, member)                                                                        \
+	for (pos = hlist_entry_safe((head)->first, typeof(*(pos)), member); pos;                                           \
+		 pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
+
 #endif /* _KFS_LIST_H */
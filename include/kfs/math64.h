@@ -0,0 +1,33 @@
+/**
+ * math64.h - 64ビット演算の補助関数
+ *
+ * @see Linux 6.18: include/linux/math64.h
+ */
+#ifndef _KFS_MATH64_H
+#define _KFS_MATH64_H
+
+#include <asm-i386/div64.h>
+#include <kfs/stdint.h>
+
+/** (a * mul) >> shift を96ビットの中間値で計算する
+ * @param a     被乗数（サイクル数など）
+ * @param mul   乗数
+ * @param shift 右シフト量（32以下）
+ * @return 結果の下位64ビット
+ * @note aを上位・下位32ビットに分けて掛けるため，a * mulが64ビットを超えても桁あふれしない
+ */
+static inline uint64_t mul_u64_u32_shr(uint64_t a, uint32_t mul, unsigned int shift)
+{
+	uint32_t ah = (uint32_t)(a >> 32);
+	uint32_t al = (uint32_t)a;
+	uint64_t ret;
+
+	ret = ((uint64_t)al * mul) >> shift;
+	if (ah)
+	{
+		ret += ((uint64_t)ah * mul) << (32 - shift);
+	}
+	return ret;
+}
+
+#endif /* _KFS_MATH64_H */
@@ -1,6 +1,7 @@
 #ifndef _KFS_MM_H
 #define _KFS_MM_H
 
+#include <kfs/spinlock_types.h>
 #include <kfs/stddef.h>
 #include <kfs/stdint.h>
 
@@ -24,6 +25,10 @@ struct page;
 #define VM_READ 0x00000001	/* 読み取り可能 */
 #define VM_WRITE 0x00000002 /* 書き込み可能 */
 #define VM_EXEC 0x00000004	/* 実行可能 */
+#define VM_DEMAND 0x00000010 /* 初回アクセス時にページを割り当てる（デマンドページング） */
+#define VM_IOREMAP 0x00000020 /* ioremap()によるデバイスメモリのマッピング */
+#define VM_MAP 0x00000040	  /* vmap()による既存ページのマッピング */
+#define VM_GUARD 0x00000080 /* 先頭1ページをマップしないガードページとする（vmalloc_guarded()） */
 
 /* メモリリージョンのリストの先頭アドレス */
 struct vm_area_struct
@@ -37,8 +42,11 @@ struct vm_area_struct
 /* 物理ページ管理関数 (mm/page_alloc.c) */
 struct page *alloc_pages(unsigned int gfp_mask, unsigned int order);
 void free_pages(struct page *page, unsigned int order);
+void get_page(struct page *page);
+int page_count(struct page *page);
 
 /* 仮想メモリ管理関数 (mm/memory.c) */
+extern spinlock_t vma_lock;
 struct vm_area_struct *find_vma(unsigned long addr);
 int insert_vm_area(struct vm_area_struct *vma);
 void remove_vm_area(unsigned long addr);
@@ -46,6 +54,25 @@ unsigned long get_unmapped_area(size_t len);
 
 /* ページング関連関数 */
 int map_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long flags);
+int map_new_page_vmalloc(unsigned long vaddr, unsigned long paddr, unsigned long flags);
+unsigned long unmap_page_vmalloc(unsigned long vaddr);
+
+/* プロセスごとのページディレクトリ (arch/i386/mm/init.c) */
+struct mm_struct;
+int pgd_alloc(struct mm_struct *mm);
+void pgd_free(struct mm_struct *mm);
+
+/* ユーザー空間のページテーブル操作 (mm/memory.c) */
+int map_user_page(struct mm_struct *mm, unsigned long vaddr, unsigned long paddr, unsigned long flags);
+int copy_page_range(struct mm_struct *dst, struct mm_struct *src);
+void exit_mmap(struct mm_struct *mm);
+int do_wp_page(struct mm_struct *mm, unsigned long address);
+
+/* ページフォルト処理 (mm/memory.c, arch/i386/mm/fault.c) */
+struct pt_regs;
+int handle_mm_fault(struct vm_area_struct *vma, unsigned long address, int write_access);
+int __do_page_fault(struct pt_regs *regs, unsigned long error_code, unsigned long address);
+void do_page_fault(struct pt_regs *regs, unsigned long error_code);
 
 /* メモリ初期化関数 */
 void mem_init(void);
@@ -53,5 +80,6 @@ void mem_init(void);
 /* テスト用リセット関数 */
 void page_allocator_reset_for_test(void);
 void vm_reset_for_test(void);
+void pgtable_reset_for_test(unsigned long start);
 
 #endif /* _KFS_MM_H */
@@ -1,6 +1,7 @@
 #ifndef _KFS_MM_TYPES_H
 #define _KFS_MM_TYPES_H
 
+#include <asm-i386/atomic.h>
 #include <asm-i386/pgtable.h>
 #include <kfs/list.h>
 #include <kfs/rbtree.h>
@@ -9,15 +10,6 @@
 /* 前方宣言 */
 struct vm_area_struct;
 
-/** アトミック変数型
- * @param counter カウンタ値
- * @note 単一CPUでは通常のintと同じだが、将来のSMP対応のため定義
- */
-typedef struct
-{
-	int counter;
-} atomic_t;
-
 /** プロセスのメモリディスクリプタ
  * @brief プロセスのメモリマップ全体を管理する中核構造体
  * @see Linux 6.18
@@ -28,7 +20,10 @@ struct mm_struct
 	struct vm_area_struct *mmap; /* VMA（仮想メモリ領域）のリスト */
 	pgd_t *pgd; /* ページディレクトリのポインタ（CR3レジスタにロードされる） */
 
-	atomic_t mm_count; /* 参照カウント（fork時のコピー管理用） */
+	atomic_t mm_users; /* アドレス空間を使うタスクの数（0でユーザーページを解放する） */
+	atomic_t mm_count; /* mm_struct自体への参照（利用者全体で1つ＋mmを借りたカーネルスレッド．0でpgdごと解放） */
+
+	struct list_head pgd_list; /* ページディレクトリを持つmmのリスト（カーネル部分のPDEを同期するため） */
 
 	unsigned long brk;		   /* ヒープ現在位置（sys_brk用） */
 	unsigned long start_stack; /* スタック開始アドレス（exec_fn用） */
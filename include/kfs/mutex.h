@@ -0,0 +1,61 @@
+/**
+ * mutex.h - 眠るミューテックス
+ *
+ * 保持したまま眠る可能性のある長いクリティカルセクションを守る．空くのを待つタスクは
+ * 待ちキューで眠るため，スピンロックと違い待っている間にCPUを消費しない．
+ * 空いていればcmpxchg 1回で取得・解放でき，保持者が他のCPUで実行中なら眠らずに少しだけ回って待つ．
+ * @note 割り込みハンドラとアイドルタスクからは使えない．取得したタスクが解放すること
+ * @see Linux 2.6.16: include/linux/mutex.h, kernel/mutex.c
+ */
+#ifndef _KFS_MUTEX_H
+#define _KFS_MUTEX_H
+
+#include <asm-i386/atomic.h>
+#include <kfs/wait.h>
+
+/* ownerの下位ビット（task_structは4バイト境界に置かれるため空いている） */
+#define MUTEX_FLAG_WAITERS 0x01 /* 眠っている待ち手がいるかもしれない（解放時に起こす） */
+#define MUTEX_FLAGS 0x01
+
+/** ミューテックス
+ * @details ownerは保持しているタスクのアドレスとMUTEX_FLAG_*の論理和で，空いていれば0
+ */
+struct mutex
+{
+	atomic_t owner;			/* 保持しているタスク | MUTEX_FLAG_* */
+	wait_queue_head_t wait; /* 空くのを待って眠るタスク */
+};
+
+#define __MUTEX_INITIALIZER(name)                                                                                      \
+	{                                                                                                                  \
+		.owner = ATOMIC_INIT(0), .wait = __WAIT_QUEUE_HEAD_INITIALIZER(name.wait)                                      \
+	}
+
+#define DEFINE_MUTEX(name) struct mutex name = __MUTEX_INITIALIZER(name)
+
+/* 実行時にミューテックスを初期化する（構造体に埋め込んだミューテックス用） */
+static inline void mutex_init(struct mutex *lock)
+{
+	atomic_set(&lock->owner, 0);
+	init_waitqueue_head(&lock->wait);
+}
+
+/* 保持しているタスク（空いていればNULL） */
+static inline struct task_struct *mutex_owner(struct mutex *lock)
+{
+	return (struct task_struct *)(atomic_read(&lock->owner) & ~MUTEX_FLAGS);
+}
+
+/* 保持されているか */
+static inline int mutex_is_locked(struct mutex *lock)
+{
+	return mutex_owner(lock) != NULL;
+}
+
+/* kernel/mutex.c */
+void mutex_lock(struct mutex *lock);
+int mutex_lock_interruptible(struct mutex *lock);
+int mutex_trylock(struct mutex *lock);
+void mutex_unlock(struct mutex *lock);
+
+#endif /* _KFS_MUTEX_H */
@@ -19,19 +19,6 @@ enum pid_type
 	PIDTYPE_MAX	  /* pid_typeの数 */
 };
 
-/* ハッシュリストノード */
-struct hlist_node
-{
-	struct hlist_node *next;   /* 次のノード */
-	struct hlist_node **pprev; /* 前のノードのnextポインタへのポインタ */
-};
-
-/* ハッシュリストヘッド */
-struct hlist_head
-{
-	struct hlist_node *first; /* 最初のノードへのポインタ */
-};
-
 /* PID構造体 */
 struct pid
 {
@@ -62,11 +49,45 @@ struct pid
 	 * tasks[PIDTYPE_TGID]: スレッドグループリスト（Phase 14で使用）
 	 */
 	struct hlist_head tasks[PIDTYPE_MAX];
+
+	/* PIDハッシュテーブルのチェーン（find_pid()で番号から引くため） */
+	struct hlist_node pid_chain;
 };
 
+/** タスクとstruct pidのつながり
+ * @details task_struct->pids[type]に埋め込まれ，nodeがpid->tasks[type]につながる
+ */
+struct pid_link
+{
+	struct hlist_node node; /* pid->tasks[type]のノード */
+	struct pid *pid;		/* つながっているPID */
+};
+
+/* idle/swapperプロセス(PID 0)のPID構造体 */
+extern struct pid init_struct_pid;
+
+/** PIDへの参照を取得する
+ * @param pid PID構造体（NULL可）
+ * @return pid
+ */
+static inline struct pid *get_pid(struct pid *pid)
+{
+	if (pid)
+	{
+		pid->count++;
+	}
+	return pid;
+}
+
 /* PID管理関数 */
 struct pid *alloc_pid(void);
 void put_pid(struct pid *pid);
+struct pid *find_pid(pid_t nr);
+void attach_pid(struct task_struct *task, enum pid_type type, struct pid *pid);
+void detach_pid(struct task_struct *task, enum pid_type type);
+struct task_struct *pid_task(struct pid *pid, enum pid_type type);
 struct task_struct *find_task_by_pid(pid_t pid);
+struct task_struct *find_get_task_by_pid(pid_t pid);
+void pid_init(void);
 
 #endif /* _KFS_PID_H */
@@ -0,0 +1,74 @@
+/**
+ * preempt.h - カーネルプリエンプションの制御
+ *
+ * current->thread_info.preempt_countが0のときだけ，割り込みからの復帰時などにタスクを切り替えられる．
+ * preempt_disable()/preempt_enable()は入れ子にできる．
+ * @see Linux 2.6.11: include/linux/preempt.h
+ */
+#ifndef _KFS_PREEMPT_H
+#define _KFS_PREEMPT_H
+
+#include <kfs/compiler.h>
+#include <kfs/sched.h>
+
+/** schedule()がプリエンプションによる呼び出しであることを示すビット
+ * @details プリエンプトされたタスクは__stateがTASK_RUNNINGでなくてもランキューから外さない．
+ *          set_current_state()からschedule()までの間に割り込まれても眠り込まないようにするため．
+ */
+#define PREEMPT_ACTIVE 0x10000000
+
+#define preempt_count() (current->thread_info.preempt_count)
+
+#define add_preempt_count(val)                                                                                         \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		preempt_count() += (val);                                                                                      \
+	} while (0)
+
+#define sub_preempt_count(val)                                                                                         \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		preempt_count() -= (val);                                                                                      \
+	} while (0)
+
+#define inc_preempt_count() add_preempt_count(1)
+#define dec_preempt_count() sub_preempt_count(1)
+
+/* プリエンプションを禁止する */
+#define preempt_disable()                                                                                              \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		inc_preempt_count();                                                                                           \
+		barrier();                                                                                                     \
+	} while (0)
+
+/* 再スケジュール要求を確認せずにプリエンプションを許可する */
+#define preempt_enable_no_resched()                                                                                    \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		barrier();                                                                                                     \
+		dec_preempt_count();                                                                                           \
+	} while (0)
+
+/* 再スケジュール要求があれば，ここで切り替える */
+#define preempt_check_resched()                                                                                        \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		if (unlikely(need_resched()))                                                                                  \
+		{                                                                                                              \
+			preempt_schedule();                                                                                        \
+		}                                                                                                              \
+	} while (0)
+
+/** プリエンプションを許可する
+ * @note 禁止中に再スケジュール要求が来ていれば，最も外側のpreempt_enable()で切り替わる
+ */
+#define preempt_enable()                                                                                               \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		preempt_enable_no_resched();                                                                                   \
+		barrier();                                                                                                     \
+		preempt_check_resched();                                                                                       \
+	} while (0)
+
+#endif /* _KFS_PREEMPT_H */
@@ -111,9 +111,17 @@ static inline struct rb_node *rb_first_cached(const struct rb_root_cached *root)
 struct rb_node *rb_first(const struct rb_root *root);
 struct rb_node *rb_next(const struct rb_node *node);
 void rb_insert_color(struct rb_node *node, struct rb_root *root);
-
 void rb_erase(struct rb_node *node, struct rb_root *root);
 
+void rb_insert_color_cached(struct rb_node *node, struct rb_root_cached *root, int leftmost);
+void rb_erase_cached(struct rb_node *node, struct rb_root_cached *root);
+
+/** ノードがツリーに属していないことを示す
+ * @note 親ポインタに自分自身を入れて「未リンク」を表す（Linuxと同じ規約）
+ */
+#define RB_CLEAR_NODE(node) ((node)->__rb_parent_color = (unsigned long)(node))
+#define RB_EMPTY_NODE(node) ((node)->__rb_parent_color == (unsigned long)(node))
+
 /** 新しいノードをツリーにリンクする
  * @param node リンクする新しいノード
  * @param parent 親ノード
@@ -1,9 +1,17 @@
 #ifndef _KFS_SCHED_H
 #define _KFS_SCHED_H
 
+#include <asm-i386/bitops.h>
+#include <asm-i386/current.h>
+#include <asm-i386/processor.h>
+#include <asm-i386/thread_info.h>
+#include <kfs/compiler.h>
 #include <kfs/list.h>
 #include <kfs/mm_types.h>
+#include <kfs/pid.h>
 #include <kfs/rbtree.h>
+#include <kfs/signal.h>
+#include <kfs/spinlock_types.h>
 #include <kfs/stdint.h>
 
 /* プロセスID型 */
@@ -37,6 +45,7 @@ typedef struct
 #define CAP_KILL 5		   /* 任意プロセスへシグナル送信 */
 #define CAP_SETUID 7	   /* UID設定 */
 #define CAP_SYS_ADMIN 21   /* システム管理操作 */
+#define CAP_SYS_NICE 23	   /* nice値を下げる（優先度を上げる） */
 
 /* 全Capability有効 */
 #define CAP_FULL_SET ((kernel_cap_t){{0xffffffff, 0xffffffff}})
@@ -44,34 +53,147 @@ typedef struct
 #define CAP_EMPTY_SET ((kernel_cap_t){{0, 0}})
 
 /** シグナル共有情報
- * Linux 6.18ではスレッドグループで共有されるシグナル情報
- * Phase 4で詳細実装予定、今は最小限
+ * @details シグナルハンドラの表と，それと保留シグナルを守るロックを持つ
+ * @note Linux 6.18ではハンドラはsighand_struct，保留はsignal_structとtask_structに分かれるが，
+ *       スレッドグループがないため1つにまとめる
  */
 struct signal_struct
 {
-	atomic_t sigcnt; /* 参照カウント */
+	atomic_t sigcnt;				 /* 参照カウント */
+	spinlock_t siglock;				 /* actionとtask->pendingを守るロック（割り込みからも送られるためirqsaveで取る） */
+	struct sigaction action[_NSIG]; /* シグナルごとのハンドラ */
 };
 
 /** 保留中シグナル
- * Phase 4で詳細実装予定、今は最小限
+ * @details signalのビットsigが立っていればシグナルsigが保留中．
+ *          リアルタイムシグナルは送られた回数分のsigqueueもlistに積む
  */
 struct sigpending
 {
-	struct list_head list; /* シグナルキュー */
-	uint64_t signal;	   /* 保留中シグナルビットマスク */
+	struct list_head list; /* 保留中のリアルタイムシグナル（struct sigqueue） */
+	uint64_t signal;	   /* 保留中シグナルビットマスク（sigmask(sig)） */
+};
+
+static inline void init_sigpending(struct sigpending *sig)
+{
+	INIT_LIST_HEAD(&sig->list);
+	sig->signal = 0;
+}
+
+/** 負荷重み
+ * @details inv_weightは2^32/weightであり，weightでの除算を乗算とシフトに置き換えるために使う．
+ *          0なら次に使うときに計算する（nice値から設定した重みは表の値を使うため計算しない）
+ */
+struct load_weight
+{
+	unsigned long weight; /* 負荷重み（nice 0でNICE_0_LOAD） */
+	uint32_t inv_weight;  /* 2^32/weight */
 };
 
 /** CFS用スケジューリングエンティティ
- * Phase 7で実装予定、今は構造のみ定義
+ * @details vruntimeは実行時間をNICE_0_LOAD/load.weightで重み付けした値であり，
+ *          重いエンティティほどvruntimeの進みが遅く，多くのCPU時間を得る
  */
 struct sched_entity
 {
-	unsigned long load;		 /* エンティティの負荷重み */
-	struct rb_node run_node; /* CFSのrb-treeノード（vruntimeでソート） */
-	unsigned int on_rq;		 /* ランキューに登録されているか */
-	uint64_t vruntime;		 /* 仮想実行時間（ナノ秒単位） */
+	struct load_weight load;		/* エンティティの負荷重み（nice値から決まる） */
+	struct rb_node run_node;		/* CFSのrb-treeノード（vruntimeでソート） */
+	unsigned int on_rq;				/* ランキューに登録されているか */
+	uint64_t exec_start;			/* 最後に実行時間を計上したランキュー時刻（ナノ秒） */
+	uint64_t sum_exec_runtime;		/* 累積実行時間（ナノ秒） */
+	uint64_t prev_sum_exec_runtime; /* 最後に選ばれた時点のsum_exec_runtime（タイムスライスの計測用） */
+	uint64_t vruntime;				/* 仮想実行時間（ナノ秒単位） */
 };
 
+/** リアルタイム用スケジューリングエンティティ
+ * @details 優先度ごとのリストにつながれ，実行中も先頭に残る．
+ *          SCHED_RRではtime_sliceを使い切ると同じ優先度のリストの末尾に回る
+ */
+struct sched_rt_entity
+{
+	struct list_head run_list; /* 優先度ごとのリストへのリンク */
+	unsigned int time_slice;   /* SCHED_RRの残りタイムスライス（tick） */
+	unsigned int on_rq;		   /* ランキューに登録されているか */
+};
+
+/** タスクごとのスケジューラ統計
+ * @details CPUで実行された回数と，実行可能になってから実際にCPUを得るまで待った時間を数える．
+ *          時刻はすべてランキュー時刻（ナノ秒）
+ * @see Linux 6.18 include/linux/sched.h struct sched_info
+ */
+struct sched_info
+{
+	unsigned long pcount;  /* CPUで実行され始めた回数 */
+	uint64_t run_delay;	   /* ランキューで待った時間の合計（ナノ秒） */
+	uint64_t last_arrival; /* 最後にCPUで実行され始めた時刻 */
+	uint64_t last_queued;  /* ランキューで待ち始めた時刻（待っていなければ0） */
+};
+
+/** CPUごとの負荷分散の統計
+ * @details 分散の間隔や移すタスクの条件を調整するときに，移動が多すぎないか・足りているかを見るために数える
+ * @see Linux 6.18 kernel/sched/stats.c（/proc/schedstatのlb_*，ttwu_*）
+ */
+struct sched_lb_stats
+{
+	unsigned long lb_count;		   /* 負荷分散を試みた回数 */
+	unsigned long lb_failed;	   /* 偏っていたのに，アフィニティや実行中のため移せるタスクがなかった回数 */
+	unsigned long lb_gained_idle;  /* アイドルになったときの分散で引き取ったタスク数 */
+	unsigned long lb_gained_busy;  /* 定期の分散で引き取ったタスク数 */
+	unsigned long lb_lost;		   /* 他のCPUに引き取られたタスク数 */
+	unsigned long wake_remote;	   /* 起床・fork時に他のCPUから移ってきたタスク数 */
+	unsigned long affinity_pushed; /* アフィニティで許されなくなり，他のCPUへ送り出したタスク数 */
+};
+
+/* nice 0のタスクの負荷重み */
+#define NICE_0_LOAD 1024
+
+/** nice値と優先度
+ * @details 優先度（prio）は値が小さいほど優先される．0〜MAX_RT_PRIO-1はリアルタイム用に空けておき，
+ *          nice値-20〜19を優先度MAX_RT_PRIO〜MAX_PRIO-1に対応させる
+ * @see Linux 6.18 include/linux/sched/prio.h
+ */
+#define MAX_NICE 19
+#define MIN_NICE -20
+#define NICE_WIDTH (MAX_NICE - MIN_NICE + 1)
+#define MAX_RT_PRIO 100
+#define MAX_PRIO (MAX_RT_PRIO + NICE_WIDTH)
+#define DEFAULT_PRIO (MAX_RT_PRIO + NICE_WIDTH / 2)
+
+#define NICE_TO_PRIO(nice) ((nice) + DEFAULT_PRIO)
+#define PRIO_TO_NICE(prio) ((prio) - DEFAULT_PRIO)
+
+/* リアルタイムタスクのrt_priorityの範囲（大きいほど優先される） */
+#define MAX_USER_RT_PRIO MAX_RT_PRIO
+
+/* スケジューリングポリシー（task_struct->policy） */
+#define SCHED_NORMAL 0 /* CFS */
+#define SCHED_FIFO 1   /* リアルタイム（同じ優先度では自分から手放すまで実行し続ける） */
+#define SCHED_RR 2	   /* リアルタイム（同じ優先度ではタイムスライスごとに順番に実行する） */
+
+/* sched_setscheduler()の引数 */
+struct sched_param
+{
+	int sched_priority; /* SCHED_FIFO/SCHED_RRでは1〜MAX_USER_RT_PRIO-1，SCHED_NORMALでは0 */
+};
+
+/** 負荷平均（11ビットの固定小数点）
+ * @details 実行可能なタスクとTASK_UNINTERRUPTIBLEで眠っているタスクの数を，
+ *          LOAD_FREQごとに1分・5分・15分の指数移動平均に畳み込む．EXP_nはe^(-5秒/n分)
+ * @see Linux 6.18 include/linux/sched/loadavg.h
+ */
+#define FSHIFT 11
+#define FIXED_1 (1 << FSHIFT)
+#define LOAD_FREQ (5 * HZ + 1) /* 5秒ごと（tick単位．他の周期処理と重ならないよう1 tickずらす） */
+#define EXP_1 1884
+#define EXP_5 2014
+#define EXP_15 2037
+
+#define LOAD_INT(x) ((x) >> FSHIFT)
+#define LOAD_FRAC(x) LOAD_INT(((x) & (FIXED_1 - 1)) * 100)
+
+/* setpriority()/getpriority()のwhich */
+#define PRIO_PROCESS 0 /* whoはPID（0なら現在のタスク） */
+
 /** プロセスの状態
  * @brief task_struct->__stateの値
  * @see Linux 6.18 include/linux/sched.h
@@ -86,28 +208,50 @@ struct sched_entity
 #define TASK_WAKEKILL 0x0100		/* SIGKILLで起床可能 */
 #define TASK_WAKING 0x0200			/* 起床処理中 */
 
+/** 終了後の状態
+ * @brief task_struct->exit_stateの値
+ */
+#define EXIT_ZOMBIE 0x0010 /* 親のwaitを待っている */
+#define EXIT_DEAD 0x0020   /* 回収済み（reaperによる解放待ち） */
+
+/* スリープ中のどちらの状態も対象にする（wake_up()用） */
+#define TASK_NORMAL (TASK_INTERRUPTIBLE | TASK_UNINTERRUPTIBLE)
+
 /* タスクフラグ(task_struct->flagsの値) */
 #define PF_EXITING 0x00000004 /* 終了中 */
 #define PF_KTHREAD 0x00200000 /* カーネルスレッド */
 
+/* clone_flags */
+#define CLONE_VM 0x00000100 /* 親とmm_structを共有する */
+
 /* プロセス名の最大長（Linux 6.18互換） */
 #define TASK_COMM_LEN 16
 
+struct sched_class;
+
 /** プロセス/スレッド記述子
  * @brief プロセス/スレッドの全情報を保持する中核構造体
  */
 struct task_struct
 {
+	/* 低レベル情報（entry.Sがcurrentから直接読むため先頭に置く） */
+	struct thread_info thread_info;
+
 	/* 状態管理 */
 	volatile unsigned int __state; /* プロセス状態（TASK_RUNNING等） */
 	void *stack;				   /* カーネルスタックへのポインタ */
+	atomic_t usage;				   /* 参照カウント（0になるとreaperがtask_structとスタックを解放する） */
 	unsigned int flags;			   /* プロセスフラグ（PF_*） */
 
 	/* メモリ管理 */
-	struct mm_struct *mm; /* メモリ記述子 */
+	struct mm_struct *mm;		 /* メモリ記述子 */
+	struct mm_struct *active_mm; /* 実行中に使うmm（カーネルスレッドは直前のタスクのmmを借りる） */
 
 	/* プロセスID */
-	pid_t pid; /* プロセスID */
+	pid_t pid;						   /* プロセスID */
+	struct pid_link pids[PIDTYPE_MAX]; /* PID構造体とのリンク（PIDハッシュからの検索用） */
+	int exit_code;					   /* 終了コード */
+	int exit_state;					   /* 終了後の状態（EXIT_ZOMBIE，EXIT_DEAD） */
 
 	/* プロセス階層 */
 	struct task_struct *parent; /* 親プロセス */
@@ -125,10 +269,217 @@ struct task_struct
 	struct sigpending pending;	  /* 保留シグナル */
 
 	/* スケジューリング（CFS用） */
-	struct sched_entity se; /* スケジューリングエンティティ（se.run_node, se.vruntimeを使用） */
+	const struct sched_class *sched_class; /* スケジューリングクラス */
+	struct sched_entity se;				   /* スケジューリングエンティティ（se.run_node, se.vruntimeを使用） */
+	struct sched_rt_entity rt;			   /* リアルタイム用スケジューリングエンティティ */
+	unsigned int on_rq;					   /* ランキューに登録されているか（クラスによらない） */
+	unsigned int policy;				   /* スケジューリングポリシー（SCHED_*） */
+	int prio;							   /* 実効優先度（リアルタイムは0〜MAX_RT_PRIO-1，それ以外はstatic_prio） */
+	int static_prio;					   /* nice値から決まる優先度（NICE_TO_PRIO(nice)） */
+	unsigned int rt_priority;			   /* リアルタイム優先度（1〜MAX_USER_RT_PRIO-1，大きいほど優先） */
+	int on_cpu;							   /* CPU上で実行中か（ミューテックスの楽観的スピンが参照する） */
+	int cpu;							   /* 登録先（眠っていれば最後に実行した）CPU */
+	unsigned long cpus_allowed;			   /* 実行してよいCPUのビットマップ（ビットnがCPU n） */
+
+	/* CPU時間の統計 */
+	struct sched_info sched_info;			/* 実行回数と実行待ちの時間 */
+	unsigned long nvcsw;					/* 自分から眠ってCPUを手放した回数 */
+	unsigned long nivcsw;					/* 実行可能なままCPUを奪われた回数 */
+	unsigned int sched_contributes_to_load; /* TASK_UNINTERRUPTIBLEで眠り，負荷平均に数えられているか */
+	unsigned long nr_migrations;			/* 他のCPUに移された回数 */
 
 	/* プロセス名 */
 	char comm[TASK_COMM_LEN]; /* プロセス名（最大16バイト） */
+
+	/* CPU固有の状態（コンテキストスイッチで保存・復元） */
+	struct thread_struct thread;
 };
 
+_Static_assert(__builtin_offsetof(struct task_struct, thread_info) == 0, "thread_info must be first");
+
+/* タスクのPID構造体を取得する */
+static inline struct pid *task_pid(struct task_struct *task)
+{
+	return task->pids[PIDTYPE_PID].pid;
+}
+
+/* 現在実行中のタスクはCPUごとのPDAにある (asm-i386/current.h) */
+
+/** thread_info.flagsの操作
+ * @note 他のCPUが再スケジュール要求を立てるのと，そのCPUのアイドルループが
+ *       TIF_POLLING_NRFLAGを変えるのが重なっても失わないよう，不可分に書き換える
+ */
+static inline void set_tsk_thread_flag(struct task_struct *tsk, int flag)
+{
+	set_bit(flag, &tsk->thread_info.flags);
+}
+
+static inline void clear_tsk_thread_flag(struct task_struct *tsk, int flag)
+{
+	clear_bit(flag, &tsk->thread_info.flags);
+}
+
+static inline int test_tsk_thread_flag(struct task_struct *tsk, int flag)
+{
+	return test_bit(flag, &tsk->thread_info.flags);
+}
+
+/* 再スケジュール要求フラグの操作 */
+static inline void set_tsk_need_resched(struct task_struct *tsk)
+{
+	set_tsk_thread_flag(tsk, TIF_NEED_RESCHED);
+}
+
+static inline void clear_tsk_need_resched(struct task_struct *tsk)
+{
+	clear_tsk_thread_flag(tsk, TIF_NEED_RESCHED);
+}
+
+static inline int test_tsk_need_resched(struct task_struct *tsk)
+{
+	return test_tsk_thread_flag(tsk, TIF_NEED_RESCHED);
+}
+
+/** 現在のタスクの状態を変更する
+ * @note 眠る前に状態を変えてから条件を確認し，schedule()を呼ぶこと．
+ *       条件確認とschedule()の間に起こされても，状態がTASK_RUNNINGに戻るため眠り込まない
+ */
+#define __set_current_state(state_value) (current->__state = (state_value))
+#define set_current_state(state_value)                                                                                 \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		current->__state = (state_value);                                                                              \
+		barrier();                                                                                                     \
+	} while (0)
+
+/** 現在のタスクに再スケジュール要求があるか
+ * @note タイマー割り込みや起床処理がフラグを立て，プリエンプションポイントで確認する
+ */
+static inline int need_resched(void)
+{
+	return test_tsk_need_resched(current);
+}
+
+/* タスクのnice値を取得する */
+static inline int task_nice(const struct task_struct *p)
+{
+	return PRIO_TO_NICE(p->static_prio);
+}
+
+/* タスクが登録されている（眠っていれば最後に実行した）CPU */
+static inline int task_cpu(const struct task_struct *p)
+{
+	return p->cpu;
+}
+
+/* 優先度がリアルタイムの範囲か */
+static inline int rt_prio(int prio)
+{
+	return prio < MAX_RT_PRIO;
+}
+
+/* リアルタイムタスクか */
+static inline int rt_task(const struct task_struct *p)
+{
+	return rt_prio(p->prio);
+}
+
+/** 現在のタスクがCapabilityを持つか
+ * @param cap CAP_*
+ * @return 持っていれば1
+ */
+static inline int capable(int cap)
+{
+	return (current->cap_effective.cap[cap / 32] >> (cap % 32)) & 1;
+}
+
+/** 全タスクのリスト（tasks）と親子関係（children/sibling）を守るロック
+ * @note シグナル送信など割り込みハンドラからもたどれるよう，spin_lock_irqsave()で取る
+ */
+extern spinlock_t tasklist_lock;
+extern struct list_head task_list;
+
+/* スケジューラ (kernel/sched/core.c) */
+void sched_init(void);
+void sched_fork(struct task_struct *p);
+void wake_up_new_task(struct task_struct *p);
+void scheduler_tick(void);
+void schedule(void);
+void preempt_schedule(void);
+int try_to_wake_up(struct task_struct *p, unsigned int state);
+int wake_up_process(struct task_struct *p);
+unsigned long nr_running(void);
+void set_user_nice(struct task_struct *p, long nice);
+int setpriority(int which, int who, int niceval);
+int getpriority(int which, int who);
+int sched_setscheduler(struct task_struct *p, int policy, const struct sched_param *param);
+unsigned long nr_context_switches(void);
+uint64_t running_clock(void);
+uint64_t get_idle_time(void);
+void scheduler_idle_ticks(unsigned long ticks);
+int sched_can_stop_tick(void);
+void init_idle(struct task_struct *idle, int cpu);
+int set_cpus_allowed(struct task_struct *p, unsigned long new_mask);
+int sched_setaffinity(pid_t pid, unsigned long mask);
+int sched_getaffinity(pid_t pid, unsigned long *mask);
+unsigned long nr_running_cpu(int cpu);
+void sched_get_lb_stats(int cpu, struct sched_lb_stats *stats);
+
+/* 負荷平均 (kernel/sched/loadavg.c) */
+extern unsigned long avenrun[3];
+void get_avenrun(unsigned long *loads, unsigned long offset, int shift);
+
+/* スケジューラ向けの高速な時刻 (arch/i386/kernel/tsc.c) */
+uint64_t sched_clock(void);
+
+/* カーネルスレッドとタスク・mmの解放 (kernel/fork.c) */
+pid_t kernel_thread(int (*fn)(void *), void *arg);
+struct task_struct *fork_idle(int cpu);
+void free_task(struct task_struct *tsk);
+void mmput(struct mm_struct *mm);
+void __mmdrop(struct mm_struct *mm);
+
+/** mm_struct自体への参照を得る
+ * @note アドレス空間の利用者にはならない（ユーザーページはmmput()で解放されうる）が，
+ *       参照を持つ間はページディレクトリとmm_structが解放されない．
+ *       カーネルスレッドが直前のタスクのmmを借りるときに使う
+ */
+static inline void mmgrab(struct mm_struct *mm)
+{
+	atomic_inc(&mm->mm_count);
+}
+
+/* mmgrab()で得た参照を外す（最後の参照ならページディレクトリごと解放する） */
+static inline void mmdrop(struct mm_struct *mm)
+{
+	if (atomic_dec_and_test(&mm->mm_count))
+	{
+		__mmdrop(mm);
+	}
+}
+
+/* 新しいタスクの初期スタックとアイドルループ (arch/i386/kernel/process.c) */
+void copy_thread(struct task_struct *p, int (*fn)(void *), void *arg);
+void cpu_idle(void) __attribute__((noreturn));
+
+/* do_wait()のoptions */
+#define WNOHANG 0x00000001 /* 終了した子がいなければ待たずに戻る */
+
+/** task_structへの参照を得る
+ * @note 参照を持つ間はtask_structとカーネルスタックが解放されない
+ */
+static inline void get_task_struct(struct task_struct *t)
+{
+	atomic_inc(&t->usage);
+}
+
+/* タスクの終了と回収 (kernel/exit.c) */
+void do_exit(long code) __attribute__((noreturn));
+void put_task_struct(struct task_struct *t);
+void release_task(struct task_struct *p);
+pid_t do_wait(pid_t pid, int *status, int options);
+int reap_dead_tasks(void);
+void reaper_init(void);
+void exit_reset_for_test(void);
+
 #endif /* _KFS_SCHED_H */
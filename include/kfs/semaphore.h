@@ -0,0 +1,42 @@
+/**
+ * semaphore.h - 計数セマフォ
+ *
+ * 同時にcount個までのタスクが資源を使えるようにする．資源が残っていなければ待ちキューで眠る．
+ * 保持者という概念がないため，down()したタスクとは別のタスクや割り込みハンドラからup()してよい．
+ * @note 1つのタスクだけに使わせる排他にはkfs/mutex.hのミューテックスを使う
+ * @see Linux 2.6.26: include/linux/semaphore.h, kernel/semaphore.c
+ */
+#ifndef _KFS_SEMAPHORE_H
+#define _KFS_SEMAPHORE_H
+
+#include <asm-i386/atomic.h>
+#include <kfs/wait.h>
+
+/* 計数セマフォ */
+struct semaphore
+{
+	atomic_t count;			/* 残っている資源の数 */
+	wait_queue_head_t wait; /* 資源が空くのを待って眠るタスク */
+};
+
+#define __SEMAPHORE_INITIALIZER(name, n)                                                                               \
+	{                                                                                                                  \
+		.count = ATOMIC_INIT(n), .wait = __WAIT_QUEUE_HEAD_INITIALIZER(name.wait)                                      \
+	}
+
+#define DEFINE_SEMAPHORE(name, n) struct semaphore name = __SEMAPHORE_INITIALIZER(name, n)
+
+/* 実行時にセマフォを初期化する */
+static inline void sema_init(struct semaphore *sem, int val)
+{
+	atomic_set(&sem->count, val);
+	init_waitqueue_head(&sem->wait);
+}
+
+/* kernel/semaphore.c */
+void down(struct semaphore *sem);
+int down_interruptible(struct semaphore *sem);
+int down_trylock(struct semaphore *sem);
+void up(struct semaphore *sem);
+
+#endif /* _KFS_SEMAPHORE_H */
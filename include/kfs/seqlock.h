@@ -0,0 +1,64 @@
+/**
+ * seqlock.h - シーケンスカウンタ
+ *
+ * 読み手はロックを取らず，書き込み中または読んでいる間に書き込まれた場合だけ読み直す．
+ * 読み込みが頻繁で書き込みがまれなデータ（時刻など）に向く．
+ * @see Linux 6.18: include/linux/seqlock.h
+ */
+#ifndef _KFS_SEQLOCK_H
+#define _KFS_SEQLOCK_H
+
+#include <asm-i386/processor.h>
+#include <kfs/compiler.h>
+
+/** シーケンスカウンタ
+ * @note 奇数の間は書き込み中．書き手は割り込みを禁止して書き込むこと
+ *       （同じCPUの割り込みハンドラが読み手になったとき，奇数のまま待ち続けないように）
+ */
+typedef struct
+{
+	unsigned int sequence;
+} seqcount_t;
+
+#define SEQCNT_ZERO {0}
+
+/** 読み込みを開始する
+ * @return 読み込み開始時のシーケンス番号（read_seqcount_retry()に渡す）
+ */
+static inline unsigned int read_seqcount_begin(const seqcount_t *s)
+{
+	unsigned int ret;
+
+	while ((ret = READ_ONCE(s->sequence)) & 1)
+	{
+		cpu_relax();
+	}
+	barrier();
+	return ret;
+}
+
+/** 読み込み中に書き込みがあったか
+ * @param start read_seqcount_begin()の戻り値
+ * @return 読み直しが必要なら非0
+ */
+static inline int read_seqcount_retry(const seqcount_t *s, unsigned int start)
+{
+	barrier();
+	return READ_ONCE(s->sequence) != start;
+}
+
+/* 書き込みを開始する（シーケンス番号が奇数になる） */
+static inline void write_seqcount_begin(seqcount_t *s)
+{
+	s->sequence++;
+	barrier();
+}
+
+/* 書き込みを終了する（シーケンス番号が偶数に戻る） */
+static inline void write_seqcount_end(seqcount_t *s)
+{
+	barrier();
+	s->sequence++;
+}
+
+#endif /* _KFS_SEQLOCK_H */
@@ -5,8 +5,16 @@
 
 #include <kfs/stddef.h>
 
+/** シリアル受信ハンドラの型
+ * @param c 受信した文字
+ * @return 処理した場合は1
+ * @note 割り込みハンドラから呼ばれる
+ */
+typedef int (*serial_rx_handler_t)(char c);
+
 void serial_init(void);
-void serial_write(const char *data, size_t size); /* 既存実装の公開(必要最小限) */
-int serial_read(void);							  /* シリアル入力: データがない場合は-1を返す */
+void serial_write(const char *data, size_t size);		/* 既存実装の公開(必要最小限) */
+int serial_read(void);									/* シリアル入力: データがない場合は-1を返す */
+int serial_set_rx_handler(serial_rx_handler_t handler); /* 受信割り込みで呼ぶハンドラを設定する */
 
 #endif /* KFS_SERIAL_H */
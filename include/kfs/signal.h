@@ -1,14 +1,18 @@
 #ifndef _SIGNAL_H_
 #define _SIGNAL_H_
 
+#include <kfs/list.h>
+#include <kfs/pid.h>
+
 /** シグナルの登録・発生・実行の流れ
  * @details
  * 1. sighandler_t signal(int sig, sighandler_t handler);
- *    - シグナル番号sigに関数handlerを登録する
- * 2. int raise(int sig);
- *    - シグナル番号sigを発生させる（保留キューに追加）
+ *    - 現在のタスクのsignal_structで，シグナル番号sigに関数handlerを登録する
+ * 2. int raise(int sig); / int kill_proc(pid_t pid, int sig); / int send_sig(int sig, struct task_struct *p);
+ *    - シグナル番号sigを現在のタスク・PIDのタスク・指定したタスクのtask->pendingに保留する
+ *    - 対象がTASK_INTERRUPTIBLEで眠っていれば起こす
  * 3. void do_signal(void);
- *    - 保留中の全シグナルを順に処理する
+ *    - 現在のタスクに保留中のシグナルを，番号の小さいものから順に処理する
  *    - handlerが登録済みならhandler(sig)を実行する
  *    - SIG_IGNなら無視、SIG_DFLならデフォルトの動作をする
  */
@@ -31,11 +35,22 @@
 #define SIGPIPE 13 /* 読み手のいないパイプへの書き込み */
 #define SIGALRM 14 /* リアルタイムクロック */
 #define SIGTERM 15 /* プロセスの終了 */
+#define SIGCHLD 17 /* 子プロセスの終了（ハンドラをSIG_IGNにすると子は親のwaitを待たずに回収される） */
+
+/** リアルタイムシグナル
+ * @details 標準シグナルは保留中に何度送っても1回にまとまるが，リアルタイムシグナルは
+ *          送った回数だけsigqueueに積まれ，同じ回数だけ処理される
+ */
+#define SIGRTMIN 32
+#define SIGRTMAX (_NSIG - 1)
 
-/* シグナル数の上限 */
-#define _NSIG 32
+/* シグナル数の上限（有効なシグナル番号は1〜_NSIG-1．sigpending.signalの1ビットずつに対応する） */
+#define _NSIG 64
 #define NSIG _NSIG
 
+/* sigpending.signalでシグナルsigに対応するビット */
+#define sigmask(sig) (1ULL << (sig))
+
 /* デフォルトハンドラと無視ハンドラ */
 #define SIG_DFL ((sighandler_t)0)	 /* デフォルト動作 */
 #define SIG_IGN ((sighandler_t)1)	 /* シグナルを無視 */
@@ -55,7 +70,22 @@ struct sigaction
 	unsigned long sa_flags;	 /* シグナルハンドラの動作を変更するためのフラグ */
 };
 
+/** 保留中のリアルタイムシグナル1つ分
+ * @note sigqueue_cachepから割り当て，do_signal()で取り出したときに解放する
+ */
+struct sigqueue
+{
+	struct list_head list; /* sigpending.listへのリンク */
+	int sig;			   /* シグナル番号 */
+};
+
+struct sigpending;
+
+void signals_init(void);
+void flush_sigqueue(struct sigpending *pending);
 sighandler_t signal(int sig, sighandler_t handler);
+int send_sig(int sig, struct task_struct *p);
+int kill_proc(pid_t pid, int sig);
 int raise(int sig);
 void do_signal(void);
 int signal_pending(void);
@@ -1,6 +1,7 @@
 #ifndef _KFS_SLAB_H
 #define _KFS_SLAB_H
 
+#include <kfs/spinlock_types.h>
 #include <kfs/stddef.h>
 #include <kfs/stdint.h>
 
@@ -47,6 +48,7 @@ struct kmem_cache
 	struct kmem_cache_node *freelist; /* 未割当リストの先頭 */
 	unsigned long start_addr;		  /* このキャッシュの開始アドレス */
 	unsigned long end_addr;			  /* このキャッシュの終了アドレス */
+	spinlock_t lock;				  /* freelistと範囲を守るロック（割り込みからも取るためirqsave） */
 };
 
 void kmem_cache_init(void);
@@ -0,0 +1,40 @@
+/**
+ * smp.h - マルチプロセッサ
+ *
+ * @see Linux 2.6.11: include/linux/smp.h, include/linux/cpumask.h
+ */
+#ifndef _KFS_SMP_H
+#define _KFS_SMP_H
+
+#include <asm-i386/bitops.h>
+#include <asm-i386/pda.h>
+#include <kfs/threads.h>
+
+/** 起動済みCPUのビットマップ（ビットnがCPU nに対応する）
+ * @note APは起動完了時に自分のビットを立てる (arch/i386/kernel/smpboot.c)
+ */
+extern volatile unsigned long cpu_online_map;
+
+#define cpu_online(cpu) ((cpu_online_map >> (cpu)) & 1UL)
+#define num_online_cpus() hweight32(cpu_online_map)
+
+/* 起動済みのCPUを順にたどる */
+#define for_each_online_cpu(cpu)                                                                                       \
+	for ((cpu) = 0; (cpu) < NR_CPUS; (cpu)++)                                                                          \
+		if (!cpu_online(cpu))                                                                                          \
+		{                                                                                                              \
+		}                                                                                                              \
+		else
+
+/* 全CPUを許すCPUマスク（task_struct->cpus_allowedの初期値） */
+#define CPU_MASK_ALL (~0UL)
+
+/* 実行中のCPUの論理番号 */
+#define smp_processor_id() read_pda(cpu_number)
+
+void smp_init(void);
+
+/* 他のCPUに再スケジュールを促すIPIを送る (arch/i386/kernel/smp.c) */
+void smp_send_reschedule(int cpu);
+
+#endif /* _KFS_SMP_H */
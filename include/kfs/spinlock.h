@@ -0,0 +1,71 @@
+/**
+ * spinlock.h - スピンロック
+ *
+ * 短いクリティカルセクションを他のCPUから守る．保持している間はプリエンプションを禁止し，
+ * 同じCPUで別のタスクに切り替わってそのタスクが同じロックを待ち続けることを防ぐ．
+ * 割り込みハンドラからも取るロックは，_irq/_irqsave版で割り込みも禁止して取ること
+ * （保持中に同じCPUで割り込まれると，ハンドラが空くことのないロックを待ち続ける）．
+ * @see Linux 2.6.11: include/linux/spinlock.h, kernel/spinlock.c
+ */
+#ifndef _KFS_SPINLOCK_H
+#define _KFS_SPINLOCK_H
+
+#include <kfs/spinlock_types.h>
+
+/* kernel/spinlock.c */
+void _spin_lock(spinlock_t *lock);
+int _spin_trylock(spinlock_t *lock);
+void _spin_unlock(spinlock_t *lock);
+void _spin_lock_irq(spinlock_t *lock);
+void _spin_unlock_irq(spinlock_t *lock);
+unsigned long _spin_lock_irqsave(spinlock_t *lock);
+void _spin_unlock_irqrestore(spinlock_t *lock, unsigned long flags);
+void lock_stat_show(void);
+
+/** 実行時にロックを初期化する（構造体に埋め込んだロック用）
+ * @note 統計モードでは名前がないため，lock_stat_show()の一覧には載らない
+ */
+#ifdef CONFIG_LOCK_STAT
+#define spin_lock_init(lock)                                                                                           \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		*(lock) = (spinlock_t){.raw_lock = __ARCH_SPIN_LOCK_UNLOCKED, .name = NULL, .owner_cpu = -1};                  \
+		INIT_LIST_HEAD(&(lock)->stat_list);                                                                            \
+	} while (0)
+#else
+#define spin_lock_init(lock)                                                                                           \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		*(lock) = (spinlock_t)__SPIN_LOCK_UNLOCKED(lock);                                                              \
+	} while (0)
+#endif
+
+#define spin_is_locked(lock) arch_spin_is_locked(&(lock)->raw_lock)
+#define spin_is_contended(lock) arch_spin_is_contended(&(lock)->raw_lock)
+
+/* プリエンプションを禁止して取得する（割り込みハンドラが取らないロック用） */
+#define spin_lock(lock) _spin_lock(lock)
+#define spin_unlock(lock) _spin_unlock(lock)
+
+/** 1度だけ取得を試みる
+ * @return 取得できたら非0（失敗したらプリエンプションも元に戻っている）
+ */
+#define spin_trylock(lock) _spin_trylock(lock)
+
+/** 割り込みも禁止して取得する
+ * @note 解放時に無条件で割り込みを許可するため，割り込みが許可されているとわかっている文脈でだけ使う
+ */
+#define spin_lock_irq(lock) _spin_lock_irq(lock)
+#define spin_unlock_irq(lock) _spin_unlock_irq(lock)
+
+/** EFLAGSを保存し，割り込みも禁止して取得する
+ * @param flags 保存先の変数（unsigned long）．spin_unlock_irqrestore()に渡す
+ */
+#define spin_lock_irqsave(lock, flags)                                                                                 \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		(flags) = _spin_lock_irqsave(lock);                                                                            \
+	} while (0)
+#define spin_unlock_irqrestore(lock, flags) _spin_unlock_irqrestore(lock, flags)
+
+#endif /* _KFS_SPINLOCK_H */
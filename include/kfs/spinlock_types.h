@@ -0,0 +1,43 @@
+/**
+ * spinlock_types.h - スピンロックの型と静的初期化
+ *
+ * 構造体にロックを埋め込むヘッダ（sched.h等）は，操作関数を持つkfs/spinlock.hではなくこちらを読む．
+ * kfs/spinlock.hはpreempt.h経由でsched.hに依存するため．
+ * @see Linux 2.6.11: include/linux/spinlock.h
+ */
+#ifndef _KFS_SPINLOCK_TYPES_H
+#define _KFS_SPINLOCK_TYPES_H
+
+#include <asm-i386/spinlock.h>
+#include <kfs/list.h>
+
+/** スピンロック
+ * @note CONFIG_LOCK_STAT（make LOCK_STAT=1）では，保持しているCPUと取得元，取得・競合回数も記録する
+ */
+typedef struct spinlock
+{
+	arch_spinlock_t raw_lock;
+#ifdef CONFIG_LOCK_STAT
+	const char *name;			/* DEFINE_SPINLOCK()の変数名（spin_lock_init()したロックはNULLで，一覧に載らない） */
+	int owner_cpu;				/* 保持しているCPU（空きなら-1） */
+	void *owner_ip;				/* 取得した呼び出し元 */
+	unsigned long nr_acquired;	/* 取得した回数 */
+	unsigned long nr_contended; /* 空くのを待った回数 */
+	unsigned long max_wait;		/* 最も長く待ったTSCサイクル数 */
+	struct list_head stat_list; /* lock_stat_show()の一覧へのリンク */
+#endif
+} spinlock_t;
+
+#ifdef CONFIG_LOCK_STAT
+#define __SPIN_LOCK_UNLOCKED(lockname)                                                                                 \
+	{                                                                                                                  \
+		.raw_lock = __ARCH_SPIN_LOCK_UNLOCKED, .name = #lockname, .owner_cpu = -1,                                     \
+		.stat_list = LIST_HEAD_INIT(lockname.stat_list)                                                                \
+	}
+#else
+#define __SPIN_LOCK_UNLOCKED(lockname) {.raw_lock = __ARCH_SPIN_LOCK_UNLOCKED}
+#endif
+
+#define DEFINE_SPINLOCK(x) spinlock_t x = __SPIN_LOCK_UNLOCKED(x)
+
+#endif /* _KFS_SPINLOCK_TYPES_H */
@@ -0,0 +1,12 @@
+/**
+ * threads.h - CPU数などのシステム全体の上限
+ *
+ * @see Linux 2.6.11: include/linux/threads.h
+ */
+#ifndef _KFS_THREADS_H
+#define _KFS_THREADS_H
+
+/* 扱えるCPUの最大数（cpu_online_mapのビット数以下にすること） */
+#define NR_CPUS 8
+
+#endif /* _KFS_THREADS_H */
@@ -0,0 +1,15 @@
+/**
+ * time.h - 時間の単位
+ *
+ * @see Linux 6.18: include/vdso/time64.h
+ */
+#ifndef _KFS_TIME_H
+#define _KFS_TIME_H
+
+#define MSEC_PER_SEC 1000UL
+#define USEC_PER_SEC 1000000UL
+#define NSEC_PER_SEC 1000000000UL
+#define NSEC_PER_MSEC 1000000UL
+#define NSEC_PER_USEC 1000UL
+
+#endif /* _KFS_TIME_H */
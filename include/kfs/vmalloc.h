@@ -3,9 +3,29 @@
 
 #include <kfs/stddef.h>
 
+struct page;
+
+/* vmalloc領域の管理構造体（Linux 2.6.11のvm_structに相当） */
+struct vm_struct
+{
+	void *addr;				/* 仮想アドレス */
+	unsigned long size;		/* 割り当てサイズ（バイト単位） */
+	unsigned long flags;	/* VMAに設定したフラグ（VM_DEMAND/VM_MAP/VM_IOREMAPなど） */
+	struct vm_struct *next; /* 次のvm_struct（リンクリスト） */
+};
+
+struct vm_struct *get_vm_area(unsigned long size, unsigned long flags);
+
 void vmalloc_init(void);
 void *vmalloc(unsigned long size);
+void *vmalloc_guarded(unsigned long size);
+void *vmalloc_lazy(unsigned long size);
+void *vreserve(unsigned long size);
 void vfree(void *addr);
+void vfree_quiet(void *addr);
+void *vmap(struct page **pages, unsigned int nr_pages);
+void vunmap(void *addr);
+void vm_unmap_aliases(void);
 size_t vsize(void *addr);
 void *vbrk(long increment);
 
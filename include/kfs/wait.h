@@ -0,0 +1,164 @@
+/**
+ * wait.h - 待ちキュー
+ *
+ * 条件が成立するまでタスクを眠らせ，条件を成立させた側が起こす仕組み．
+ * 眠っている間はランキューから外れるため，CPU時間を消費しない．
+ * @see Linux 6.18: include/linux/wait.h
+ */
+#ifndef _KFS_WAIT_H
+#define _KFS_WAIT_H
+
+#include <kfs/errno.h>
+#include <kfs/list.h>
+#include <kfs/sched.h>
+#include <kfs/signal.h>
+#include <kfs/spinlock.h>
+
+struct wait_queue_entry;
+
+/** 起床関数の型
+ * @param wq_entry 起こすエントリ
+ * @param mode     起こす対象の状態（TASK_NORMAL等）
+ * @return 実際に起こした場合は非0
+ */
+typedef int (*wait_queue_func_t)(struct wait_queue_entry *wq_entry, unsigned int mode);
+
+/* wait_queue_entry->flagsの値 */
+#define WQ_FLAG_EXCLUSIVE 0x01 /* wake_up()で1つだけ起こす待ち手 */
+
+/** 待ちキューのエントリ
+ * @note 通常は待つタスクのスタック上に置く
+ */
+struct wait_queue_entry
+{
+	unsigned int flags;		/* WQ_FLAG_* */
+	void *private;			/* 待っているタスク */
+	wait_queue_func_t func; /* 起床関数 */
+	struct list_head entry; /* wait_queue_headのリストへのリンク */
+};
+typedef struct wait_queue_entry wait_queue_entry_t;
+
+/** 待ちキュー
+ * @note 割り込みハンドラからも起こせるよう，lockはspin_lock_irqsave()で取る
+ */
+struct wait_queue_head
+{
+	spinlock_t lock;	   /* headを守るロック */
+	struct list_head head; /* wait_queue_entryのリスト */
+};
+typedef struct wait_queue_head wait_queue_head_t;
+
+#define __WAIT_QUEUE_HEAD_INITIALIZER(name)                                                                            \
+	{                                                                                                                  \
+		.lock = __SPIN_LOCK_UNLOCKED(name.lock), .head = LIST_HEAD_INIT(name.head)                                     \
+	}
+
+#define DECLARE_WAIT_QUEUE_HEAD(name) wait_queue_head_t name = __WAIT_QUEUE_HEAD_INITIALIZER(name)
+
+/* 現在のタスクを待つエントリを定義する（起こされるとキューから自動で外れる） */
+#define DEFINE_WAIT(name)                                                                                              \
+	wait_queue_entry_t name = {                                                                                        \
+		.flags = 0,                                                                                                    \
+		.private = current,                                                                                            \
+		.func = autoremove_wake_function,                                                                              \
+		.entry = LIST_HEAD_INIT((name).entry),                                                                         \
+	}
+
+/* 起床関数 (kernel/sched/wait.c) */
+int default_wake_function(struct wait_queue_entry *wq_entry, unsigned int mode);
+int autoremove_wake_function(struct wait_queue_entry *wq_entry, unsigned int mode);
+
+static inline void init_waitqueue_head(struct wait_queue_head *wq_head)
+{
+	spin_lock_init(&wq_head->lock);
+	INIT_LIST_HEAD(&wq_head->head);
+}
+
+static inline void init_waitqueue_entry(struct wait_queue_entry *wq_entry, struct task_struct *p)
+{
+	wq_entry->flags = 0;
+	wq_entry->private = p;
+	wq_entry->func = default_wake_function;
+	INIT_LIST_HEAD(&wq_entry->entry);
+}
+
+/* 待っているタスクがいるか */
+static inline int waitqueue_active(struct wait_queue_head *wq_head)
+{
+	return !list_empty(&wq_head->head);
+}
+
+/* kernel/sched/wait.c */
+void add_wait_queue(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry);
+void add_wait_queue_exclusive(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry);
+void remove_wait_queue(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry);
+void prepare_to_wait(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry, unsigned int state);
+void prepare_to_wait_exclusive(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry,
+							   unsigned int state);
+void finish_wait(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry);
+void __wake_up(struct wait_queue_head *wq_head, unsigned int mode, int nr_exclusive);
+
+/** 待ち手を起こす
+ * @note 排他的でない待ち手はすべて，排他的な待ち手（WQ_FLAG_EXCLUSIVE）は先頭の1つだけ起こす
+ */
+#define wake_up(x) __wake_up(x, TASK_NORMAL, 1)
+#define wake_up_all(x) __wake_up(x, TASK_NORMAL, 0)
+#define wake_up_interruptible(x) __wake_up(x, TASK_INTERRUPTIBLE, 1)
+#define wake_up_interruptible_all(x) __wake_up(x, TASK_INTERRUPTIBLE, 0)
+
+/** conditionが真になるまでTASK_UNINTERRUPTIBLEで眠る
+ * @param wq_head   待ちキュー
+ * @param condition 起こされるたびに評価する条件式
+ * @note conditionを真にした側はwake_up()を呼ぶこと．アイドルタスクからは呼べない
+ */
+#define wait_event(wq_head, condition)                                                                                 \
+	do                                                                                                                 \
+	{                                                                                                                  \
+		DEFINE_WAIT(__wait);                                                                                           \
+		if (condition)                                                                                                 \
+		{                                                                                                              \
+			break;                                                                                                     \
+		}                                                                                                              \
+		for (;;)                                                                                                       \
+		{                                                                                                              \
+			prepare_to_wait(&(wq_head), &__wait, TASK_UNINTERRUPTIBLE);                                                \
+			if (condition)                                                                                             \
+			{                                                                                                          \
+				break;                                                                                                 \
+			}                                                                                                          \
+			schedule();                                                                                                \
+		}                                                                                                              \
+		finish_wait(&(wq_head), &__wait);                                                                              \
+	} while (0)
+
+/** conditionが真になるか，シグナルが届くまでTASK_INTERRUPTIBLEで眠る
+ * @param wq_head   待ちキュー
+ * @param condition 起こされるたびに評価する条件式
+ * @return conditionが真になれば0，シグナルで中断されれば-ERESTARTSYS
+ */
+#define wait_event_interruptible(wq_head, condition)                                                                   \
+	({                                                                                                                 \
+		int __ret = 0;                                                                                                 \
+		DEFINE_WAIT(__wait);                                                                                           \
+		if (!(condition))                                                                                              \
+		{                                                                                                              \
+			for (;;)                                                                                                   \
+			{                                                                                                          \
+				prepare_to_wait(&(wq_head), &__wait, TASK_INTERRUPTIBLE);                                              \
+				if (condition)                                                                                         \
+				{                                                                                                      \
+					break;                                                                                             \
+				}                                                                                                      \
+				if (signal_pending())                                                                                  \
+				{                                                                                                      \
+					__ret = -ERESTARTSYS;                                                                              \
+					break;                                                                                             \
+				}                                                                                                      \
+				schedule();                                                                                            \
+			}                                                                                                          \
+			finish_wait(&(wq_head), &__wait);                                                                          \
+		}                                                                                                              \
+		__ret;                                                                                                         \
+	})
+
+#endif /* _KFS_WAIT_H */
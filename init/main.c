@@ -1,14 +1,19 @@
 #include <asm-i386/desc.h>
 #include <asm-i386/i8259.h>
+#include <asm-i386/io.h>
 #include <asm-i386/page.h>
 #include <kfs/console.h>
+#include <kfs/cpuidle.h>
 #include <kfs/keyboard.h>
 #include <kfs/mm.h>
 #include <kfs/multiboot.h>
+#include <kfs/pid.h>
 #include <kfs/printk.h>
+#include <kfs/sched.h>
 #include <kfs/serial.h>
 #include <kfs/shell.h>
 #include <kfs/slab.h>
+#include <kfs/smp.h>
 #include <kfs/vmalloc.h>
 
 /** Multiboot情報構造体へのポインタ（boot.Sで設定）
@@ -21,6 +26,12 @@ extern unsigned long multiboot_info_ptr;
 /* ページアロケータの初期化（mm/page_alloc.c） */
 extern void page_alloc_init(struct multiboot_info *mbi);
 
+/* task_struct用スラブキャッシュの初期化（kernel/fork.c） */
+extern void fork_init(void);
+
+/* タイマーの初期化（arch/i386/kernel/time.c） */
+extern void time_init(void);
+
 void start_kernel(void)
 {
 	serial_init();
@@ -62,12 +73,34 @@ void start_kernel(void)
 		vmalloc_init();
 
 		mem_init();
+
+		/* PATを設定し，VGAテキストバッファをライトコンバインでマップし直す */
+		pat_init();
+		terminal_ioremap();
+
+		/* タスク管理とスケジューラの初期化（kernel_thread使用可能に） */
+		pid_init();
+		signals_init();
+		fork_init();
+		sched_init();
+
+		/* 終了したタスクをまとめて解放するスレッドを起動する */
+		reaper_init();
+
+		/* tickを開始する（Local APICのMMIOをioremapするためメモリ管理の後） */
+		time_init();
+
+		/* 他のCPUを起動する（Local APICのMMIOとioremapを使うためtime_init()の後） */
+		smp_init();
 	}
 	else
 	{
 		printk("Multiboot info not available\n");
 	}
 
+	/* アイドルループで使う休止命令（HLTまたはMONITOR/MWAIT）を選ぶ */
+	select_idle_routine();
+
 	kfs_terminal_set_color(kfs_vga_make_color(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
 	printk("Alt+F1..F4 switch consoles; keyboard echo ready.\n");
 
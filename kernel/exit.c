@@ -0,0 +1,368 @@
+/** タスクの終了と回収
+ * - Linux 2.6.11のkernel/exit.cに相当
+ * - 終了したタスクは子をinit_taskに預け，親に知らせてTASK_DEADでCPUを手放す
+ * - task_struct，カーネルスタック，mm_struct，signal_structは終了したタスク自身の文脈では解放せず，
+ *   最後の参照が外れたらdead_tasksに積み，reaperスレッドがまとめて解放する
+ */
+
+#include <asm-i386/pgtable.h>
+#include <kfs/errno.h>
+#include <kfs/list.h>
+#include <kfs/mm.h>
+#include <kfs/panic.h>
+#include <kfs/pid.h>
+#include <kfs/preempt.h>
+#include <kfs/printk.h>
+#include <kfs/sched.h>
+#include <kfs/signal.h>
+#include <kfs/slab.h>
+#include <kfs/spinlock.h>
+#include <kfs/string.h>
+#include <kfs/wait.h>
+
+/* PID 0のアイドルタスク（kernel/sched/core.c）．親を失った子を引き取る */
+extern struct task_struct init_task;
+
+/* ブート時のページディレクトリ（boot.S．物理アドレスに置かれ，恒等マップされている） */
+extern pde_t boot_page_directory[];
+
+/** 子の終了を待つタスクの待ちキュー
+ * @note Linux 2.6.11ではタスクごとに持つが，全タスクで1つにまとめる．
+ *       起こされた親は自分の子を調べ直すため，他の親の子の終了で起こされても正しく動く
+ */
+static DECLARE_WAIT_QUEUE_HEAD(wait_chldexit);
+
+/** 回収待ちのタスク
+ * @details 参照カウントが0になったタスクをtasksでつなぐ（タスクリストからは外れている）．
+ *          reaperは空でなくなったときだけ起こされ，溜まった分を1度にまとめて解放する
+ */
+static LIST_HEAD(dead_tasks);
+static DEFINE_SPINLOCK(dead_lock);
+static unsigned int nr_dead;
+static DECLARE_WAIT_QUEUE_HEAD(reaper_wait);
+static struct task_struct *reaper;
+
+/** task_structへの参照を外す
+ * @param t 参照を外すタスク
+ * @details 最後の参照ならdead_tasksに積み，空だったならreaperを起こす
+ * @note 割り込み禁止中のschedule()からも呼ばれるため，ここでは何も解放しない
+ */
+void put_task_struct(struct task_struct *t)
+{
+	unsigned long flags;
+	int first;
+
+	if (!atomic_dec_and_test(&t->usage))
+	{
+		return;
+	}
+
+	spin_lock_irqsave(&dead_lock, flags);
+	first = list_empty(&dead_tasks);
+	list_add_tail(&t->tasks, &dead_tasks);
+	nr_dead++;
+	spin_unlock_irqrestore(&dead_lock, flags);
+
+	if (first && reaper != NULL)
+	{
+		wake_up(&reaper_wait);
+	}
+}
+
+/** 終了したタスクの資源を解放する
+ * @param p 参照カウントが0になったタスク
+ */
+static void __free_dead_task(struct task_struct *p)
+{
+	struct signal_struct *sig = p->signal;
+
+	flush_sigqueue(&p->pending);
+	if (atomic_dec_and_test(&sig->sigcnt))
+	{
+		kfree(sig);
+	}
+	if (p->mm)
+	{
+		mmput(p->mm);
+	}
+	free_task(p);
+}
+
+/** 回収待ちのタスクをまとめて解放する
+ * @return 解放したタスクの数
+ * @details ロックはdead_tasksを手元のリストにつなぎ替える1回だけ取り，解放はロックの外で行う
+ * @note reaperスレッドから呼ばれる．reaperのいないテストからは直接呼べる
+ */
+int reap_dead_tasks(void)
+{
+	LIST_HEAD(batch);
+	struct task_struct *p, *n;
+	unsigned long flags;
+	int count = 0;
+
+	spin_lock_irqsave(&dead_lock, flags);
+	list_splice_init(&dead_tasks, &batch);
+	nr_dead = 0;
+	spin_unlock_irqrestore(&dead_lock, flags);
+
+	list_for_each_entry_safe(p, n, &batch, tasks)
+	{
+		__free_dead_task(p);
+		count++;
+	}
+	return count;
+}
+
+/* 回収待ちのタスクが積まれるのを待って解放し続けるスレッド */
+static int reaper_thread(void *arg)
+{
+	(void)arg;
+	for (;;)
+	{
+		wait_event(reaper_wait, READ_ONCE(nr_dead) != 0);
+		reap_dead_tasks();
+	}
+	return 0;
+}
+
+/** reaperスレッドを起動する
+ * @note sched_init()の後に呼ぶ．起動前に積まれたタスクは最初の起床でまとめて解放される
+ */
+void reaper_init(void)
+{
+	pid_t pid = kernel_thread(reaper_thread, NULL);
+
+	if (pid < 0)
+	{
+		printk(KERN_WARNING "exit: failed to start reaper thread\n");
+		return;
+	}
+	reaper = find_task_by_pid(pid);
+	strlcpy(reaper->comm, "kreaper", sizeof(reaper->comm));
+}
+
+/** タスクリストとPIDハッシュから外し，回収されるまでの参照を外す
+ * @param p 外すタスク（EXIT_DEADにしてあること）
+ * @note 外した後もタスクが実行中なら，実行中の参照が残るためまだ解放されない
+ */
+void release_task(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tasklist_lock, flags);
+	list_del(&p->tasks);
+	list_del(&p->sibling);
+	spin_unlock_irqrestore(&tasklist_lock, flags);
+
+	detach_pid(p, PIDTYPE_PID);
+	put_task_struct(p);
+}
+
+/** アドレス空間から降りる
+ * @param tsk 終了するタスク
+ * @details ブート時のページディレクトリに切り替える．mm_struct自体はreaperがmmput()する
+ * @note active_mmを空にするため，この後に切り替わるカーネルスレッドはこのmmを借りない．
+ *       すでに借りているカーネルスレッドはmm_countを持つため，ページディレクトリは返すまで残る
+ */
+static void exit_mm(struct task_struct *tsk)
+{
+	if (!tsk->mm)
+	{
+		return;
+	}
+	load_cr3((unsigned long)boot_page_directory);
+	tsk->active_mm = NULL;
+}
+
+/** 親がSIGCHLDを無視しているかを調べる
+ * @param parent 親タスク
+ * @return 無視していれば非0
+ * @note ハンドラはsignal()で他のCPUから書き換えられるため，siglockを持って読む
+ */
+static int sigchld_ignored(struct task_struct *parent)
+{
+	unsigned long flags;
+	int ignored;
+
+	spin_lock_irqsave(&parent->signal->siglock, flags);
+	ignored = parent->signal->action[SIGCHLD].sa_handler == SIG_IGN;
+	spin_unlock_irqrestore(&parent->signal->siglock, flags);
+
+	return ignored;
+}
+
+/** 子をinit_taskに預け，親に終了を知らせる
+ * @param tsk 終了するタスク
+ * @details 親がinit_taskか，親のSIGCHLDのハンドラがSIG_IGNなら，waitを待たずにその場で回収する．
+ *          それ以外はEXIT_ZOMBIEにして親にSIGCHLDを送る．どちらの場合もdo_wait()で待つ親を起こす
+ * @note init_taskはシェルとして動き，子をwaitしないため，引き取った子は常にその場で回収する
+ * @note 親は終了するときにtasklist_lockを持って子をinit_taskに預け直すので，親の読み出しから
+ *       SIGCHLDの送信までをtasklist_lockの1区間で行い，終了した親に送らないようにする
+ *       （Linux 2.6.11のdo_notify_parent()と同じ）
+ */
+static void exit_notify(struct task_struct *tsk)
+{
+	LIST_HEAD(zombies);
+	struct task_struct *parent;
+	struct task_struct *p, *n;
+	unsigned long flags;
+	int autoreap;
+
+	spin_lock_irqsave(&tasklist_lock, flags);
+	parent = tsk->parent;
+	autoreap = parent == &init_task || sigchld_ignored(parent);
+
+	list_for_each_entry_safe(p, n, &tsk->children, sibling)
+	{
+		list_del(&p->sibling);
+		p->parent = &init_task;
+		if (p->exit_state == EXIT_ZOMBIE)
+		{
+			/* waitされないまま残っていた子は，引き取り手が回収する */
+			p->exit_state = EXIT_DEAD;
+			list_add_tail(&p->sibling, &zombies);
+		}
+		else
+		{
+			list_add_tail(&p->sibling, &init_task.children);
+		}
+	}
+	tsk->exit_state = autoreap ? EXIT_DEAD : EXIT_ZOMBIE;
+	if (!autoreap)
+	{
+		send_sig(SIGCHLD, parent);
+	}
+	spin_unlock_irqrestore(&tasklist_lock, flags);
+
+	list_for_each_entry_safe(p, n, &zombies, sibling)
+	{
+		release_task(p);
+	}
+
+	if (autoreap)
+	{
+		release_task(tsk);
+	}
+
+	/* 自動回収した場合も起こす（子がいなくなったことに気づかせる） */
+	wake_up_all(&wait_chldexit);
+}
+
+/** 現在のタスクを終了する
+ * @param code 終了コード
+ * @details アドレス空間から降り，親に知らせてからTASK_DEADにしてschedule()を呼ぶ．
+ *          schedule()がランキューから外すため，このタスクが再び選ばれることはない．
+ * @note task_structとカーネルスタックはこのスタック上では解放できないため，
+ *       切り替え後にfinish_task_switch()が実行中の参照を外し，reaperが解放する
+ */
+void do_exit(long code)
+{
+	struct task_struct *tsk = current;
+
+	if (tsk->pid == 0)
+	{
+		panic("Attempted to kill the idle task!");
+	}
+
+	tsk->flags |= PF_EXITING;
+	tsk->exit_code = (int)code;
+
+	exit_mm(tsk);
+	exit_notify(tsk);
+
+	/* TASK_DEADにしてからschedule()までにプリエンプトされると，ランキューに戻れなくなる */
+	preempt_disable();
+	tsk->__state = TASK_DEAD;
+
+	schedule();
+
+	/* TASK_DEADのタスクが再開されることはない */
+	panic("do_exit: dead task rescheduled");
+}
+
+/** 子の終了を待って回収する
+ * @param pid     待つ子のPID（0以下なら任意の子．プロセスグループはない）
+ * @param status  終了コードの格納先（NULL可）
+ * @param options WNOHANGなら終了した子がいなくても待たない
+ * @return 回収した子のPID，WNOHANGで終了した子がいなければ0，
+ *         該当する子がいなければ-ECHILD，待っている間にシグナルが届いたら-ERESTARTSYS
+ * @note Linux 2.6.11のdo_wait()に相当する
+ */
+pid_t do_wait(pid_t pid, int *status, int options)
+{
+	DEFINE_WAIT(wait);
+	struct task_struct *p, *found;
+	unsigned long flags;
+	int has_child;
+	pid_t ret;
+
+	for (;;)
+	{
+		prepare_to_wait(&wait_chldexit, &wait, TASK_INTERRUPTIBLE);
+
+		has_child = 0;
+		found = NULL;
+		spin_lock_irqsave(&tasklist_lock, flags);
+		list_for_each_entry(p, &current->children, sibling)
+		{
+			if (pid > 0 && p->pid != pid)
+			{
+				continue;
+			}
+			has_child = 1;
+			if (p->exit_state == EXIT_ZOMBIE)
+			{
+				/* 他の待ち手に二重に回収されないよう，ロックの中で取る */
+				p->exit_state = EXIT_DEAD;
+				found = p;
+				break;
+			}
+		}
+		spin_unlock_irqrestore(&tasklist_lock, flags);
+
+		if (found != NULL)
+		{
+			if (status != NULL)
+			{
+				*status = found->exit_code;
+			}
+			ret = found->pid;
+			release_task(found);
+			break;
+		}
+		if (!has_child)
+		{
+			ret = -ECHILD;
+			break;
+		}
+		if (options & WNOHANG)
+		{
+			ret = 0;
+			break;
+		}
+		if (signal_pending())
+		{
+			ret = -ERESTARTSYS;
+			break;
+		}
+		schedule();
+	}
+	finish_wait(&wait_chldexit, &wait);
+	return ret;
+}
+
+/** テスト用: 回収待ちのタスクとタスクリストを空にする
+ * @note task_structはSlab上にあるため，Slabのリセットで無効になる．
+ *       古いタスクを指したままのリストからlist_del()すると，無効なメモリを書き換えてしまう
+ */
+void exit_reset_for_test(void)
+{
+	INIT_LIST_HEAD(&dead_tasks);
+	nr_dead = 0;
+	reaper = NULL;
+	init_waitqueue_head(&reaper_wait);
+	init_waitqueue_head(&wait_chldexit);
+	INIT_LIST_HEAD(&task_list);
+	INIT_LIST_HEAD(&init_task.children);
+	INIT_LIST_HEAD(&init_task.tasks);
+}
@@ -1,21 +1,129 @@
 #include <kfs/errno.h>
 #include <kfs/mm.h>
 #include <kfs/pid.h>
+#include <kfs/preempt.h>
+#include <kfs/printk.h>
 #include <kfs/sched.h>
 #include <kfs/slab.h>
+#include <kfs/smp.h>
+#include <kfs/spinlock.h>
 #include <kfs/string.h>
+#include <kfs/vmalloc.h>
 
 /* 初期化マクロ（Phase 1では何もしない） */
 #define __init
 
-/** カーネルスタックサイズ（4KB = 1ページ） */
-#define THREAD_SIZE 4096
+/* PID 0のアイドルタスク（kernel/sched/core.c） */
+extern struct task_struct init_task;
 
 /** task_struct用スラブキャッシュ
  * @note 頻繁に割り当て/解放されるため、スラブアロケータで高速化
  */
 static struct kmem_cache *task_struct_cachep = NULL;
 
+/** 解放されたカーネルスタックのCPUごとのキャッシュ
+ * @details fork/exitが繰り返されるたびにvmalloc領域のマップ・アンマップをしないよう，
+ *          解放されたスタックをCPUごとにNR_CACHED_STACKS個まで取っておき，次の割り当てで再利用する
+ * @note 自分のCPUの組だけをプリエンプション禁止で触るため，他のCPUと競合しない．
+ *       割り込みハンドラから触られても取りこぼさないよう，スロットの出し入れはcmpxchgで行う
+ *       （Linux 6.18のthis_cpu_cmpxchg()によるcached_stacksに相当する）
+ */
+#define NR_CACHED_STACKS 2
+static void *cached_stacks[NR_CPUS][NR_CACHED_STACKS];
+
+/** カーネルスタックを割り当てる
+ * @return THREAD_SIZEバイトのスタック（ページ境界，下端にガードページ付き），失敗時NULL
+ * @note Linux 6.18のalloc_thread_stack_node()に相当する
+ */
+static void *alloc_thread_stack(void)
+{
+	void **cache;
+	int i;
+
+	/* 自分のCPUのキャッシュにあればマップ済みのものをそのまま使う */
+	preempt_disable();
+	cache = cached_stacks[smp_processor_id()];
+	for (i = 0; i < NR_CACHED_STACKS; i++)
+	{
+		void *stack = READ_ONCE(cache[i]);
+
+		if (stack && cmpxchg(&cache[i], stack, NULL) == stack)
+		{
+			preempt_enable();
+			return stack;
+		}
+	}
+	preempt_enable();
+
+	return vmalloc_guarded(THREAD_SIZE);
+}
+
+/** カーネルスタックを解放する
+ * @param stack alloc_thread_stack()で割り当てたスタック
+ * @details 自分のCPUのキャッシュに空きがあれば取っておき，なければvmalloc領域に返す
+ * @note fork/exitのたびに通る経路のため，ログを出さないvfree_quiet()で返す
+ */
+static void free_thread_stack(void *stack)
+{
+	void **cache;
+	int i;
+
+	preempt_disable();
+	cache = cached_stacks[smp_processor_id()];
+	for (i = 0; i < NR_CACHED_STACKS; i++)
+	{
+		if (cmpxchg(&cache[i], NULL, stack) == NULL)
+		{
+			preempt_enable();
+			return;
+		}
+	}
+	preempt_enable();
+
+	vfree_quiet(stack);
+}
+
+/** task_structとカーネルスタックを解放する
+ * @param tsk 解放するタスク（PIDやタスクリストからは外してあること）
+ */
+void free_task(struct task_struct *tsk)
+{
+	if (tsk->stack)
+	{
+		free_thread_stack(tsk->stack);
+	}
+	kmem_cache_free(task_struct_cachep, tsk);
+}
+
+/** mm_struct自体の最後の参照が外れたときに，ページディレクトリとmm_structを解放する
+ * @param mm 解放するmm_struct（ユーザーページはmmput()で解放済み）
+ * @note mmdrop()から呼ばれる
+ */
+void __mmdrop(struct mm_struct *mm)
+{
+	pgd_free(mm);
+	kfree(mm);
+}
+
+/** アドレス空間の利用者の参照を外し，最後の利用者ならユーザーページを解放する
+ * @param mm 参照を外すmm_struct
+ * @note ユーザーページは共有中なら参照数が減るだけで，最後の参照で解放される．
+ *       ページディレクトリはmmを借りているカーネルスレッドがCR3に載せているかもしれないため，
+ *       mmdrop()でmm_countが0になるまで残す
+ */
+void mmput(struct mm_struct *mm)
+{
+	if (!atomic_dec_and_test(&mm->mm_users))
+	{
+		return;
+	}
+	if (mm->pgd)
+	{
+		exit_mmap(mm);
+	}
+	mmdrop(mm);
+}
+
 /** task_structを複製
  * @param orig コピー元のtask_struct
  * @return 新しいtask_struct（失敗時NULL）
@@ -33,7 +141,7 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 	}
 
 	/* カーネルスタックを割り当て */
-	stack = kmalloc(THREAD_SIZE);
+	stack = alloc_thread_stack();
 	if (!stack)
 	{
 		kmem_cache_free(task_struct_cachep, tsk);
@@ -48,16 +156,21 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 	 */
 	tsk->stack = stack;
 
+	/* 実行中であることの参照と，回収（release_task()）されるまでの参照 */
+	atomic_set(&tsk->usage, 2);
+
 	return tsk;
 }
 
 /** mm_structをコピー
  * @param tsk コピー先のtask_struct
  * @param oldmm コピー元のmm_struct
+ * @param clone_flags CLONE_VMなら親とmm_structを共有する
  * @return 0（成功）、負のエラーコード（失敗）
- * @note Phase 6でCOW[Copy On Write]実装予定
+ * @details 子は自分のページディレクトリを持ち，ユーザーページは親とCOW[Copy On Write]で共有する．
+ *          ページの中身はどちらかが書き込むまでコピーしない
  */
-static int copy_mm(struct task_struct *tsk, struct mm_struct *oldmm)
+static int copy_mm(struct task_struct *tsk, struct mm_struct *oldmm, unsigned long clone_flags)
 {
 	struct mm_struct *mm;
 
@@ -65,6 +178,16 @@ static int copy_mm(struct task_struct *tsk, struct mm_struct *oldmm)
 	if (!oldmm)
 	{
 		tsk->mm = NULL;
+		tsk->active_mm = NULL;
+		return 0;
+	}
+
+	/* 共有する場合は参照カウントを増やすだけ */
+	if (clone_flags & CLONE_VM)
+	{
+		atomic_inc(&oldmm->mm_users);
+		tsk->mm = oldmm;
+		tsk->active_mm = oldmm;
 		return 0;
 	}
 
@@ -75,24 +198,36 @@ static int copy_mm(struct task_struct *tsk, struct mm_struct *oldmm)
 		return -ENOMEM;
 	}
 
-	/* mm_structの内容をコピー（Phase 6でページテーブルコピー実装予定） */
+	/* mm_structの内容をコピー */
 	memcpy(mm, oldmm, sizeof(*mm));
 
-	/* 参照カウントを初期化 */
-	mm->mm_count.counter = 1;
+	/* 参照カウントを初期化（利用者は子だけで，利用者全体でmm_countを1つ持つ） */
+	atomic_set(&mm->mm_users, 1);
+	atomic_set(&mm->mm_count, 1);
+
+	/* 子専用のページディレクトリを作り，ユーザーページをCOWで共有する */
+	mm->pgd = NULL;
+	if (pgd_alloc(mm) < 0 || copy_page_range(mm, oldmm) < 0)
+	{
+		mmput(mm);
+		return -ENOMEM;
+	}
 
 	tsk->mm = mm;
+	tsk->active_mm = mm;
 	return 0;
 }
 
 /** シグナル状態をコピー
- * @param tsk コピー先のtask_struct
+ * @param tsk コピー先のtask_struct（signalはまだコピー元のものを指している）
  * @return 0（成功）、負のエラーコード（失敗）
- * @note Phase 4で詳細実装予定
+ * @details ハンドラは親から引き継ぎ，保留中のシグナルは引き継がない
  */
 static int copy_signal(struct task_struct *tsk)
 {
+	struct signal_struct *old = tsk->signal;
 	struct signal_struct *sig;
+	unsigned long flags;
 
 	/* 新しいsignal_structを割り当て */
 	sig = kmalloc(sizeof(*sig));
@@ -102,20 +237,31 @@ static int copy_signal(struct task_struct *tsk)
 	}
 
 	/* 参照カウントを初期化 */
-	sig->sigcnt.counter = 1;
+	atomic_set(&sig->sigcnt, 1);
+	spin_lock_init(&sig->siglock);
+
+	spin_lock_irqsave(&old->siglock, flags);
+	memcpy(sig->action, old->action, sizeof(sig->action));
+	spin_unlock_irqrestore(&old->siglock, flags);
 
 	tsk->signal = sig;
+	init_sigpending(&tsk->pending);
 	return 0;
 }
 
 /** プロセスをコピー
  * @param orig コピー元のtask_struct
+ * @param clone_flags CLONE_*フラグ
+ * @param fn 新しいタスクが最初に実行する関数（NULLなら実行せずに終了する）
+ * @param arg fnに渡す引数
  * @return 新しいtask_struct（失敗時NULL）
  */
-struct task_struct *copy_process(struct task_struct *orig)
+static struct task_struct *__copy_process(struct task_struct *orig, unsigned long clone_flags, int (*fn)(void *),
+										  void *arg)
 {
 	struct task_struct *p;
 	struct pid *pid;
+	unsigned long flags;
 	int err;
 
 	/* task_structを複製 */
@@ -129,25 +275,17 @@ struct task_struct *copy_process(struct task_struct *orig)
 	pid = alloc_pid();
 	if (!pid)
 	{
-		if (p->stack)
-		{
-			kfree(p->stack);
-		}
-		kmem_cache_free(task_struct_cachep, p);
+		free_task(p);
 		return NULL;
 	}
 	p->pid = pid->nr;
 
 	/* mm_structをコピー */
-	err = copy_mm(p, orig->mm);
+	err = copy_mm(p, orig->mm, clone_flags);
 	if (err)
 	{
 		put_pid(pid);
-		if (p->stack)
-		{
-			kfree(p->stack);
-		}
-		kmem_cache_free(task_struct_cachep, p);
+		free_task(p);
 		return NULL;
 	}
 
@@ -157,14 +295,10 @@ struct task_struct *copy_process(struct task_struct *orig)
 	{
 		if (p->mm)
 		{
-			kfree(p->mm);
+			mmput(p->mm);
 		}
 		put_pid(pid);
-		if (p->stack)
-		{
-			kfree(p->stack);
-		}
-		kmem_cache_free(task_struct_cachep, p);
+		free_task(p);
 		return NULL;
 	}
 
@@ -174,19 +308,41 @@ struct task_struct *copy_process(struct task_struct *orig)
 	INIT_LIST_HEAD(&p->sibling);  /* 兄弟リストを初期化 */
 	INIT_LIST_HEAD(&p->tasks);	  /* グローバルリストを初期化 */
 
-	/* コピー元の子リストに追加（親の視点では新しい子） */
+	/* コピー元の子リストとグローバルタスクリストに追加（親の視点では新しい子） */
+	spin_lock_irqsave(&tasklist_lock, flags);
 	list_add_tail(&p->sibling, &orig->children);
-
-	/* グローバルタスクリストに追加 */
-	extern struct list_head task_list; /* kernel/sched/core.cのtask_list */
 	list_add_tail(&p->tasks, &task_list);
+	spin_unlock_irqrestore(&tasklist_lock, flags);
+
+	/* PIDハッシュから引けるようにする（pidへの参照はタスクに引き渡す） */
+	p->pids[PIDTYPE_TGID].pid = NULL;
+	INIT_HLIST_NODE(&p->pids[PIDTYPE_TGID].node);
+	attach_pid(p, PIDTYPE_PID, pid);
 
 	/* 新プロセスを実行可能状態に */
 	p->__state = TASK_RUNNING;
+	p->exit_code = 0;
+	p->exit_state = 0;
+
+	/* 初めてスケジュールされたときの開始地点とスタックを設定 */
+	copy_thread(p, fn, arg);
+
+	/* スケジューラ関連のフィールドを初期化（vruntimeは親から引き継ぐ） */
+	sched_fork(p);
 
 	return p;
 }
 
+/** プロセスをコピー
+ * @param orig コピー元のtask_struct
+ * @return 新しいtask_struct（失敗時NULL）
+ * @note ユーザーモードへ戻る経路がまだないため，子はスケジュールされると即座に終了する
+ */
+struct task_struct *copy_process(struct task_struct *orig)
+{
+	return __copy_process(orig, 0, NULL, NULL);
+}
+
 /** プロセスをfork
  * @return 新しいプロセスのPID（成功）、負のエラーコード（失敗）
  * @note Linux 6.18のkernel_clone()相当。Phase 10でsys_fork()から呼ばれる
@@ -194,7 +350,6 @@ struct task_struct *copy_process(struct task_struct *orig)
 pid_t do_fork(void)
 {
 	struct task_struct *p;
-	extern struct task_struct *current; /* 現在のプロセス */
 
 	/* 現在のプロセスをコピー */
 	p = copy_process(current);
@@ -203,10 +358,74 @@ pid_t do_fork(void)
 		return -EAGAIN;
 	}
 
+	/* ランキューに登録して実行可能にする */
+	wake_up_new_task(p);
+
 	/* 新プロセスのPIDを返す */
 	return p->pid;
 }
 
+/** カーネルスレッドを生成する
+ * @param fn  スレッドで実行する関数（戻り値が終了コードになる）
+ * @param arg fnに渡す引数
+ * @return 新しいスレッドのPID（成功）、負のエラーコード（失敗）
+ * @details 現在のタスクとmm_structを共有するタスクを作り，ランキューに登録する．
+ *          fnは次にschedule()が新しいスレッドを選んだときに実行される．
+ * @note Linux 2.6.11のkernel_thread()に相当する
+ */
+pid_t kernel_thread(int (*fn)(void *), void *arg)
+{
+	struct task_struct *p;
+
+	p = __copy_process(current, CLONE_VM, fn, arg);
+	if (!p)
+	{
+		return -EAGAIN;
+	}
+	p->flags |= PF_KTHREAD;
+
+	wake_up_new_task(p);
+
+	return p->pid;
+}
+
+/** APのアイドルタスクを作る
+ * @param cpu アイドルタスクを実行する論理CPU番号
+ * @return 新しいアイドルタスク（失敗時NULL）
+ * @details init_taskと同じくPID 0でmmを持たない．タスクリストやPIDハッシュには登録せず，
+ *          カーネルスタックだけを新しく割り当てる
+ * @note Linux 2.6.11のfork_idle()に相当する
+ */
+struct task_struct *fork_idle(int cpu)
+{
+	struct task_struct *idle;
+
+	idle = dup_task_struct(&init_task);
+	if (!idle)
+	{
+		return NULL;
+	}
+
+	idle->pid = 0;
+	idle->pids[PIDTYPE_PID].pid = NULL;
+	idle->pids[PIDTYPE_TGID].pid = NULL;
+	idle->mm = NULL;
+	idle->active_mm = NULL;
+	idle->parent = idle;
+	INIT_LIST_HEAD(&idle->children);
+	INIT_LIST_HEAD(&idle->sibling);
+	INIT_LIST_HEAD(&idle->tasks);
+	atomic_inc(&idle->signal->sigcnt); /* signal_structはinit_taskと共有する */
+	init_sigpending(&idle->pending);
+	idle->thread_info.flags = 0;
+	idle->thread_info.preempt_count = 0;
+	idle->__state = TASK_RUNNING;
+	idle->on_cpu = 0; /* APが起動してstart_secondary()に入ったら1になる */
+	snprintf(idle->comm, sizeof(idle->comm), "swapper/%d", cpu);
+
+	return idle;
+}
+
 /** fork初期化
  * @note カーネル起動時に呼ばれる
  */
@@ -214,4 +433,7 @@ void __init fork_init(void)
 {
 	/* task_struct用スラブキャッシュを作成 */
 	task_struct_cachep = kmem_cache_create("task_struct", sizeof(struct task_struct));
+
+	/* 全CPUのスタックのキャッシュを空にする */
+	memset(cached_stacks, 0, sizeof(cached_stacks));
 }
@@ -0,0 +1,195 @@
+/** ミューテックス
+ * - Linux 2.6.16のkernel/mutex.cに相当（ownerにタスクを持たせる形は4.10以降に倣う）
+ * - 空いていればcmpxchg 1回（0 → current）で取得し，待ち手がいなければcmpxchg 1回（current → 0）で解放する
+ * - 取れなければ，保持者が他のCPUで実行中の間だけ回って待ち（楽観的スピン），
+ *   それでも取れなければMUTEX_FLAG_WAITERSを立てて待ちキューで眠る
+ * - 眠っていたタスクが取得するときは常にMUTEX_FLAG_WAITERSを立てておき，解放時に次の待ち手を起こさせる
+ */
+
+#include <asm-i386/processor.h>
+#include <kfs/compiler.h>
+#include <kfs/errno.h>
+#include <kfs/mutex.h>
+#include <kfs/panic.h>
+#include <kfs/preempt.h>
+#include <kfs/sched.h>
+#include <kfs/signal.h>
+#include <kfs/wait.h>
+
+/** 空いていればflagsを付けて取得する
+ * @return 取得できたら1
+ */
+static inline int __mutex_trylock(struct mutex *lock, int flags)
+{
+	return atomic_cmpxchg(&lock->owner, 0, (int)current | flags) == 0;
+}
+
+/** 保持者が他のCPUで実行中の間だけ回って待つ
+ * @return 回っている間に取得できたら1
+ * @details 保持者が眠った・CPUを譲った，保持者が入れ替わった，自分に再スケジュール要求が来た，のいずれかで諦める．
+ *          保持者はじきに解放すると期待でき，眠って起こされるまでのコンテキストスイッチ2回より安い．
+ *          単一CPUでは保持者が実行中であることはないため，すぐに諦める
+ * @note 回っている間にプリエンプトされると，保持者のCPUを奪ったまま回り続けることがあるため，プリエンプションを禁止する
+ */
+static int mutex_optimistic_spin(struct mutex *lock)
+{
+	struct task_struct *owner;
+	int acquired = 0;
+
+	preempt_disable();
+	for (;;)
+	{
+		owner = mutex_owner(lock);
+		if (owner == NULL)
+		{
+			if (__mutex_trylock(lock, 0))
+			{
+				acquired = 1;
+				break;
+			}
+			continue;
+		}
+
+		while (mutex_owner(lock) == owner && READ_ONCE(owner->on_cpu) && !need_resched())
+		{
+			cpu_relax();
+		}
+		if (mutex_owner(lock) != NULL)
+		{
+			break;
+		}
+	}
+	preempt_enable();
+	return acquired;
+}
+
+/** ownerにMUTEX_FLAG_WAITERSを立てるか，空いていれば取得する
+ * @return 取得できたら1
+ * @note 待ちキューに並んでから呼ぶ．立てた後に解放されれば，解放した側が自分を起こす
+ */
+static int mutex_set_waiters_or_acquire(struct mutex *lock)
+{
+	int owner = atomic_read(&lock->owner);
+
+	for (;;)
+	{
+		int old;
+
+		if (owner == 0)
+		{
+			old = atomic_cmpxchg(&lock->owner, 0, (int)current | MUTEX_FLAG_WAITERS);
+			if (old == 0)
+			{
+				return 1;
+			}
+		}
+		else if (owner & MUTEX_FLAG_WAITERS)
+		{
+			return 0;
+		}
+		else
+		{
+			old = atomic_cmpxchg(&lock->owner, owner, owner | MUTEX_FLAG_WAITERS);
+			if (old == owner)
+			{
+				return 0;
+			}
+		}
+		owner = old;
+	}
+}
+
+/** 取得の遅い経路
+ * @param state TASK_UNINTERRUPTIBLEまたはTASK_INTERRUPTIBLE
+ * @return 取得できたら0，TASK_INTERRUPTIBLEでシグナルが届いたら-EINTR
+ */
+static int __mutex_lock_slowpath(struct mutex *lock, unsigned int state)
+{
+	DEFINE_WAIT(wait);
+	int ret = 0;
+
+	if (mutex_owner(lock) == current)
+	{
+		panic("mutex_lock: recursive lock %p by pid %d", (void *)lock, current->pid);
+	}
+
+	if (mutex_optimistic_spin(lock))
+	{
+		return 0;
+	}
+
+	for (;;)
+	{
+		prepare_to_wait_exclusive(&lock->wait, &wait, state);
+		if (mutex_set_waiters_or_acquire(lock))
+		{
+			break;
+		}
+		if (state == TASK_INTERRUPTIBLE && signal_pending())
+		{
+			ret = -EINTR;
+			break;
+		}
+		schedule();
+	}
+	finish_wait(&lock->wait, &wait);
+
+	/* 解放時に自分だけが起こされていた場合，諦める前に次の待ち手へ起床を引き継ぐ */
+	if (ret != 0 && !mutex_is_locked(lock) && waitqueue_active(&lock->wait))
+	{
+		wake_up(&lock->wait);
+	}
+	return ret;
+}
+
+/** ミューテックスを取得する（取れるまで眠る）
+ * @note 同じタスクが二重に取得するとpanicする
+ */
+void mutex_lock(struct mutex *lock)
+{
+	if (__mutex_trylock(lock, 0))
+	{
+		return;
+	}
+	__mutex_lock_slowpath(lock, TASK_UNINTERRUPTIBLE);
+}
+
+/** ミューテックスを取得する（眠っている間はシグナルで中断できる）
+ * @return 取得できたら0，シグナルが届いたら-EINTR（取得していない）
+ */
+int mutex_lock_interruptible(struct mutex *lock)
+{
+	if (__mutex_trylock(lock, 0))
+	{
+		return 0;
+	}
+	return __mutex_lock_slowpath(lock, TASK_INTERRUPTIBLE);
+}
+
+/** 1度だけ取得を試みる
+ * @return 取得できたら1，できなければ0
+ * @note spin_trylock()と同じく成功で1を返す（down_trylock()とは逆）
+ */
+int mutex_trylock(struct mutex *lock)
+{
+	return __mutex_trylock(lock, 0);
+}
+
+/** ミューテックスを解放する
+ * @details 待ち手の印がなければcmpxchg 1回で解放する．印があれば解放してから待ち手を1つ起こす
+ */
+void mutex_unlock(struct mutex *lock)
+{
+	if (atomic_cmpxchg(&lock->owner, (int)current, 0) == (int)current)
+	{
+		return;
+	}
+
+	if (mutex_owner(lock) != current)
+	{
+		panic("mutex_unlock: %p is not held by pid %d", (void *)lock, current->pid);
+	}
+	barrier(); /* 保護していた書き込みを解放より前に置く */
+	atomic_set(&lock->owner, 0);
+	wake_up(&lock->wait);
+}
@@ -1,21 +1,20 @@
+#include <kfs/bitmap.h>
 #include <kfs/errno.h>
 #include <kfs/pid.h>
 #include <kfs/sched.h>
 #include <kfs/slab.h>
+#include <kfs/spinlock.h>
 
 /* PID管理用の定数 */
 #define PID_MAX_DEFAULT 32768 /* デフォルト最大PID（Linux 6.18互換） */
 
-/* PID_MAX_DEFAULT個のPID管理に必要なunsigned long配列の要素数を計算するもの */
-#define PIDMAP_ENTRIES ((PID_MAX_DEFAULT + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
-
 /** PIDビットマップ
  * @brief 各PID番号の使用状況(使用済か未使用か)を表すビットマップ
  */
 static struct
 {
-	unsigned long page[PIDMAP_ENTRIES]; /* ビットマップページ（各ビットが1つのPIDを表す） */
-	int nr_free;						/* 空きPID数 */
+	DECLARE_BITMAP(page, PID_MAX_DEFAULT); /* ビットマップページ（各ビットが1つのPIDを表す） */
+	int nr_free;						   /* 空きPID数 */
 } pidmap = {
 	.page =
 		{
@@ -27,6 +26,41 @@ static struct
 /* PID割り当ての開始位置（0は予約済み） */
 static int last_pid = 0;
 
+/** PIDビットマップ，PIDハッシュと各pidのtasksを守るロック
+ * @note 割り込みハンドラからもPIDを引けるよう，spin_lock_irqsave()で取る
+ */
+static DEFINE_SPINLOCK(pidmap_lock);
+
+/** PIDハッシュテーブル
+ * @details PID番号からstruct pidを引くためのチェーン法のハッシュ表．
+ *          PIDは連番で割り当てられるため下位ビットでよく分散し，
+ *          PID_MAX_DEFAULT個すべて使っても1チェーンは高々PID_MAX_DEFAULT / PIDHASH_SIZE個に収まる
+ */
+#define PIDHASH_SHIFT 12
+#define PIDHASH_SIZE (1 << PIDHASH_SHIFT)
+static struct hlist_head pid_hash[PIDHASH_SIZE];
+
+/** PID用ハッシュ関数
+ * @param nr PID番号
+ * @return ハッシュテーブルのインデックス
+ */
+static inline unsigned int pid_hashfn(pid_t nr)
+{
+	return (unsigned int)nr & (PIDHASH_SIZE - 1);
+}
+
+extern struct task_struct init_task;
+
+/** idle/swapperプロセス(PID 0)のPID構造体
+ * @note init_taskとともに静的に存在し，解放されることはない
+ */
+struct pid init_struct_pid = {
+	.count = 1,
+	.level = 0,
+	.inum = 1,
+	.nr = 0,
+};
+
 /** 新しいPIDを割り当てる
  * @brief 空きPIDを検索して割り当てる
  * @return 割り当てられたPID構造体，失敗時NULL
@@ -34,53 +68,43 @@ static int last_pid = 0;
 struct pid *alloc_pid(void)
 {
 	struct pid *pid_struct;
-	int pid_nr;
-	int offset, bit, i;
+	unsigned long pid_nr;
+	unsigned long flags;
+	int i;
 
-	/* 空きPIDがない */
-	if (pidmap.nr_free == 0)
+	/* pid構造体はロックの外で割り当てておく */
+	pid_struct = kmalloc(sizeof(struct pid));
+	if (!pid_struct)
 	{
 		return NULL;
 	}
 
-	/* 次の空きPIDを検索（ラウンドロビン） */
-	pid_nr = -1;
-	for (i = 0; i < PID_MAX_DEFAULT; i++)
-	{
-		int test_pid = (last_pid + i + 1) % PID_MAX_DEFAULT;
-		offset = test_pid / (8 * sizeof(long)); // pidmap.page配列のインデックス
-		bit = test_pid % (8 * sizeof(long));	// pidmap.page配列内のビット位置
+	spin_lock_irqsave(&pidmap_lock, flags);
 
-		/* このPIDが空いているか確認 */
-		if (!(pidmap.page[offset] & (1UL << bit)))
+	/* 次の空きPIDを検索（ラウンドロビン，末尾まで空きがなければ先頭から探し直す） */
+	pid_nr = PID_MAX_DEFAULT;
+	if (pidmap.nr_free > 0)
+	{
+		pid_nr = find_next_zero_bit(pidmap.page, PID_MAX_DEFAULT, last_pid + 1);
+		if (pid_nr >= PID_MAX_DEFAULT)
 		{
-			pid_nr = test_pid;
-			break;
+			pid_nr = find_first_zero_bit(pidmap.page, PID_MAX_DEFAULT);
 		}
 	}
 
-	if (pid_nr < 0)
+	if (pid_nr >= PID_MAX_DEFAULT)
 	{
-		return NULL; /* 空きが見つからない */
+		/* 空きが見つからない */
+		spin_unlock_irqrestore(&pidmap_lock, flags);
+		kfree(pid_struct);
+		return NULL;
 	}
 
 	/* PIDビットを立てる */
-	offset = pid_nr / (8 * sizeof(long));
-	bit = pid_nr % (8 * sizeof(long));
-	pidmap.page[offset] |= (1UL << bit);
+	__set_bit(pid_nr, pidmap.page);
 	pidmap.nr_free--;
 	last_pid = pid_nr;
 
-	/* pid構造体を割り当て */
-	pid_struct = kmalloc(sizeof(struct pid));
-	if (!pid_struct)
-	{
-		/* メモリ不足：PIDビットを戻す */
-		pidmap.page[offset] &= ~(1UL << bit);
-		pidmap.nr_free++;
-		return NULL;
-	}
-
 	/* pid構造体を初期化 */
 	pid_struct->count = 1;	 /* 参照カウント1で開始 */
 	pid_struct->level = 0;	 /* 単一namespace（レベル0） */
@@ -90,9 +114,13 @@ struct pid *alloc_pid(void)
 	/* tasks配列を初期化（Phase 14でスレッドグループ管理に使用） */
 	for (i = 0; i < PIDTYPE_MAX; i++)
 	{
-		pid_struct->tasks[i].first = NULL;
+		INIT_HLIST_HEAD(&pid_struct->tasks[i]);
 	}
 
+	/* 番号から引けるようにハッシュに登録 */
+	hlist_add_head(&pid_struct->pid_chain, &pid_hash[pid_hashfn(pid_nr)]);
+
+	spin_unlock_irqrestore(&pidmap_lock, flags);
 	return pid_struct;
 }
 
@@ -102,62 +130,182 @@ struct pid *alloc_pid(void)
  */
 void put_pid(struct pid *pid_struct)
 {
-	int pid_nr;
-	int offset, bit;
+	unsigned long flags;
 
 	if (!pid_struct)
 	{
 		return;
 	}
 
+	spin_lock_irqsave(&pidmap_lock, flags);
+
 	/* 参照カウントをデクリメント */
 	pid_struct->count--;
 	if (pid_struct->count > 0)
 	{
+		spin_unlock_irqrestore(&pidmap_lock, flags);
 		return; /* まだ参照されている */
 	}
 
-	/* PID番号を取得 */
-	pid_nr = pid_struct->nr;
+	/* ハッシュから外す（以後find_pid()で見つからない） */
+	hlist_del_init(&pid_struct->pid_chain);
 
 	/* PIDビットをクリア */
-	offset = pid_nr / (8 * sizeof(long));
-	bit = pid_nr % (8 * sizeof(long));
-	pidmap.page[offset] &= ~(1UL << bit);
+	__clear_bit(pid_struct->nr, pidmap.page);
 	pidmap.nr_free++;
 
+	spin_unlock_irqrestore(&pidmap_lock, flags);
+
 	/* pid構造体を解放 */
 	kfree(pid_struct);
 }
 
-/* PIDハッシュテーブル（簡易版、Phase 2で使用） */
-#define PID_HASH_SIZE 256
-static struct hlist_head pid_hash[PID_HASH_SIZE] __attribute__((unused));
+/* PIDハッシュの1チェーンだけを走査する（pidmap_lockを持って呼ぶ） */
+static struct pid *__find_pid(pid_t nr)
+{
+	struct pid *pid;
 
-/** PID用ハッシュ関数
- * @param pid プロセスID
- * @return ハッシュテーブルのインデックス
+	hlist_for_each_entry(pid, &pid_hash[pid_hashfn(nr)], pid_chain)
+	{
+		if (pid->nr == nr)
+		{
+			return pid;
+		}
+	}
+	return NULL;
+}
+
+/** PID番号からPID構造体を検索する
+ * @param nr PID番号
+ * @return PID構造体（使われていない番号ならNULL）
  */
-static inline int pid_hashfn(pid_t pid)
+struct pid *find_pid(pid_t nr)
 {
-	return pid % PID_HASH_SIZE;
+	struct pid *pid;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pidmap_lock, flags);
+	pid = __find_pid(nr);
+	spin_unlock_irqrestore(&pidmap_lock, flags);
+	return pid;
+}
+
+/** タスクをPIDにつなぐ
+ * @param task つなぐタスク
+ * @param type PIDの種類
+ * @param pid  つなぐPID構造体
+ * @note 呼び出し元が持つpidへの参照はタスクに引き渡される（detach_pid()で解放される）
+ */
+void attach_pid(struct task_struct *task, enum pid_type type, struct pid *pid)
+{
+	struct pid_link *link = &task->pids[type];
+	unsigned long flags;
+
+	spin_lock_irqsave(&pidmap_lock, flags);
+	link->pid = pid;
+	hlist_add_head(&link->node, &pid->tasks[type]);
+	spin_unlock_irqrestore(&pidmap_lock, flags);
+}
+
+/** タスクをPIDから外す
+ * @param task 外すタスク
+ * @param type PIDの種類
+ * @details attach_pid()で引き渡された参照を解放する．
+ *          最後の参照であればPID番号も解放され，find_pid()で見つからなくなる
+ */
+void detach_pid(struct task_struct *task, enum pid_type type)
+{
+	struct pid_link *link = &task->pids[type];
+	struct pid *pid;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pidmap_lock, flags);
+	pid = link->pid;
+	if (!pid)
+	{
+		spin_unlock_irqrestore(&pidmap_lock, flags);
+		return;
+	}
+	hlist_del_init(&link->node);
+	link->pid = NULL;
+	spin_unlock_irqrestore(&pidmap_lock, flags);
+
+	put_pid(pid);
+}
+
+/** PIDにつながっているタスクを取得する
+ * @param pid  PID構造体（NULL可）
+ * @param type PIDの種類
+ * @return タスク（つながっていなければNULL）
+ */
+struct task_struct *pid_task(struct pid *pid, enum pid_type type)
+{
+	if (!pid || hlist_empty(&pid->tasks[type]))
+	{
+		return NULL;
+	}
+	return hlist_entry(pid->tasks[type].first, struct task_struct, pids[type].node);
 }
 
-/** プロセスをPIDハッシュテーブルに追加する
- * @param task 追加するプロセス
- *
- * PIDからの高速検索のため
- * Phase 2で完全実装
+/** PIDからtask_structを検索
+ * @param pid 検索するプロセスID
+ * @return 見つかったtask_struct（見つからない場合NULL）
+ * @note PIDハッシュを引くためタスク数によらない
  */
-void hash_pid(struct task_struct *task)
+struct task_struct *find_task_by_pid(pid_t pid)
 {
-	(void)task; /* Phase 2で完全実装 */
+	struct task_struct *task;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pidmap_lock, flags);
+	task = pid_task(__find_pid(pid), PIDTYPE_PID);
+	spin_unlock_irqrestore(&pidmap_lock, flags);
+	return task;
+}
+
+/** PIDからtask_structを検索し，参照を得る
+ * @param pid 検索するプロセスID
+ * @return 見つかったtask_struct（見つからない場合NULL）．使い終わったらput_task_struct()する
+ * @note PIDハッシュに残っている間はrelease_task()が参照を外していないため，pidmap_lockを持ったまま参照を得れば，
+ *       戻った後に他のCPUでタスクが回収されても解放されない
+ */
+struct task_struct *find_get_task_by_pid(pid_t pid)
+{
+	struct task_struct *task;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pidmap_lock, flags);
+	task = pid_task(__find_pid(pid), PIDTYPE_PID);
+	if (task != NULL)
+	{
+		get_task_struct(task);
+	}
+	spin_unlock_irqrestore(&pidmap_lock, flags);
+	return task;
 }
 
 /** PID管理の初期化
- * @note Phase 1では何もしない（静的初期化で十分）
+ * @details PIDビットマップとPIDハッシュを空にし，init_task(PID 0)を登録する
+ * @note PID構造体はSlab上にあるため，アロケータを初期化し直した後にも呼ぶ
  */
 void pid_init(void)
 {
-	/* Phase 2以降で初期化処理を追加予定 */
+	unsigned int i;
+
+	bitmap_zero(pidmap.page, PID_MAX_DEFAULT);
+	__set_bit(0, pidmap.page); /* PID 0は予約済み（init_task用） */
+	pidmap.nr_free = PID_MAX_DEFAULT - 1;
+	last_pid = 0;
+
+	for (i = 0; i < PIDHASH_SIZE; i++)
+	{
+		INIT_HLIST_HEAD(&pid_hash[i]);
+	}
+
+	for (i = 0; i < PIDTYPE_MAX; i++)
+	{
+		INIT_HLIST_HEAD(&init_struct_pid.tasks[i]);
+	}
+	hlist_add_head(&init_struct_pid.pid_chain, &pid_hash[pid_hashfn(0)]);
+	attach_pid(&init_task, PIDTYPE_PID, &init_struct_pid);
 }
@@ -1,20 +1,48 @@
+#include <asm-i386/mmu_context.h>
+#include <asm-i386/param.h>
+#include <asm-i386/system.h>
+#include <kfs/cpuidle.h>
+#include <kfs/errno.h>
+#include <kfs/linkage.h>
 #include <kfs/list.h>
 #include <kfs/mm_types.h>
 #include <kfs/pid.h>
+#include <kfs/preempt.h>
 #include <kfs/sched.h>
+#include <kfs/string.h>
+
+#include "sched.h"
+#include "stats.h"
+
+/** init_taskのシグナル共有情報
+ * @note ハンドラはすべてSIG_DFL．fork()した子はこれを写して自分のsignal_structを持つ
+ */
+static struct signal_struct init_signals = {
+	.sigcnt = ATOMIC_INIT(1),
+	.siglock = __SPIN_LOCK_UNLOCKED(init_signals.siglock),
+};
 
 /** idle/swapperプロセス (PID=0)
  * @details すべてのプロセスの祖先．静的に定義され，カーネル起動時に実行される最初のプロセス．
  *          fork()でinitプロセス(PID=1)を作成し，その後は実行可能なプロセスがない時にCPUをアイドル状態にする．
  */
 struct task_struct init_task = {
+	/* 低レベル情報 */
+	.thread_info =
+		{
+			.flags = 0,
+			.preempt_count = 0, /* シェルとして動くためプリエンプト可能 */
+		},
+
 	/* 状態管理 */
 	.__state = TASK_RUNNING, /* 実行可能状態 */
 	.stack = NULL,			 /* カーネル初期スタック使用 */
+	.usage = ATOMIC_INIT(2), /* 静的に置かれ，解放されることはない */
 	.flags = PF_KTHREAD,	 /* カーネルスレッド */
 
 	/* メモリ管理（カーネルスレッドなのでNULL） */
-	.mm = NULL, /* ユーザー空間なし */
+	.mm = NULL,		   /* ユーザー空間なし */
+	.active_mm = NULL, /* カーネル空間のみ（ブート時のページディレクトリ） */
 
 	/* プロセスID */
 	.pid = 0, /* PID 0（idle） */
@@ -30,8 +58,8 @@ struct task_struct init_task = {
 	.euid = {.val = 0},			   /* root実効UID */
 	.cap_effective = CAP_FULL_SET, /* 全Capability有効 */
 
-	/* シグナル（後で初期化） */
-	.signal = NULL, /* Phase 4で設定 */
+	/* シグナル */
+	.signal = &init_signals,
 	.pending =
 		{
 			.list = LIST_HEAD_INIT(init_task.pending.list),
@@ -39,28 +67,42 @@ struct task_struct init_task = {
 		},
 
 	/* スケジューリング */
+	.sched_class = &fair_sched_class,
 	.se =
 		{
-			.load = 0,
+			.load = {.weight = NICE_0_LOAD},
 			.run_node = {0},
 			.on_rq = 0,
+			.exec_start = 0,
+			.sum_exec_runtime = 0,
+			.prev_sum_exec_runtime = 0,
 			.vruntime = 0,
 		},
+	.rt =
+		{
+			.run_list = LIST_HEAD_INIT(init_task.rt.run_list),
+			.time_slice = 0,
+			.on_rq = 0,
+		},
+	.on_rq = 0,
+	.policy = SCHED_NORMAL,
+	.prio = DEFAULT_PRIO,
+	.static_prio = DEFAULT_PRIO, /* nice 0 */
+	.rt_priority = 0,
+	.on_cpu = 1, /* ブートCPUで実行中 */
+	.cpu = 0,
+	.cpus_allowed = CPU_MASK_ALL, /* 子が引き継ぐため，アイドルタスクでも全CPUを許す */
 
 	/* プロセス名 */
 	.comm = "swapper", /* idle/swapperプロセス */
 };
 
-/** 現在実行中のタスクへのポインタ
- * @note 単一CPUなので通常のグローバル変数として実装
- */
-struct task_struct *current = &init_task;
-
 /** 全タスクのリスト
  * 全てのtask_structをつなぐグローバルリスト
  * Phase 2でタスク検索等に使用
  */
 LIST_HEAD(task_list);
+DEFINE_SPINLOCK(tasklist_lock);
 
 /** init_taskの最終初期化
  * @brief init_taskの静的初期化できない部分を実行時に初期化する．
@@ -79,33 +121,1225 @@ void init_idle_task(void)
 	list_add(&init_task.tasks, &task_list);
 
 	/* 現在のタスクとして設定 */
-	current = &init_task;
+	write_pda(pcurrent, &init_task);
+}
+
+/* ========== nice値と負荷重み ========== */
+
+/** nice値ごとの負荷重み
+ * @details nice値が1違うとCPU時間が約10%違うよう，隣り合う重みの比を約1.25にしてある．
+ *          nice 0（添字20）がNICE_0_LOAD
+ * @see Linux 6.18 kernel/sched/core.c
+ */
+const int sched_prio_to_weight[NICE_WIDTH] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548, 7620, 6100, 4904, 3906,
+	/*  -5 */ 3121, 2501, 1991, 1586, 1277,
+	/*   0 */ 1024, 820, 655, 526, 423,
+	/*   5 */ 335, 272, 215, 172, 137,
+	/*  10 */ 110, 87, 70, 56, 45,
+	/*  15 */ 36, 29, 23, 18, 15,
+};
+
+/** sched_prio_to_weightの逆数（2^32/weight）
+ * @note vruntimeの換算をweightでの除算ではなく，この値との乗算とシフトで行うために使う
+ */
+const uint32_t sched_prio_to_wmult[NICE_WIDTH] = {
+	/* -20 */ 48388, 59856, 76040, 92818, 118348,
+	/* -15 */ 147320, 184698, 229616, 287308, 360437,
+	/* -10 */ 449829, 563644, 704093, 875809, 1099582,
+	/*  -5 */ 1376151, 1717300, 2157191, 2708050, 3363326,
+	/*   0 */ 4194304, 5237765, 6557202, 8165337, 10153587,
+	/*   5 */ 12820798, 15790321, 19976592, 24970740, 31350126,
+	/*  10 */ 39045157, 49367440, 61356676, 76695844, 95443717,
+	/*  15 */ 119304647, 148102320, 186737708, 238609294, 286331153,
+};
+
+/** タスクのnice値から負荷重みを設定する
+ * @param p 対象のタスク（static_prioを設定済み）
+ */
+static void set_load_weight(struct task_struct *p)
+{
+	int idx = p->static_prio - MAX_RT_PRIO;
+
+	p->se.load.weight = sched_prio_to_weight[idx];
+	p->se.load.inv_weight = sched_prio_to_wmult[idx];
+}
+
+/* ========== ランキュー ========== */
+
+/** CPUごとのランキュー
+ * @note 自CPUのものはthis_rq()，他のCPUのものはcpu_rq()で引く
+ */
+struct rq runqueues[NR_CPUS];
+
+/* 最も優先度の高いスケジューリングクラス */
+#define sched_class_highest (&rt_sched_class)
+
+/* 現在のCPUのランキューを取得する */
+struct rq *this_rq(void)
+{
+	return cpu_rq(smp_processor_id());
+}
+
+/** タスクが登録されているランキューのロックを取る
+ * @param p     対象のタスク
+ * @param flags 保存したEFLAGSの格納先（task_rq_unlock()に渡す）
+ * @return ロックを取ったランキュー
+ * @details ロックを待つ間に他のCPUへ移されうるため，取った後で登録先が変わっていないか確かめる
+ */
+static struct rq *task_rq_lock(struct task_struct *p, unsigned long *flags)
+{
+	struct rq *rq;
+
+	for (;;)
+	{
+		rq = task_rq(p);
+		spin_lock_irqsave(&rq->lock, *flags);
+		if (likely(rq == task_rq(p)))
+		{
+			return rq;
+		}
+		spin_unlock_irqrestore(&rq->lock, *flags);
+	}
+}
+
+static void task_rq_unlock(struct rq *rq, unsigned long flags)
+{
+	spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/** 自CPUのランキューのロックを取る
+ * @note 割り込みを先に禁止し，ロックを取るまでの間に他のCPUへ移らないようにする
+ */
+static struct rq *this_rq_lock(unsigned long *flags)
+{
+	struct rq *rq;
+
+	local_irq_save(*flags);
+	rq = this_rq();
+	spin_lock(&rq->lock);
+	return rq;
+}
+
+/** ランキューを空にする
+ * @param cpu 対象のCPU
+ * @note アイドルタスクはinit_idle()で設定する
+ */
+static void init_rq(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	spin_lock_init(&rq->lock);
+	rq->cpu = cpu;
+	rq->nr_running = 0;
+	rq->clock = 0;
+	init_rt_rq(&rq->rt, rq->clock);
+	init_cfs_rq(&rq->cfs);
+	rq->curr = NULL;
+	rq->idle = NULL;
+	rq->nr_switches = 0;
+	rq->nr_uninterruptible = 0;
+	rq->idle_time = 0;
+	init_calc_load(rq);
+	rq->next_balance = rq->clock + BALANCE_INTERVAL_NS;
+	rq->nr_balance_failed = 0;
+	rq->push_task = NULL;
+	rq->prev_mm = NULL;
+	memset(&rq->lb_stats, 0, sizeof(rq->lb_stats));
+}
+
+/** CPUのアイドルタスクを設定する
+ * @param idle アイドルタスク（BSPはinit_task，APはfork_idle()で作ったもの）
+ * @param cpu  実行するCPU
+ * @details アイドルタスクはランキューに登録せず，実行可能なタスクがないときにだけ選ばれる
+ * @note APは起動前にBSPから呼ばれる (arch/i386/kernel/smpboot.c)
+ */
+void init_idle(struct task_struct *idle, int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	idle->cpu = cpu;
+	idle->on_rq = 0;
+	memset(&idle->sched_info, 0, sizeof(idle->sched_info));
+	idle->sched_info.last_arrival = rq->clock;
+	clear_tsk_need_resched(idle);
+	rq->curr = idle;
+	rq->idle = idle;
+}
+
+/** スケジューラを初期化する
+ * @details 全CPUのランキューを空にし，init_task(PID 0)をCPU 0のアイドルタスクとして実行中にする
+ * @note Linux 6.18のsched_init()に相当する
+ */
+void sched_init(void)
+{
+	int cpu;
+
+	init_idle_task();
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+	{
+		init_rq(cpu);
+	}
+	init_idle(&init_task, 0);
+	init_task.on_cpu = 1;
+	set_load_weight(&init_task);
+}
+
+/** タスクをランキューに登録する
+ * @param rq    ランキュー
+ * @param p     登録するタスク
+ * @param flags ENQUEUE_*フラグ
+ */
+void activate_task(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (p->on_rq)
+	{
+		return;
+	}
+	p->sched_class->enqueue_task(rq, p, flags);
+	p->on_rq = 1;
+	rq->nr_running++;
+	sched_info_enqueue(rq, p);
+}
+
+/** タスクをランキューから外す
+ * @param rq    ランキュー
+ * @param p     外すタスク
+ * @param flags DEQUEUE_*フラグ
+ */
+void deactivate_task(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (!p->on_rq)
+	{
+		return;
+	}
+	p->sched_class->dequeue_task(rq, p, flags);
+	p->on_rq = 0;
+	rq->nr_running--;
+	sched_info_dequeue(rq, p);
+}
+
+/** 実行中のタスクに再スケジュールを要求する
+ * @param rq ランキュー
+ * @details 他のCPUならIPIで割り込み，次の割り込みからの復帰で切り替えさせる．
+ *          MWAITで待っているアイドルタスク（TIF_POLLING_NRFLAG）はフラグの書き込みで起きるため送らない
+ * @note 切り替えは次のプリエンプションポイント（割り込みからの復帰，preempt_enable()等）で行われる．
+ *       アイドル中なら，アイドルループを抜けるまでの時間を測り始める．ランキューのロックを持って呼ぶ
+ */
+void resched_curr(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+
+	if (test_tsk_need_resched(curr))
+	{
+		return;
+	}
+	if (curr == rq->idle)
+	{
+		cpuidle_wake_request(rq->cpu);
+	}
+	set_tsk_need_resched(curr);
+
+	if (rq->cpu == smp_processor_id())
+	{
+		return;
+	}
+	if (!test_tsk_thread_flag(curr, TIF_POLLING_NRFLAG))
+	{
+		smp_send_reschedule(rq->cpu);
+	}
+}
+
+/** 実行可能になったタスクが実行中のタスクをプリエンプトすべきか判定する
+ * @param rq ランキュー
+ * @param p  実行可能になったタスク
+ * @details アイドルタスクは常に譲る．同じクラス同士の判定はクラスに任せ，
+ *          違うクラスなら優先度の高いクラス（リアルタイム）のタスクが譲らせる
+ */
+void check_preempt_curr(struct rq *rq, struct task_struct *p)
+{
+	struct task_struct *curr = rq->curr;
+	const struct sched_class *class;
+
+	if (curr == rq->idle)
+	{
+		resched_curr(rq);
+		return;
+	}
+
+	if (p->sched_class == curr->sched_class)
+	{
+		curr->sched_class->check_preempt_curr(rq, p);
+		return;
+	}
+
+	for (class = sched_class_highest; class != NULL; class = class->next)
+	{
+		if (class == curr->sched_class)
+		{
+			break;
+		}
+		if (class == p->sched_class)
+		{
+			resched_curr(rq);
+			break;
+		}
+	}
 }
 
-/** PIDからtask_structを検索
- * @param pid 検索するプロセスID
- * @return 見つかったtask_struct（見つからない場合NULL）
- * @note グローバルタスクリストを線形探索（Phase 1-6の簡易実装）
- *       Phase 7以降でPIDハッシュテーブルによる高速化を実装予定
+/** 次に実行するタスクを選ぶ
+ * @param rq ランキュー
+ * @return 優先度の高いクラスから最初に見つかったタスク，なければアイドルタスク
  */
-struct task_struct *find_task_by_pid(pid_t pid)
+static struct task_struct *pick_next_task(struct rq *rq)
 {
-	struct task_struct *task;
+	const struct sched_class *class;
 
-	/* リストが空の場合は即座にNULLを返す */
-	if (list_empty(&task_list))
+	for (class = sched_class_highest; class != NULL; class = class->next)
 	{
-		return NULL;
+		struct task_struct *p = class->pick_next_task(rq);
+		if (p)
+		{
+			return p;
+		}
+	}
+
+	return rq->idle;
+}
+
+/** 実行を終えるタスクをクラスに戻す
+ * @param rq   ランキュー
+ * @param prev 直前まで実行していたタスク
+ */
+static void put_prev_task(struct rq *rq, struct task_struct *prev)
+{
+	if (prev == rq->idle)
+	{
+		return;
+	}
+	prev->sched_class->put_prev_task(rq, prev);
+}
+
+/** 次に実行するタスクを選び，ランキューの実行中タスクを切り替える
+ * @param rq ランキュー
+ * @return 新しく実行中になったタスク
+ * @note スタックとレジスタの切り替えは呼び出し元（schedule()）が行う．
+ *       実行待ちの時間とアイドル時間はここで計上する
+ */
+struct task_struct *__pick_next_task(struct rq *rq)
+{
+	struct task_struct *prev = rq->curr;
+	struct task_struct *next;
+
+	put_prev_task(rq, prev);
+	next = pick_next_task(rq);
+	if (next != prev)
+	{
+		sched_info_switch(rq, prev, next);
+	}
+	rq->curr = next;
+
+	return next;
+}
+
+/* ========== CPU間の移動 ========== */
+
+/** タスクの登録先のCPUを変える
+ * @param p       移すタスク（実行中でないこと）
+ * @param new_cpu 移し先のCPU
+ * @details vruntimeはランキューごとのmin_vruntimeからの相対位置として引き継ぐ．
+ *          そのままの値では，min_vruntimeの進み方が違うCPUの間で不当に優遇・冷遇される
+ * @note 移し元と移し先の両方のランキューのロックを持って呼ぶ．
+ *       ランキューで待っているタスクは，外すとmin_vruntimeが進みうるため外す前に呼ぶ
+ */
+static void set_task_cpu(struct task_struct *p, int new_cpu)
+{
+	struct rq *old_rq = task_rq(p);
+	struct rq *new_rq = cpu_rq(new_cpu);
+
+	if (task_cpu(p) == new_cpu)
+	{
+		return;
+	}
+	if (p->sched_class == &fair_sched_class)
+	{
+		p->se.vruntime = p->se.vruntime - old_rq->cfs.min_vruntime + new_rq->cfs.min_vruntime;
 	}
+	p->cpu = new_cpu;
+	p->nr_migrations++;
+}
+
+/** 起床・fork・送り出しの際にタスクを置くCPUを選ぶ
+ * @param p 対象のタスク
+ * @return 前のCPUが空いていればそれ，他に空いているCPUがあればそれ，どこも埋まっていれば前のCPU．
+ *         前のCPUが許されていなければ，許されたCPUのうち最も実行可能なタスクの少ないもの
+ * @details キャッシュに残ったデータを使えるよう前のCPUを優先し，待たせるくらいなら空いているCPUへ移す
+ * @note 他のランキューはロックを取らずに見るため，結果は目安．許されたCPUがすべて停止していれば起動済みのCPUから選ぶ
+ */
+int select_task_rq(struct task_struct *p)
+{
+	unsigned long allowed = p->cpus_allowed & cpu_online_map;
+	int prev = task_cpu(p);
+	int best = prev;
+	unsigned int min_running = ~0U;
+	int cpu;
 
-	/* タスクリストを走査（tasksフィールドを使用） */
-	list_for_each_entry(task, &task_list, tasks)
+	if (!allowed)
 	{
-		if (task->pid == pid)
+		allowed = cpu_online_map;
+	}
+	if (((allowed >> prev) & 1UL) && idle_cpu(prev))
+	{
+		return prev;
+	}
+
+	for_each_online_cpu(cpu)
+	{
+		unsigned int running;
+
+		if (!((allowed >> cpu) & 1UL))
+		{
+			continue;
+		}
+		running = READ_ONCE(cpu_rq(cpu)->nr_running);
+		if (running < min_running)
 		{
-			return task;
+			min_running = running;
+			best = cpu;
 		}
 	}
 
-	return NULL;
+	if (min_running != 0 && ((allowed >> prev) & 1UL))
+	{
+		return prev;
+	}
+	return best;
+}
+
+/** 登録されていないタスクを他のCPUへ移し，移し先のランキューのロックに持ち替える
+ * @param rq  pの登録先のランキュー（ロックを持っている）
+ * @param p   どのランキューにも登録されておらず，他から登録されることもないタスク
+ * @param cpu 移し先のCPU
+ * @return ロックを持っている移し先のランキュー
+ */
+static struct rq *migrate_unqueued_task(struct rq *rq, struct task_struct *p, int cpu)
+{
+	struct rq *new_rq = cpu_rq(cpu);
+
+	double_lock_balance(rq, new_rq);
+	set_task_cpu(p, cpu);
+	spin_unlock(&rq->lock);
+	return new_rq;
+}
+
+/** ランキューで待っているタスクを他のCPUのランキューへ移す
+ * @param src_rq 移し元のランキュー
+ * @param p      移すタスク（実行中でないこと）
+ * @param dst_rq 移し先のランキュー
+ * @note 両方のランキューのロックを持って呼ぶ
+ */
+void move_queued_task(struct rq *src_rq, struct task_struct *p, struct rq *dst_rq)
+{
+	set_task_cpu(p, dst_rq->cpu);
+	deactivate_task(src_rq, p, 0);
+	activate_task(dst_rq, p, 0);
+	check_preempt_curr(dst_rq, p);
+}
+
+/** アフィニティで許されなくなったタスクを，許されたCPUのランキューへ送り出す
+ * @param p 切り替え前に自CPUのランキューから外したタスク（実行可能なまま，on_cpuは下りている）
+ * @note finish_task_switch()から，ランキューのロックを持たず割り込み禁止で呼ばれる
+ */
+static void push_disallowed_task(struct task_struct *p)
+{
+	struct rq *rq = task_rq(p);
+	int cpu;
+
+	spin_lock(&rq->lock);
+	rq->lb_stats.affinity_pushed++;
+	cpu = select_task_rq(p);
+	if (cpu != task_cpu(p))
+	{
+		rq = migrate_unqueued_task(rq, p, cpu);
+	}
+	activate_task(rq, p, 0);
+	check_preempt_curr(rq, p);
+	spin_unlock(&rq->lock);
+}
+
+/** fork時にスケジューラ関連のフィールドを初期化する
+ * @param p 新しいタスク（まだランキューに登録されていない）
+ * @note Linux 6.18のsched_fork()に相当する．実行してよいCPUは親から引き継ぐ
+ */
+void sched_fork(struct task_struct *p)
+{
+	struct rq *rq;
+	unsigned long flags;
+
+	p->on_rq = 0;
+	p->se.on_rq = 0;
+	p->se.exec_start = 0;
+	p->se.sum_exec_runtime = 0;
+	p->se.prev_sum_exec_runtime = 0;
+	p->se.vruntime = 0;
+	set_load_weight(p); /* nice値は親から引き継ぐ */
+	RB_CLEAR_NODE(&p->se.run_node);
+	INIT_LIST_HEAD(&p->rt.run_list);
+	p->rt.on_rq = 0;
+	p->on_cpu = 0;
+	memset(&p->sched_info, 0, sizeof(p->sched_info));
+	p->nvcsw = 0;
+	p->nivcsw = 0;
+	p->sched_contributes_to_load = 0;
+	p->nr_migrations = 0;
+
+	/* ポリシーと優先度は親から引き継ぐ */
+	if (task_has_rt_policy(p))
+	{
+		p->sched_class = &rt_sched_class;
+	}
+	else
+	{
+		p->sched_class = &fair_sched_class;
+	}
+
+	/* vruntimeの基準は親のCPUのランキュー．置き先はwake_up_new_task()で選ぶ */
+	rq = this_rq_lock(&flags);
+	p->cpu = rq->cpu;
+	p->sched_class->task_fork(p);
+	task_rq_unlock(rq, flags);
+
+	/** 親から複製した再スケジュール要求は引き継がない
+	 * @note schedule()の途中（プリエンプト禁止とランキューのロックを持った状態）から開始したことにするため2にし，
+	 *       schedule_tail()で戻す
+	 */
+	clear_tsk_need_resched(p);
+	p->thread_info.preempt_count = 2;
+}
+
+/** fork直後のタスクを初めてランキューに登録する
+ * @param p 新しいタスク
+ * @details 親のCPUが埋まっていれば，空いているCPUに置く
+ */
+void wake_up_new_task(struct task_struct *p)
+{
+	struct rq *rq;
+	unsigned long flags;
+	int cpu;
+
+	rq = task_rq_lock(p, &flags);
+	p->__state = TASK_RUNNING;
+	cpu = select_task_rq(p);
+	if (cpu != task_cpu(p))
+	{
+		rq = migrate_unqueued_task(rq, p, cpu);
+		rq->lb_stats.wake_remote++;
+	}
+	activate_task(rq, p, 0);
+	check_preempt_curr(rq, p);
+	task_rq_unlock(rq, flags);
+}
+
+/** 眠っているタスクを起こす
+ * @param p     起こすタスク
+ * @param state 起こす対象の状態（p->__stateがこれに含まれなければ起こさない）
+ * @return 起こした場合は1，対象外の状態なら0
+ * @details ランキューに戻し，実行中のタスクより優先すべきなら再スケジュールを要求する．
+ *          眠ろうとしてまだランキューに残っている（schedule()前やプリエンプト中の）タスクは状態を戻すだけでよい．
+ *          戻すCPUはselect_task_rq()で選び直す．ただし切り替えの途中（on_cpu）のタスクは，
+ *          まだ元のCPUのスタックにいるため元のランキューに戻す
+ * @note 割り込みハンドラからも呼べる
+ */
+int try_to_wake_up(struct task_struct *p, unsigned int state)
+{
+	struct rq *rq;
+	unsigned long flags;
+	int success = 0;
+	int cpu;
+
+	rq = task_rq_lock(p, &flags);
+	if (!(p->__state & state))
+	{
+		goto out;
+	}
+
+	success = 1;
+	if (p->on_rq)
+	{
+		p->__state = TASK_RUNNING;
+		goto out;
+	}
+
+	if (p->sched_contributes_to_load)
+	{
+		rq->nr_uninterruptible--;
+		p->sched_contributes_to_load = 0;
+	}
+
+	/* 移し先のロックを取る間に，他から重ねて起こされないようにする */
+	p->__state = TASK_WAKING;
+	cpu = p->on_cpu ? task_cpu(p) : select_task_rq(p);
+	if (cpu != task_cpu(p))
+	{
+		rq = migrate_unqueued_task(rq, p, cpu);
+		rq->lb_stats.wake_remote++;
+	}
+	activate_task(rq, p, ENQUEUE_WAKEUP);
+	p->__state = TASK_RUNNING;
+	check_preempt_curr(rq, p);
+out:
+	task_rq_unlock(rq, flags);
+	return success;
+}
+
+/* 眠っているタスクを状態を問わず起こす */
+int wake_up_process(struct task_struct *p)
+{
+	return try_to_wake_up(p, TASK_NORMAL);
+}
+
+/* 実行可能なタスク数（全CPUの合計．アイドルタスクを除く） */
+unsigned long nr_running(void)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+	{
+		sum += READ_ONCE(cpu_rq(cpu)->nr_running);
+	}
+	return sum;
+}
+
+/* CPUの実行可能なタスク数（アイドルタスクを除く） */
+unsigned long nr_running_cpu(int cpu)
+{
+	return READ_ONCE(cpu_rq(cpu)->nr_running);
+}
+
+/** タスクのnice値を変更する
+ * @param p    対象のタスク
+ * @param nice 新しいnice値（MIN_NICE〜MAX_NICE）
+ * @details ランキューに登録中なら，負荷重みの合計が合うよう外してから重みを変えて戻す．
+ *          重みが増えたタスクは実行中のタスクを譲らせうる．実行中のタスクの重みが減れば再スケジュールを要求する
+ * @note Linux 6.18のset_user_nice()に相当する．vruntimeはそのまま引き継ぐ．
+ *       リアルタイムタスクはnice値を覚えておくだけで，SCHED_NORMALに戻ったときに効く
+ */
+void set_user_nice(struct task_struct *p, long nice)
+{
+	struct rq *rq;
+	unsigned long flags;
+	int queued, old_prio;
+
+	if (nice < MIN_NICE || nice > MAX_NICE || task_nice(p) == nice)
+	{
+		return;
+	}
+
+	rq = task_rq_lock(p, &flags);
+	if (task_has_rt_policy(p))
+	{
+		p->static_prio = NICE_TO_PRIO(nice);
+		set_load_weight(p);
+		task_rq_unlock(rq, flags);
+		return;
+	}
+
+	queued = p->on_rq;
+	if (queued)
+	{
+		p->sched_class->dequeue_task(rq, p, 0);
+	}
+
+	old_prio = p->static_prio;
+	p->static_prio = NICE_TO_PRIO(nice);
+	p->prio = p->static_prio;
+	set_load_weight(p);
+
+	if (queued)
+	{
+		p->sched_class->enqueue_task(rq, p, 0);
+		if (p == rq->curr)
+		{
+			if (p->static_prio > old_prio)
+			{
+				resched_curr(rq);
+			}
+		}
+		else if (p->static_prio < old_prio)
+		{
+			check_preempt_curr(rq, p);
+		}
+	}
+	task_rq_unlock(rq, flags);
+}
+
+/** setpriority()/getpriority()の対象のタスクを求め，参照を得る
+ * @return タスク，見つからなければNULL．使い終わったらput_task_struct()する
+ * @note 使う間に他のCPUで終了・回収されないよう参照を持つ
+ */
+static struct task_struct *find_prio_task(int who)
+{
+	if (who == 0)
+	{
+		get_task_struct(current);
+		return current;
+	}
+	return find_get_task_by_pid(who);
+}
+
+/** タスクのnice値を変更する
+ * @param which   PRIO_PROCESSのみ
+ * @param who     PID（0なら現在のタスク）
+ * @param niceval 新しいnice値（範囲外はMIN_NICE〜MAX_NICEに丸める）
+ * @return 成功時0，whichが不正なら-EINVAL，タスクがなければ-ESRCH，
+ *         CAP_SYS_NICEを持たずにnice値を下げようとしたら-EACCES
+ * @note Linux 6.18のsys_setpriority()に相当する（プロセスグループとユーザーは未対応）
+ */
+int setpriority(int which, int who, int niceval)
+{
+	struct task_struct *p;
+	int ret = 0;
+
+	if (which != PRIO_PROCESS)
+	{
+		return -EINVAL;
+	}
+	if (niceval < MIN_NICE)
+	{
+		niceval = MIN_NICE;
+	}
+	if (niceval > MAX_NICE)
+	{
+		niceval = MAX_NICE;
+	}
+
+	p = find_prio_task(who);
+	if (p == NULL)
+	{
+		return -ESRCH;
+	}
+	if (niceval < task_nice(p) && !capable(CAP_SYS_NICE))
+	{
+		ret = -EACCES;
+	}
+	else
+	{
+		set_user_nice(p, niceval);
+	}
+	put_task_struct(p);
+	return ret;
+}
+
+/** タスクのnice値を取得する
+ * @param which PRIO_PROCESSのみ
+ * @param who   PID（0なら現在のタスク）
+ * @return 20 - nice値（1〜40），whichが不正なら-EINVAL，タスクがなければ-ESRCH
+ * @note 負のnice値とエラーを区別するため，Linuxのsys_getpriority()と同じく20 - niceを返す
+ */
+int getpriority(int which, int who)
+{
+	struct task_struct *p;
+	int nice;
+
+	if (which != PRIO_PROCESS)
+	{
+		return -EINVAL;
+	}
+	p = find_prio_task(who);
+	if (p == NULL)
+	{
+		return -ESRCH;
+	}
+	nice = task_nice(p);
+	put_task_struct(p);
+	return 20 - nice;
+}
+
+/** タスクの実行してよいCPUを変える
+ * @param p        対象のタスク
+ * @param new_mask 実行してよいCPUのビットマップ
+ * @return 成功時0，起動済みのCPUを1つも含まなければ-EINVAL
+ * @details 今のCPUが許されなくなったとき，ランキューで待っているタスクはすぐに移し，
+ *          実行中のタスクは再スケジュールを要求して，schedule()で外してから送り出す．
+ *          眠っているタスクは起床時に許されたCPUへ置かれる
+ * @note Linux 2.6.11のset_cpus_allowed()に相当する（移動はmigrationスレッドではなくschedule()が行う）
+ */
+int set_cpus_allowed(struct task_struct *p, unsigned long new_mask)
+{
+	struct rq *rq;
+	unsigned long flags;
+
+	if (!(new_mask & cpu_online_map))
+	{
+		return -EINVAL;
+	}
+
+	rq = task_rq_lock(p, &flags);
+	p->cpus_allowed = new_mask;
+	if (cpu_allowed(p, task_cpu(p)))
+	{
+		goto out;
+	}
+
+	if (task_running(rq, p))
+	{
+		resched_curr(rq);
+	}
+	else if (p->on_rq)
+	{
+		struct rq *dst_rq = cpu_rq(select_task_rq(p));
+
+		if (dst_rq != rq)
+		{
+			/* ロックを取り直す間に移されたり実行されたりしていれば，schedule()や起床時の選択に任せる */
+			double_lock_balance(rq, dst_rq);
+			if (task_rq(p) == rq && p->on_rq && !task_running(rq, p))
+			{
+				move_queued_task(rq, p, dst_rq);
+			}
+			spin_unlock(&dst_rq->lock);
+		}
+	}
+out:
+	task_rq_unlock(rq, flags);
+	return 0;
+}
+
+/** タスクの実行してよいCPUを変える
+ * @param pid  対象のPID（0なら現在のタスク）
+ * @param mask 実行してよいCPUのビットマップ
+ * @return 成功時0，タスクがなければ-ESRCH，起動済みのCPUを含まなければ-EINVAL，
+ *         CAP_SYS_NICEを持たずに他のユーザーのタスクを変えようとしたら-EPERM
+ * @note Linux 6.18のsys_sched_setaffinity()に相当する（マスクは1ワード）
+ */
+int sched_setaffinity(pid_t pid, unsigned long mask)
+{
+	struct task_struct *p = find_prio_task(pid);
+	int ret;
+
+	if (p == NULL)
+	{
+		return -ESRCH;
+	}
+	if (p->euid.val != current->euid.val && !capable(CAP_SYS_NICE))
+	{
+		ret = -EPERM;
+	}
+	else
+	{
+		ret = set_cpus_allowed(p, mask);
+	}
+	put_task_struct(p);
+	return ret;
+}
+
+/** タスクの実行してよいCPUを取得する
+ * @param pid  対象のPID（0なら現在のタスク）
+ * @param mask 起動済みのCPUに限ったビットマップの格納先
+ * @return 成功時0，タスクがなければ-ESRCH
+ */
+int sched_getaffinity(pid_t pid, unsigned long *mask)
+{
+	struct task_struct *p = find_prio_task(pid);
+
+	if (p == NULL)
+	{
+		return -ESRCH;
+	}
+	*mask = p->cpus_allowed & cpu_online_map;
+	put_task_struct(p);
+	return 0;
+}
+
+/** タスクのスケジューリングポリシーと優先度を変更する
+ * @param p      対象のタスク
+ * @param policy SCHED_NORMAL，SCHED_FIFO，SCHED_RRのいずれか
+ * @param param  SCHED_FIFO/SCHED_RRでは1〜MAX_USER_RT_PRIO-1（大きいほど優先），SCHED_NORMALでは0
+ * @return 成功時0，引数が不正なら-EINVAL，CAP_SYS_NICEを持たずにリアルタイムにしようとしたら-EPERM
+ * @details ランキューに登録中なら古いクラスから外して新しいクラスに登録し直す．
+ *          実行中のタスクなら再スケジュールを要求し，そうでなければ実行中のタスクを譲らせるか判定する
+ * @note Linux 6.18のsched_setscheduler()に相当する（SCHED_BATCH/SCHED_IDLE/SCHED_DEADLINEは未対応）
+ */
+int sched_setscheduler(struct task_struct *p, int policy, const struct sched_param *param)
+{
+	struct rq *rq;
+	const struct sched_class *prev_class;
+	unsigned long flags;
+	int queued;
+
+	if (param == NULL || (policy != SCHED_NORMAL && !rt_policy(policy)))
+	{
+		return -EINVAL;
+	}
+	if (param->sched_priority < 0 || param->sched_priority > MAX_USER_RT_PRIO - 1 ||
+		rt_policy(policy) != (param->sched_priority != 0))
+	{
+		return -EINVAL;
+	}
+	if (rt_policy(policy) && !capable(CAP_SYS_NICE))
+	{
+		return -EPERM;
+	}
+
+	rq = task_rq_lock(p, &flags);
+	queued = p->on_rq;
+	if (queued)
+	{
+		p->sched_class->dequeue_task(rq, p, 0);
+	}
+	if (p == rq->curr)
+	{
+		p->sched_class->put_prev_task(rq, p);
+	}
+
+	prev_class = p->sched_class;
+	p->policy = (unsigned int)policy;
+	p->rt_priority = (unsigned int)param->sched_priority;
+	if (rt_policy(policy))
+	{
+		p->prio = MAX_RT_PRIO - 1 - param->sched_priority;
+		p->sched_class = &rt_sched_class;
+	}
+	else
+	{
+		p->prio = p->static_prio;
+		p->sched_class = &fair_sched_class;
+	}
+	if (p->sched_class != prev_class)
+	{
+		/* 新しいクラスでの初期値（vruntime，タイムスライス）はfork直後と同じく決める */
+		p->sched_class->task_fork(p);
+	}
+
+	if (queued)
+	{
+		p->sched_class->enqueue_task(rq, p, 0);
+		if (p == rq->curr)
+		{
+			resched_curr(rq);
+		}
+		else
+		{
+			check_preempt_curr(rq, p);
+		}
+	}
+	task_rq_unlock(rq, flags);
+	return 0;
+}
+
+/** タイマー割り込みごとに呼ばれる
+ * @details ランキュー時刻を1 tick進め，実行中タスクの実行時間を計上する．
+ *          タイムスライスを使い切ったタスクやアイドルタスクには再スケジュールを要求する．
+ *          最後に，間隔が来ていれば他のCPUとの負荷分散を行う
+ * @note 各CPUが自分のランキューについて呼ぶ
+ */
+void scheduler_tick(void)
+{
+	struct rq *rq;
+	struct task_struct *curr;
+	unsigned long flags;
+
+	rq = this_rq_lock(&flags);
+	curr = rq->curr;
+	rq->clock += TICK_NSEC;
+	sched_rt_period_tick(rq);
+	calc_global_load_tick(rq);
+
+	if (curr != rq->idle)
+	{
+		curr->sched_class->task_tick(rq, curr);
+	}
+	else if (rq->nr_running)
+	{
+		resched_curr(rq);
+	}
+	spin_unlock(&rq->lock);
+
+	trigger_load_balance(rq);
+	local_irq_restore(flags);
+}
+
+/* 起動からのコンテキストスイッチの回数（全CPUの合計） */
+unsigned long nr_context_switches(void)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+	{
+		sum += READ_ONCE(cpu_rq(cpu)->nr_switches);
+	}
+	return sum;
+}
+
+/** 起動からの時間
+ * @return jiffiesを進めるCPU 0のランキュー時刻（ナノ秒）
+ * @note tickとnohzから戻ったときに進むため，精度は1 tick
+ */
+uint64_t running_clock(void)
+{
+	return cpu_rq(0)->clock;
+}
+
+/** アイドルタスクが実行していた時間の合計
+ * @return 全CPUの合計（ナノ秒．いまアイドル中のCPUは，今回アイドルに入ってからの分も含む）
+ * @note 他のCPUのランキューはロックを取らずに読むため，目安
+ */
+uint64_t get_idle_time(void)
+{
+	uint64_t idle = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+	{
+		struct rq *rq = cpu_rq(cpu);
+
+		idle += rq->idle_time;
+		if (rq->curr == rq->idle)
+		{
+			idle += rq->clock - rq->idle->sched_info.last_arrival;
+		}
+	}
+	return idle;
+}
+
+/** nohzのidleで止まっていた分のtickを進める
+ * @param ticks 止まっていたtickの数
+ * @details 実行可能なタスクはいないため，ランキュー時刻を進めて負荷平均に畳み込むだけでよい．
+ *          進めた時間はアイドルタスクの実行時間としてアイドル時間に入る
+ * @note tick_nohz_idle_exit()から呼ばれる
+ */
+void scheduler_idle_ticks(unsigned long ticks)
+{
+	struct rq *rq;
+	unsigned long flags;
+
+	rq = this_rq_lock(&flags);
+	rq->clock += (uint64_t)ticks * TICK_NSEC;
+	sched_rt_period_tick(rq);
+	calc_global_load_tick(rq);
+	task_rq_unlock(rq, flags);
+}
+
+/** 自CPUのtickを止めてよいか
+ * @return 自CPUに実行可能なタスクがなければ1．
+ *         ただしjiffiesと負荷平均を進めるCPU 0は，他のCPUにもなくなるまで0
+ * @note tick_nohz_idle_enter()から割り込み禁止で呼ばれる
+ */
+int sched_can_stop_tick(void)
+{
+	int cpu = smp_processor_id();
+
+	if (nr_running_cpu(cpu))
+	{
+		return 0;
+	}
+	return cpu != 0 || nr_running() == 0;
+}
+
+/* CPUの負荷分散の統計を取得する */
+void sched_get_lb_stats(int cpu, struct sched_lb_stats *stats)
+{
+	*stats = cpu_rq(cpu)->lb_stats;
+}
+
+/* ========== コンテキストスイッチ ========== */
+
+/** 切り替え後の後処理
+ * @param prev 直前まで実行していたタスク
+ * @details ここで切り替え元のスタックから完全に降りているため，切り替え元のon_cpuを下ろし，
+ *          schedule()から持ち越したランキューのロックを解放する．
+ *          アフィニティで許されなくなった切り替え元は，ここで許されたCPUへ送り出す．
+ *          切り替え元が終了したタスクなら，実行中の間持っていた参照を外す（最後の参照ならreaperに回る）．
+ *          切り替え元がカーネルスレッドなら，借りていたmmの参照を外す（もうCR3には載っていない）
+ * @note 状態は切り替え元が実行中の間に読んでおく．on_cpuを下ろした後は他のCPUで回収されうる
+ */
+static void finish_task_switch(struct task_struct *prev)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *push = rq->push_task;
+	struct mm_struct *mm = rq->prev_mm;
+	unsigned int prev_state = prev->__state;
+
+	rq->push_task = NULL;
+	rq->prev_mm = NULL;
+	prev->on_cpu = 0;
+	spin_unlock(&rq->lock);
+
+	if (unlikely(push))
+	{
+		push_disallowed_task(push);
+	}
+	if (mm)
+	{
+		mmdrop(mm);
+	}
+	if (unlikely(prev_state == TASK_DEAD))
+	{
+		put_task_struct(prev);
+	}
+}
+
+/** アドレス空間とレジスタを切り替える
+ * @param rq   ランキュー
+ * @param prev 現在実行中のタスク
+ * @param next 次に実行するタスク
+ * @details mmを持たないカーネルスレッドは直前のタスクのmmを借りる（lazy TLB）．
+ *          これによりカーネルスレッドへの切り替えではCR3を書き換えずTLBを保てる．
+ *          借りている間はmmgrab()で参照を持ち，元の持ち主が終了してもページディレクトリを解放させない
+ * @note switch_to()から戻るのは，prevが再びスケジュールされたとき
+ */
+static void context_switch(struct rq *rq, struct task_struct *prev, struct task_struct *next)
+{
+	struct mm_struct *oldmm = prev->active_mm;
+
+	if (!next->mm)
+	{
+		next->active_mm = oldmm;
+		if (oldmm)
+		{
+			mmgrab(oldmm);
+		}
+	}
+	else
+	{
+		switch_mm(oldmm, next->mm);
+		next->active_mm = next->mm;
+	}
+
+	/* カーネルスレッドが借りていたmmは，CR3から降りた後（finish_task_switch()）で返す */
+	if (!prev->mm)
+	{
+		rq->prev_mm = oldmm;
+		prev->active_mm = NULL;
+	}
+
+	next->on_cpu = 1;
+	switch_to(prev, next, prev);
+
+	finish_task_switch(prev);
+}
+
+/** 新しいタスクが初めて実行されるときの後処理
+ * @param prev 直前まで実行していたタスク
+ * @details 切り替え元の後処理（ランキューのロックの解放を含む）をし，
+ *          schedule()で禁止した割り込みとプリエンプションを許可する．
+ *          新しいタスクはschedule()の途中から再開しないため，ここで肩代わりする．
+ * @note arch/i386/kernel/entry.Sのret_from_forkから呼ばれる
+ */
+asmlinkage void schedule_tail(struct task_struct *prev)
+{
+	finish_task_switch(prev);
+	local_irq_enable();
+	preempt_enable();
+}
+
+/** 次に実行するタスクを選んで切り替える
+ * @details 実行中のタスクがTASK_RUNNINGでなければランキューから外し，
+ *          スケジューリングクラスに問い合わせて次のタスクを選ぶ．
+ *          実行可能なタスクがなければ，他のCPUから引き取ってから（idle_balance()）アイドルタスクに戻る．
+ *          プリエンプトされた場合（PREEMPT_ACTIVE）は，眠りかけていてもランキューに残す．
+ *          実行可能なままアフィニティで許されなくなったタスクは外しておき，切り替え後に送り出す
+ * @note Linux 2.6.11のschedule()に相当する．割り込みとプリエンプションを禁止し，
+ *       ランキューのロックを持ったまま切り替える（解放は切り替え先のfinish_task_switch()）
+ */
+void schedule(void)
+{
+	struct rq *rq;
+	struct task_struct *prev;
+	struct task_struct *next;
+	unsigned long *switch_count;
+	unsigned long flags;
+
+need_resched:
+	preempt_disable();
+	rq = this_rq();
+	local_irq_save(flags);
+	spin_lock(&rq->lock);
+
+	prev = rq->curr;
+	switch_count = &prev->nivcsw;
+	if (prev != rq->idle && prev->__state != TASK_RUNNING && !(preempt_count() & PREEMPT_ACTIVE))
+	{
+		prev->sched_contributes_to_load = (prev->__state & TASK_UNINTERRUPTIBLE) != 0;
+		if (prev->sched_contributes_to_load)
+		{
+			rq->nr_uninterruptible++;
+		}
+		deactivate_task(rq, prev, DEQUEUE_SLEEP);
+		switch_count = &prev->nvcsw;
+	}
+	else if (prev != rq->idle && prev->__state == TASK_RUNNING && !cpu_allowed(prev, rq->cpu) &&
+			 (prev->cpus_allowed & cpu_online_map))
+	{
+		deactivate_task(rq, prev, 0);
+		rq->push_task = prev;
+	}
+	clear_tsk_need_resched(prev);
+
+	if (unlikely(!rq->nr_running))
+	{
+		idle_balance(rq);
+	}
+
+	next = __pick_next_task(rq);
+	if (next != prev)
+	{
+		rq->nr_switches++;
+		++*switch_count;
+		context_switch(rq, prev, next);
+	}
+	else
+	{
+		spin_unlock(&rq->lock);
+	}
+
+	local_irq_restore(flags);
+	preempt_enable_no_resched();
+	if (unlikely(need_resched()))
+	{
+		goto need_resched;
+	}
+}
+
+/** preempt_enable()から呼ばれるプリエンプション
+ * @details プリエンプト禁止中や割り込み禁止中なら何もしない
+ * @note Linux 2.6.11のpreempt_schedule()に相当する
+ */
+void preempt_schedule(void)
+{
+	if (likely(preempt_count() || irqs_disabled()))
+	{
+		return;
+	}
+
+	do
+	{
+		add_preempt_count(PREEMPT_ACTIVE);
+		schedule();
+		sub_preempt_count(PREEMPT_ACTIVE);
+		barrier();
+	} while (unlikely(need_resched()));
+}
+
+/** 割り込みからの復帰時に呼ばれるプリエンプション
+ * @details 割り込み禁止で呼ばれ，割り込み禁止で戻る
+ * @note arch/i386/kernel/entry.Sのret_from_intrから，preempt_countが0で割り込まれた文脈のIFが
+ *       立っているときだけ呼ばれる．Linux 2.6.11のpreempt_schedule_irq()に相当する
+ */
+asmlinkage void preempt_schedule_irq(void)
+{
+	do
+	{
+		add_preempt_count(PREEMPT_ACTIVE);
+		local_irq_enable();
+		schedule();
+		local_irq_disable();
+		sub_preempt_count(PREEMPT_ACTIVE);
+		barrier();
+	} while (unlikely(need_resched()));
 }
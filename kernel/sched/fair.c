@@ -0,0 +1,680 @@
+/** CFS（Completely Fair Scheduler）
+ * - Linux 6.18のkernel/sched/fair.cに相当（グループスケジューリングなし）
+ * - 実行可能タスクをvruntime順のrb-treeに並べ，最もvruntimeが小さいタスクを選ぶ
+ */
+
+#include <asm-i386/bitops.h>
+#include <asm-i386/div64.h>
+#include <kfs/compiler.h>
+#include <kfs/math64.h>
+#include <kfs/rbtree.h>
+#include <kfs/sched.h>
+#include <kfs/stddef.h>
+
+#include "sched.h"
+
+/** スケジューリングレイテンシ（ナノ秒）
+ * @note 起床タスクはmin_vruntimeからこの半分まで遡った位置に置かれる（スリープ中の補償）
+ */
+#define SCHED_LATENCY_NS 6000000ULL
+
+/* タイムスライスの下限（ナノ秒）．これより短い間隔では切り替えない */
+#define SCHED_MIN_GRANULARITY_NS 750000ULL
+
+/* 起床タスクが実行中のタスクをプリエンプトするのに必要なvruntimeの差（ナノ秒） */
+#define SCHED_WAKEUP_GRANULARITY_NS 1000000ULL
+
+/* sched_entityから含むtask_structを取得する */
+static inline struct task_struct *task_of(struct sched_entity *se)
+{
+	return container_of(se, struct task_struct, se);
+}
+
+/* cfs_rqを含むランキューを取得する */
+static inline struct rq *rq_of(struct cfs_rq *cfs_rq)
+{
+	return container_of(cfs_rq, struct rq, cfs);
+}
+
+/** vruntimeを比較する
+ * @return aがbより前ならば非0
+ * @note 64ビットのラップアラウンドを考慮して差の符号で比較する
+ */
+static inline int entity_before(const struct sched_entity *a, const struct sched_entity *b)
+{
+	return (int64_t)(a->vruntime - b->vruntime) < 0;
+}
+
+static inline uint64_t max_vruntime(uint64_t max_vruntime, uint64_t vruntime)
+{
+	if ((int64_t)(vruntime - max_vruntime) > 0)
+	{
+		max_vruntime = vruntime;
+	}
+	return max_vruntime;
+}
+
+static inline uint64_t min_vruntime(uint64_t min_vruntime, uint64_t vruntime)
+{
+	if ((int64_t)(vruntime - min_vruntime) < 0)
+	{
+		min_vruntime = vruntime;
+	}
+	return min_vruntime;
+}
+
+/** 負荷重みの逆数を用意する
+ * @note テストなどでweightだけを書き換えた重みは，最初に使うときに1度だけ除算して求める（weightは0不可）
+ */
+static void __update_inv_weight(struct load_weight *lw)
+{
+	if (likely(lw->inv_weight))
+	{
+		return;
+	}
+	if (lw->weight == 1)
+	{
+		lw->inv_weight = WMULT_CONST; /* 2^32は32ビットに収まらない */
+		return;
+	}
+	/* sched_prio_to_wmultと同じく，2^32/weightを四捨五入する */
+	lw->inv_weight = (uint32_t)div_u64((1ULL << WMULT_SHIFT) + lw->weight / 2, lw->weight);
+}
+
+/** delta * weight / lw->weightを除算なしで求める
+ * @param delta  実行時間（ナノ秒）
+ * @param weight 掛ける重み
+ * @param lw     割る重み
+ * @details lw->inv_weight（2^32/lw->weight）を掛けて32ビット右シフトする．
+ *          weight * inv_weightが32ビットを超える分はシフト量から差し引き，積が64ビットに収まるようにする
+ * @see Linux 6.18: kernel/sched/fair.c __calc_delta()
+ */
+static uint64_t __calc_delta(uint64_t delta, unsigned long weight, struct load_weight *lw)
+{
+	uint64_t fact;
+	uint32_t fact_hi;
+	int shift = WMULT_SHIFT;
+
+	__update_inv_weight(lw);
+
+	fact = (uint64_t)(uint32_t)weight * lw->inv_weight;
+	fact_hi = (uint32_t)(fact >> 32);
+	if (fact_hi)
+	{
+		int fs = (int)__fls(fact_hi) + 1;
+
+		shift -= fs;
+		fact >>= fs;
+	}
+	return mul_u64_u32_shr(delta, (uint32_t)fact, shift);
+}
+
+/** 実行時間を負荷重みで仮想実行時間に換算する
+ * @param delta 実行時間（ナノ秒）
+ * @param se    対象エンティティ
+ * @return delta * NICE_0_LOAD / se->load.weight
+ * @note tickごとに呼ばれるため，除算ではなく逆数との乗算で求める
+ */
+static uint64_t calc_delta_fair(uint64_t delta, struct sched_entity *se)
+{
+	if (se->load.weight == NICE_0_LOAD || se->load.weight == 0)
+	{
+		return delta;
+	}
+	return __calc_delta(delta, NICE_0_LOAD, &se->load);
+}
+
+/** min_vruntimeを更新する
+ * @details 実行中エンティティと最左エンティティのvruntimeの小さい方に追従させる．
+ *          ただし単調増加を保つ（後退させない）．
+ */
+static void update_min_vruntime(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *curr = cfs_rq->curr;
+	struct rb_node *leftmost = rb_first_cached(&cfs_rq->tasks_timeline);
+	uint64_t vruntime = cfs_rq->min_vruntime;
+
+	if (curr)
+	{
+		vruntime = curr->vruntime;
+	}
+
+	if (leftmost)
+	{
+		struct sched_entity *se = rb_entry(leftmost, struct sched_entity, run_node);
+
+		if (!curr)
+		{
+			vruntime = se->vruntime;
+		}
+		else
+		{
+			vruntime = min_vruntime(vruntime, se->vruntime);
+		}
+	}
+
+	cfs_rq->min_vruntime = max_vruntime(cfs_rq->min_vruntime, vruntime);
+}
+
+/** 実行中エンティティの実行時間を計上する
+ * @details 前回計上からの経過時間をsum_exec_runtimeに加え，
+ *          重み付けした値をvruntimeに加える
+ */
+static void update_curr(struct cfs_rq *cfs_rq)
+{
+	struct sched_entity *curr = cfs_rq->curr;
+	uint64_t now = rq_of(cfs_rq)->clock;
+	int64_t delta_exec;
+
+	if (!curr)
+	{
+		return;
+	}
+
+	delta_exec = (int64_t)(now - curr->exec_start);
+	if (delta_exec <= 0)
+	{
+		return;
+	}
+
+	curr->exec_start = now;
+	curr->sum_exec_runtime += (uint64_t)delta_exec;
+	curr->vruntime += calc_delta_fair((uint64_t)delta_exec, curr);
+	update_min_vruntime(cfs_rq);
+}
+
+/** エンティティをrb-treeに挿入する
+ * @note 同じvruntimeのエンティティは後から入れた方が右に並ぶ（FIFO）
+ */
+static void __enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	struct rb_node **link = &cfs_rq->tasks_timeline.rb_root.rb_node;
+	struct rb_node *parent = NULL;
+	int leftmost = 1;
+
+	while (*link)
+	{
+		struct sched_entity *entry;
+
+		parent = *link;
+		entry = rb_entry(parent, struct sched_entity, run_node);
+		if (entity_before(se, entry))
+		{
+			link = &parent->rb_left;
+		}
+		else
+		{
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+
+	rb_link_node(&se->run_node, parent, link);
+	rb_insert_color_cached(&se->run_node, &cfs_rq->tasks_timeline, leftmost);
+}
+
+/* エンティティをrb-treeから外す */
+static void __dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	rb_erase_cached(&se->run_node, &cfs_rq->tasks_timeline);
+	RB_CLEAR_NODE(&se->run_node);
+}
+
+/** 起床するエンティティのvruntimeを決める
+ * @details 長くスリープしていたエンティティが他を長時間締め出さないよう，
+ *          min_vruntimeからSCHED_LATENCY_NS/2だけ遡った位置より前には置かない
+ */
+static void place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	uint64_t vruntime = cfs_rq->min_vruntime - SCHED_LATENCY_NS / 2;
+
+	se->vruntime = max_vruntime(se->vruntime, vruntime);
+}
+
+/* CFSランキューを初期化する */
+void init_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	cfs_rq->tasks_timeline = RB_ROOT_CACHED;
+	cfs_rq->load = 0;
+	cfs_rq->nr_running = 0;
+	cfs_rq->min_vruntime = 0;
+	cfs_rq->curr = NULL;
+}
+
+/** タスクをCFSランキューに登録する
+ * @param rq    ランキュー
+ * @param p     登録するタスク
+ * @param flags ENQUEUE_WAKEUPなら起床位置を調整する
+ */
+static void enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *se = &p->se;
+
+	if (se->on_rq)
+	{
+		return;
+	}
+
+	update_curr(cfs_rq);
+
+	if (flags & ENQUEUE_WAKEUP)
+	{
+		place_entity(cfs_rq, se);
+	}
+
+	if (se != cfs_rq->curr)
+	{
+		__enqueue_entity(cfs_rq, se);
+	}
+	se->on_rq = 1;
+	cfs_rq->load += se->load.weight;
+	cfs_rq->nr_running++;
+}
+
+/** タスクをCFSランキューから外す
+ * @param rq    ランキュー
+ * @param p     外すタスク
+ * @param flags 未使用（DEQUEUE_SLEEP等）
+ */
+static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *se = &p->se;
+
+	(void)flags;
+
+	if (!se->on_rq)
+	{
+		return;
+	}
+
+	update_curr(cfs_rq);
+
+	if (se != cfs_rq->curr)
+	{
+		__dequeue_entity(cfs_rq, se);
+	}
+	se->on_rq = 0;
+	cfs_rq->load -= se->load.weight;
+	cfs_rq->nr_running--;
+	update_min_vruntime(cfs_rq);
+}
+
+/** 次に実行するタスクを選ぶ
+ * @param rq ランキュー
+ * @return 最小vruntimeのタスク，CFSに実行可能タスクがなければNULL
+ * @note 選んだエンティティはrb-treeから外してcurrにする（O(log n)）
+ */
+static struct task_struct *pick_next_task_fair(struct rq *rq)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct rb_node *left = rb_first_cached(&cfs_rq->tasks_timeline);
+	struct sched_entity *se;
+
+	if (!left)
+	{
+		return NULL;
+	}
+
+	se = rb_entry(left, struct sched_entity, run_node);
+	__dequeue_entity(cfs_rq, se);
+	se->exec_start = rq->clock;
+	se->prev_sum_exec_runtime = se->sum_exec_runtime;
+	cfs_rq->curr = se;
+
+	return task_of(se);
+}
+
+/** 実行を終えるタスクの後始末をする
+ * @param rq ランキュー
+ * @param p  直前まで実行していたタスク
+ * @note 実行可能なままなら，更新したvruntimeでrb-treeに戻す
+ */
+static void put_prev_task_fair(struct rq *rq, struct task_struct *p)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *se = &p->se;
+
+	if (cfs_rq->curr != se)
+	{
+		return;
+	}
+
+	update_curr(cfs_rq);
+	if (se->on_rq)
+	{
+		__enqueue_entity(cfs_rq, se);
+	}
+	cfs_rq->curr = NULL;
+}
+
+/** エンティティに割り当てるタイムスライスを求める
+ * @return SCHED_LATENCY_NSを負荷重みの比で分けた時間（SCHED_MIN_GRANULARITY_NS以上）
+ * @note タスクが多く下限を下回る場合は，周期を延ばして全員が下限分は実行できるようにする
+ */
+static uint64_t sched_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	uint64_t period = SCHED_LATENCY_NS;
+	uint64_t slice;
+
+	if (cfs_rq->nr_running * SCHED_MIN_GRANULARITY_NS > period)
+	{
+		period = cfs_rq->nr_running * SCHED_MIN_GRANULARITY_NS;
+	}
+
+	if (cfs_rq->load == 0)
+	{
+		return period;
+	}
+	slice = period * se->load.weight;
+	do_div(slice, cfs_rq->load);
+	return slice;
+}
+
+/** 実行中のエンティティがタイムスライスを使い切ったか判定する
+ * @details スライスを使い切ったか，最左エンティティとのvruntimeの差がスライスを超えたら再スケジュールを要求する
+ */
+static void check_preempt_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr)
+{
+	uint64_t ideal_runtime = sched_slice(cfs_rq, curr);
+	uint64_t delta_exec = curr->sum_exec_runtime - curr->prev_sum_exec_runtime;
+	struct rb_node *left;
+	struct sched_entity *se;
+	int64_t delta;
+
+	if (delta_exec > ideal_runtime)
+	{
+		resched_curr(rq_of(cfs_rq));
+		return;
+	}
+
+	if (delta_exec < SCHED_MIN_GRANULARITY_NS)
+	{
+		return;
+	}
+
+	left = rb_first_cached(&cfs_rq->tasks_timeline);
+	if (!left)
+	{
+		return;
+	}
+	se = rb_entry(left, struct sched_entity, run_node);
+	delta = (int64_t)(curr->vruntime - se->vruntime);
+	if (delta > (int64_t)ideal_runtime)
+	{
+		resched_curr(rq_of(cfs_rq));
+	}
+}
+
+/* タイマー割り込みごとに実行中タスクの実行時間を計上し，タイムスライスを確認する */
+static void task_tick_fair(struct rq *rq, struct task_struct *p)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+
+	(void)p;
+	update_curr(cfs_rq);
+
+	if (cfs_rq->curr && cfs_rq->nr_running > 1)
+	{
+		check_preempt_tick(cfs_rq, cfs_rq->curr);
+	}
+}
+
+/** 起床したタスクが実行中のタスクをプリエンプトすべきか判定する
+ * @details 実行中のタスクのvruntimeが起床タスクよりSCHED_WAKEUP_GRANULARITY_NS以上進んでいれば譲らせる．
+ *          粒度を設けることで，起床のたびに切り替わってキャッシュを失うのを防ぐ
+ */
+static void check_preempt_wakeup(struct rq *rq, struct task_struct *p)
+{
+	struct cfs_rq *cfs_rq = &rq->cfs;
+	struct sched_entity *curr = cfs_rq->curr;
+
+	if (!curr)
+	{
+		return;
+	}
+
+	update_curr(cfs_rq);
+	if ((int64_t)(curr->vruntime - p->se.vruntime) > (int64_t)SCHED_WAKEUP_GRANULARITY_NS)
+	{
+		resched_curr(rq);
+	}
+}
+
+/** fork直後のタスクのvruntimeを決める
+ * @details 親（実行中のエンティティ）のvruntimeを引き継ぎ，min_vruntimeより前には置かない．
+ *          これにより，forkを繰り返してCPU時間を独占することはできない．
+ * @note pのCPU（forkでは親のCPU）のランキューのロックを持って呼ぶ
+ */
+static void task_fork_fair(struct task_struct *p)
+{
+	struct cfs_rq *cfs_rq = &task_rq(p)->cfs;
+	struct sched_entity *se = &p->se;
+
+	update_curr(cfs_rq);
+	se->vruntime = cfs_rq->curr ? cfs_rq->curr->vruntime : cfs_rq->min_vruntime;
+	se->vruntime = max_vruntime(se->vruntime, cfs_rq->min_vruntime);
+}
+
+/* ========== 負荷分散 ========== */
+
+/** 移すタスクを探すときに見るタスク数の上限
+ * @note ロックを2つ持ったままrb-treeをたどるため，長いランキューでも待たせすぎないよう打ち切る
+ * @see Linux 6.18: sysctl_sched_nr_migrate
+ */
+#define SCHED_NR_MIGRATE 32
+
+/** 最も負荷の大きいランキューを探す
+ * @param this_rq 自CPUのランキュー
+ * @return 自CPUより負荷重みの合計が大きく，待っているタスクがあるランキュー（なければNULL）
+ * @note ロックを取らずに読むため目安．移す前にロックを取って確かめ直す
+ */
+static struct rq *find_busiest_queue(struct rq *this_rq)
+{
+	struct rq *busiest = NULL;
+	unsigned long max_load = READ_ONCE(this_rq->cfs.load);
+	int cpu;
+
+	for_each_online_cpu(cpu)
+	{
+		struct rq *rq = cpu_rq(cpu);
+		unsigned long load;
+
+		if (rq == this_rq || READ_ONCE(rq->nr_running) < 2 || READ_ONCE(rq->cfs.nr_running) == 0)
+		{
+			continue;
+		}
+		load = READ_ONCE(rq->cfs.load);
+		if (load > max_load)
+		{
+			max_load = load;
+			busiest = rq;
+		}
+	}
+	return busiest;
+}
+
+/** 引き取るタスクを選ぶ
+ * @param busiest 移し元のランキュー
+ * @param this_rq 移し先のランキュー
+ * @param idle    移し先がアイドルになるところか
+ * @return 移し先で実行してよく，実行中でないタスクのうち最も重いもの（なければNULL）
+ * @details アイドルなら待っているタスクは何でも引き取る．忙しければ，移した後も移し先の方が軽いままでいられる
+ *          （重みが負荷の差より小さい）タスクだけを引き取り，2つのCPUの間でタスクが行き来し続けないようにする
+ * @note 両方のランキューのロックを持って呼ぶ
+ */
+static struct task_struct *pick_migrate_task(struct rq *busiest, struct rq *this_rq, int idle)
+{
+	struct task_struct *best = NULL;
+	unsigned long imbalance = 0;
+	struct rb_node *node;
+	int scanned = 0;
+
+	if (!idle)
+	{
+		if (busiest->cfs.load <= this_rq->cfs.load)
+		{
+			return NULL;
+		}
+		imbalance = busiest->cfs.load - this_rq->cfs.load;
+	}
+
+	for (node = rb_first_cached(&busiest->cfs.tasks_timeline); node && scanned < SCHED_NR_MIGRATE;
+		 node = rb_next(node), scanned++)
+	{
+		struct task_struct *p = task_of(rb_entry(node, struct sched_entity, run_node));
+
+		if (!cpu_allowed(p, this_rq->cpu) || task_running(busiest, p) || p->on_cpu)
+		{
+			continue;
+		}
+		if (!idle && p->se.load.weight >= imbalance)
+		{
+			continue;
+		}
+		if (!best || p->se.load.weight > best->se.load.weight)
+		{
+			best = p;
+		}
+	}
+	return best;
+}
+
+/** 最も負荷の大きいCPUからタスクを1つ引き取る
+ * @param this_rq 自CPUのランキュー（ロックを持っている）
+ * @param idle    自CPUがアイドルになるところか（idle_balance()）
+ * @return 引き取れば1
+ * @details 引き取れなかった回数をnr_balance_failedに数え，定期の分散の間隔を延ばすのに使う
+ * @note 割り込み禁止で呼ぶ．移し元のロックを取るために自CPUのロックを1度手放すことがある．
+ *       CFSのタスクだけを移す（リアルタイムタスクは起床時にselect_task_rq()で空いているCPUに置かれる）
+ * @see Linux 6.18: load_balance()（スケジューリングドメインは1段のみ）
+ */
+int load_balance(struct rq *this_rq, int idle)
+{
+	struct rq *busiest;
+	struct task_struct *p = NULL;
+
+	this_rq->lb_stats.lb_count++;
+	busiest = find_busiest_queue(this_rq);
+	if (!busiest)
+	{
+		this_rq->nr_balance_failed = 0;
+		return 0;
+	}
+
+	double_lock_balance(this_rq, busiest);
+	/* ロックを取るまでの間に減っていれば移さない */
+	if (busiest->nr_running >= 2)
+	{
+		p = pick_migrate_task(busiest, this_rq, idle);
+	}
+	if (p)
+	{
+		move_queued_task(busiest, p, this_rq);
+		busiest->lb_stats.lb_lost++;
+	}
+	spin_unlock(&busiest->lock);
+
+	if (!p)
+	{
+		this_rq->lb_stats.lb_failed++;
+		this_rq->nr_balance_failed++;
+		return 0;
+	}
+	if (idle)
+	{
+		this_rq->lb_stats.lb_gained_idle++;
+	}
+	else
+	{
+		this_rq->lb_stats.lb_gained_busy++;
+	}
+	this_rq->nr_balance_failed = 0;
+	return 1;
+}
+
+/** アイドルになるCPUが，他のCPUからタスクを引き取る
+ * @param this_rq 自CPUのランキュー
+ * @details 定期の分散を待たず，CPUが空くその場で引き取る．待っているタスクの待ち時間を縮める
+ * @note schedule()から，ランキューのロックを持ち割り込み禁止で呼ばれる
+ */
+void idle_balance(struct rq *this_rq)
+{
+	if (num_online_cpus() < 2)
+	{
+		return;
+	}
+	load_balance(this_rq, 1);
+}
+
+/** 他のCPUに引き取りを促す
+ * @param this_rq 自CPUのランキュー
+ * @details 自CPUで待っているタスクがあるのにアイドルのCPUがあれば，1つ起こしてidle_balance()で引き取らせる．
+ *          nohzでtickを止めたアイドルのCPUは定期の分散を行わないため，こうしないと空いたままになる
+ * @note 割り込み禁止で呼ぶ
+ */
+static void kick_idle_cpu(struct rq *this_rq)
+{
+	int cpu;
+
+	if (READ_ONCE(this_rq->nr_running) < 2)
+	{
+		return;
+	}
+	for_each_online_cpu(cpu)
+	{
+		struct rq *rq = cpu_rq(cpu);
+
+		if (rq == this_rq || !idle_cpu(cpu))
+		{
+			continue;
+		}
+		spin_lock(&rq->lock);
+		if (idle_cpu(cpu))
+		{
+			resched_curr(rq);
+		}
+		spin_unlock(&rq->lock);
+		return;
+	}
+}
+
+/** tickごとに，間隔が来ていれば定期の負荷分散を行う
+ * @param rq 自CPUのランキュー（ロックは持たない）
+ * @details 移せなかった回数に応じて次の間隔をBALANCE_INTERVAL_NSの2のべき乗倍に延ばす（上限MAX_BALANCE_INTERVAL_NS）
+ * @note scheduler_tick()から割り込み禁止で呼ばれる
+ */
+void trigger_load_balance(struct rq *rq)
+{
+	uint64_t interval = BALANCE_INTERVAL_NS;
+	unsigned int failed;
+
+	if (num_online_cpus() < 2 || (int64_t)(rq->clock - rq->next_balance) < 0)
+	{
+		return;
+	}
+
+	spin_lock(&rq->lock);
+	load_balance(rq, rq->nr_running == 0);
+	for (failed = rq->nr_balance_failed; failed && interval < MAX_BALANCE_INTERVAL_NS; failed--)
+	{
+		interval <<= 1;
+	}
+	rq->next_balance = rq->clock + interval;
+	spin_unlock(&rq->lock);
+
+	kick_idle_cpu(rq);
+}
+
+/* CFSのスケジューリングクラス */
+const struct sched_class fair_sched_class = {
+	.next = NULL,
+	.enqueue_task = enqueue_task_fair,
+	.dequeue_task = dequeue_task_fair,
+	.pick_next_task = pick_next_task_fair,
+	.put_prev_task = put_prev_task_fair,
+	.task_tick = task_tick_fair,
+	.task_fork = task_fork_fair,
+	.check_preempt_curr = check_preempt_wakeup,
+};
@@ -0,0 +1,148 @@
+/** アイドル中の仕事と休止の統計
+ * - Linux 6.18のkernel/sched/idle.cとdrivers/cpuidle/のうち，アーキテクチャに依存しない部分に相当
+ * - アイドルループ（arch/i386/kernel/process.cのcpu_idle()）は眠る前に登録された仕事を片付け，
+ *   休止の前後と再スケジュール要求の受け取りをここに知らせる
+ * - 統計はCPUごとに持ち，そのCPUのアイドルループだけが書き換える（wake_stampは要求した側が書く）
+ */
+
+#include <asm-i386/system.h>
+#include <kfs/cpuidle.h>
+#include <kfs/list.h>
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/spinlock.h>
+#include <kfs/string.h>
+
+#include "sched.h"
+
+/** 登録されたアイドル中の仕事
+ * @note 登録は起動時に行う．アイドルループはロックを取らずにたどる
+ */
+static LIST_HEAD(idle_works);
+static DEFINE_SPINLOCK(idle_works_lock);
+
+/* CPUごとの休止の統計 */
+static struct cpuidle_stats cpuidle_stats[NR_CPUS];
+
+/** アイドル中の仕事を登録する
+ * @param work 登録する仕事（静的に置くこと．登録の解除はない）
+ * @details 登録した順に呼ばれる
+ */
+void idle_work_register(struct idle_work *work)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&idle_works_lock, flags);
+	list_add_tail(&work->list, &idle_works);
+	spin_unlock_irqrestore(&idle_works_lock, flags);
+}
+
+/** 登録された仕事を1巡ずつ片付ける
+ * @return 仕事をした数（0ならもう片付けるものはない）
+ * @details 再スケジュールを要求されたら途中でやめ，すぐにCPUを明け渡す
+ * @note アイドルループから割り込み許可・プリエンプト禁止で呼ばれる
+ */
+int run_idle_work(void)
+{
+	struct idle_work *work;
+	int done = 0;
+
+	list_for_each_entry(work, &idle_works, list)
+	{
+		if (need_resched())
+		{
+			break;
+		}
+		if (work->fn())
+		{
+			done++;
+		}
+	}
+	return done;
+}
+
+/** 休止し始める
+ * @note 割り込み禁止で，休止命令の直前に呼ぶ
+ */
+void cpuidle_account_enter(void)
+{
+	cpuidle_stats[smp_processor_id()].enter_stamp = sched_clock();
+}
+
+/* 休止から起きた（起こした割り込みの処理は済んでいる） */
+void cpuidle_account_exit(void)
+{
+	struct cpuidle_stats *st = &cpuidle_stats[smp_processor_id()];
+
+	st->time_ns += sched_clock() - st->enter_stamp;
+	st->usage++;
+}
+
+/** アイドル中のCPUに再スケジュールを要求した
+ * @param cpu 要求を受けたCPU
+ * @details 要求した時刻を記録し，アイドルループが抜けるまでの時間を測る．
+ *          まだ抜けていないうちの2度目以降の要求は最初の時刻を残す
+ * @note resched_curr()から，アイドルタスクが実行中のときに呼ばれる
+ * @note wake_stampは64ビットでi386では1命令で読み書きできないため，cpuのランキューのロックで守る
+ *       （resched_curr()が持っている）
+ */
+void cpuidle_wake_request(int cpu)
+{
+	struct cpuidle_stats *st = &cpuidle_stats[cpu];
+
+	if (!st->wake_stamp)
+	{
+		/* 0は要求なしを表すため，最下位ビットを立てて0にならないようにする（1ナノ秒の誤差は無視する） */
+		st->wake_stamp = sched_clock() | 1;
+	}
+}
+
+/** アイドルループを抜ける
+ * @details 再スケジュールを要求されていれば，要求から抜けるまでの時間を計上する
+ * @note schedule()を呼ぶ直前に呼ぶ
+ */
+void cpuidle_account_wakeup(void)
+{
+	int cpu = smp_processor_id();
+	struct cpuidle_stats *st = &cpuidle_stats[cpu];
+	struct rq *rq = cpu_rq(cpu);
+	uint64_t now = sched_clock();
+	uint64_t stamp, latency;
+	unsigned long flags;
+
+	/* 他のCPUのcpuidle_wake_request()と同じランキューのロックで読み出しとクリアを行う */
+	spin_lock_irqsave(&rq->lock, flags);
+	stamp = st->wake_stamp;
+	st->wake_stamp = 0;
+	spin_unlock_irqrestore(&rq->lock, flags);
+
+	if (!stamp)
+	{
+		return;
+	}
+
+	latency = now > stamp ? now - stamp : 0;
+	st->nr_wakeups++;
+	st->wake_latency_ns += latency;
+	if (latency > st->max_wake_latency_ns)
+	{
+		st->max_wake_latency_ns = latency;
+	}
+}
+
+/** CPUの休止の統計を写し取る
+ * @param cpu   CPU番号
+ * @param stats 格納先
+ * @note 他のCPUが書き換え中の値を読むことがあるが，表示用なので揃っていなくてよい
+ */
+void cpuidle_get_stats(int cpu, struct cpuidle_stats *stats)
+{
+	*stats = cpuidle_stats[cpu];
+}
+
+/* テスト用: 登録された仕事と統計を消す */
+void cpuidle_reset_for_test(void)
+{
+	INIT_LIST_HEAD(&idle_works);
+	memset(cpuidle_stats, 0, sizeof(cpuidle_stats));
+}
@@ -0,0 +1,100 @@
+/** 負荷平均
+ * - Linux 6.18のkernel/sched/loadavg.cに相当（単一のランキューを直接畳み込む）
+ * - LOAD_FREQごとに，実行可能なタスクとTASK_UNINTERRUPTIBLEで眠っているタスクの数を
+ *   1分・5分・15分の指数移動平均に畳み込む
+ * - 値はFSHIFTビットの固定小数点で持ち，除算はFIXED_1（2の累乗）でのシフトだけで済む
+ */
+
+#include <asm-i386/param.h>
+#include <kfs/sched.h>
+
+#include "sched.h"
+
+/* 1分・5分・15分の負荷平均（FIXED_1が1.0） */
+unsigned long avenrun[3];
+
+/* LOAD_FREQをランキュー時刻（ナノ秒）にしたもの */
+#define LOAD_FREQ_NS ((uint64_t)LOAD_FREQ * TICK_NSEC)
+
+/** 負荷平均を取得する
+ * @param loads  格納先（3要素）
+ * @param offset 各値に加える値（表示時の丸め用．FIXED_1/200で小数第2位を四捨五入）
+ * @param shift  左シフトする量
+ */
+void get_avenrun(unsigned long *loads, unsigned long offset, int shift)
+{
+	loads[0] = (avenrun[0] + offset) << shift;
+	loads[1] = (avenrun[1] + offset) << shift;
+	loads[2] = (avenrun[2] + offset) << shift;
+}
+
+/** 指数移動平均を1回進める
+ * @param load   これまでの平均
+ * @param exp    減衰率（EXP_n）
+ * @param active 現在のタスク数（固定小数点）
+ * @return load * exp + active * (1 - exp)
+ * @note 増えている間は切り上げ，同じ数のタスクが続けば平均がその数にちょうど届くようにする
+ */
+static unsigned long calc_load(unsigned long load, unsigned long exp, unsigned long active)
+{
+	unsigned long newload;
+
+	newload = load * exp + active * (FIXED_1 - exp);
+	if (active >= load)
+	{
+		newload += FIXED_1 - 1;
+	}
+	return newload / FIXED_1;
+}
+
+/** 負荷平均を初期化する
+ * @param rq ランキュー（ランキュー時刻を設定済み）
+ */
+void init_calc_load(struct rq *rq)
+{
+	avenrun[0] = 0;
+	avenrun[1] = 0;
+	avenrun[2] = 0;
+	rq->calc_load_update = rq->clock + LOAD_FREQ_NS;
+}
+
+/* 全CPUの実行可能なタスクとTASK_UNINTERRUPTIBLEで眠っているタスクの数 */
+static unsigned long calc_load_active(void)
+{
+	unsigned long nr = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+	{
+		struct rq *rq = cpu_rq(cpu);
+
+		nr += READ_ONCE(rq->nr_running) + READ_ONCE(rq->nr_uninterruptible);
+	}
+	return nr;
+}
+
+/** LOAD_FREQが経過していれば負荷平均を更新する
+ * @param rq ランキュー
+ * @details nohzで止まっていたtickをまとめて進めた場合は，過ぎた周期の数だけ畳み込む．
+ *          負荷平均はシステム全体で1つのため，jiffiesを進めるCPU 0だけが全CPUの分を数えて畳み込む
+ * @note scheduler_tick()とscheduler_idle_ticks()から呼ばれる
+ */
+void calc_global_load_tick(struct rq *rq)
+{
+	unsigned long active;
+
+	if (rq->cpu != 0)
+	{
+		return;
+	}
+	while ((int64_t)(rq->clock - rq->calc_load_update) >= 0)
+	{
+		active = calc_load_active() * FIXED_1;
+
+		avenrun[0] = calc_load(avenrun[0], EXP_1, active);
+		avenrun[1] = calc_load(avenrun[1], EXP_5, active);
+		avenrun[2] = calc_load(avenrun[2], EXP_15, active);
+
+		rq->calc_load_update += LOAD_FREQ_NS;
+	}
+}
@@ -0,0 +1,244 @@
+/** リアルタイムスケジューリングクラス（SCHED_FIFO/SCHED_RR）
+ * - Linux 6.18のkernel/sched/rt.cに相当（グループスケジューリングとCPU間の移動なし）
+ * - 優先度（0〜MAX_RT_PRIO-1，小さいほど優先）ごとのリストと，空でないリストを表すビットマップを持つ
+ * - 次のタスクはビットマップをbsfで探した最高優先度のリストの先頭であり，タスク数によらずO(1)で選べる
+ */
+
+#include <asm-i386/bitops.h>
+#include <kfs/list.h>
+#include <kfs/sched.h>
+#include <kfs/stddef.h>
+
+#include "sched.h"
+
+/* rt_rqを含むランキューを取得する */
+static inline struct rq *rq_of_rt_rq(struct rt_rq *rt_rq)
+{
+	return container_of(rt_rq, struct rq, rt);
+}
+
+/** リアルタイムランキューを初期化する
+ * @param rt_rq 初期化するランキュー
+ * @param now   最初の周期の始まり（ランキュー時刻）
+ */
+void init_rt_rq(struct rt_rq *rt_rq, uint64_t now)
+{
+	struct rt_prio_array *array = &rt_rq->active;
+	int i;
+
+	for (i = 0; i < MAX_RT_PRIO; i++)
+	{
+		INIT_LIST_HEAD(&array->queue[i]);
+	}
+	bitmap_zero(array->bitmap, MAX_RT_PRIO + 1);
+	__set_bit(MAX_RT_PRIO, array->bitmap); /* 番兵 */
+
+	rt_rq->rt_nr_running = 0;
+	rt_rq->rt_time = 0;
+	rt_rq->rt_period_expires = now + RT_PERIOD_NS;
+	rt_rq->rt_throttled = 0;
+}
+
+/** 実行中のリアルタイムタスクの実行時間を計上する
+ * @details 周期内の合計がRT_RUNTIME_NSを超えたらスロットリングし，CFSのタスクに譲らせる
+ */
+static void update_curr_rt(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	struct rt_rq *rt_rq = &rq->rt;
+	int64_t delta_exec;
+
+	if (curr->sched_class != &rt_sched_class)
+	{
+		return;
+	}
+
+	delta_exec = (int64_t)(rq->clock - curr->se.exec_start);
+	if (delta_exec <= 0)
+	{
+		return;
+	}
+	curr->se.exec_start = rq->clock;
+	curr->se.sum_exec_runtime += (uint64_t)delta_exec;
+
+	rt_rq->rt_time += (uint64_t)delta_exec;
+	if (!rt_rq->rt_throttled && rt_rq->rt_time > RT_RUNTIME_NS)
+	{
+		rt_rq->rt_throttled = 1;
+		resched_curr(rq);
+	}
+}
+
+/** 周期の境界を過ぎていれば実行時間を補充する
+ * @details 過ぎた周期の数だけrt_timeからRT_RUNTIME_NSを差し引き，使い切っていなければスロットリングを解く．
+ *          待っていたリアルタイムタスクがあれば，実行中のCFSのタスクを譲らせる
+ * @note scheduler_tick()からtickごとに呼ばれる（Linux 6.18ではhrtimerで周期を刻む）
+ */
+void sched_rt_period_tick(struct rq *rq)
+{
+	struct rt_rq *rt_rq = &rq->rt;
+
+	while ((int64_t)(rq->clock - rt_rq->rt_period_expires) >= 0)
+	{
+		rt_rq->rt_period_expires += RT_PERIOD_NS;
+		rt_rq->rt_time -= rt_rq->rt_time < RT_RUNTIME_NS ? rt_rq->rt_time : RT_RUNTIME_NS;
+	}
+
+	if (rt_rq->rt_throttled && rt_rq->rt_time < RT_RUNTIME_NS)
+	{
+		rt_rq->rt_throttled = 0;
+		if (rt_rq->rt_nr_running && !rt_task(rq->curr))
+		{
+			resched_curr(rq);
+		}
+	}
+}
+
+/** タスクを優先度のリストの末尾に登録する
+ * @param rq    ランキュー
+ * @param p     登録するタスク
+ * @param flags 未使用（ENQUEUE_WAKEUP等）
+ */
+static void enqueue_task_rt(struct rq *rq, struct task_struct *p, int flags)
+{
+	struct rt_prio_array *array = &rq->rt.active;
+	struct sched_rt_entity *rt_se = &p->rt;
+
+	(void)flags;
+
+	if (rt_se->on_rq)
+	{
+		return;
+	}
+
+	list_add_tail(&rt_se->run_list, &array->queue[p->prio]);
+	__set_bit(p->prio, array->bitmap);
+	rt_se->on_rq = 1;
+	rq->rt.rt_nr_running++;
+}
+
+/** タスクを優先度のリストから外す
+ * @param rq    ランキュー
+ * @param p     外すタスク
+ * @param flags 未使用（DEQUEUE_SLEEP等）
+ * @note リストが空になればビットを下ろす
+ */
+static void dequeue_task_rt(struct rq *rq, struct task_struct *p, int flags)
+{
+	struct rt_prio_array *array = &rq->rt.active;
+	struct sched_rt_entity *rt_se = &p->rt;
+
+	(void)flags;
+
+	if (!rt_se->on_rq)
+	{
+		return;
+	}
+
+	update_curr_rt(rq);
+
+	list_del_init(&rt_se->run_list);
+	if (list_empty(&array->queue[p->prio]))
+	{
+		__clear_bit(p->prio, array->bitmap);
+	}
+	rt_se->on_rq = 0;
+	rq->rt.rt_nr_running--;
+}
+
+/** タスクを同じ優先度のリストの末尾に回す */
+static void requeue_task_rt(struct rq *rq, struct task_struct *p)
+{
+	struct sched_rt_entity *rt_se = &p->rt;
+
+	if (rt_se->on_rq)
+	{
+		list_del(&rt_se->run_list);
+		list_add_tail(&rt_se->run_list, &rq->rt.active.queue[p->prio]);
+	}
+}
+
+/** 次に実行するタスクを選ぶ
+ * @param rq ランキュー
+ * @return 最も優先度の高いリストの先頭のタスク，登録がないかスロットリング中ならNULL
+ * @note 選んだタスクはリストに残したまま実行する
+ */
+static struct task_struct *pick_next_task_rt(struct rq *rq)
+{
+	struct rt_rq *rt_rq = &rq->rt;
+	struct sched_rt_entity *rt_se;
+	struct task_struct *p;
+	unsigned long idx;
+
+	if (!rt_rq->rt_nr_running || rt_rq->rt_throttled)
+	{
+		return NULL;
+	}
+
+	idx = sched_find_first_bit(rt_rq->active.bitmap);
+	rt_se = list_entry(rt_rq->active.queue[idx].next, struct sched_rt_entity, run_list);
+	p = container_of(rt_se, struct task_struct, rt);
+	p->se.exec_start = rq->clock;
+	return p;
+}
+
+/* 実行を終えるタスクの実行時間を計上する */
+static void put_prev_task_rt(struct rq *rq, struct task_struct *p)
+{
+	(void)p;
+	update_curr_rt(rq);
+}
+
+/** タイマー割り込みごとに実行時間を計上し，SCHED_RRのタイムスライスを減らす
+ * @details 使い切ったら補充し，同じ優先度に他のタスクがいれば末尾に回って譲る．
+ *          SCHED_FIFOは自分から手放すか，より優先度の高いタスクが来るまで実行し続ける
+ */
+static void task_tick_rt(struct rq *rq, struct task_struct *p)
+{
+	struct sched_rt_entity *rt_se = &p->rt;
+
+	update_curr_rt(rq);
+
+	if (p->policy != SCHED_RR)
+	{
+		return;
+	}
+	if (--rt_se->time_slice)
+	{
+		return;
+	}
+
+	rt_se->time_slice = RR_TIMESLICE;
+	if (rt_se->run_list.prev != rt_se->run_list.next)
+	{
+		requeue_task_rt(rq, p);
+		resched_curr(rq);
+	}
+}
+
+/* fork直後のタスクはタイムスライスを満タンにして始める */
+static void task_fork_rt(struct task_struct *p)
+{
+	p->rt.time_slice = RR_TIMESLICE;
+}
+
+/* より優先度の高いリアルタイムタスクが実行可能になったら譲らせる */
+static void check_preempt_curr_rt(struct rq *rq, struct task_struct *p)
+{
+	if (p->prio < rq->curr->prio)
+	{
+		resched_curr(rq);
+	}
+}
+
+/* リアルタイムのスケジューリングクラス（CFSより優先される） */
+const struct sched_class rt_sched_class = {
+	.next = &fair_sched_class,
+	.enqueue_task = enqueue_task_rt,
+	.dequeue_task = dequeue_task_rt,
+	.pick_next_task = pick_next_task_rt,
+	.put_prev_task = put_prev_task_rt,
+	.task_tick = task_tick_rt,
+	.task_fork = task_fork_rt,
+	.check_preempt_curr = check_preempt_curr_rt,
+};
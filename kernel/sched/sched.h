@@ -0,0 +1,268 @@
+/**
+ * sched.h - スケジューラ内部定義
+ *
+ * kernel/sched/配下のみで使用するランキューとスケジューリングクラスの定義
+ * @see Linux 6.18: kernel/sched/sched.h
+ */
+#ifndef _KERNEL_SCHED_SCHED_H
+#define _KERNEL_SCHED_SCHED_H
+
+#include <asm-i386/param.h>
+#include <kfs/bitmap.h>
+#include <kfs/list.h>
+#include <kfs/rbtree.h>
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/spinlock.h>
+#include <kfs/stdint.h>
+
+struct rq;
+
+/** CFSランキュー
+ * @details 実行可能なエンティティをvruntime順のrb-treeで管理する．
+ *          最左ノード（最小vruntime）をキャッシュするため，次のタスクの選択はO(1)．
+ */
+struct cfs_rq
+{
+	struct rb_root_cached tasks_timeline; /* vruntime順のrb-tree */
+	unsigned long load;					  /* 登録中エンティティの負荷重みの合計 */
+	unsigned int nr_running;			  /* 登録中エンティティ数（実行中のcurrを含む） */
+	uint64_t min_vruntime;				  /* 単調増加する最小vruntime（新規・起床タスクの基準） */
+	struct sched_entity *curr;			  /* 実行中のエンティティ（rb-treeからは外れている） */
+};
+
+/** リアルタイム優先度ごとのリスト
+ * @details 優先度idxのリストが空でなければbitmapのビットidxが立つ．
+ *          ビットMAX_RT_PRIOは番兵として常に立てておき，最初のビットをbsfで探すときに範囲外へ出ないようにする
+ */
+struct rt_prio_array
+{
+	DECLARE_BITMAP(bitmap, MAX_RT_PRIO + 1);
+	struct list_head queue[MAX_RT_PRIO];
+};
+
+/** リアルタイムランキュー
+ * @details 次のタスクの選択はビットマップの探索とリストの先頭を見るだけで，タスク数によらずO(1)．
+ *          rt_timeは周期（RT_PERIOD_NS）ごとにRT_RUNTIME_NSずつ差し引き，超えたら周期の残りは実行させない（スロットリング）
+ */
+struct rt_rq
+{
+	struct rt_prio_array active;  /* 優先度ごとの実行可能タスク */
+	unsigned int rt_nr_running;	  /* 登録中のタスク数（実行中のものを含む） */
+	uint64_t rt_time;			  /* 現在の周期でリアルタイムタスクが使った時間（ナノ秒） */
+	uint64_t rt_period_expires;	  /* 現在の周期の終わり（ランキュー時刻） */
+	int rt_throttled;			  /* 使い切ったため選ばれない状態か */
+};
+
+/* SCHED_RRのタイムスライス（100ミリ秒，tick単位） */
+#define RR_TIMESLICE (100 * HZ / 1000)
+
+/** リアルタイムタスクのスロットリング
+ * @details 周期1秒のうち0.95秒までしかリアルタイムタスクを実行せず，残りをCFSのタスクに回す．
+ *          暴走したリアルタイムタスクがシェルなどを完全に止めてしまうのを防ぐ
+ * @see Linux 6.18: sysctl_sched_rt_period, sysctl_sched_rt_runtime
+ */
+#define RT_PERIOD_NS 1000000000ULL
+#define RT_RUNTIME_NS 950000000ULL
+
+/* リアルタイムのポリシーか */
+static inline int rt_policy(int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static inline int task_has_rt_policy(const struct task_struct *p)
+{
+	return rt_policy(p->policy);
+}
+
+/** ランキュー（CPUごと）
+ * @details lockはランキューと，登録されたタスクのスケジューラ関連のフィールドを守る．
+ *          割り込みハンドラ（scheduler_tick()，try_to_wake_up()）からも取るため，割り込みを禁止して取る．
+ *          2つのランキューのロックを取るときは，デッドロックしないよう必ずアドレスの小さい方から取る（double_rq_lock()）
+ * @note schedule()はロックを持ったまま切り替え，切り替え先のfinish_task_switch()で解放する
+ */
+struct rq
+{
+	spinlock_t lock;		   /* このランキューを守るロック */
+	int cpu;				   /* このランキューのCPU */
+	unsigned int nr_running;   /* 実行可能タスク数 */
+	uint64_t clock;			   /* ランキュー時刻（ナノ秒） */
+	struct rt_rq rt;		   /* リアルタイムランキュー */
+	struct cfs_rq cfs;		   /* CFSランキュー */
+	struct task_struct *curr;  /* 実行中のタスク */
+	struct task_struct *idle;  /* アイドルタスク */
+
+	/* 統計 */
+	unsigned long nr_switches;		  /* コンテキストスイッチの回数 */
+	unsigned int nr_uninterruptible;  /* TASK_UNINTERRUPTIBLEで眠っているタスク数（負荷平均に数える） */
+	uint64_t idle_time;				  /* アイドルタスクが実行していた時間の合計（ナノ秒．実行中の分は含まない） */
+	uint64_t calc_load_update;		  /* 次に負荷平均を更新するランキュー時刻 */
+
+	/* 負荷分散 */
+	uint64_t next_balance;				 /* 次に定期の負荷分散を行うランキュー時刻 */
+	unsigned int nr_balance_failed;		 /* 定期の負荷分散が続けて移せなかった回数 */
+	struct task_struct *push_task;		 /* 切り替え後に他のCPUへ送り出すタスク（アフィニティの変更による） */
+	struct mm_struct *prev_mm;			 /* 切り替え元のカーネルスレッドが借りていたmm（切り替え後にmmdrop()する） */
+	struct sched_lb_stats lb_stats;		 /* 負荷分散の統計 */
+};
+
+/** 定期の負荷分散の間隔（ナノ秒）
+ * @details tickごとに全CPUのランキューを見て回ると，忙しいCPUほど他のランキューのロックを取り合うため，
+ *          この間隔ごとにだけ見る．アイドルになったCPUはこの間隔を待たずにすぐ引き取りに行く
+ * @see Linux 6.18: sd->balance_interval（busy_factorを掛ける前の値）
+ */
+#define BALANCE_INTERVAL_NS (4 * TICK_NSEC)
+
+/** 移せるタスクがなかったときに間隔を延ばす上限
+ * @note アフィニティで移せないタスクしかない偏りを，間隔ごとに見に行き続けないようにする
+ */
+#define MAX_BALANCE_INTERVAL_NS (32 * TICK_NSEC)
+
+/* 各CPUのランキュー (kernel/sched/core.c) */
+extern struct rq runqueues[NR_CPUS];
+
+#define cpu_rq(cpu) (&runqueues[(cpu)])
+#define task_rq(p) cpu_rq(task_cpu(p))
+
+/* タスクがCPU上で実行中か */
+static inline int task_running(struct rq *rq, struct task_struct *p)
+{
+	return rq->curr == p;
+}
+
+/* CPUが何も実行しておらず，待っているタスクもないか */
+static inline int idle_cpu(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	return rq->curr == rq->idle && READ_ONCE(rq->nr_running) == 0;
+}
+
+/* タスクがCPUで実行してよいか */
+static inline int cpu_allowed(const struct task_struct *p, int cpu)
+{
+	return (p->cpus_allowed >> cpu) & 1UL;
+}
+
+/** 2つのランキューのロックを取る
+ * @note 割り込み禁止で呼ぶ．アドレスの小さい方から取る
+ */
+static inline void double_rq_lock(struct rq *rq1, struct rq *rq2)
+{
+	if (rq1 == rq2)
+	{
+		spin_lock(&rq1->lock);
+	}
+	else if (rq1 < rq2)
+	{
+		spin_lock(&rq1->lock);
+		spin_lock(&rq2->lock);
+	}
+	else
+	{
+		spin_lock(&rq2->lock);
+		spin_lock(&rq1->lock);
+	}
+}
+
+/* double_rq_lock()で取ったロックを解放する */
+static inline void double_rq_unlock(struct rq *rq1, struct rq *rq2)
+{
+	spin_unlock(&rq1->lock);
+	if (rq1 != rq2)
+	{
+		spin_unlock(&rq2->lock);
+	}
+}
+
+/** this_rqのロックを持ったまま，busiestのロックも取る
+ * @return this_rqのロックを1度手放した場合は1（その間にthis_rqが変わっていうる）
+ * @details すぐ取れなければ，順序を守るためにthis_rqを手放して取り直すことがある
+ */
+static inline int double_lock_balance(struct rq *this_rq, struct rq *busiest)
+{
+	if (spin_trylock(&busiest->lock))
+	{
+		return 0;
+	}
+	if (busiest < this_rq)
+	{
+		spin_unlock(&this_rq->lock);
+		spin_lock(&busiest->lock);
+		spin_lock(&this_rq->lock);
+		return 1;
+	}
+	spin_lock(&busiest->lock);
+	return 0;
+}
+
+/** スケジューリングクラス
+ * @details ポリシーごとの操作をまとめた関数テーブル．
+ *          コアスケジューラは優先度の高いクラスから順にpick_next_taskを問い合わせる．
+ */
+struct sched_class
+{
+	const struct sched_class *next; /* 次に優先度の低いクラス */
+
+	void (*enqueue_task)(struct rq *rq, struct task_struct *p, int flags);
+	void (*dequeue_task)(struct rq *rq, struct task_struct *p, int flags);
+	struct task_struct *(*pick_next_task)(struct rq *rq);
+	void (*put_prev_task)(struct rq *rq, struct task_struct *p);
+	void (*task_tick)(struct rq *rq, struct task_struct *p);
+	void (*task_fork)(struct task_struct *p);
+	void (*check_preempt_curr)(struct rq *rq, struct task_struct *p);
+};
+
+/** 負荷重みの逆数の精度
+ * @details inv_weight = 2^WMULT_SHIFT / weightとし，x / weightを(x * inv_weight) >> WMULT_SHIFTで求める
+ */
+#define WMULT_CONST (~0U)
+#define WMULT_SHIFT 32
+
+/* nice値（-20〜19）ごとの負荷重みと，その逆数（2^32/weight） (kernel/sched/core.c) */
+extern const int sched_prio_to_weight[NICE_WIDTH];
+extern const uint32_t sched_prio_to_wmult[NICE_WIDTH];
+
+/* enqueue_task/dequeue_taskのflags */
+#define ENQUEUE_WAKEUP 0x01 /* スリープからの起床 */
+#define DEQUEUE_SLEEP 0x01	/* スリープによる除去 */
+
+extern const struct sched_class rt_sched_class;
+extern const struct sched_class fair_sched_class;
+
+/* 自CPUのランキューの取得（プリエンプト禁止中に呼ぶ） */
+struct rq *this_rq(void);
+
+/* ランキューへの登録・除去 (kernel/sched/core.c) */
+void activate_task(struct rq *rq, struct task_struct *p, int flags);
+void deactivate_task(struct rq *rq, struct task_struct *p, int flags);
+
+/* 再スケジュール要求 (kernel/sched/core.c) */
+void resched_curr(struct rq *rq);
+void check_preempt_curr(struct rq *rq, struct task_struct *p);
+
+/* 次のタスクを選んでrq->currを切り替える (kernel/sched/core.c) */
+struct task_struct *__pick_next_task(struct rq *rq);
+
+/* タスクのCPU間の移動 (kernel/sched/core.c) */
+int select_task_rq(struct task_struct *p);
+void move_queued_task(struct rq *src_rq, struct task_struct *p, struct rq *dst_rq);
+
+/* 負荷分散 (kernel/sched/fair.c) */
+int load_balance(struct rq *this_rq, int idle);
+void idle_balance(struct rq *this_rq);
+void trigger_load_balance(struct rq *rq);
+
+/* CFSランキューの初期化 (kernel/sched/fair.c) */
+void init_cfs_rq(struct cfs_rq *cfs_rq);
+
+/* リアルタイムランキューの初期化と周期の更新 (kernel/sched/rt.c) */
+void init_rt_rq(struct rt_rq *rt_rq, uint64_t now);
+void sched_rt_period_tick(struct rq *rq);
+
+/* 負荷平均の初期化と更新 (kernel/sched/loadavg.c) */
+void init_calc_load(struct rq *rq);
+void calc_global_load_tick(struct rq *rq);
+
+#endif /* _KERNEL_SCHED_SCHED_H */
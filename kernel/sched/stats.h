@@ -0,0 +1,69 @@
+/**
+ * stats.h - スケジューラ統計
+ *
+ * タスクがランキューで待った時間と，CPUで実行された回数をランキュー時刻で数える．
+ * 待ち始め（登録・プリエンプト）から実行開始までをrun_delayに加え，
+ * アイドルタスクが実行していた時間はランキューのidle_timeに加える
+ * @see Linux 6.18: kernel/sched/stats.h
+ */
+#ifndef _KERNEL_SCHED_STATS_H
+#define _KERNEL_SCHED_STATS_H
+
+#include "sched.h"
+
+/* ランキューで待ち始める（すでに待っていれば何もしない） */
+static inline void sched_info_enqueue(struct rq *rq, struct task_struct *t)
+{
+	if (!t->sched_info.last_queued)
+	{
+		t->sched_info.last_queued = rq->clock;
+	}
+}
+
+/* ランキューでの待ちを終える（待った時間を計上する） */
+static inline void sched_info_dequeue(struct rq *rq, struct task_struct *t)
+{
+	if (t->sched_info.last_queued)
+	{
+		t->sched_info.run_delay += rq->clock - t->sched_info.last_queued;
+		t->sched_info.last_queued = 0;
+	}
+}
+
+/* CPUで実行され始める */
+static inline void sched_info_arrive(struct rq *rq, struct task_struct *t)
+{
+	sched_info_dequeue(rq, t);
+	t->sched_info.last_arrival = rq->clock;
+	t->sched_info.pcount++;
+}
+
+/** CPUを離れる
+ * @details 実行可能なまま（プリエンプトされて）離れたなら，再び待ち始める．
+ *          アイドルタスクなら実行していた時間をアイドル時間に加える
+ */
+static inline void sched_info_depart(struct rq *rq, struct task_struct *t)
+{
+	if (t == rq->idle)
+	{
+		rq->idle_time += rq->clock - t->sched_info.last_arrival;
+		return;
+	}
+	if (t->on_rq)
+	{
+		sched_info_enqueue(rq, t);
+	}
+}
+
+/** 実行中のタスクの切り替えを計上する
+ * @param rq   ランキュー
+ * @param prev CPUを離れるタスク
+ * @param next CPUで実行され始めるタスク
+ */
+static inline void sched_info_switch(struct rq *rq, struct task_struct *prev, struct task_struct *next)
+{
+	sched_info_depart(rq, prev);
+	sched_info_arrive(rq, next);
+}
+
+#endif /* _KERNEL_SCHED_STATS_H */
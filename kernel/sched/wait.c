@@ -0,0 +1,148 @@
+/** 待ちキュー
+ * - Linux 6.18のkernel/sched/wait.cに相当
+ * - 待ちキューの操作は割り込みハンドラや他のCPUからのwake_up()と競合するため，
+ *   wq_head->lockを割り込み禁止で取って行う
+ */
+
+#include <kfs/list.h>
+#include <kfs/sched.h>
+#include <kfs/spinlock.h>
+#include <kfs/wait.h>
+
+/* 待ちキューにエントリを追加する（排他的でない待ち手は先頭に並べる） */
+void add_wait_queue(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry)
+{
+	unsigned long flags;
+
+	wq_entry->flags &= ~WQ_FLAG_EXCLUSIVE;
+	spin_lock_irqsave(&wq_head->lock, flags);
+	list_add(&wq_entry->entry, &wq_head->head);
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/* 待ちキューに排他的なエントリを追加する（末尾に並べ，wake_up()では先頭の1つだけ起こされる） */
+void add_wait_queue_exclusive(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry)
+{
+	unsigned long flags;
+
+	wq_entry->flags |= WQ_FLAG_EXCLUSIVE;
+	spin_lock_irqsave(&wq_head->lock, flags);
+	list_add_tail(&wq_entry->entry, &wq_head->head);
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/* 待ちキューからエントリを外す */
+void remove_wait_queue(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wq_head->lock, flags);
+	list_del(&wq_entry->entry);
+	INIT_LIST_HEAD(&wq_entry->entry);
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/** 眠る準備をする
+ * @param wq_head  待ちキュー
+ * @param wq_entry 現在のタスクのエントリ
+ * @param state    TASK_INTERRUPTIBLEまたはTASK_UNINTERRUPTIBLE
+ * @details キューに並んでから状態を変えるため，この後に条件が成立してwake_up()されても起床を取りこぼさない
+ */
+void prepare_to_wait(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry, unsigned int state)
+{
+	unsigned long flags;
+
+	wq_entry->flags &= ~WQ_FLAG_EXCLUSIVE;
+	spin_lock_irqsave(&wq_head->lock, flags);
+	if (list_empty(&wq_entry->entry))
+	{
+		list_add(&wq_entry->entry, &wq_head->head);
+	}
+	set_current_state(state);
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/* 排他的な待ち手として眠る準備をする */
+void prepare_to_wait_exclusive(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry,
+							   unsigned int state)
+{
+	unsigned long flags;
+
+	wq_entry->flags |= WQ_FLAG_EXCLUSIVE;
+	spin_lock_irqsave(&wq_head->lock, flags);
+	if (list_empty(&wq_entry->entry))
+	{
+		list_add_tail(&wq_entry->entry, &wq_head->head);
+	}
+	set_current_state(state);
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/** 待ちを終える
+ * @details 状態をTASK_RUNNINGに戻し，まだキューに残っていれば外す
+ *          （条件が先に成立して眠らなかった場合や，シグナルで中断した場合）
+ */
+void finish_wait(struct wait_queue_head *wq_head, struct wait_queue_entry *wq_entry)
+{
+	unsigned long flags;
+
+	__set_current_state(TASK_RUNNING);
+	spin_lock_irqsave(&wq_head->lock, flags);
+	if (!list_empty(&wq_entry->entry))
+	{
+		list_del(&wq_entry->entry);
+		INIT_LIST_HEAD(&wq_entry->entry);
+	}
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
+
+/* エントリのタスクを起こす（キューには残す） */
+int default_wake_function(struct wait_queue_entry *wq_entry, unsigned int mode)
+{
+	return try_to_wake_up(wq_entry->private, mode);
+}
+
+/** エントリのタスクを起こし，キューから外す
+ * @note DEFINE_WAIT()のエントリが使う．起こされたタスクは再度prepare_to_wait()で並び直す
+ */
+int autoremove_wake_function(struct wait_queue_entry *wq_entry, unsigned int mode)
+{
+	int ret = default_wake_function(wq_entry, mode);
+
+	if (ret)
+	{
+		list_del(&wq_entry->entry);
+		INIT_LIST_HEAD(&wq_entry->entry);
+	}
+	return ret;
+}
+
+/** 待ちキューの待ち手を起こす
+ * @param wq_head      待ちキュー
+ * @param mode         起こす対象の状態（TASK_NORMAL等）
+ * @param nr_exclusive 起こす排他的な待ち手の数（0ならすべて）
+ * @details 先頭から順に起床関数を呼ぶ．排他的な待ち手をnr_exclusive個起こしたら止める
+ * @note 割り込みハンドラからも呼べる
+ */
+void __wake_up(struct wait_queue_head *wq_head, unsigned int mode, int nr_exclusive)
+{
+	struct wait_queue_entry *curr;
+	struct wait_queue_entry *next;
+	unsigned long flags;
+
+	spin_lock_irqsave(&wq_head->lock, flags);
+	curr = list_entry(wq_head->head.next, struct wait_queue_entry, entry);
+	while (&curr->entry != &wq_head->head)
+	{
+		unsigned int wq_flags = curr->flags;
+
+		/* 起床関数がエントリを外すことがあるため，先に次を取得しておく */
+		next = list_entry(curr->entry.next, struct wait_queue_entry, entry);
+		if (curr->func(curr, mode) && (wq_flags & WQ_FLAG_EXCLUSIVE) && !--nr_exclusive)
+		{
+			break;
+		}
+		curr = next;
+	}
+	spin_unlock_irqrestore(&wq_head->lock, flags);
+}
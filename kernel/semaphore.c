@@ -0,0 +1,110 @@
+/** 計数セマフォ
+ * - Linux 2.6.26のkernel/semaphore.cに相当
+ * - 資源が残っていればcmpxchg 1回でcountを1減らして取得する
+ * - 残っていなければ待ちキューに排他的な待ち手として並んで眠り，up()で1つずつ起こされる
+ */
+
+#include <kfs/errno.h>
+#include <kfs/semaphore.h>
+#include <kfs/sched.h>
+#include <kfs/signal.h>
+#include <kfs/wait.h>
+
+/** countが正なら1減らす
+ * @return 減らせたら1
+ */
+static inline int __down_trylock(struct semaphore *sem)
+{
+	int count = atomic_read(&sem->count);
+
+	while (count > 0)
+	{
+		int old = atomic_cmpxchg(&sem->count, count, count - 1);
+
+		if (old == count)
+		{
+			return 1;
+		}
+		count = old;
+	}
+	return 0;
+}
+
+/** 取得の遅い経路
+ * @param state TASK_UNINTERRUPTIBLEまたはTASK_INTERRUPTIBLE
+ * @return 取得できたら0，TASK_INTERRUPTIBLEでシグナルが届いたら-EINTR
+ */
+static int __down_slowpath(struct semaphore *sem, unsigned int state)
+{
+	DEFINE_WAIT(wait);
+	int ret = 0;
+
+	for (;;)
+	{
+		prepare_to_wait_exclusive(&sem->wait, &wait, state);
+		if (__down_trylock(sem))
+		{
+			break;
+		}
+		if (state == TASK_INTERRUPTIBLE && signal_pending())
+		{
+			ret = -EINTR;
+			break;
+		}
+		schedule();
+	}
+	finish_wait(&sem->wait, &wait);
+
+	/** up()で自分だけが起こされていた場合，諦める前に次の待ち手へ起床を引き継ぐ
+	 * @note up()と同じ理由で，待ちキューが空かどうかはロックを取らずに判断しない
+	 */
+	if (ret != 0 && atomic_read(&sem->count) > 0)
+	{
+		wake_up(&sem->wait);
+	}
+	return ret;
+}
+
+/* 資源を1つ取得する（残っていなければ眠る） */
+void down(struct semaphore *sem)
+{
+	if (__down_trylock(sem))
+	{
+		return;
+	}
+	__down_slowpath(sem, TASK_UNINTERRUPTIBLE);
+}
+
+/** 資源を1つ取得する（眠っている間はシグナルで中断できる）
+ * @return 取得できたら0，シグナルが届いたら-EINTR（取得していない）
+ */
+int down_interruptible(struct semaphore *sem)
+{
+	if (__down_trylock(sem))
+	{
+		return 0;
+	}
+	return __down_slowpath(sem, TASK_INTERRUPTIBLE);
+}
+
+/** 1度だけ取得を試みる
+ * @return 取得できたら0，できなければ1
+ * @note Linuxに合わせ，mutex_trylock()・spin_trylock()とは逆の値を返す
+ */
+int down_trylock(struct semaphore *sem)
+{
+	return !__down_trylock(sem);
+}
+
+/** 資源を1つ返す
+ * @details 待ち手がいれば1つ起こす．待ちキューが空かどうかは必ずwake_up()の中で待ちキューのロックを取って調べる
+ * @note ロックを取らないwaitqueue_active()で省略すると，待ち手がキューに並ぶ書き込みとcountの読み出しが
+ *       入れ替わって見えたとき（x86でもストアの後のロードは追い越せる），待ち手はcount=0を読んで眠り，
+ *       up()は空のキューを見て誰も起こさない．ロックを取れば，待ち手のprepare_to_wait_exclusive()の
+ *       前後どちらで起こそうとしたかが決まり，前ならcountの加算が，後ならキューに並んだ待ち手が見える
+ */
+void up(struct semaphore *sem)
+{
+	atomic_inc(&sem->count);
+	wake_up(&sem->wait);
+}
@@ -1,19 +1,30 @@
+#include <asm-i386/div64.h>
 #include <asm-i386/pgtable.h>
+#include <asm-i386/system.h>
 #include <kfs/console.h>
+#include <kfs/compiler.h>
+#include <kfs/cpuidle.h>
 #include <kfs/keyboard.h>
 #include <kfs/neofetch.h>
 #include <kfs/panic.h>
 #include <kfs/printk.h>
 #include <kfs/reboot.h>
+#include <kfs/sched.h>
 #include <kfs/serial.h>
 #include <kfs/shell.h>
+#include <kfs/signal.h>
+#include <kfs/smp.h>
+#include <kfs/spinlock.h>
 #include <kfs/stdint.h>
 #include <kfs/string.h>
+#include <kfs/wait.h>
 
 #define SHELL_PROMPT "kfs $ " /* シェルプロンプト文字列 */
 #define CMD_BUFFER_SIZE 256	  /* コマンドバッファのサイズ */
 #define PS2_STATUS_PORT 0x64 /* PS/2 コントローラのペリフェラルから受け取るステータスレジスタのポート番号 */
 #define PS2_RESET_COMMAND 0xFE /* PS/2 コントローラのリセットコマンド */
+#define INPUT_BUFFER_SIZE 256  /* 割り込みハンドラから受け取った未処理入力のバッファサイズ（2の累乗） */
+#define TOP_MAX_TASKS 32	   /* topが一度に表示するタスクの最大数 */
 
 /* シェルの状態を保持する構造体 */
 static struct
@@ -25,6 +36,19 @@ static struct
 	int initialized;				  /* 初期化済みフラグ */
 } shell_state;
 
+/** 割り込みハンドラからシェルスレッドへ渡す入力のリングバッファ
+ * @note 書き込みは割り込みハンドラ，読み出しはシェルスレッドだけが行う
+ */
+static struct
+{
+	char buf[INPUT_BUFFER_SIZE];
+	unsigned int head; /* 次に書き込む位置（単調増加） */
+	unsigned int tail; /* 次に読み出す位置（単調増加） */
+} shell_input;
+
+/* 入力を待つシェルスレッドの待ちキュー */
+static DECLARE_WAIT_QUEUE_HEAD(shell_input_wait);
+
 /* プロンプトを表示する。ユーザに入力待機状態を示すために必要 */
 static void show_prompt(void)
 {
@@ -105,6 +129,172 @@ void cmd_loadkeys(const char *args)
 	}
 }
 
+/* topが表示するタスク1つ分の値（タスクリストのロックの中で写し取る） */
+struct top_entry
+{
+	pid_t pid;
+	int nice;
+	char state;
+	int cpu;				 /* 登録先（眠っていれば最後に実行した）CPU */
+	uint64_t runtime;		 /* 累積実行時間（ナノ秒） */
+	uint64_t run_delay;		 /* 実行待ちの時間の合計（ナノ秒） */
+	unsigned long nvcsw;	 /* 自発的なコンテキストスイッチ */
+	unsigned long nivcsw;	 /* 非自発的なコンテキストスイッチ */
+	char comm[TASK_COMM_LEN];
+};
+
+/* topの表示用（シェルスレッドだけが使うためstaticに置き，スタックを節約する） */
+static struct top_entry top_entries[TOP_MAX_TASKS];
+
+/* タスクの状態を1文字で表す（R:実行可能，S:割り込み可能スリープ，D:割り込み不可スリープ，Z:ゾンビ，X:終了） */
+static char task_state_char(const struct task_struct *p)
+{
+	if (p->exit_state == EXIT_ZOMBIE)
+	{
+		return 'Z';
+	}
+	if (p->__state == TASK_RUNNING)
+	{
+		return 'R';
+	}
+	if (p->__state & TASK_INTERRUPTIBLE)
+	{
+		return 'S';
+	}
+	if (p->__state & TASK_UNINTERRUPTIBLE)
+	{
+		return 'D';
+	}
+	return 'X';
+}
+
+/* ナノ秒をミリ秒にする */
+static unsigned long ns_to_ms(uint64_t ns)
+{
+	return (unsigned long)div_u64(ns, 1000000);
+}
+
+/* ナノ秒をマイクロ秒にする */
+static unsigned long ns_to_us(uint64_t ns)
+{
+	return (unsigned long)div_u64(ns, 1000);
+}
+
+/* partがtotalに占める割合（0.1%単位） */
+static unsigned int permille(unsigned long part, unsigned long total)
+{
+	if (total == 0)
+	{
+		return 0;
+	}
+	return (unsigned int)div_u64((uint64_t)part * 1000, (uint32_t)total);
+}
+
+/** タスクをCPU時間の多い順に一覧表示する（top組み込みコマンド）
+ * @details 負荷平均，CPUのビジー率とアイドル率（全CPUの平均），CPUごとの実行可能なタスク数・負荷分散・休止の統計，
+ *          タスクごとのCPU（P），累積CPU時間と実行待ちの時間，コンテキストスイッチの回数を表示する．%CPUは起動からの平均
+ * @note アイドルタスク（PID 0）は一覧に載せず，その時間はidleに表示する．テスト用にstaticを外している
+ */
+void cmd_top(void)
+{
+	struct task_struct *p;
+	unsigned long loads[3];
+	unsigned long uptime_ms, idle_ms;
+	unsigned long flags;
+	unsigned int idle_pm;
+	int nr = 0, total = 0, running = 0;
+	int i, cpu;
+
+	spin_lock_irqsave(&tasklist_lock, flags);
+	list_for_each_entry(p, &task_list, tasks)
+	{
+		struct top_entry e;
+
+		if (p->pid == 0)
+		{
+			continue;
+		}
+		total++;
+		e.pid = p->pid;
+		e.nice = task_nice(p);
+		e.state = task_state_char(p);
+		e.cpu = task_cpu(p);
+		e.runtime = p->se.sum_exec_runtime;
+		e.run_delay = p->sched_info.run_delay;
+		e.nvcsw = p->nvcsw;
+		e.nivcsw = p->nivcsw;
+		strlcpy(e.comm, p->comm, sizeof(e.comm));
+		if (e.state == 'R')
+		{
+			running++;
+		}
+
+		/* 実行時間の多い順に挿入する（あふれた分は少ない方から捨てる） */
+		for (i = nr; i > 0 && top_entries[i - 1].runtime < e.runtime; i--)
+		{
+			if (i < TOP_MAX_TASKS)
+			{
+				top_entries[i] = top_entries[i - 1];
+			}
+		}
+		if (i < TOP_MAX_TASKS)
+		{
+			top_entries[i] = e;
+			if (nr < TOP_MAX_TASKS)
+			{
+				nr++;
+			}
+		}
+	}
+	spin_unlock_irqrestore(&tasklist_lock, flags);
+
+	uptime_ms = ns_to_ms(running_clock());
+	idle_ms = ns_to_ms(get_idle_time());
+	get_avenrun(loads, FIXED_1 / 200, 0);
+
+	printk("top - up %lu.%03lus, load average: %lu.%02lu, %lu.%02lu, %lu.%02lu\n", uptime_ms / 1000, uptime_ms % 1000,
+		   LOAD_INT(loads[0]), LOAD_FRAC(loads[0]), LOAD_INT(loads[1]), LOAD_FRAC(loads[1]), LOAD_INT(loads[2]),
+		   LOAD_FRAC(loads[2]));
+	printk("Tasks: %d total, %d running, %d sleeping\n", total, running, total - running);
+	idle_pm = permille(idle_ms, uptime_ms * num_online_cpus());
+	printk("Cpu: %u.%u%% busy, %u.%u%% idle, %lu context switches\n", (1000 - idle_pm) / 10, (1000 - idle_pm) % 10,
+		   idle_pm / 10, idle_pm % 10, nr_context_switches());
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+	{
+		struct cpuidle_stats st;
+		struct sched_lb_stats lb;
+
+		if (!cpu_online(cpu))
+		{
+			continue;
+		}
+		sched_get_lb_stats(cpu, &lb);
+		printk("CPU%d sched: %lu running, balance %lu (%lu failed), pulled %lu idle %lu busy, lost %lu, "
+			   "remote wakeups %lu, pushed %lu\n",
+			   cpu, nr_running_cpu(cpu), lb.lb_count, lb.lb_failed, lb.lb_gained_idle, lb.lb_gained_busy, lb.lb_lost,
+			   lb.wake_remote, lb.affinity_pushed);
+		cpuidle_get_stats(cpu, &st);
+		printk("CPU%d %s: %lu sleeps, %lu ms asleep, wakeup latency avg %lu us, max %lu us\n", cpu,
+			   idle_routine_name(), st.usage, ns_to_ms(st.time_ns),
+			   st.nr_wakeups ? ns_to_us(div_u64(st.wake_latency_ns, (uint32_t)st.nr_wakeups)) : 0UL,
+			   ns_to_us(st.max_wake_latency_ns));
+	}
+	printk("  PID  NI S  P  %%CPU  TIME(ms)  WAIT(ms)   VCSW  IVCSW COMMAND\n");
+	for (i = 0; i < nr; i++)
+	{
+		struct top_entry *e = &top_entries[i];
+		unsigned int cpu = permille(ns_to_ms(e->runtime), uptime_ms);
+
+		printk("%5u %c%2u %c %2d %3u.%u %9lu %9lu %6lu %6lu %s\n", (unsigned int)e->pid, e->nice < 0 ? '-' : ' ',
+			   (unsigned int)(e->nice < 0 ? -e->nice : e->nice), e->state, e->cpu, cpu / 10, cpu % 10, ns_to_ms(e->runtime),
+			   ns_to_ms(e->run_delay), e->nvcsw, e->nivcsw, e->comm);
+	}
+	if (total > nr)
+	{
+		printk("(%d more tasks not shown)\n", total - nr);
+	}
+}
+
 /* コマンドを実行する。入力された文字列を解析して対応する処理を行う */
 static void execute_command(const char *cmd)
 {
@@ -152,6 +342,20 @@ static void execute_command(const char *cmd)
 		return;
 	}
 
+	/* スピンロックの統計表示（make LOCK_STAT=1でビルドしたとき） */
+	if (strcmp(cmd, "lockstat") == 0)
+	{
+		lock_stat_show();
+		return;
+	}
+
+	/* タスクのCPU使用状況の表示 */
+	if (strcmp(cmd, "top") == 0)
+	{
+		cmd_top();
+		return;
+	}
+
 	/* kmalloc/kfreeテスト */
 	if (strcmp(cmd, "malloc") == 0)
 	{
@@ -437,8 +641,67 @@ void shell_init(void)
 	show_prompt();
 }
 
-/** シェルのメインループ
- * キーボード入力を受け付けてコマンドを処理する
+/** 入力をバッファに積んでシェルスレッドを起こす
+ * @param c 入力された文字
+ * @return 常に1（処理済み）
+ * @note キーボード・シリアルの割り込みハンドラから呼ばれる．バッファが一杯なら捨てる．
+ *       シェルスレッドは別のCPUで動きうるため，文字を書き終えてからheadを進めて公開する
+ */
+static int shell_input_handler(char c)
+{
+	unsigned int head = shell_input.head;
+
+	if (head - READ_ONCE(shell_input.tail) < INPUT_BUFFER_SIZE)
+	{
+		shell_input.buf[head % INPUT_BUFFER_SIZE] = c;
+		barrier();
+		WRITE_ONCE(shell_input.head, head + 1);
+	}
+	wake_up_interruptible(&shell_input_wait);
+	return 1;
+}
+
+/* 未処理の入力があるか（headは割り込みハンドラが別のCPUで進める） */
+static int shell_input_pending(void)
+{
+	return READ_ONCE(shell_input.head) != shell_input.tail;
+}
+
+/** シェルスレッド
+ * @details 入力が来るまで待ちキューで眠り，起こされたら溜まった入力をすべて処理する．
+ *          眠っている間はランキューから外れるため，CPUはアイドルループで休止できる
+ */
+static int shell_thread(void *arg)
+{
+	(void)arg;
+
+	for (;;)
+	{
+		if (wait_event_interruptible(shell_input_wait, shell_input_pending()) != 0)
+		{
+			/* シグナルで起こされた */
+			do_signal();
+			continue;
+		}
+
+		while (shell_input_pending())
+		{
+			char c;
+
+			/* headを読んだ後に文字を読み，読み終えてから枠を返す */
+			barrier();
+			c = shell_input.buf[shell_input.tail % INPUT_BUFFER_SIZE];
+			barrier();
+			WRITE_ONCE(shell_input.tail, shell_input.tail + 1);
+			shell_keyboard_handler(c);
+		}
+	}
+	return 0;
+}
+
+/** シェルを起動する
+ * @details シェルを専用のカーネルスレッドで動かし，呼び出し元（init_task）はアイドルループに入る．
+ *          キーボードとシリアルの入力は割り込みハンドラがバッファに積み，シェルスレッドを起こす
  *
  * この関数はweak symbolとして定義されており、
  * テスト環境では別の実装でオーバーライドできる
@@ -447,23 +710,19 @@ __attribute__((weak)) void shell_run(void)
 {
 	shell_init();
 
-	/* メインループ: 割り込みでキーボード入力を処理
-	 * hltでCPUを休止し、割り込みで起きる */
-	for (;;)
+	/* 入力の処理は割り込みハンドラではなくシェルスレッドで行う */
+	kfs_keyboard_set_handler(shell_input_handler);
+	if (serial_set_rx_handler(shell_input_handler) != 0)
 	{
-		/** シリアルポート入力を確認
-		 * @note シリアルI/Oはデバッグ用途のためIRQラインではなくポーリング方式を用いる
-		 */
-		int c = serial_read();
-		if (c != -1)
-		{
-			/* シリアルからの入力を処理（キーボードハンドラを再利用） */
-			shell_keyboard_handler((char)c);
-		}
+		printk(KERN_WARNING "shell: serial input unavailable\n");
+	}
 
-		/* CPUを休止して割り込みを待つ */
-		__asm__ __volatile__("hlt");
+	if (kernel_thread(shell_thread, NULL) < 0)
+	{
+		panic("shell: cannot create shell thread");
 	}
+
+	cpu_idle();
 }
 
 /* 単体テストやドライバがシェルの初期化状態を問い合わせるためのヘルパ */
@@ -1,16 +1,21 @@
+/** シグナル
+ * - Linux 2.6.11のkernel/signal.cに相当
+ * - ハンドラは送り先のtask->signal->actionに，保留中のシグナルはtask->pendingに持つ
+ * - 保留ビットの最下位をbsfで求めて取り出すため，処理はシグナルの総数ではなく保留中の数に比例する
+ */
+
+#include <asm-i386/bitops.h>
+#include <kfs/compiler.h>
+#include <kfs/pid.h>
+#include <kfs/printk.h>
+#include <kfs/sched.h>
 #include <kfs/signal.h>
+#include <kfs/slab.h>
+#include <kfs/spinlock.h>
 #include <kfs/stddef.h>
 
-/** シグナルアクションテーブル
- * @brief 各シグナルのハンドラを保持する
- */
-static struct sigaction sig_actions[_NSIG];
-
-/** 保留中シグナルのビットマスク
- * @brief 発生したがまだ処理されていないシグナル
- * @note マルチプロセス環境ではpending_signalsをプロセスごとに保有する
- */
-static unsigned long pending_signals;
+/* 保留中のリアルタイムシグナル（struct sigqueue）用スラブキャッシュ */
+static struct kmem_cache *sigqueue_cachep = NULL;
 
 /** シグナル番号が有効範囲内かを検証する
  * @param sig 検証するシグナル番号
@@ -22,14 +27,65 @@ static int valid_signal(int sig)
 	return sig > 0 && sig < _NSIG;
 }
 
+/** 保留中で番号が最も小さいシグナルを求める
+ * @param pending 保留中シグナルビットマスク
+ * @return シグナル番号，保留がなければ0
+ * @note 64ビットのマスクを下位・上位の32ビットに分け，それぞれbsf 1命令で調べる
+ */
+static int next_signal(uint64_t pending)
+{
+	uint32_t word = (uint32_t)pending;
+
+	if (word != 0)
+	{
+		return (int)__ffs(word);
+	}
+	word = (uint32_t)(pending >> 32);
+	if (word != 0)
+	{
+		return 32 + (int)__ffs(word);
+	}
+	return 0;
+}
+
+/** シグナル状態を初期化する
+ * @details sigqueue用のスラブキャッシュを作り，現在のタスクの保留シグナルを空にする
+ * @note Slabアロケータの初期化後に呼ぶ
+ */
+void signals_init(void)
+{
+	sigqueue_cachep = kmem_cache_create("sigqueue", sizeof(struct sigqueue));
+	init_sigpending(&current->pending);
+}
+
+/** 保留中のシグナルをすべて捨てる
+ * @param pending 捨てる保留シグナル
+ * @details 積まれたsigqueueをキャッシュに返し，保留ビットを下ろす
+ * @note 終了したタスクの回収時に呼ぶ．もうシグナルが送られないタスクに対してだけ使う
+ */
+void flush_sigqueue(struct sigpending *pending)
+{
+	struct sigqueue *q, *n;
+
+	list_for_each_entry_safe(q, n, &pending->list, list)
+	{
+		list_del(&q->list);
+		kmem_cache_free(sigqueue_cachep, q);
+	}
+	pending->signal = 0;
+}
+
 /** シグナルハンドラを登録する
  * @param sig シグナル番号
  * @param handler 登録するハンドラ関数
  * @return 以前のハンドラ，エラー時はSIG_ERR
+ * @note 現在のタスクのsignal_structに登録する
  */
 sighandler_t signal(int sig, sighandler_t handler)
 {
+	struct signal_struct *sigs = current->signal;
 	sighandler_t old_handler;
+	unsigned long flags;
 
 	/* シグナル番号の有効性を検証 */
 	if (!valid_signal(sig))
@@ -43,62 +99,158 @@ sighandler_t signal(int sig, sighandler_t handler)
 		return SIG_ERR;
 	}
 
+	spin_lock_irqsave(&sigs->siglock, flags);
+
 	/* 以前のハンドラを帰り値として保存する */
-	old_handler = sig_actions[sig].sa_handler;
+	old_handler = sigs->action[sig].sa_handler;
 
 	/* 新しいハンドラを設定する */
-	sig_actions[sig].sa_handler = handler;
+	sigs->action[sig].sa_handler = handler;
+
+	spin_unlock_irqrestore(&sigs->siglock, flags);
 
 	return old_handler;
 }
 
-/** シグナルを発生させる
- * @brief シグナルを保留キューに追加する
- * @param sig 発生させるシグナル番号
- * @return 成功時は0、エラー時は-1
+/** タスクにシグナルを送る
+ * @param sig 送るシグナル番号
+ * @param p   送り先のタスク
+ * @return 成功時は0，エラー時は-1
+ * @details 保留ビットを立て，リアルタイムシグナルならsigqueueも積む．
+ *          送り先がTASK_INTERRUPTIBLEで眠っていれば起こし，シグナルに気づかせる
+ * @note 割り込みハンドラからも呼べる
  */
-int raise(int sig)
+int send_sig(int sig, struct task_struct *p)
 {
+	struct sigqueue *q = NULL;
+	unsigned long flags;
+
 	/* シグナル番号の有効性を検証 */
-	if (!valid_signal(sig))
+	if (!valid_signal(sig) || p == NULL || p->signal == NULL)
 	{
 		return -1;
 	}
 
-	/* 保留シグナルビットマスクに該当シグナルをセット */
-	pending_signals |= (1UL << sig);
+	/* リアルタイムシグナルは回数を失わないよう，送るたびにキューに積む（割り当てはロックの外で行う） */
+	if (sig >= SIGRTMIN)
+	{
+		q = kmem_cache_alloc(sigqueue_cachep);
+		if (q == NULL)
+		{
+			printk(KERN_WARNING "signal: failed to queue signal %d for pid %d\n", sig, p->pid);
+			return -1;
+		}
+		q->sig = sig;
+	}
 
+	spin_lock_irqsave(&p->signal->siglock, flags);
+	if (q != NULL)
+	{
+		list_add_tail(&q->list, &p->pending.list);
+	}
+	p->pending.signal |= sigmask(sig);
+	spin_unlock_irqrestore(&p->signal->siglock, flags);
+
+	try_to_wake_up(p, TASK_INTERRUPTIBLE);
 	return 0;
 }
 
-/** 保留中シグナルを処理する
- * @brief カーネル内部で呼び出され，登録済みハンドラを実行する
+/** PIDで指定したタスクにシグナルを送る
+ * @param pid 送り先のプロセスID
+ * @param sig 送るシグナル番号
+ * @return 成功時は0，タスクが見つからないかエラー時は-1
+ * @note 送る間に他のCPUで終了・回収されないよう，タスクの参照を持つ
  */
-void do_signal(void)
+int kill_proc(pid_t pid, int sig)
 {
+	struct task_struct *p = find_get_task_by_pid(pid);
+	int ret;
+
+	if (p == NULL)
+	{
+		return -1;
+	}
+	ret = send_sig(sig, p);
+	put_task_struct(p);
+	return ret;
+}
+
+/** シグナルを発生させる
+ * @brief 現在のタスクにシグナルを保留する
+ * @param sig 発生させるシグナル番号
+ * @return 成功時は0、エラー時は-1
+ */
+int raise(int sig)
+{
+	return send_sig(sig, current);
+}
+
+/** 保留中で番号が最も小さいシグナルを1つ取り出す
+ * @param tsk     取り出すタスク
+ * @param handler 取り出したシグナルのハンドラの格納先
+ * @return シグナル番号，保留がなければ0
+ * @details リアルタイムシグナルはキューから1つ外し，同じ番号がもう残っていないときだけ保留ビットを下ろす
+ */
+static int dequeue_signal(struct task_struct *tsk, sighandler_t *handler)
+{
+	struct sigpending *pending = &tsk->pending;
+	struct sigqueue *q, *found = NULL;
+	unsigned long flags;
 	int sig;
-	sighandler_t handler;
 
-	/* 保留シグナルがなければ何もしない */
-	if (pending_signals == 0)
+	spin_lock_irqsave(&tsk->signal->siglock, flags);
+	sig = next_signal(pending->signal);
+	if (sig == 0)
 	{
-		return;
+		spin_unlock_irqrestore(&tsk->signal->siglock, flags);
+		return 0;
 	}
 
-	/* 各シグナルを順番にチェックして処理 */
-	for (sig = 1; sig < _NSIG; sig++)
+	pending->signal &= ~sigmask(sig);
+	if (sig >= SIGRTMIN)
 	{
-		/* このシグナルが保留中でなければスキップ */
-		if (!(pending_signals & (1UL << sig)))
+		list_for_each_entry(q, &pending->list, list)
 		{
-			continue;
+			if (q->sig != sig)
+			{
+				continue;
+			}
+			if (found == NULL)
+			{
+				found = q;
+				continue;
+			}
+			/* 同じ番号がまだ積まれている */
+			pending->signal |= sigmask(sig);
+			break;
 		}
+		if (found != NULL)
+		{
+			list_del(&found->list);
+		}
+	}
 
-		/* 保留ビットをクリア（処理済みにする） */
-		pending_signals &= ~(1UL << sig);
+	*handler = tsk->signal->action[sig].sa_handler;
+	spin_unlock_irqrestore(&tsk->signal->siglock, flags);
+
+	if (found != NULL)
+	{
+		kmem_cache_free(sigqueue_cachep, found);
+	}
+	return sig;
+}
 
-		handler = sig_actions[sig].sa_handler;
+/** 保留中シグナルを処理する
+ * @brief カーネル内部で呼び出され，現在のタスクの登録済みハンドラを実行する
+ */
+void do_signal(void)
+{
+	int sig;
+	sighandler_t handler;
 
+	/* 保留中のシグナルを番号の小さいものから1つずつ取り出して処理 */
+	while ((sig = dequeue_signal(current, &handler)) != 0)
+	{
 		/* SIG_IGNなら無視 */
 		if (handler == SIG_IGN)
 		{
@@ -108,7 +260,7 @@ void do_signal(void)
 		/* SIG_DFLならデフォルト動作 */
 		if (handler == SIG_DFL)
 		{
-			/* シグナル送信対象(プロセス)を定義したとき，シグナルごとのデフォルト動作を実装する */
+			/* プロセスの終了を実装したとき，シグナルごとのデフォルト動作を実装する */
 			continue;
 		}
 
@@ -118,9 +270,9 @@ void do_signal(void)
 }
 
 /** シグナルが保留中かどうかを確認する
- * @return 保留中のシグナルがあれば1、なければ0
+ * @return 現在のタスクに保留中のシグナルがあれば1、なければ0
  */
 int signal_pending(void)
 {
-	return pending_signals != 0;
+	return READ_ONCE(current->pending.signal) != 0;
 }
@@ -0,0 +1,196 @@
+/** スピンロック
+ * - Linux 2.6.11のkernel/spinlock.cに相当
+ * - 取得の前にプリエンプション（と割り込み）を禁止し，解放の後に元に戻す
+ * - CONFIG_LOCK_STAT（make LOCK_STAT=1）では，保持しているCPUと取得元，取得・競合回数を記録し，
+ *   同じCPUでの二重取得（割り込みハンドラが，割り込まれた文脈が持つロックを取る場合を含む）を検出する
+ */
+
+#include <asm-i386/system.h>
+#include <kfs/panic.h>
+#include <kfs/preempt.h>
+#include <kfs/printk.h>
+#include <kfs/smp.h>
+#include <kfs/spinlock.h>
+
+#ifdef CONFIG_LOCK_STAT
+
+#include <asm-i386/tsc.h>
+
+/* 一度でも取得された名前付きロックの一覧 */
+static LIST_HEAD(lock_stat_list);
+static arch_spinlock_t lock_stat_list_lock = __ARCH_SPIN_LOCK_UNLOCKED;
+
+/** ロックを取得して統計を記録する
+ * @param ip 取得元（spin_lock*()の呼び出し元）
+ * @details まず1度だけ取得を試み，取れなかったときだけ待ち時間を測る
+ */
+static void do_spin_lock(spinlock_t *lock, void *ip)
+{
+	if (arch_spin_is_locked(&lock->raw_lock) && READ_ONCE(lock->owner_cpu) == smp_processor_id())
+	{
+		panic("spin_lock: recursive lock %s (held at %p, taken again at %p)",
+			  lock->name ? lock->name : "(anonymous)", lock->owner_ip, ip);
+	}
+
+	if (!arch_spin_trylock(&lock->raw_lock))
+	{
+		uint64_t start = rdtsc();
+		unsigned long wait;
+
+		arch_spin_lock(&lock->raw_lock);
+		wait = (unsigned long)(rdtsc() - start);
+		lock->nr_contended++;
+		if (wait > lock->max_wait)
+		{
+			lock->max_wait = wait;
+		}
+	}
+
+	lock->owner_cpu = smp_processor_id();
+	lock->owner_ip = ip;
+	lock->nr_acquired++;
+	if (lock->name != NULL && list_empty(&lock->stat_list))
+	{
+		arch_spin_lock(&lock_stat_list_lock);
+		list_add_tail(&lock->stat_list, &lock_stat_list);
+		arch_spin_unlock(&lock_stat_list_lock);
+	}
+}
+
+/* 統計を記録して1度だけ取得を試みる */
+static int do_spin_trylock(spinlock_t *lock, void *ip)
+{
+	if (!arch_spin_trylock(&lock->raw_lock))
+	{
+		return 0;
+	}
+	lock->owner_cpu = smp_processor_id();
+	lock->owner_ip = ip;
+	lock->nr_acquired++;
+	return 1;
+}
+
+/* 保持者の記録を消してから解放する */
+static void do_spin_unlock(spinlock_t *lock)
+{
+	lock->owner_cpu = -1;
+	lock->owner_ip = NULL;
+	arch_spin_unlock(&lock->raw_lock);
+}
+
+/** 名前付きロックの統計を表示する
+ * @details 取得回数，競合回数，最長の待ちサイクル数，現在の保持CPU（空きなら-）を1行ずつ表示する
+ */
+void lock_stat_show(void)
+{
+	spinlock_t *lock;
+
+	printk("  acquired contended  max-wait cpu name\n");
+	arch_spin_lock(&lock_stat_list_lock);
+	list_for_each_entry(lock, &lock_stat_list, stat_list)
+	{
+		int cpu = READ_ONCE(lock->owner_cpu);
+
+		printk("%10lu %9lu %9lu ", lock->nr_acquired, lock->nr_contended, lock->max_wait);
+		if (cpu < 0)
+		{
+			printk("  - %s\n", lock->name);
+		}
+		else
+		{
+			printk("%3u %s\n", (unsigned int)cpu, lock->name);
+		}
+	}
+	arch_spin_unlock(&lock_stat_list_lock);
+}
+
+#else /* !CONFIG_LOCK_STAT */
+
+static inline void do_spin_lock(spinlock_t *lock, void *ip)
+{
+	(void)ip;
+	arch_spin_lock(&lock->raw_lock);
+}
+
+static inline int do_spin_trylock(spinlock_t *lock, void *ip)
+{
+	(void)ip;
+	return arch_spin_trylock(&lock->raw_lock);
+}
+
+static inline void do_spin_unlock(spinlock_t *lock)
+{
+	arch_spin_unlock(&lock->raw_lock);
+}
+
+void lock_stat_show(void)
+{
+	printk("lockstat: not available (build with LOCK_STAT=1)\n");
+}
+
+#endif /* CONFIG_LOCK_STAT */
+
+/* プリエンプションを禁止してロックを取得する */
+void _spin_lock(spinlock_t *lock)
+{
+	preempt_disable();
+	do_spin_lock(lock, __builtin_return_address(0));
+}
+
+/** 1度だけ取得を試みる
+ * @return 取得できたら1，できなければ0（プリエンプションの禁止も戻す）
+ */
+int _spin_trylock(spinlock_t *lock)
+{
+	preempt_disable();
+	if (do_spin_trylock(lock, __builtin_return_address(0)))
+	{
+		return 1;
+	}
+	preempt_enable();
+	return 0;
+}
+
+/* ロックを解放し，プリエンプションを許可する */
+void _spin_unlock(spinlock_t *lock)
+{
+	do_spin_unlock(lock);
+	preempt_enable();
+}
+
+/* 割り込みとプリエンプションを禁止してロックを取得する */
+void _spin_lock_irq(spinlock_t *lock)
+{
+	local_irq_disable();
+	preempt_disable();
+	do_spin_lock(lock, __builtin_return_address(0));
+}
+
+/* ロックを解放し，割り込みとプリエンプションを許可する */
+void _spin_unlock_irq(spinlock_t *lock)
+{
+	do_spin_unlock(lock);
+	local_irq_enable();
+	preempt_enable();
+}
+
+/** EFLAGSを保存し，割り込みとプリエンプションを禁止してロックを取得する
+ * @return 保存したEFLAGS（_spin_unlock_irqrestore()に渡す）
+ */
+unsigned long _spin_lock_irqsave(spinlock_t *lock)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	preempt_disable();
+	do_spin_lock(lock, __builtin_return_address(0));
+	return flags;
+}
+
+/* ロックを解放し，EFLAGSとプリエンプションを元に戻す */
+void _spin_unlock_irqrestore(spinlock_t *lock, unsigned long flags)
+{
+	do_spin_unlock(lock);
+	local_irq_restore(flags);
+	preempt_enable();
+}
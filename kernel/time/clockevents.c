@@ -0,0 +1,150 @@
+/** クロックイベントデバイスの管理
+ * - Linux 6.18のkernel/time/clockevents.cに相当
+ * - ナノ秒⇔サイクル変換と状態遷移をデバイスドライバから切り離す
+ */
+
+#include <asm-i386/div64.h>
+#include <kfs/clockchips.h>
+#include <kfs/stddef.h>
+#include <kfs/time.h>
+
+/* ワンショットで設定する最短時間の下限（割り込み処理より短い間隔は意味がない） */
+#define CLOCKEVENT_MIN_DELTA_NS 1000ULL
+
+/** サイクル数をナノ秒に変換する
+ * @param cycles デバイスのサイクル数
+ * @param dev    クロックイベントデバイス（mult/shift設定済み）
+ * @return cyclesに相当するナノ秒
+ */
+uint64_t clockevent_delta2ns(unsigned long cycles, const struct clock_event_device *dev)
+{
+	uint64_t ns = (uint64_t)cycles << dev->shift;
+
+	do_div(ns, dev->mult);
+	if (ns < CLOCKEVENT_MIN_DELTA_NS)
+	{
+		ns = CLOCKEVENT_MIN_DELTA_NS;
+	}
+	return ns;
+}
+
+/** 周波数からmult/shiftと設定可能な時間範囲を計算する
+ * @param dev  クロックイベントデバイス（min/max_delta_ticks設定済み）
+ * @param freq デバイスの周波数（Hz）
+ * @note shiftは32に固定する．mult = freq * 2^32 / 10^9 がuint32_tに収まるよう，
+ *       freqは1GHz未満であること
+ */
+void clockevents_config(struct clock_event_device *dev, uint32_t freq)
+{
+	uint64_t mult = (uint64_t)freq << 32;
+
+	do_div(mult, NSEC_PER_SEC);
+	dev->shift = 32;
+	dev->mult = (uint32_t)mult;
+	if (dev->mult == 0)
+	{
+		dev->mult = 1;
+	}
+
+	dev->min_delta_ns = clockevent_delta2ns(dev->min_delta_ticks, dev);
+	dev->max_delta_ns = clockevent_delta2ns(dev->max_delta_ticks, dev);
+}
+
+/* 使われていないデバイスの割り込みハンドラ */
+void clockevents_handle_noop(struct clock_event_device *dev)
+{
+	(void)dev;
+}
+
+/** デバイスの状態を切り替える
+ * @param dev   クロックイベントデバイス
+ * @param state CLOCK_EVT_STATE_*
+ * @note 対応していないモードへの切り替えは無視する
+ */
+void clockevents_switch_state(struct clock_event_device *dev, int state)
+{
+	if (dev->state == state)
+	{
+		return;
+	}
+
+	switch (state)
+	{
+	case CLOCK_EVT_STATE_PERIODIC:
+		if (!(dev->features & CLOCK_EVT_FEAT_PERIODIC) || !dev->set_state_periodic)
+		{
+			return;
+		}
+		dev->set_state_periodic(dev);
+		break;
+	case CLOCK_EVT_STATE_ONESHOT:
+		if (!(dev->features & CLOCK_EVT_FEAT_ONESHOT) || !dev->set_state_oneshot)
+		{
+			return;
+		}
+		dev->set_state_oneshot(dev);
+		break;
+	case CLOCK_EVT_STATE_SHUTDOWN:
+	case CLOCK_EVT_STATE_DETACHED:
+		if (dev->set_state_shutdown)
+		{
+			dev->set_state_shutdown(dev);
+		}
+		break;
+	default:
+		return;
+	}
+	dev->state = state;
+}
+
+/** delta_ns後に割り込みが発生するようデバイスを設定する
+ * @param dev      ワンショットモードのクロックイベントデバイス
+ * @param delta_ns 割り込みまでの時間（ナノ秒）
+ * @return 0: 成功, -1: ワンショットモードでない
+ * @note delta_nsはデバイスの設定可能範囲に丸める
+ */
+int clockevents_program_event(struct clock_event_device *dev, uint64_t delta_ns)
+{
+	uint64_t cycles;
+
+	if (dev->state != CLOCK_EVT_STATE_ONESHOT || !dev->set_next_event)
+	{
+		return -1;
+	}
+
+	if (delta_ns > dev->max_delta_ns)
+	{
+		delta_ns = dev->max_delta_ns;
+	}
+	if (delta_ns < dev->min_delta_ns)
+	{
+		delta_ns = dev->min_delta_ns;
+	}
+
+	cycles = (delta_ns * dev->mult) >> dev->shift;
+	if (cycles < dev->min_delta_ticks)
+	{
+		cycles = dev->min_delta_ticks;
+	}
+	if (cycles > dev->max_delta_ticks)
+	{
+		cycles = dev->max_delta_ticks;
+	}
+
+	return dev->set_next_event((unsigned long)cycles, dev);
+}
+
+/** クロックイベントデバイスを登録する
+ * @param dev 登録するデバイス（clockevents_config()済み）
+ * @details tick層に渡し，現在のtickデバイスより優先度が高ければ置き換える
+ */
+void clockevents_register_device(struct clock_event_device *dev)
+{
+	dev->state = CLOCK_EVT_STATE_DETACHED;
+	if (!dev->event_handler)
+	{
+		dev->event_handler = clockevents_handle_noop;
+	}
+
+	tick_check_new_device(dev);
+}
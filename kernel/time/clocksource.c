@@ -0,0 +1,133 @@
+/** クロックソースの管理
+ * - Linux 6.18のkernel/time/clocksource.cに相当
+ * - 登録されたクロックソースから最も優先度の高いものを選び，timekeeping層に渡す
+ */
+
+#include <asm-i386/div64.h>
+#include <asm-i386/system.h>
+#include <kfs/clocksource.h>
+#include <kfs/stddef.h>
+#include <kfs/time.h>
+
+/** 時刻を更新せずに済む最長時間（秒）
+ * @details timekeeping層は(delta * mult)を64ビットで計算するため，
+ *          この時間分のサイクル数を掛けても桁あふれしないようmultを選ぶ
+ */
+#define CLOCKSOURCE_MAX_IDLE_SEC 600
+
+/* 登録済みクロックソースのリスト */
+static struct clocksource *clocksource_list;
+
+/** fromHzのカウンタをtoHzに変換するmult/shiftを計算する
+ * @param mult   乗数の格納先
+ * @param shift  シフト量の格納先
+ * @param from   変換元の周波数
+ * @param to     変換先の周波数（ナノ秒ならNSEC_PER_SEC）
+ * @param maxsec 桁あふれせずに変換できるべき時間（fromの単位で数えた秒数）
+ * @details maxsec分のサイクル数とmultの積が64ビットに収まる範囲で，精度が最も高い（shiftが最も大きい）値を選ぶ
+ * @note Linux 6.18のclocks_calc_mult_shift()と同じアルゴリズム
+ */
+void clocks_calc_mult_shift(uint32_t *mult, uint32_t *shift, uint32_t from, uint32_t to, uint32_t maxsec)
+{
+	uint64_t tmp;
+	uint32_t sft, sftacc = 32;
+
+	/* maxsec分のサイクル数が32ビットを超える分だけ，multに使えるビット数を減らす */
+	tmp = ((uint64_t)maxsec * from) >> 32;
+	while (tmp)
+	{
+		tmp >>= 1;
+		sftacc--;
+	}
+
+	for (sft = 32; sft > 0; sft--)
+	{
+		tmp = (uint64_t)to << sft;
+		tmp += from / 2;
+		do_div(tmp, from);
+		if ((tmp >> sftacc) == 0)
+		{
+			break;
+		}
+	}
+	*mult = (uint32_t)tmp;
+	*shift = sft;
+}
+
+/* 最も優先度の高いクロックソースをtimekeeping層に使わせる */
+static void clocksource_select(void)
+{
+	struct clocksource *cs;
+	struct clocksource *best = NULL;
+
+	for (cs = clocksource_list; cs; cs = cs->next)
+	{
+		if (!best || cs->rating > best->rating)
+		{
+			best = cs;
+		}
+	}
+
+	if (best && best != timekeeping_get_clocksource())
+	{
+		timekeeping_notify(best);
+	}
+}
+
+/** mult/shift設定済みのクロックソースを登録する
+ * @param cs 登録するクロックソース
+ */
+void clocksource_register(struct clocksource *cs)
+{
+	struct clocksource *pos;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	for (pos = clocksource_list; pos; pos = pos->next)
+	{
+		if (pos == cs)
+		{
+			/* 登録済み */
+			local_irq_restore(flags);
+			return;
+		}
+	}
+	cs->next = clocksource_list;
+	clocksource_list = cs;
+	clocksource_select();
+	local_irq_restore(flags);
+}
+
+/** 周波数からmult/shiftを計算してクロックソースを登録する
+ * @param cs  登録するクロックソース
+ * @param khz カウンタの周波数（kHz）
+ * @note 4GHzを超えるTSCも表せるようkHz単位で受け取る
+ */
+void clocksource_register_khz(struct clocksource *cs, uint32_t khz)
+{
+	clocks_calc_mult_shift(&cs->mult, &cs->shift, khz, NSEC_PER_MSEC, CLOCKSOURCE_MAX_IDLE_SEC * MSEC_PER_SEC);
+	clocksource_register(cs);
+}
+
+/** クロックソースの登録を解除する
+ * @param cs 解除するクロックソース
+ * @note 使用中だった場合は次に優先度の高いものに切り替わる
+ */
+void clocksource_unregister(struct clocksource *cs)
+{
+	struct clocksource **pp;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	for (pp = &clocksource_list; *pp; pp = &(*pp)->next)
+	{
+		if (*pp == cs)
+		{
+			*pp = cs->next;
+			cs->next = NULL;
+			break;
+		}
+	}
+	clocksource_select();
+	local_irq_restore(flags);
+}
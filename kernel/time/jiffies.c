@@ -0,0 +1,31 @@
+/** jiffiesクロックソース
+ * - Linux 6.18のkernel/time/jiffies.cに相当
+ * - TSCが使えない環境でも時刻が読めるよう，tickの回数を最低優先度のクロックソースにする
+ */
+
+#include <kfs/clocksource.h>
+#include <kfs/jiffies.h>
+
+/* multを大きくして精度を保つためのシフト量（TICK_NSEC << 8 が32ビットに収まる） */
+#define JIFFIES_SHIFT 8
+
+static uint64_t jiffies_read(struct clocksource *cs)
+{
+	(void)cs;
+	return (uint64_t)jiffies;
+}
+
+static struct clocksource clocksource_jiffies = {
+	.name = "jiffies",
+	.rating = 1,
+	.read = jiffies_read,
+	.mask = CLOCKSOURCE_MASK(32),
+	.mult = TICK_NSEC << JIFFIES_SHIFT,
+	.shift = JIFFIES_SHIFT,
+};
+
+/* jiffiesクロックソースを登録する */
+void init_jiffies_clocksource(void)
+{
+	clocksource_register(&clocksource_jiffies);
+}
@@ -0,0 +1,26 @@
+/**
+ * tick-sched.h - tickless idleの状態
+ *
+ * kernel/time/配下のみで使用する内部定義
+ * @see Linux 6.18: kernel/time/tick-sched.h
+ */
+#ifndef _KERNEL_TIME_TICK_SCHED_H
+#define _KERNEL_TIME_TICK_SCHED_H
+
+#include <kfs/stdint.h>
+
+/** tickless idleの状態と統計 */
+struct tick_sched
+{
+	int tick_stopped;			/* idle中で周期tickを止めている */
+	int expired;				/* 止めている間にワンショットが満了した */
+	uint64_t sleep_length_ns;	/* idle突入時にプログラムした時間 */
+	uint64_t carry_ns;			/* jiffiesに反映しきれなかった1 tick未満の端数 */
+	unsigned long idle_calls;	/* tick_nohz_idle_enter()の呼び出し回数 */
+	unsigned long idle_sleeps;	/* 実際にtickを止めた回数 */
+	unsigned long idle_jiffies; /* tickを止めていた間に経過したtick数の合計 */
+};
+
+struct tick_sched *tick_get_tick_sched(void);
+
+#endif /* _KERNEL_TIME_TICK_SCHED_H */
@@ -0,0 +1,249 @@
+/** 周期tickとtickless idle
+ * - Linux 6.18のkernel/time/tick-common.c, tick-sched.cに相当
+ * - CPUごとに，そのCPUで登録されたクロックイベントデバイスのうち最も優先度の高いものでHZ回/秒のtickを発生させる
+ * - jiffiesと壁時計はTICK_DO_TIMER_CPUのtickだけが進め，他のCPUのtickはスケジューラだけを動かす
+ * - idle中は周期tickを止め，ワンショットで次のイベントだけを設定する
+ */
+
+#include <asm-i386/div64.h>
+#include <asm-i386/system.h>
+#include <kfs/clockchips.h>
+#include <kfs/clocksource.h>
+#include <kfs/jiffies.h>
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/stddef.h>
+#include <kfs/string.h>
+#include <kfs/time.h>
+
+#include "tick-sched.h"
+
+/** tickを止めておく最長時間（ナノ秒）
+ * @note タイマーリストがまだないため，次のイベントはこの上限で決める．
+ *       シェルは起床のたびにシリアルポートをポーリングするので，入力の遅延もこの時間が上限となる
+ */
+#define TICK_NOHZ_MAX_SLEEP_NS NSEC_PER_SEC
+
+/** jiffiesと壁時計を進めるCPU
+ * @note PITの割り込みもBSPにしか届かないため，BSPに固定する
+ */
+#define TICK_DO_TIMER_CPU 0
+
+/* 起動からのtick数 */
+volatile unsigned long jiffies;
+
+/* CPUごとのtickを発生させているデバイス */
+static struct clock_event_device *tick_devices[NR_CPUS];
+
+/* CPUごとのtickless idleの状態 */
+static struct tick_sched tick_scheds[NR_CPUS];
+
+/* 自CPUの現在のtickデバイスを取得する */
+struct clock_event_device *tick_get_device(void)
+{
+	return tick_devices[smp_processor_id()];
+}
+
+/* 自CPUのtickless idleの状態を取得する */
+struct tick_sched *tick_get_tick_sched(void)
+{
+	return &tick_scheds[smp_processor_id()];
+}
+
+/** 1 tick分の処理
+ * @details TICK_DO_TIMER_CPUならjiffiesと時刻の基準点を進め，どのCPUでもスケジューラに実行時間を計上させる
+ */
+static void tick_periodic(void)
+{
+	if (smp_processor_id() == TICK_DO_TIMER_CPU)
+	{
+		jiffies++;
+		update_wall_time();
+	}
+	scheduler_tick();
+}
+
+/** 周期tickの割り込みハンドラ
+ * @param dev tickデバイス
+ * @note ワンショットしか持たないデバイスでは，ここで次のtickを設定し直す
+ */
+void tick_handle_periodic(struct clock_event_device *dev)
+{
+	tick_periodic();
+
+	if (dev->state == CLOCK_EVT_STATE_ONESHOT)
+	{
+		clockevents_program_event(dev, TICK_NSEC);
+	}
+}
+
+/* tickを止めている間の割り込みハンドラ（経過時間はidle復帰時にまとめて反映する） */
+static void tick_nohz_handler(struct clock_event_device *dev)
+{
+	(void)dev;
+	tick_get_tick_sched()->expired = 1;
+}
+
+/** デバイスでHZ回/秒のtickを開始する
+ * @param dev tickデバイス
+ * @note 周期モードがなければワンショットで1 tickずつ設定する
+ */
+static void tick_setup_periodic(struct clock_event_device *dev)
+{
+	dev->event_handler = tick_handle_periodic;
+
+	if (dev->features & CLOCK_EVT_FEAT_PERIODIC)
+	{
+		clockevents_switch_state(dev, CLOCK_EVT_STATE_PERIODIC);
+	}
+	else
+	{
+		clockevents_switch_state(dev, CLOCK_EVT_STATE_ONESHOT);
+		clockevents_program_event(dev, TICK_NSEC);
+	}
+}
+
+/** 新しく登録されたデバイスを自CPUのtickデバイスにするか判断する
+ * @param dev 登録されたデバイス（割り込みが自CPUに届くもの）
+ * @details 現在のtickデバイスより優先度が高ければ，古いデバイスを止めて置き換える
+ */
+void tick_check_new_device(struct clock_event_device *dev)
+{
+	struct clock_event_device **tick_device = &tick_devices[smp_processor_id()];
+	unsigned long flags;
+
+	if (*tick_device && (*tick_device)->rating >= dev->rating)
+	{
+		return;
+	}
+
+	local_irq_save(flags);
+	if (*tick_device)
+	{
+		(*tick_device)->event_handler = clockevents_handle_noop;
+		clockevents_switch_state(*tick_device, CLOCK_EVT_STATE_SHUTDOWN);
+	}
+	*tick_device = dev;
+	tick_setup_periodic(dev);
+	local_irq_restore(flags);
+}
+
+/** idleに入る前に周期tickを止める
+ * @details 実行可能なタスクがなければデバイスをワンショットモードにし，
+ *          TICK_NOHZ_MAX_SLEEP_NS後にだけ割り込みが来るよう設定する．
+ *          これにより，idle中のCPUがHZ回/秒起こされることはない．
+ *          TICK_DO_TIMER_CPUは，他のCPUにも実行可能なタスクがいなくなるまで止めない（sched_can_stop_tick()）
+ * @note 割り込み禁止状態で呼び，直後にsti; hltすること
+ */
+void tick_nohz_idle_enter(void)
+{
+	struct clock_event_device *dev = tick_get_device();
+	struct tick_sched *ts = tick_get_tick_sched();
+	uint64_t delta = TICK_NOHZ_MAX_SLEEP_NS;
+
+	ts->idle_calls++;
+
+	if (!dev || !(dev->features & CLOCK_EVT_FEAT_ONESHOT) || !sched_can_stop_tick())
+	{
+		return;
+	}
+
+	if (delta > dev->max_delta_ns)
+	{
+		delta = dev->max_delta_ns;
+	}
+
+	clockevents_switch_state(dev, CLOCK_EVT_STATE_ONESHOT);
+	dev->event_handler = tick_nohz_handler;
+	ts->expired = 0;
+	if (clockevents_program_event(dev, delta) < 0)
+	{
+		tick_setup_periodic(dev);
+		return;
+	}
+
+	ts->sleep_length_ns = delta;
+	ts->tick_stopped = 1;
+	ts->idle_sleeps++;
+}
+
+/** idleから戻ったときに周期tickを再開する
+ * @details ワンショットが満了していれば設定した時間全体を，
+ *          他の割り込みで起こされた場合はデバイスの残り時間から経過時間を求め，
+ *          その分のtickをランキュー時刻に（TICK_DO_TIMER_CPUならjiffiesにも）まとめて加える．
+ *          他のCPUがタスクを実行し始めるときにTICK_DO_TIMER_CPUがtickを止めていれば，
+ *          jiffiesが進まなくならないよう，再スケジュールIPIで起こして周期tickに戻させる
+ */
+void tick_nohz_idle_exit(void)
+{
+	int cpu = smp_processor_id();
+	struct clock_event_device *dev = tick_devices[cpu];
+	struct tick_sched *ts = &tick_scheds[cpu];
+	uint64_t elapsed;
+	unsigned long ticks;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (cpu != TICK_DO_TIMER_CPU && READ_ONCE(tick_scheds[TICK_DO_TIMER_CPU].tick_stopped))
+	{
+		smp_send_reschedule(TICK_DO_TIMER_CPU);
+	}
+	if (!ts->tick_stopped)
+	{
+		local_irq_restore(flags);
+		return;
+	}
+
+	elapsed = ts->sleep_length_ns;
+	if (!ts->expired)
+	{
+		uint64_t remaining;
+
+		/* 残り時間が読めないデバイスでは経過時間は0とみなす */
+		if (!dev->read_remaining)
+		{
+			elapsed = 0;
+		}
+		else
+		{
+			remaining = (uint64_t)dev->read_remaining(dev) << dev->shift;
+			do_div(remaining, dev->mult);
+			elapsed = remaining < elapsed ? elapsed - remaining : 0;
+		}
+	}
+
+	elapsed += ts->carry_ns;
+	ts->carry_ns = do_div(elapsed, TICK_NSEC);
+	ticks = (unsigned long)elapsed;
+
+	if (cpu == TICK_DO_TIMER_CPU)
+	{
+		jiffies += ticks;
+		update_wall_time();
+	}
+	scheduler_idle_ticks(ticks);
+	ts->idle_jiffies += ticks;
+	ts->tick_stopped = 0;
+
+	tick_setup_periodic(dev);
+	local_irq_restore(flags);
+}
+
+/** テスト用: 自CPUのtickデバイスを止めて状態を初期化する
+ * @note 各テストが自前のデバイスを登録できるようにする
+ */
+void tick_reset_for_test(void)
+{
+	int cpu = smp_processor_id();
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (tick_devices[cpu])
+	{
+		tick_devices[cpu]->event_handler = clockevents_handle_noop;
+		clockevents_switch_state(tick_devices[cpu], CLOCK_EVT_STATE_SHUTDOWN);
+		tick_devices[cpu] = NULL;
+	}
+	memset(&tick_scheds[cpu], 0, sizeof(tick_scheds[cpu]));
+	local_irq_restore(flags);
+}
@@ -0,0 +1,136 @@
+/** 時刻管理
+ * - Linux 6.18のkernel/time/timekeeping.cに相当（単調時刻のみ）
+ * - 現在のクロックソースの値と，最後に更新した時点の時刻から起動後のナノ秒を求める
+ * - 状態はシーケンスカウンタで保護し，割り込みコンテキストからもロックなしで読める
+ */
+
+#include <asm-i386/system.h>
+#include <kfs/clocksource.h>
+#include <kfs/ktime.h>
+#include <kfs/seqlock.h>
+#include <kfs/stddef.h>
+
+/* kernel/time/jiffies.c */
+extern void init_jiffies_clocksource(void);
+
+/** 時刻の基準点
+ * @details ns = base_ns + (((now - cycle_last) & mask) * mult + base_frac) >> shift
+ *          base_fracに1ナノ秒未満の端数を（shiftしたまま）残し，更新のたびに誤差が積もらないようにする
+ */
+static struct
+{
+	seqcount_t seq;				/* 以下のフィールドを保護する */
+	struct clocksource *clock;	/* 使用中のクロックソース */
+	uint64_t cycle_last;		/* 最後に更新したときのカウンタ値 */
+	uint64_t base_ns;			/* cycle_last時点の起動からのナノ秒 */
+	uint64_t base_frac;			/* base_nsの端数（shiftしたナノ秒） */
+} tk_core = {
+	.seq = SEQCNT_ZERO,
+};
+
+/* 最後の更新から経過した時間（shiftしたナノ秒，端数を含む） */
+static inline uint64_t timekeeping_delta_snsec(struct clocksource *clock, uint64_t now)
+{
+	return ((now - tk_core.cycle_last) & clock->mask) * clock->mult + tk_core.base_frac;
+}
+
+/** 使用中のクロックソースで基準点を現在に進める
+ * @note tk_core.seqの書き込み区間内で呼ぶこと
+ */
+static void timekeeping_forward(void)
+{
+	struct clocksource *clock = tk_core.clock;
+	uint64_t now = clock->read(clock);
+	uint64_t snsec = timekeeping_delta_snsec(clock, now);
+
+	tk_core.base_ns += snsec >> clock->shift;
+	tk_core.base_frac = snsec & ((1ULL << clock->shift) - 1);
+	tk_core.cycle_last = now;
+}
+
+/* 使用中のクロックソースを取得する */
+struct clocksource *timekeeping_get_clocksource(void)
+{
+	return tk_core.clock;
+}
+
+/** 使用するクロックソースを切り替える
+ * @param cs 新しいクロックソース
+ * @details 古いクロックソースで現在時刻まで進めてから切り替えるため，時刻は連続する
+ */
+void timekeeping_notify(struct clocksource *cs)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	write_seqcount_begin(&tk_core.seq);
+
+	if (tk_core.clock)
+	{
+		timekeeping_forward();
+	}
+	tk_core.clock = cs;
+	tk_core.cycle_last = cs->read(cs);
+	tk_core.base_frac = 0;
+
+	write_seqcount_end(&tk_core.seq);
+	local_irq_restore(flags);
+}
+
+/** tickごとに基準点を進める
+ * @details カウンタのラップアラウンドと(delta * mult)の桁あふれを防ぐため，
+ *          最後の更新からの経過時間を短く保つ
+ */
+void update_wall_time(void)
+{
+	unsigned long flags;
+
+	if (!tk_core.clock)
+	{
+		return;
+	}
+
+	local_irq_save(flags);
+	write_seqcount_begin(&tk_core.seq);
+	timekeeping_forward();
+	write_seqcount_end(&tk_core.seq);
+	local_irq_restore(flags);
+}
+
+/** 起動からのナノ秒を返す
+ * @return 単調増加する時刻（クロックソースがなければ0）
+ * @note 読んでいる間に更新されたら読み直す．割り込みコンテキストからも呼べる
+ */
+uint64_t ktime_get_ns(void)
+{
+	struct clocksource *clock;
+	unsigned int seq;
+	uint64_t ns;
+
+	do
+	{
+		seq = read_seqcount_begin(&tk_core.seq);
+		clock = tk_core.clock;
+		if (!clock)
+		{
+			return 0;
+		}
+		ns = tk_core.base_ns + (timekeeping_delta_snsec(clock, clock->read(clock)) >> clock->shift);
+	} while (read_seqcount_retry(&tk_core.seq, seq));
+
+	return ns;
+}
+
+/* 起動からの時刻をktime_tで返す */
+ktime_t ktime_get(void)
+{
+	return ns_to_ktime(ktime_get_ns());
+}
+
+/** 時刻管理を初期化する
+ * @note 最初はjiffiesクロックソースを使い，TSC等が登録されると切り替わる
+ */
+void timekeeping_init(void)
+{
+	init_jiffies_clocksource();
+}
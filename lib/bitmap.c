@@ -0,0 +1,177 @@
+/** ビットマップ
+ * - Linux 6.18のlib/find_bit.c，lib/bitmap.cに相当
+ * - 走査は1ワード（32ビット）ずつ進め，目的のビットを含むワードが見つかったらbsf/bsrで位置を求める
+ */
+
+#include <kfs/bitmap.h>
+
+/** find_next_bit()とfind_next_zero_bit()の共通部分
+ * @param addr   ビットマップ
+ * @param nbits  ビットマップのビット数
+ * @param start  探索を始めるビット番号
+ * @param invert 0なら立っているビット，~0ULなら落ちているビットを探す
+ * @return 見つかったビット番号（見つからなければnbits）
+ * @details 各ワードをinvertとXORして「探すビットが1」の形にそろえ，0のワードは読み飛ばす
+ */
+static unsigned long _find_next_bit(const unsigned long *addr, unsigned long nbits, unsigned long start,
+									unsigned long invert)
+{
+	unsigned long tmp;
+
+	if (start >= nbits)
+	{
+		return nbits;
+	}
+
+	/* 最初のワードはstartより下のビットを除く */
+	tmp = addr[BIT_WORD(start)] ^ invert;
+	tmp &= BITMAP_FIRST_WORD_MASK(start);
+	start -= start % BITS_PER_LONG;
+
+	while (!tmp)
+	{
+		start += BITS_PER_LONG;
+		if (start >= nbits)
+		{
+			return nbits;
+		}
+		tmp = addr[BIT_WORD(start)] ^ invert;
+	}
+
+	/* 最後のワードのnbits以上のビットで見つかった場合も見つからなかった扱い */
+	start += __ffs(tmp);
+	return start < nbits ? start : nbits;
+}
+
+/** 立っているビットを探す
+ * @param addr   ビットマップ
+ * @param size   ビットマップのビット数
+ * @param offset 探索を始めるビット番号
+ * @return offset以上で最初に立っているビット番号（見つからなければsize）
+ */
+unsigned long find_next_bit(const unsigned long *addr, unsigned long size, unsigned long offset)
+{
+	return _find_next_bit(addr, size, offset, 0UL);
+}
+
+/** 落ちているビットを探す
+ * @param addr   ビットマップ
+ * @param size   ビットマップのビット数
+ * @param offset 探索を始めるビット番号
+ * @return offset以上で最初に落ちているビット番号（見つからなければsize）
+ */
+unsigned long find_next_zero_bit(const unsigned long *addr, unsigned long size, unsigned long offset)
+{
+	return _find_next_bit(addr, size, offset, ~0UL);
+}
+
+/** 最後に立っているビットを探す
+ * @param addr ビットマップ
+ * @param size ビットマップのビット数
+ * @return 立っているビットのうち最大の番号（見つからなければsize）
+ */
+unsigned long find_last_bit(const unsigned long *addr, unsigned long size)
+{
+	unsigned long idx;
+	unsigned long val;
+
+	if (!size)
+	{
+		return size;
+	}
+
+	/* 最後のワードからさかのぼる */
+	idx = BIT_WORD(size - 1);
+	val = addr[idx] & BITMAP_LAST_WORD_MASK(size);
+	for (;;)
+	{
+		if (val)
+		{
+			return idx * BITS_PER_LONG + __fls(val);
+		}
+		if (idx == 0)
+		{
+			return size;
+		}
+		val = addr[--idx];
+	}
+}
+
+/** 範囲内のビットをすべて立てる
+ * @param map   ビットマップ
+ * @param start 最初のビット番号
+ * @param len   立てるビット数
+ * @details 端のワードはマスクで部分的に，間のワードは丸ごと書き込む
+ */
+void bitmap_set(unsigned long *map, unsigned long start, unsigned long len)
+{
+	unsigned long *p = map + BIT_WORD(start);
+	const unsigned long size = start + len;
+	unsigned long bits_to_set = BITS_PER_LONG - (start % BITS_PER_LONG);
+	unsigned long mask_to_set = BITMAP_FIRST_WORD_MASK(start);
+
+	while (len >= bits_to_set)
+	{
+		*p |= mask_to_set;
+		len -= bits_to_set;
+		bits_to_set = BITS_PER_LONG;
+		mask_to_set = ~0UL;
+		p++;
+	}
+	if (len)
+	{
+		mask_to_set &= BITMAP_LAST_WORD_MASK(size);
+		*p |= mask_to_set;
+	}
+}
+
+/** 範囲内のビットをすべて落とす
+ * @param map   ビットマップ
+ * @param start 最初のビット番号
+ * @param len   落とすビット数
+ */
+void bitmap_clear(unsigned long *map, unsigned long start, unsigned long len)
+{
+	unsigned long *p = map + BIT_WORD(start);
+	const unsigned long size = start + len;
+	unsigned long bits_to_clear = BITS_PER_LONG - (start % BITS_PER_LONG);
+	unsigned long mask_to_clear = BITMAP_FIRST_WORD_MASK(start);
+
+	while (len >= bits_to_clear)
+	{
+		*p &= ~mask_to_clear;
+		len -= bits_to_clear;
+		bits_to_clear = BITS_PER_LONG;
+		mask_to_clear = ~0UL;
+		p++;
+	}
+	if (len)
+	{
+		mask_to_clear &= BITMAP_LAST_WORD_MASK(size);
+		*p &= ~mask_to_clear;
+	}
+}
+
+/** 立っているビットの数を数える
+ * @param map   ビットマップ
+ * @param nbits ビットマップのビット数
+ * @return 立っているビットの数
+ */
+unsigned long bitmap_weight(const unsigned long *map, unsigned long nbits)
+{
+	unsigned long k;
+	unsigned long lim = nbits / BITS_PER_LONG;
+	unsigned long w = 0;
+
+	for (k = 0; k < lim; k++)
+	{
+		w += hweight32(map[k]);
+	}
+
+	/* 半端なワードはnbits未満のビットだけ数える */
+	if (nbits % BITS_PER_LONG)
+	{
+		w += hweight32(map[k] & BITMAP_LAST_WORD_MASK(nbits));
+	}
+	return w;
+}
@@ -58,48 +58,339 @@ struct rb_node *rb_next(const struct rb_node *node)
 	return parent;
 }
 
+/** ノードを左回転する
+ * @param node 回転の軸となるノード（右の子が新しい親になる）
+ * @param root ツリーのルート
+ * @details
+ *     node               right
+ *    /    \             /     \
+ *   a    right   →    node    c
+ *        /   \        /   \
+ *       b     c      a     b
+ */
+static void __rb_rotate_left(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *right = node->rb_right;
+	struct rb_node *parent = rb_parent(node);
+
+	if ((node->rb_right = right->rb_left))
+	{
+		rb_set_parent(right->rb_left, node);
+	}
+	right->rb_left = node;
+
+	rb_set_parent(right, parent);
+
+	if (parent)
+	{
+		if (node == parent->rb_left)
+		{
+			parent->rb_left = right;
+		}
+		else
+		{
+			parent->rb_right = right;
+		}
+	}
+	else
+	{
+		root->rb_node = right;
+	}
+	rb_set_parent(node, right);
+}
+
+/** ノードを右回転する
+ * @param node 回転の軸となるノード（左の子が新しい親になる）
+ * @param root ツリーのルート
+ * @note __rb_rotate_left()の左右を入れ替えたもの
+ */
+static void __rb_rotate_right(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *left = node->rb_left;
+	struct rb_node *parent = rb_parent(node);
+
+	if ((node->rb_left = left->rb_right))
+	{
+		rb_set_parent(left->rb_right, node);
+	}
+	left->rb_right = node;
+
+	rb_set_parent(left, parent);
+
+	if (parent)
+	{
+		if (node == parent->rb_right)
+		{
+			parent->rb_right = left;
+		}
+		else
+		{
+			parent->rb_left = left;
+		}
+	}
+	else
+	{
+		root->rb_node = left;
+	}
+	rb_set_parent(node, left);
+}
+
 /** ノード挿入後の色を調整する
- * @param node 挿入したノード
+ * @param node 挿入したノード（rb_link_node()でリンク済み，赤）
  * @param root ツリーのルート
- *
- * Phase 7で完全実装予定
- * 今はノードを黒に設定するだけ
+ * @details 赤ノードが連続しないように，叔父ノードの色に応じて
+ *          色の塗り替え（叔父が赤）または回転（叔父が黒）を繰り返す
+ * @note Linux 2.6.11のrb_insert_color()に相当する
  */
 void rb_insert_color(struct rb_node *node, struct rb_root *root)
 {
-	(void)root; /* Phase 7で使用 */
-	/* 簡易実装：単純に黒に設定 */
-	rb_set_color(node, RB_BLACK);
+	struct rb_node *parent, *gparent;
+
+	while ((parent = rb_parent(node)) && rb_is_red(parent))
+	{
+		gparent = rb_parent(parent);
+
+		if (parent == gparent->rb_left)
+		{
+			struct rb_node *uncle = gparent->rb_right;
+
+			/* ケース1: 叔父が赤 → 親と叔父を黒，祖父を赤にして祖父から再調整 */
+			if (uncle && rb_is_red(uncle))
+			{
+				rb_set_color(uncle, RB_BLACK);
+				rb_set_color(parent, RB_BLACK);
+				rb_set_color(gparent, RB_RED);
+				node = gparent;
+				continue;
+			}
+
+			/* ケース2: nodeが親の右の子 → 左回転してケース3の形にする */
+			if (parent->rb_right == node)
+			{
+				struct rb_node *tmp;
+				__rb_rotate_left(parent, root);
+				tmp = parent;
+				parent = node;
+				node = tmp;
+			}
+
+			/* ケース3: nodeが親の左の子 → 祖父を右回転 */
+			rb_set_color(parent, RB_BLACK);
+			rb_set_color(gparent, RB_RED);
+			__rb_rotate_right(gparent, root);
+		}
+		else
+		{
+			struct rb_node *uncle = gparent->rb_left;
+
+			if (uncle && rb_is_red(uncle))
+			{
+				rb_set_color(uncle, RB_BLACK);
+				rb_set_color(parent, RB_BLACK);
+				rb_set_color(gparent, RB_RED);
+				node = gparent;
+				continue;
+			}
+
+			if (parent->rb_left == node)
+			{
+				struct rb_node *tmp;
+				__rb_rotate_right(parent, root);
+				tmp = parent;
+				parent = node;
+				node = tmp;
+			}
+
+			rb_set_color(parent, RB_BLACK);
+			rb_set_color(gparent, RB_RED);
+			__rb_rotate_left(gparent, root);
+		}
+	}
+
+	/* ルートは常に黒 */
+	rb_set_color(root->rb_node, RB_BLACK);
+}
+
+/** ノード削除後の色を調整する
+ * @param node   削除により黒の高さが1つ減った位置のノード（NULLの場合あり）
+ * @param parent nodeの親
+ * @param root   ツリーのルート
+ * @note Linux 2.6.11の__rb_erase_color()に相当する
+ */
+static void __rb_erase_color(struct rb_node *node, struct rb_node *parent, struct rb_root *root)
+{
+	struct rb_node *other;
 
-	/* Phase 7で完全なRed-Black Tree調整を実装 */
+	while ((!node || rb_is_black(node)) && node != root->rb_node)
+	{
+		if (parent->rb_left == node)
+		{
+			other = parent->rb_right;
+
+			/* ケース1: 兄弟が赤 → 回転して兄弟を黒にする */
+			if (rb_is_red(other))
+			{
+				rb_set_color(other, RB_BLACK);
+				rb_set_color(parent, RB_RED);
+				__rb_rotate_left(parent, root);
+				other = parent->rb_right;
+			}
+
+			/* ケース2: 兄弟の子が両方黒 → 兄弟を赤にして親から再調整 */
+			if ((!other->rb_left || rb_is_black(other->rb_left)) &&
+				(!other->rb_right || rb_is_black(other->rb_right)))
+			{
+				rb_set_color(other, RB_RED);
+				node = parent;
+				parent = rb_parent(node);
+				continue;
+			}
+
+			/* ケース3: 兄弟の右の子が黒 → 兄弟を右回転してケース4の形にする */
+			if (!other->rb_right || rb_is_black(other->rb_right))
+			{
+				rb_set_color(other->rb_left, RB_BLACK);
+				rb_set_color(other, RB_RED);
+				__rb_rotate_right(other, root);
+				other = parent->rb_right;
+			}
+
+			/* ケース4: 兄弟の右の子が赤 → 親を左回転して終了 */
+			rb_set_color(other, rb_color(parent));
+			rb_set_color(parent, RB_BLACK);
+			rb_set_color(other->rb_right, RB_BLACK);
+			__rb_rotate_left(parent, root);
+			node = root->rb_node;
+			break;
+		}
+		else
+		{
+			other = parent->rb_left;
+
+			if (rb_is_red(other))
+			{
+				rb_set_color(other, RB_BLACK);
+				rb_set_color(parent, RB_RED);
+				__rb_rotate_right(parent, root);
+				other = parent->rb_left;
+			}
+
+			if ((!other->rb_left || rb_is_black(other->rb_left)) &&
+				(!other->rb_right || rb_is_black(other->rb_right)))
+			{
+				rb_set_color(other, RB_RED);
+				node = parent;
+				parent = rb_parent(node);
+				continue;
+			}
+
+			if (!other->rb_left || rb_is_black(other->rb_left))
+			{
+				rb_set_color(other->rb_right, RB_BLACK);
+				rb_set_color(other, RB_RED);
+				__rb_rotate_left(other, root);
+				other = parent->rb_left;
+			}
+
+			rb_set_color(other, rb_color(parent));
+			rb_set_color(parent, RB_BLACK);
+			rb_set_color(other->rb_left, RB_BLACK);
+			__rb_rotate_right(parent, root);
+			node = root->rb_node;
+			break;
+		}
+	}
+
+	if (node)
+	{
+		rb_set_color(node, RB_BLACK);
+	}
 }
 
 /** ツリーからノードを削除する
  * @param node 削除するノード
  * @param root ツリーのルート
- *
- * Phase 7で完全実装予定
+ * @details 子が2つある場合は後続ノード（右部分木の最小ノード）をnodeの位置に移し，
+ *          後続ノードが元々あった位置から色を調整する
+ * @note Linux 2.6.11のrb_erase()に相当する
  */
 void rb_erase(struct rb_node *node, struct rb_root *root)
 {
-	(void)root; /* Phase 7で使用 */
-	/* Phase 7で実装 */
-	/* 今はリンク解除のみ */
-	if (node->rb_left && node->rb_right)
+	struct rb_node *child, *parent;
+	int color;
+
+	if (!node->rb_left)
 	{
-		/* 両方の子がある場合は複雑なので未実装 */
-		return;
+		child = node->rb_right;
 	}
+	else if (!node->rb_right)
+	{
+		child = node->rb_left;
+	}
+	else
+	{
+		struct rb_node *old = node, *left;
 
-	/* 子が1つ以下の場合の簡易削除 */
-	struct rb_node *child = node->rb_left ? node->rb_left : node->rb_right;
-	struct rb_node *parent = rb_parent(node);
+		/* 後続ノードを探す */
+		node = node->rb_right;
+		while ((left = node->rb_left) != NULL)
+		{
+			node = left;
+		}
+
+		/* oldの親のリンクを後続ノードに付け替える */
+		if (rb_parent(old))
+		{
+			if (rb_parent(old)->rb_left == old)
+			{
+				rb_parent(old)->rb_left = node;
+			}
+			else
+			{
+				rb_parent(old)->rb_right = node;
+			}
+		}
+		else
+		{
+			root->rb_node = node;
+		}
+
+		child = node->rb_right;
+		parent = rb_parent(node);
+		color = rb_color(node);
+
+		if (parent == old)
+		{
+			parent = node;
+		}
+		else
+		{
+			/* 後続ノードを元の位置から外し，oldの右部分木を引き継ぐ */
+			if (child)
+			{
+				rb_set_parent(child, parent);
+			}
+			parent->rb_left = child;
+
+			node->rb_right = old->rb_right;
+			rb_set_parent(old->rb_right, node);
+		}
+
+		/* 後続ノードがoldの親・色・左部分木を引き継ぐ */
+		node->__rb_parent_color = old->__rb_parent_color;
+		node->rb_left = old->rb_left;
+		rb_set_parent(old->rb_left, node);
+
+		goto color;
+	}
+
+	parent = rb_parent(node);
+	color = rb_color(node);
 
 	if (child)
 	{
 		rb_set_parent(child, parent);
 	}
-
 	if (parent)
 	{
 		if (parent->rb_left == node)
@@ -115,4 +406,40 @@ void rb_erase(struct rb_node *node, struct rb_root *root)
 	{
 		root->rb_node = child;
 	}
+
+color:
+	/* 黒ノードを取り除いた場合は黒の高さを修復する */
+	if (color == RB_BLACK)
+	{
+		__rb_erase_color(child, parent, root);
+	}
+}
+
+/** キャッシュ付きツリーに挿入したノードの色を調整する
+ * @param node     挿入したノード
+ * @param root     キャッシュ付きルート
+ * @param leftmost nodeを最左位置に挿入したなら非0
+ * @note 最左ノードのキャッシュを更新するため，O(1)でrb_first_cached()できる
+ */
+void rb_insert_color_cached(struct rb_node *node, struct rb_root_cached *root, int leftmost)
+{
+	if (leftmost)
+	{
+		root->rb_leftmost = node;
+	}
+	rb_insert_color(node, &root->rb_root);
+}
+
+/** キャッシュ付きツリーからノードを削除する
+ * @param node 削除するノード
+ * @param root キャッシュ付きルート
+ * @note 最左ノードを削除する場合は，その次のノードを新しい最左ノードにする
+ */
+void rb_erase_cached(struct rb_node *node, struct rb_root_cached *root)
+{
+	if (root->rb_leftmost == node)
+	{
+		root->rb_leftmost = rb_next(node);
+	}
+	rb_erase(node, &root->rb_root);
 }
@@ -4,15 +4,28 @@
  */
 
 #include <asm-i386/page.h>
+#include <asm-i386/pgtable.h>
+#include <kfs/errno.h>
+#include <kfs/gfp.h>
 #include <kfs/mm.h>
+#include <kfs/mm_types.h>
 #include <kfs/printk.h>
+#include <kfs/spinlock.h>
 #include <kfs/stddef.h>
+#include <kfs/string.h>
 
-/* 仮想メモリ領域のリスト（カーネル用） */
+/** 仮想メモリ領域のリスト（カーネル用）
+ * @note 変更はvmap_mutex（mm/vmalloc.c）を持ち，さらにvma_lockを割り込み禁止で取って行う．
+ *       ページフォルトハンドラは眠れないためミューテックスを取れず，他のCPUが同時にリストを
+ *       変更・解放しうるので，vma_lockを持ってfind_vma()し，見つけたVMAを使い終わるまで持ち続ける
+ */
 /* テスト用にstaticを外してエクスポート */
 struct vm_area_struct *vm_area_list = NULL;
 #define vma_list vm_area_list /* 内部コードとの互換性のためエイリアス */
 
+/* vm_area_listをページフォルトハンドラから守るロック（vmap_mutexの内側で取る） */
+DEFINE_SPINLOCK(vma_lock);
+
 /* カーネル仮想メモリの開始位置（ページング後の高位メモリ） */
 /* Linux 2.6.11では VMALLOC_START に相当 */
 #define KERNEL_VM_START 0xD0000000 /* 3.25GB */
@@ -27,6 +40,7 @@ static unsigned long next_vm_addr = KERNEL_VM_START;
  *
  * @param addr 検索する仮想アドレス
  * @return 見つかったVMA、見つからない場合はNULL
+ * @note vma_lockを持って呼ぶ（リストを変更するvmap_mutexの保持者は持たなくてよい）
  */
 struct vm_area_struct *find_vma(unsigned long addr)
 {
@@ -43,22 +57,11 @@ struct vm_area_struct *find_vma(unsigned long addr)
 	return NULL;
 }
 
-/**
- * 仮想メモリ領域をリストに挿入
- * アドレス順にソートして挿入
- *
- * @param new_vma 挿入するVMA
- * @return 成功時0、失敗時-1
- */
-int insert_vm_area(struct vm_area_struct *new_vma)
+/* vma_lockを持ってVMAをリストに挿入する（insert_vm_area()の本体） */
+static int __insert_vm_area(struct vm_area_struct *new_vma)
 {
 	struct vm_area_struct *vma, *prev;
 
-	if (new_vma == NULL)
-	{
-		return -1;
-	}
-
 	/* 重複チェック */
 	for (vma = vma_list; vma != NULL; vma = vma->vm_next)
 	{
@@ -107,11 +110,30 @@ int insert_vm_area(struct vm_area_struct *new_vma)
 }
 
 /**
- * 指定したアドレスの仮想メモリ領域をリストから削除
+ * 仮想メモリ領域をリストに挿入
+ * アドレス順にソートして挿入
  *
- * @param addr 削除するVMAの開始アドレス
+ * @param new_vma 挿入するVMA
+ * @return 成功時0、失敗時-1
  */
-void remove_vm_area(unsigned long addr)
+int insert_vm_area(struct vm_area_struct *new_vma)
+{
+	unsigned long flags;
+	int ret;
+
+	if (new_vma == NULL)
+	{
+		return -1;
+	}
+
+	spin_lock_irqsave(&vma_lock, flags);
+	ret = __insert_vm_area(new_vma);
+	spin_unlock_irqrestore(&vma_lock, flags);
+	return ret;
+}
+
+/* vma_lockを持ってVMAをリストから外す（remove_vm_area()の本体） */
+static void __remove_vm_area(unsigned long addr)
 {
 	struct vm_area_struct *vma, *prev;
 
@@ -140,6 +162,21 @@ void remove_vm_area(unsigned long addr)
 	}
 }
 
+/**
+ * 指定したアドレスの仮想メモリ領域をリストから削除
+ *
+ * @param addr 削除するVMAの開始アドレス
+ * @note 戻った後は，ページフォルトハンドラが外したVMAを参照していないため解放してよい
+ */
+void remove_vm_area(unsigned long addr)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&vma_lock, flags);
+	__remove_vm_area(addr);
+	spin_unlock_irqrestore(&vma_lock, flags);
+}
+
 /**
  * 指定サイズの未使用仮想アドレス領域を見つける
  * First Fit方式で検索
@@ -190,6 +227,269 @@ unsigned long get_unmapped_area(size_t len)
 	return 0;
 }
 
+/**
+ * デマンドページングVMAへのアクセスで発生したフォルトを解決する
+ * Linux 2.6.11の handle_mm_fault() に相当（無名ページのみ対応）
+ *
+ * @param vma          フォルトアドレスを含むVMA
+ * @param address      フォルトを起こした仮想アドレス
+ * @param write_access 書き込みアクセスなら非0
+ * @return 成功時0、失敗時-1
+ * @note ゼロクリア済みのページを割り当て、ページ境界に揃えてマップする
+ */
+int handle_mm_fault(struct vm_area_struct *vma, unsigned long address, int write_access)
+{
+	struct page *page;
+	pte_t *pte;
+	unsigned long flags;
+	int ret;
+
+	(void)write_access;
+
+	if (vma == NULL || address < vma->vm_start || address >= vma->vm_end)
+	{
+		return -1;
+	}
+
+	address &= PAGE_MASK;
+
+	/* 別経路で既にマップ済みなら何もしない */
+	pte = get_pte(address);
+	if (pte != NULL && pte_present(*pte))
+	{
+		return 0;
+	}
+
+	page = alloc_pages(GFP_ZERO, 0);
+	if (page == NULL)
+	{
+		printk(KERN_WARNING "handle_mm_fault: out of memory at 0x%lx\n", address);
+		return -1;
+	}
+
+	/** 確認してから割り当てるまでの間に他の経路がマップしていたら，そちらを残して割り当てたページを返す
+	 * @note 既存のマッピングを置き換えないので，割り込み禁止のまま全CPUのTLBシュートダウンをせずに済む
+	 */
+	flags = (vma->vm_flags & VM_WRITE) ? _PAGE_KERNEL : _PAGE_PRESENT;
+	ret = map_new_page_vmalloc(address, (unsigned long)page, flags);
+	if (ret != 0)
+	{
+		free_pages(page, 0);
+		return ret < 0 ? -1 : 0;
+	}
+
+	return 0;
+}
+
+/* ========== ユーザー空間のページテーブル ========== */
+
+/** mmのユーザー空間のPTEを取得する
+ * @param mm     ページディレクトリを持つmm
+ * @param vaddr  ユーザー空間の仮想アドレス
+ * @param create 非0ならページテーブルがなければ作成する
+ * @return PTEへのポインタ，ページテーブルがない（または作成に失敗した）ときNULL
+ */
+static pte_t *user_pte(struct mm_struct *mm, unsigned long vaddr, int create)
+{
+	unsigned long pde_idx = pgd_index(vaddr);
+	pde_t *pde;
+	pte_t *table;
+
+	if (mm->pgd == NULL || pde_idx < FIRST_USER_PGD_NR || pde_idx >= USER_PTRS_PER_PGD)
+	{
+		return NULL;
+	}
+
+	pde = &mm->pgd[pde_idx];
+	if (!pde_present(*pde))
+	{
+		struct page *page;
+
+		if (!create)
+		{
+			return NULL;
+		}
+		page = alloc_pages(GFP_ZERO, 0);
+		if (page == NULL)
+		{
+			return NULL;
+		}
+		set_pde(pde, (unsigned long)page, _PAGE_USER_RW);
+	}
+
+	table = (pte_t *)__va(pde_page(*pde));
+	return &table[pte_index(vaddr)];
+}
+
+/** ユーザー空間にページをマップする
+ * @param mm    マップ先のmm
+ * @param vaddr ユーザー空間の仮想アドレス（4KBアライメント）
+ * @param paddr 物理ページのアドレス（4KBアライメント）
+ * @param flags ページフラグ（_PAGE_USER_RW等）
+ * @return 0=成功、-1=失敗
+ * @note 呼び出し元のページへの参照はマッピングに引き渡され，exit_mmap()で解放される
+ */
+int map_user_page(struct mm_struct *mm, unsigned long vaddr, unsigned long paddr, unsigned long flags)
+{
+	pte_t *pte;
+
+	if ((vaddr & ~PAGE_MASK) || (paddr & ~PAGE_MASK))
+	{
+		return -1;
+	}
+
+	pte = user_pte(mm, vaddr, 1);
+	if (pte == NULL || pte_present(*pte))
+	{
+		return -1;
+	}
+
+	set_pte(pte, paddr, flags | _PAGE_PRESENT);
+	__flush_tlb_one(vaddr);
+	return 0;
+}
+
+/** fork時にユーザー空間のページテーブルをコピーする
+ * @param dst コピー先のmm（ユーザー部分が空のページディレクトリを持つ）
+ * @param src コピー元のmm
+ * @return 0=成功、-ENOMEM=メモリ不足（途中までコピーしたページテーブルはexit_mmap()で解放する）
+ * @details ページ自体はコピーせず，ページテーブルだけを複製して親子で同じページを指す．
+ *          書き込み可能なページは両方で読み取り専用にして_PAGE_COWを付け，
+ *          最初に書き込んだ側がdo_wp_page()で自分用のコピーを作る．
+ *          コストはマップされているページテーブルの数に比例し，常駐ページの中身の大きさによらない
+ * @note Linux 2.6.11のcopy_page_range()に相当する
+ */
+int copy_page_range(struct mm_struct *dst, struct mm_struct *src)
+{
+	unsigned long i, j;
+
+	if (src->pgd == NULL)
+	{
+		return 0;
+	}
+
+	for (i = FIRST_USER_PGD_NR; i < USER_PTRS_PER_PGD; i++)
+	{
+		pte_t *src_table;
+		pte_t *dst_table;
+		struct page *page;
+
+		if (!pde_present(src->pgd[i]))
+		{
+			continue;
+		}
+
+		page = alloc_pages(GFP_ZERO, 0);
+		if (page == NULL)
+		{
+			return -ENOMEM;
+		}
+		set_pde(&dst->pgd[i], (unsigned long)page, _PAGE_USER_RW);
+
+		src_table = (pte_t *)__va(pde_page(src->pgd[i]));
+		dst_table = (pte_t *)__va((unsigned long)page);
+		for (j = 0; j < PTRS_PER_PTE; j++)
+		{
+			pte_t pte = src_table[j];
+
+			if (!pte_present(pte))
+			{
+				continue;
+			}
+
+			/* 書き込み可能なページは親子とも書き込み時にコピーする */
+			if (pte_write(pte))
+			{
+				pte = (pte & ~_PAGE_RW) | _PAGE_COW;
+				src_table[j] = pte;
+			}
+			get_page((struct page *)pte_page(pte));
+			dst_table[j] = pte;
+		}
+	}
+
+	/* 親のPTEを読み取り専用にしたため，親のアドレス空間で古いTLBエントリが残らないようにする */
+	__flush_tlb();
+	return 0;
+}
+
+/** ユーザー空間のページとページテーブルをすべて解放する
+ * @param mm 解放するmm（ページディレクトリ自体はpgd_free()で解放する）
+ * @note 共有中のページは参照数が減るだけで，最後の参照で解放される
+ */
+void exit_mmap(struct mm_struct *mm)
+{
+	unsigned long i, j;
+
+	if (mm->pgd == NULL)
+	{
+		return;
+	}
+
+	for (i = FIRST_USER_PGD_NR; i < USER_PTRS_PER_PGD; i++)
+	{
+		pte_t *table;
+
+		if (!pde_present(mm->pgd[i]))
+		{
+			continue;
+		}
+
+		table = (pte_t *)__va(pde_page(mm->pgd[i]));
+		for (j = 0; j < PTRS_PER_PTE; j++)
+		{
+			if (pte_present(table[j]))
+			{
+				free_pages((struct page *)pte_page(table[j]), 0);
+			}
+		}
+		free_pages((struct page *)pde_page(mm->pgd[i]), 0);
+		pde_clear(&mm->pgd[i]);
+	}
+	__flush_tlb();
+}
+
+/** COWページへの書き込みフォルトを解決する
+ * @param mm      フォルトしたタスクのmm
+ * @param address フォルトを起こした仮想アドレス
+ * @return 0=解決済み、-1=COWページではない（本当の保護違反）かメモリ不足
+ * @details ページを参照しているのが自分だけならコピーせずに書き込み可能に戻す．
+ *          共有中なら新しいページに中身をコピーして付け替え，元のページの参照を1つ外す
+ * @note Linux 2.6.11のdo_wp_page()に相当する
+ */
+int do_wp_page(struct mm_struct *mm, unsigned long address)
+{
+	pte_t *pte = user_pte(mm, address, 0);
+	unsigned long old_page;
+	struct page *new_page;
+
+	if (pte == NULL || !pte_present(*pte) || !(*pte & _PAGE_COW))
+	{
+		return -1;
+	}
+
+	old_page = pte_page(*pte);
+	if (page_count((struct page *)old_page) == 1)
+	{
+		*pte = (*pte & ~_PAGE_COW) | _PAGE_RW;
+		__flush_tlb_one(address);
+		return 0;
+	}
+
+	new_page = alloc_pages(GFP_KERNEL, 0);
+	if (new_page == NULL)
+	{
+		printk(KERN_WARNING "do_wp_page: out of memory at 0x%lx\n", address);
+		return -1;
+	}
+	memcpy(__va((unsigned long)new_page), __va(old_page), PAGE_SIZE);
+
+	set_pte(pte, (unsigned long)new_page, (*pte & ~_PAGE_COW) | _PAGE_RW);
+	__flush_tlb_one(address);
+	free_pages((struct page *)old_page, 0);
+	return 0;
+}
+
 /**
  * テスト用: 仮想メモリ領域（VMA）を初期状態にリセット
  * @details
@@ -199,12 +499,16 @@ unsigned long get_unmapped_area(size_t len)
  * リセット内容:
  * - vm_area_listをNULLに設定（全VMAを削除）
  * - 次に割り当て可能な仮想アドレスを初期位置に戻す
+ * - vmalloc領域のページディレクトリエントリをクリア
+ *   （ページテーブルのページはページアロケータのリセットで空き扱いになるため）
  */
 void vm_reset_for_test(void)
 {
 	/* VMAリストをクリア（全て削除） */
 	vm_area_list = NULL;
 
+	pgtable_reset_for_test(KERNEL_VM_START);
+
 	/* 次の割り当て位置を初期化 */
 	next_vm_addr = KERNEL_VM_START;
 }
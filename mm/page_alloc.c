@@ -8,16 +8,24 @@
  */
 
 #include <asm-i386/page.h>
+#include <kfs/bitmap.h>
 #include <kfs/gfp.h>
 #include <kfs/mm.h>
 #include <kfs/multiboot.h>
 #include <kfs/panic.h>
 #include <kfs/printk.h>
+#include <kfs/spinlock.h>
 #include <kfs/string.h>
 
 /* ページビットマップ（最大128MB = 32768ページ = 4096バイト） */
 #define MAX_PAGES 32768
-static uint8_t page_bitmap[MAX_PAGES / 8];
+static DECLARE_BITMAP(page_bitmap, MAX_PAGES);
+
+/** ページごとの参照数
+ * @details COWで親子が同じページを共有するため，最後の参照が外れたときだけ空きに戻す
+ * @note Linux 2.6.11のstruct page->_countに相当する（struct pageの配列を持たないため別に持つ）
+ */
+static uint16_t page_refcount[MAX_PAGES];
 
 /* メモリ統計情報 */
 unsigned long total_pages = 0;
@@ -25,6 +33,11 @@ unsigned long nr_free_pages = 0; /* 空きページ数（Linux 2.6.11に倣い n
 unsigned long kernel_end_pfn = 0;
 static int page_alloc_initialized = 0; /* 初期化済みフラグ */
 
+/** ページビットマップ，参照数とnr_free_pagesを守るロック
+ * @note 割り込みハンドラからも割り当てられるよう，spin_lock_irqsave()で取る（Linux 2.6.11のzone->lock）
+ */
+static DEFINE_SPINLOCK(zone_lock);
+
 /* 外部シンボル：カーネルの終端アドレス（linker.ldで定義） */
 extern char _kernel_end[];
 
@@ -37,7 +50,7 @@ static inline void set_page_bit(unsigned long pfn)
 	{
 		return;
 	}
-	page_bitmap[pfn / 8] |= (1 << (pfn % 8));
+	__set_bit(pfn, page_bitmap);
 }
 
 /**
@@ -49,7 +62,7 @@ static inline void clear_page_bit(unsigned long pfn)
 	{
 		return;
 	}
-	page_bitmap[pfn / 8] &= ~(1 << (pfn % 8)); // pfn番目のビットに0を書き込む
+	__clear_bit(pfn, page_bitmap);
 }
 
 /**
@@ -62,7 +75,7 @@ static inline int test_page_bit(unsigned long pfn)
 	{
 		return 1; /* 範囲外は使用中とみなす */
 	}
-	return (page_bitmap[pfn / 8] & (1 << (pfn % 8))) != 0;
+	return test_bit(pfn, page_bitmap);
 }
 
 /**
@@ -85,7 +98,7 @@ static void parse_memory_map(struct multiboot_info *mbi)
 	mmap_end = mbi->mmap_addr + mbi->mmap_length;
 
 	/* 全ページを使用中としてマーク（デフォルト） */
-	memset(page_bitmap, 0xFF, sizeof(page_bitmap));
+	bitmap_fill(page_bitmap, MAX_PAGES);
 
 	/* メモリマップを走査 */
 	while ((unsigned long)mmap < mmap_end)
@@ -111,10 +124,12 @@ static void parse_memory_map(struct multiboot_info *mbi)
 				start_pfn = kernel_end_pfn;
 			}
 
-			for (unsigned long pfn = start_pfn; pfn < end_pfn && pfn < MAX_PAGES; pfn++)
+			/* 未使用としてマーク（ビットマップに収まる範囲のみ） */
+			unsigned long clear_end = end_pfn < MAX_PAGES ? end_pfn : MAX_PAGES;
+			if (start_pfn < clear_end)
 			{
-				clear_page_bit(pfn); /* 未使用としてマーク */
-				nr_free_pages++;
+				bitmap_clear(page_bitmap, start_pfn, clear_end - start_pfn);
+				nr_free_pages += clear_end - start_pfn;
 			}
 
 			if (end_pfn > total_pages && end_pfn <= MAX_PAGES)
@@ -168,43 +183,52 @@ void page_alloc_init(struct multiboot_info *mbi)
  */
 unsigned long __alloc_pages(unsigned int gfp_mask)
 {
+	unsigned long limit = total_pages < MAX_PAGES ? total_pages : MAX_PAGES;
 	unsigned long pfn;
+	unsigned long phys_addr;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zone_lock, flags);
 
-	/** 空きページを検索
+	/** 空きページを検索（使用中のワードは32ページまとめて読み飛ばす）
 	 * @note カーネルが使用するページを割当対象から除外する
 	 */
-	for (pfn = kernel_end_pfn; pfn < total_pages && pfn < MAX_PAGES; pfn++)
+	pfn = find_next_zero_bit(page_bitmap, limit, kernel_end_pfn);
+	if (pfn >= limit)
 	{
-		if (!test_page_bit(pfn))
-		{
-			/* ページを使用中としてマーク */
-			set_page_bit(pfn);
-			nr_free_pages--;
+		/* 割り当て失敗 */
+		spin_unlock_irqrestore(&zone_lock, flags);
+		return 0;
+	}
 
-			/* 物理アドレスを計算 */
-			unsigned long phys_addr = pfn * PAGE_SIZE;
+	/* ページを使用中としてマーク */
+	set_page_bit(pfn);
+	page_refcount[pfn] = 1;
+	nr_free_pages--;
 
-			/* GFP_ZEROフラグが設定されている場合はゼロクリア */
-			if (gfp_mask & GFP_ZERO)
-			{
-				memset((void *)phys_addr, 0, PAGE_SIZE);
-			}
+	spin_unlock_irqrestore(&zone_lock, flags);
 
-			return phys_addr;
-		}
+	/* 物理アドレスを計算 */
+	phys_addr = pfn * PAGE_SIZE;
+
+	/* GFP_ZEROフラグが設定されている場合はゼロクリア */
+	if (gfp_mask & GFP_ZERO)
+	{
+		memset((void *)phys_addr, 0, PAGE_SIZE);
 	}
 
-	/* 割り当て失敗 */
-	return 0;
+	return phys_addr;
 }
 
 /**
  * 物理ページを解放する
  * @param addr ページの物理アドレス
+ * @note 共有されているページは参照数を1減らすだけで，最後の参照で空きに戻す
  */
 void __free_pages(unsigned long addr)
 {
 	unsigned long pfn = addr / PAGE_SIZE;
+	unsigned long flags;
 
 	/** 範囲チェック
 	 * @note カーネルが使用するページを解放対象から除外する
@@ -215,16 +239,73 @@ void __free_pages(unsigned long addr)
 		return;
 	}
 
+	spin_lock_irqsave(&zone_lock, flags);
+
 	/* 既に解放済みかチェック */
 	if (!test_page_bit(pfn))
 	{
+		spin_unlock_irqrestore(&zone_lock, flags);
 		printk(KERN_WARNING "Double free detected: 0x%08lx (PFN: %lu)\n", addr, pfn);
 		return;
 	}
 
+	/* まだ他から参照されている */
+	if (page_refcount[pfn] > 1)
+	{
+		page_refcount[pfn]--;
+		spin_unlock_irqrestore(&zone_lock, flags);
+		return;
+	}
+
 	/* ページを未使用としてマーク */
+	page_refcount[pfn] = 0;
 	clear_page_bit(pfn);
 	nr_free_pages++;
+
+	spin_unlock_irqrestore(&zone_lock, flags);
+}
+
+/**
+ * get_page - ページへの参照を1つ増やす
+ * @page: ページ（物理アドレス）
+ * @note 参照はfree_pages()で1つずつ外す
+ */
+void get_page(struct page *page)
+{
+	unsigned long pfn = (unsigned long)page / PAGE_SIZE;
+	unsigned long flags;
+
+	if (pfn >= MAX_PAGES)
+	{
+		printk(KERN_WARNING "get_page: page not in use: 0x%08lx\n", (unsigned long)page);
+		return;
+	}
+
+	spin_lock_irqsave(&zone_lock, flags);
+	if (!test_page_bit(pfn))
+	{
+		spin_unlock_irqrestore(&zone_lock, flags);
+		printk(KERN_WARNING "get_page: page not in use: 0x%08lx\n", (unsigned long)page);
+		return;
+	}
+	page_refcount[pfn]++;
+	spin_unlock_irqrestore(&zone_lock, flags);
+}
+
+/**
+ * page_count - ページの参照数を返す
+ * @page: ページ（物理アドレス）
+ * @return: 参照数（空きページなら0）
+ */
+int page_count(struct page *page)
+{
+	unsigned long pfn = (unsigned long)page / PAGE_SIZE;
+
+	if (pfn >= MAX_PAGES)
+	{
+		return 0;
+	}
+	return page_refcount[pfn];
 }
 
 /**
@@ -304,12 +385,11 @@ void mem_init(void)
  *
  * リセット内容:
  * - ページビットマップを初期状態（カーネル領域以外は空き）に戻す
+ * - ページの参照数をすべて0にする
  * - 空きページ数カウンタをリセット
  */
 void page_allocator_reset_for_test(void)
 {
-	unsigned long pfn;
-
 	/* 初期化されていなければ何もしない */
 	if (!page_alloc_initialized)
 	{
@@ -317,13 +397,11 @@ void page_allocator_reset_for_test(void)
 	}
 
 	/* 全ページを空きとしてマーク */
-	memset(page_bitmap, 0x00, sizeof(page_bitmap));
+	bitmap_zero(page_bitmap, MAX_PAGES);
+	memset(page_refcount, 0, sizeof(page_refcount));
 
 	/* カーネル使用領域を使用中としてマーク */
-	for (pfn = 0; pfn < kernel_end_pfn && pfn < MAX_PAGES; pfn++)
-	{
-		set_page_bit(pfn);
-	}
+	bitmap_set(page_bitmap, 0, kernel_end_pfn < MAX_PAGES ? kernel_end_pfn : MAX_PAGES);
 
 	/* 空きページ数をリセット */
 	nr_free_pages = total_pages - kernel_end_pfn;
@@ -4,6 +4,7 @@
 #include <kfs/panic.h>
 #include <kfs/printk.h>
 #include <kfs/slab.h>
+#include <kfs/spinlock.h>
 #include <kfs/stdint.h>
 
 /* オブジェクトメタデータ（各オブジェクトの先頭に配置） */
@@ -44,10 +45,12 @@ struct obj_meta
 /** 固定サイズキャッシュ
  * @note Linux 2.6.11のcache_sizes配列に相当する
  */
+#define KMALLOC_CACHE(idx, sz)                                                                                         \
+	[idx] = {.name = "kmalloc-" #sz, .size = sz, .lock = __SPIN_LOCK_UNLOCKED(kmalloc_caches[idx].lock)}
+
 static struct kmem_cache kmalloc_caches[NR_CACHES] = {
-	{"kmalloc-32", 32, NULL, 0, 0},		{"kmalloc-64", 64, NULL, 0, 0},		{"kmalloc-128", 128, NULL, 0, 0},
-	{"kmalloc-256", 256, NULL, 0, 0},	{"kmalloc-512", 512, NULL, 0, 0},	{"kmalloc-1024", 1024, NULL, 0, 0},
-	{"kmalloc-2048", 2048, NULL, 0, 0}, {"kmalloc-4096", 4096, NULL, 0, 0},
+	KMALLOC_CACHE(0, 32),	KMALLOC_CACHE(1, 64),	KMALLOC_CACHE(2, 128),	KMALLOC_CACHE(3, 256),
+	KMALLOC_CACHE(4, 512),	KMALLOC_CACHE(5, 1024), KMALLOC_CACHE(6, 2048), KMALLOC_CACHE(7, 4096),
 };
 
 /* 各キャッシュ kmem_cache[cache_idx] が管理するページ数 */
@@ -88,6 +91,7 @@ static int find_cache_index(size_t size)
  * @param cache 対象キャッシュ
  * @param cache_idx 対象キャッシュのインデックス
  * @details 物理ページを割り当て，オブジェクト単位に分割して未割当リストに追加する
+ * @note cache->lockを持って呼ぶ（ページアロケータのロックはこの内側で取る）
  */
 static int kmem_cache_grow(struct kmem_cache *cache, int cache_idx)
 {
@@ -230,6 +234,7 @@ void *kmalloc(size_t size)
 	int idx;
 	struct kmem_cache *cache;
 	struct kmem_cache_node *node;
+	unsigned long flags;
 	void *ptr;
 
 	/* サイズチェック */
@@ -253,11 +258,14 @@ void *kmalloc(size_t size)
 	}
 	cache = &kmalloc_caches[idx];
 
+	spin_lock_irqsave(&cache->lock, flags);
+
 	/* 未割当リストが空なら新しいページを追加する */
 	if (!cache->freelist)
 	{
 		if (kmem_cache_grow(cache, idx) < 0)
 		{
+			spin_unlock_irqrestore(&cache->lock, flags);
 			printk("kmalloc: failed to grow cache %s\n", cache->name);
 			return NULL;
 		}
@@ -278,6 +286,7 @@ void *kmalloc(size_t size)
 	meta->magic = SLAB_MAGIC | idx;
 	meta->reserved = 0;
 
+	spin_unlock_irqrestore(&cache->lock, flags);
 	return ptr;
 }
 
@@ -291,6 +300,8 @@ void kfree(void *ptr)
 {
 	struct obj_meta *meta;
 	struct kmem_cache_node *node;
+	struct kmem_cache *cache;
+	unsigned long flags;
 	int cache_idx;
 
 	/* NULLポインタは何もしない */
@@ -324,9 +335,12 @@ void kfree(void *ptr)
 	 */
 	// obj_meta *型の構造体 meta を kmem_cache_node *型の構造体 として用いる
 	node = (struct kmem_cache_node *)meta;
+	cache = &kmalloc_caches[cache_idx];
+	spin_lock_irqsave(&cache->lock, flags);
 	node->addr = ptr; /* ユーザーポインタを保存 */
-	node->next = kmalloc_caches[cache_idx].freelist;
-	kmalloc_caches[cache_idx].freelist = node;
+	node->next = cache->freelist;
+	cache->freelist = node;
+	spin_unlock_irqrestore(&cache->lock, flags);
 }
 
 /** 割り当てられたメモリのサイズを取得する
@@ -7,26 +7,54 @@
 #include <asm-i386/pgtable.h>
 #include <kfs/gfp.h>
 #include <kfs/mm.h>
+#include <kfs/mutex.h>
 #include <kfs/printk.h>
 #include <kfs/slab.h>
 #include <kfs/stddef.h>
 #include <kfs/vmalloc.h>
 
-/* vmalloc領域の管理構造体（Linux 2.6.11のvm_structに相当） */
-struct vm_struct
-{
-	void *addr;				/* 仮想アドレス */
-	unsigned long size;		/* 割り当てサイズ（バイト単位） */
-	struct vm_struct *next; /* 次のvm_struct（リンクリスト） */
-};
-
 /* vmalloc領域のリスト */
 static struct vm_struct *vmlist = NULL;
 
-/* vbrk用の仮想メモリヒープ境界 */
-static void *vheap_start = NULL;
-static void *vheap_end = NULL;
-static void *vheap_brk = NULL;
+/** 遅延解放（lazy purge）
+ * @details vfree()ではPTEのクリアと物理ページの解放だけを行い，TLBのフラッシュと
+ *          仮想アドレス範囲の返却は後回しにする．遅延解放されたページ数が閾値に
+ *          達した時点で，溜まった領域をまとめて1回のTLBフラッシュで片付ける．
+ * @note 遅延中の仮想アドレス範囲はVMAを残したままにして再利用させない
+ *       （古いTLBエントリが残っている可能性があるため）
+ */
+#define LAZY_MAX_PAGES 256 /* 1MB分の遅延解放でパージする */
+
+static struct vm_struct *purge_list = NULL;
+static unsigned long nr_lazy_pages = 0;
+
+/** vmlist，遅延解放リストとカーネルのVMAリスト（mm/memory.c，仮想アドレス範囲の予約）を守るミューテックス
+ * @details 遅延解放のパージ（全CPUのTLBシュートダウン）を含む長い区間を保持したまま行うため，
+ *          スピンロックではなく眠るミューテックスにする．待つタスクはその間CPUを他に譲る
+ * @note vmalloc/vfreeはプロセス文脈からだけ呼ばれる
+ * @note vmalloc領域のページテーブルはページフォルトハンドラも変更するため，このミューテックスではなく
+ *       map_page_vmalloc()/unmap_page_vmalloc()の中のpage_table_lock（arch/i386/mm/init.c）で守る
+ */
+static DEFINE_MUTEX(vmap_mutex);
+
+/* vbrkのヒープ境界を守るミューテックス（vmap_mutexより先に取る） */
+static DEFINE_MUTEX(vbrk_mutex);
+
+static void __vm_unmap_aliases(void);
+
+/** vbrk用の仮想メモリヒープ
+ * @details VBRK_WINDOW_SIZEの仮想アドレス窓をvreserve()で1つだけ予約し，
+ *          ブレイクの伸縮に合わせて窓の先頭から物理ページをマップ・アンマップする．
+ *          これにより，ヒープは常に1つの連続した仮想アドレス範囲になる．
+ * @note vheap_start <= vheap_brk <= vheap_mapped <= vheap_end
+ */
+#define VBRK_WINDOW_SIZE (16 * 1024 * 1024) /* 予約する仮想アドレス窓（16MB） */
+#define VBRK_TRIM_THRESHOLD (4 * PAGE_SIZE) /* 縮小時にアンマップを始める余剰サイズ */
+
+static void *vheap_start = NULL;  /* ヒープ窓の先頭 */
+static void *vheap_end = NULL;	  /* ヒープ窓の終端（排他的） */
+static void *vheap_brk = NULL;	  /* 現在のブレイク */
+static void *vheap_mapped = NULL; /* 物理ページをマップ済みの終端（ページ境界） */
 
 /** vmalloc領域を初期化する
  * @details これにより，vmalloc/vfreeが使用可能になる
@@ -36,33 +64,32 @@ void vmalloc_init(void)
 {
 	/* 初期化時はリストを空にする */
 	vmlist = NULL;
+	purge_list = NULL;
+	nr_lazy_pages = 0;
+	mutex_init(&vmap_mutex);
+	mutex_init(&vbrk_mutex);
 
 	/* vbrk用のヒープ境界を初期化 */
 	vheap_start = NULL;
 	vheap_end = NULL;
 	vheap_brk = NULL;
+	vheap_mapped = NULL;
 
 	printk(KERN_INFO "vmalloc initialized\n");
 }
 
-/** 指定したサイズの仮想メモリを割り当てる
- * @param size 割り当てサイズ（バイト単位）
- * @return 割り当てた仮想アドレス、失敗時はNULL
- * @note Linux 2.6.11のvmalloc()に相当する
+/** 仮想アドレス領域を予約してVMAとvm_structを登録する
+ * @param size  予約サイズ（バイト単位、0は不可）
+ * @param flags VMAに設定するフラグ
+ * @return 登録したvm_struct、失敗時はNULL
+ * @note Linux 2.6.11のget_vm_area()に相当する（物理ページは割り当てない）
  */
-void *vmalloc(unsigned long size)
+struct vm_struct *get_vm_area(unsigned long size, unsigned long flags)
 {
 	struct vm_struct *vm;
 	struct vm_area_struct *vma;
 	unsigned long addr;
 	unsigned long aligned_size;
-	unsigned long nr_pages;
-	unsigned long i;
-
-	if (size == 0)
-	{
-		return NULL;
-	}
 
 	/** sizeをPAGE_SIZEの倍数に切り上げて揃える
 	 * @details
@@ -71,26 +98,13 @@ void *vmalloc(unsigned long size)
 	 */
 	aligned_size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 
-	/* ページ数を計算 */
-	nr_pages = aligned_size >> PAGE_SHIFT;
-
-	/* 未使用の仮想アドレス領域を探す */
-	addr = get_unmapped_area(aligned_size);
-	if (addr == 0)
-	{
-		printk(KERN_WARNING "vmalloc: no space for %lu bytes\n", size);
-		return NULL;
-	}
-
-	/* vm_struct（vmalloc管理構造体）を割り当て */
+	/* vm_struct（vmalloc管理構造体）とvm_area_struct（VMA）はロックの外で割り当てておく */
 	vm = (struct vm_struct *)kmalloc(sizeof(struct vm_struct));
 	if (vm == NULL)
 	{
 		printk(KERN_WARNING "vmalloc: failed to allocate vm_struct\n");
 		return NULL;
 	}
-
-	/* vm_area_struct（VMA）を割り当て */
 	vma = (struct vm_area_struct *)kmalloc(sizeof(struct vm_area_struct));
 	if (vma == NULL)
 	{
@@ -99,22 +113,61 @@ void *vmalloc(unsigned long size)
 		return NULL;
 	}
 
+	mutex_lock(&vmap_mutex);
+
+	/* 未使用の仮想アドレス領域を探す（足りなければ遅延解放中の領域を回収して再試行） */
+	addr = get_unmapped_area(aligned_size);
+	if (addr == 0 && purge_list != NULL)
+	{
+		__vm_unmap_aliases();
+		addr = get_unmapped_area(aligned_size);
+	}
+	if (addr == 0)
+	{
+		mutex_unlock(&vmap_mutex);
+		kfree(vma);
+		kfree(vm);
+		printk(KERN_WARNING "vmalloc: no space for %lu bytes\n", size);
+		return NULL;
+	}
+
 	/* VMAを初期化 */
 	vma->vm_start = addr;
 	vma->vm_end = addr + aligned_size;
-	vma->vm_flags = VM_READ | VM_WRITE; /* 読み書き可能 */
+	vma->vm_flags = flags;
 	vma->vm_next = NULL;
 
 	/* VMAをリストに挿入 */
 	if (insert_vm_area(vma) != 0)
 	{
+		mutex_unlock(&vmap_mutex);
 		kfree(vma);
 		kfree(vm);
 		printk(KERN_WARNING "vmalloc: failed to insert vm_area\n");
 		return NULL;
 	}
 
-	/* 物理ページを割り当ててマッピング */
+	/* vm_structを初期化してリストに追加 */
+	vm->addr = (void *)addr;
+	vm->size = aligned_size;
+	vm->flags = flags;
+	vm->next = vmlist;
+	vmlist = vm;
+
+	mutex_unlock(&vmap_mutex);
+	return vm;
+}
+
+/** 物理ページを割り当てて仮想アドレス範囲にマップする
+ * @param addr     マップする先頭の仮想アドレス（ページ境界）
+ * @param nr_pages ページ数
+ * @return 0=成功、-1=失敗（途中までマップしたページは残す）
+ */
+static int map_new_pages(unsigned long addr, unsigned long nr_pages)
+{
+	unsigned long i;
+	int ret = 0;
+
 	for (i = 0; i < nr_pages; i++)
 	{
 		struct page *page;
@@ -125,19 +178,9 @@ void *vmalloc(unsigned long size)
 		page = alloc_pages(GFP_KERNEL, 0);
 		if (page == NULL)
 		{
-			/* 失敗した場合は既に割り当てたページを解放 */
-			unsigned long j;
-			for (j = 0; j < i; j++)
-			{
-				unsigned long free_vaddr = addr + (j << PAGE_SHIFT);
-				struct page *free_page = (struct page *)virt_to_phys((void *)free_vaddr);
-				free_pages(free_page, 0);
-			}
-			remove_vm_area(addr);
-			kfree(vma);
-			kfree(vm);
 			printk(KERN_WARNING "vmalloc: failed to allocate page %lu/%lu\n", i, nr_pages);
-			return NULL;
+			ret = -1;
+			break;
 		}
 
 		/* 物理ページのアドレスを取得 */
@@ -146,43 +189,279 @@ void *vmalloc(unsigned long size)
 		/* 仮想アドレスと物理アドレスをページテーブルでマッピング（カーネル専用） */
 		if (map_page_vmalloc(vaddr, paddr, _PAGE_KERNEL) != 0)
 		{
-			/* マッピング失敗時は物理ページも含めて解放 */
-			unsigned long j;
+			/* マッピング失敗時は物理ページも解放 */
 			free_pages(page, 0);
-			for (j = 0; j < i; j++)
-			{
-				unsigned long free_vaddr = addr + (j << PAGE_SHIFT);
-				struct page *free_page = (struct page *)virt_to_phys((void *)free_vaddr);
-				free_pages(free_page, 0);
-			}
-			remove_vm_area(addr);
-			kfree(vma);
-			kfree(vm);
 			printk(KERN_WARNING "vmalloc: failed to map page %lu/%lu\n", i, nr_pages);
-			return NULL;
+			ret = -1;
+			break;
 		}
 	}
 
-	/* vm_structを初期化してリストに追加 */
-	vm->addr = (void *)addr;
-	vm->size = aligned_size;
-	vm->next = vmlist;
-	vmlist = vm;
+	return ret;
+}
+
+/** 指定したサイズの仮想メモリを割り当てる
+ * @param size 割り当てサイズ（バイト単位）
+ * @return 割り当てた仮想アドレス、失敗時はNULL
+ * @note Linux 2.6.11のvmalloc()に相当する
+ */
+void *vmalloc(unsigned long size)
+{
+	struct vm_struct *vm;
+	unsigned long addr;
+	unsigned long nr_pages;
+
+	if (size == 0)
+	{
+		return NULL;
+	}
+
+	vm = get_vm_area(size, VM_READ | VM_WRITE);
+	if (vm == NULL)
+	{
+		return NULL;
+	}
+	addr = (unsigned long)vm->addr;
+
+	/* ページ数を計算 */
+	nr_pages = vm->size >> PAGE_SHIFT;
+
+	/* 物理ページを割り当ててマッピング */
+	if (map_new_pages(addr, nr_pages) != 0)
+	{
+		/* 失敗した場合は既にマップしたページごと領域を解放 */
+		vfree(vm->addr);
+		return NULL;
+	}
 
 	printk(KERN_INFO "vmalloc: allocated %lu bytes at 0x%lx\n", size, addr);
 	return (void *)addr;
 }
 
-/** vmalloc()で割り当てた仮想メモリを解放する
- * @param addr 解放する仮想アドレス
- * @note Linux 2.6.11のvfree()に相当する
+/** 下端にガードページを付けて仮想メモリを割り当てる
+ * @param size 割り当てサイズ（バイト単位）
+ * @return 割り当てた仮想アドレス（ガードページの直上），失敗時はNULL
+ * @details 領域の先頭1ページをマップせずに残す．下向きに伸びるカーネルスタックがあふれると，
+ *          隣の領域を壊す前にガードページへのアクセスでフォルトする
+ * @note 解放はvfree()に返されたアドレスを渡す
  */
-void vfree(void *addr)
+void *vmalloc_guarded(unsigned long size)
+{
+	struct vm_struct *vm;
+	unsigned long addr;
+
+	if (size == 0)
+	{
+		return NULL;
+	}
+
+	vm = get_vm_area(size + PAGE_SIZE, VM_READ | VM_WRITE | VM_GUARD);
+	if (vm == NULL)
+	{
+		return NULL;
+	}
+	addr = (unsigned long)vm->addr + PAGE_SIZE;
+
+	if (map_new_pages(addr, (vm->size >> PAGE_SHIFT) - 1) != 0)
+	{
+		vfree((void *)addr);
+		return NULL;
+	}
+
+	return (void *)addr;
+}
+
+/** 既存の物理ページ群を仮想的に連続した領域にマップする
+ * @param pages    物理ページの配列
+ * @param nr_pages ページ数
+ * @return マップした仮想アドレス、失敗時はNULL
+ * @note Linux 2.6.11のvmap()に相当する
+ * @note 物理ページの所有権は呼び出し元に残り，解除はvunmap()で行う
+ */
+void *vmap(struct page **pages, unsigned int nr_pages)
+{
+	struct vm_struct *vm;
+	unsigned long addr;
+	unsigned int i;
+
+	if (pages == NULL || nr_pages == 0)
+	{
+		return NULL;
+	}
+
+	vm = get_vm_area((unsigned long)nr_pages << PAGE_SHIFT, VM_READ | VM_WRITE | VM_MAP);
+	if (vm == NULL)
+	{
+		return NULL;
+	}
+	addr = (unsigned long)vm->addr;
+
+	for (i = 0; i < nr_pages; i++)
+	{
+		if (map_page_vmalloc(addr + (i << PAGE_SHIFT), (unsigned long)pages[i], _PAGE_KERNEL) != 0)
+		{
+			vunmap(vm->addr);
+			printk(KERN_WARNING "vmap: failed to map page %u/%u\n", i, nr_pages);
+			return NULL;
+		}
+	}
+
+	return vm->addr;
+}
+
+/** 物理メモリを割り当てずに仮想メモリを確保する（デマンドページング）
+ * @param size 確保サイズ（バイト単位）
+ * @return 確保した仮想アドレス、失敗時はNULL
+ * @note 各ページは初回アクセス時のページフォルトでゼロページとして割り当てられる
+ * @note 解放はvfree()で行う
+ */
+void *vmalloc_lazy(unsigned long size)
+{
+	struct vm_struct *vm;
+
+	if (size == 0)
+	{
+		return NULL;
+	}
+
+	vm = get_vm_area(size, VM_READ | VM_WRITE | VM_DEMAND);
+	if (vm == NULL)
+	{
+		return NULL;
+	}
+
+	printk(KERN_INFO "vmalloc_lazy: reserved %lu bytes at 0x%lx\n", size, (unsigned long)vm->addr);
+	return vm->addr;
+}
+
+/** 仮想アドレス空間のみを予約する
+ * @param size 予約サイズ（バイト単位）
+ * @return 予約した仮想アドレス、失敗時はNULL
+ * @note アクセス権を持たないため，呼び出し元がmap_page_vmalloc()で明示的にマップするまで
+ *       アクセスするとページフォルトでpanicする
+ * @note 解放はvfree()で行う（マップ済みのページも解放される）
+ */
+void *vreserve(unsigned long size)
+{
+	struct vm_struct *vm;
+
+	if (size == 0)
+	{
+		return NULL;
+	}
+
+	vm = get_vm_area(size, 0);
+	if (vm == NULL)
+	{
+		return NULL;
+	}
+
+	return vm->addr;
+}
+
+/** ページテーブルを辿って領域のマッピングを外し，物理ページを解放する
+ * @param addr             領域の開始仮想アドレス
+ * @param nr_pages         領域のページ数
+ * @param deallocate_pages 非0なら物理ページも解放する（vmap/ioremap領域では0）
+ * @note 遅延割り当て・予約領域や割り当て途中で失敗した領域は
+ *       マップ済みのページだけが物理ページを持つため，PTEの存在を確認する
+ * @note 空になったページテーブルはunmap_page_vmalloc()が回収する
+ * @note TLBはフラッシュしない（呼び出し元の責任）
+ */
+static void unmap_vm_area(unsigned long addr, unsigned long nr_pages, int deallocate_pages)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr_pages; i++)
+	{
+		pte_t old = unmap_page_vmalloc(addr + (i << PAGE_SHIFT));
+
+		if (pte_present(old) && deallocate_pages)
+		{
+			free_pages((struct page *)pte_page(old), 0);
+		}
+	}
+}
+
+/** 遅延解放中の領域をまとめて回収する
+ * @details 溜まっていた領域全体を覆う範囲で全CPUのTLBを1回だけ無効化してから，
+ *          VMAとvm_structを解放し，仮想アドレス範囲を再利用可能にする
+ * @note vmap_mutexを持って呼ぶ．Linuxのpurge_vmap_area_lazy()に相当する
+ */
+static void __vm_unmap_aliases(void)
+{
+	struct vm_struct *vm, *next;
+	unsigned long start = ~0UL;
+	unsigned long end = 0;
+
+	if (purge_list == NULL)
+	{
+		return;
+	}
+
+	for (vm = purge_list; vm != NULL; vm = vm->next)
+	{
+		if ((unsigned long)vm->addr < start)
+		{
+			start = (unsigned long)vm->addr;
+		}
+		if ((unsigned long)vm->addr + vm->size > end)
+		{
+			end = (unsigned long)vm->addr + vm->size;
+		}
+	}
+	flush_tlb_kernel_range(start, end);
+
+	for (vm = purge_list; vm != NULL; vm = next)
+	{
+		unsigned long vaddr = (unsigned long)vm->addr;
+		struct vm_area_struct *vma = find_vma(vaddr);
+
+		next = vm->next;
+		remove_vm_area(vaddr);
+		kfree(vma);
+		kfree(vm);
+	}
+
+	purge_list = NULL;
+	nr_lazy_pages = 0;
+}
+
+/* 遅延解放中の領域をまとめて回収する（Linuxのvm_unmap_aliases()に相当する） */
+void vm_unmap_aliases(void)
+{
+	mutex_lock(&vmap_mutex);
+	__vm_unmap_aliases();
+	mutex_unlock(&vmap_mutex);
+}
+
+/** 領域の利用者に渡したアドレスを求める
+ * @note ガードページ付きの領域ではガードページの直上になる
+ */
+static inline void *vm_struct_addr(const struct vm_struct *vm)
+{
+	if (vm->flags & VM_GUARD)
+	{
+		return (char *)vm->addr + PAGE_SIZE;
+	}
+	return vm->addr;
+}
+
+/** vmalloc領域のマッピングを解除する（vfree/vunmapの共通処理）
+ * @param addr             解除する仮想アドレス
+ * @param deallocate_pages 非0なら物理ページも解放する
+ * @param verbose          非0なら解放したことをログに出す
+ * @note Linux 2.6.11の__vunmap()に相当する
+ * @note マッピングは即座に外すが，TLBのフラッシュと仮想アドレス範囲の返却は
+ *       遅延解放ページ数がLAZY_MAX_PAGESに達するまで持ち越す
+ * @note 探索から遅延解放リストへの追加までをvmap_mutexの1区間で行い，
+ *       パージが仮想アドレス範囲を返却する前にマッピングが外れているようにする
+ */
+static void __vunmap(void *addr, int deallocate_pages, int verbose)
 {
 	struct vm_struct *vm, *prev;
 	unsigned long vaddr = (unsigned long)addr;
 	unsigned long nr_pages;
-	unsigned long i;
 
 	if (addr == NULL)
 	{
@@ -190,10 +469,11 @@ void vfree(void *addr)
 	}
 
 	/* vmlistから該当するvm_structを探す */
+	mutex_lock(&vmap_mutex);
 	prev = NULL;
 	for (vm = vmlist; vm != NULL; vm = vm->next)
 	{
-		if (vm->addr == addr)
+		if (vm_struct_addr(vm) == addr)
 		{
 			break;
 		}
@@ -202,23 +482,12 @@ void vfree(void *addr)
 
 	if (vm == NULL)
 	{
+		mutex_unlock(&vmap_mutex);
 		printk(KERN_WARNING "vfree: address 0x%lx not found\n", vaddr);
 		return;
 	}
 
-	/* 物理ページを解放 */
-	nr_pages = vm->size >> PAGE_SHIFT;
-	for (i = 0; i < nr_pages; i++)
-	{
-		unsigned long free_vaddr = vaddr + (i << PAGE_SHIFT);
-		struct page *page = (struct page *)virt_to_phys((void *)free_vaddr);
-		free_pages(page, 0);
-	}
-
-	/* VMAをリストから削除 */
-	remove_vm_area(vaddr);
-
-	/* vmlistから削除 */
+	/* vmlistから外す */
 	if (prev == NULL)
 	{
 		vmlist = vm->next;
@@ -228,10 +497,60 @@ void vfree(void *addr)
 		prev->next = vm->next;
 	}
 
-	/* vm_structを解放 */
-	kfree(vm);
+	/* vmap/ioremap領域の物理ページは呼び出し元（またはデバイス）のもの */
+	if (vm->flags & (VM_MAP | VM_IOREMAP))
+	{
+		deallocate_pages = 0;
+	}
+
+	/** ガードページはマップされていないが，unmap_vm_area()がPTEを確認するため領域全体を渡してよい
+	 * @note 物理ページはTLBの無効化を待たずに解放する．他のCPUに古い変換が残っていても，
+	 *       解放済みの仮想アドレスには誰もアクセスしない．仮想アドレスの再利用はパージで全CPUを無効化した後
+	 */
+	nr_pages = vm->size >> PAGE_SHIFT;
+	unmap_vm_area((unsigned long)vm->addr, nr_pages, deallocate_pages);
+
+	if (verbose)
+	{
+		printk(KERN_INFO "vfree: freed %lu bytes at 0x%lx\n", vm->size, vaddr);
+	}
+
+	/* 遅延解放リストに積み，閾値に達したらまとめてパージする */
+	vm->next = purge_list;
+	purge_list = vm;
+	nr_lazy_pages += nr_pages;
+	if (nr_lazy_pages >= LAZY_MAX_PAGES)
+	{
+		__vm_unmap_aliases();
+	}
+	mutex_unlock(&vmap_mutex);
+}
+
+/** vmalloc()で割り当てた仮想メモリを解放する
+ * @param addr 解放する仮想アドレス
+ * @note Linux 2.6.11のvfree()に相当する
+ */
+void vfree(void *addr)
+{
+	__vunmap(addr, 1, 1);
+}
 
-	printk(KERN_INFO "vfree: freed %lu bytes at 0x%lx\n", vm->size, vaddr);
+/** ログを出さずにvmalloc()で割り当てた仮想メモリを解放する
+ * @param addr 解放する仮想アドレス
+ * @note fork/exitのたびに解放されるカーネルスタックのように，頻繁に解放する領域で使う
+ */
+void vfree_quiet(void *addr)
+{
+	__vunmap(addr, 1, 0);
+}
+
+/** vmap()で作成したマッピングを解除する
+ * @param addr vmap()が返した仮想アドレス
+ * @note 物理ページは解放しない
+ */
+void vunmap(void *addr)
+{
+	__vunmap(addr, 0, 1);
 }
 
 /** 割り当て済み仮想メモリのサイズを取得する
@@ -241,6 +560,7 @@ void vfree(void *addr)
 size_t vsize(void *addr)
 {
 	struct vm_struct *vm;
+	size_t size = 0;
 
 	if (addr == NULL)
 	{
@@ -248,45 +568,87 @@ size_t vsize(void *addr)
 	}
 
 	/* vmlistから該当するvm_structを探す */
+	mutex_lock(&vmap_mutex);
 	for (vm = vmlist; vm != NULL; vm = vm->next)
 	{
-		if (vm->addr == addr)
+		if (vm_struct_addr(vm) == addr)
 		{
-			return vm->size;
+			size = (vm->flags & VM_GUARD) ? vm->size - PAGE_SIZE : vm->size;
+			break;
 		}
 	}
+	mutex_unlock(&vmap_mutex);
 
-	return 0;
+	return size;
 }
 
-/** 仮想メモリヒープの拡張する
- * @param increment 増減サイズ（バイト単位）
- * @return 新しいヒープ境界、失敗時はNULL
- * @note Linux 2.6.11にはない独自関数（kbrk()の仮想メモリ版）
- * @details
- * - increment > 0: ヒープを拡張
- * - increment < 0: ヒープを縮小
- * - increment == 0: 現在のヒープ境界を返す
+/** ヒープ窓の[vheap_mapped, end)に物理ページをマップする
+ * @param end マップ後の終端（ページ境界）
+ * @return 0=成功、-1=失敗（途中までマップしたページは残す）
  */
-void *vbrk(long increment)
+static int vbrk_map_until(unsigned long end)
+{
+	unsigned long vaddr;
+	int ret = 0;
+
+	for (vaddr = (unsigned long)vheap_mapped; vaddr < end; vaddr += PAGE_SIZE)
+	{
+		struct page *page = alloc_pages(GFP_ZERO, 0);
+
+		if (page == NULL)
+		{
+			ret = -1;
+			break;
+		}
+		if (map_page_vmalloc(vaddr, (unsigned long)page, _PAGE_KERNEL) != 0)
+		{
+			free_pages(page, 0);
+			ret = -1;
+			break;
+		}
+		vheap_mapped = (void *)(vaddr + PAGE_SIZE);
+	}
+
+	return ret;
+}
+
+/** ヒープ窓の[end, vheap_mapped)をアンマップして物理ページを解放する
+ * @param end アンマップ後の終端（ページ境界）
+ */
+static void vbrk_unmap_from(unsigned long end)
+{
+	unsigned long mapped = (unsigned long)vheap_mapped;
+
+	if (end >= mapped)
+	{
+		return;
+	}
+
+	unmap_vm_area(end, (mapped - end) >> PAGE_SHIFT, 1);
+	flush_tlb_kernel_range(end, mapped);
+	vheap_mapped = (void *)end;
+}
+
+/* vbrk_mutexを持ってヒープ境界を動かす（vbrk()の本体） */
+static void *__vbrk(long increment)
 {
-	void *new_brk;
-	unsigned long expand_size;
-	void *new_region;
+	unsigned long brk;
+	unsigned long new_brk;
+	unsigned long new_mapped;
 
-	/* 初回呼び出し時：初期ヒープ領域を確保 */
+	/* 初回呼び出し時：ヒープ用の仮想アドレス窓を予約 */
 	if (vheap_start == NULL)
 	{
-		/* 初期サイズ：1MB */
-		vheap_start = vmalloc(1024 * 1024);
+		vheap_start = vreserve(VBRK_WINDOW_SIZE);
 		if (vheap_start == NULL)
 		{
-			printk(KERN_WARNING "vbrk: failed to initialize heap\n");
+			printk(KERN_WARNING "vbrk: failed to reserve heap window\n");
 			return NULL;
 		}
-		vheap_end = (void *)((unsigned long)vheap_start + 1024 * 1024);
+		vheap_end = (void *)((unsigned long)vheap_start + VBRK_WINDOW_SIZE);
 		vheap_brk = vheap_start;
-		printk(KERN_INFO "vbrk: initialized heap at 0x%lx-0x%lx\n", (unsigned long)vheap_start,
+		vheap_mapped = vheap_start;
+		printk(KERN_INFO "vbrk: reserved heap window at 0x%lx-0x%lx\n", (unsigned long)vheap_start,
 			   (unsigned long)vheap_end);
 	}
 
@@ -296,50 +658,71 @@ void *vbrk(long increment)
 		return vheap_brk;
 	}
 
-	new_brk = (void *)((long)vheap_brk + increment);
+	brk = (unsigned long)vheap_brk;
 
 	/* ヒープ縮小の場合 */
 	if (increment < 0)
 	{
 		/* ヒープ開始位置より前には戻せない */
-		if (new_brk < vheap_start)
+		if ((unsigned long)-increment > brk - (unsigned long)vheap_start)
 		{
 			printk(KERN_WARNING "vbrk: cannot shrink below heap start\n");
 			return NULL;
 		}
-		vheap_brk = new_brk;
-		printk(KERN_INFO "vbrk: shrunk by %ld bytes to 0x%lx\n", -increment, (unsigned long)new_brk);
-		return new_brk;
+		new_brk = brk - (unsigned long)-increment;
+		new_mapped = (new_brk + PAGE_SIZE - 1) & PAGE_MASK;
+
+		/* 余剰が閾値を超えたときだけアンマップする */
+		if ((unsigned long)vheap_mapped - new_mapped > VBRK_TRIM_THRESHOLD)
+		{
+			vbrk_unmap_from(new_mapped);
+		}
+
+		vheap_brk = (void *)new_brk;
+		printk(KERN_INFO "vbrk: shrunk by %ld bytes to 0x%lx\n", -increment, new_brk);
+		return vheap_brk;
 	}
 
-	/* ヒープ拡張の場合 */
-	/* 現在の割り当て済み領域内に収まる場合 */
-	if (new_brk <= vheap_end)
+	/* ヒープ拡張の場合：窓を超えることはできない */
+	if ((unsigned long)increment > (unsigned long)vheap_end - brk)
 	{
-		vheap_brk = new_brk;
-		printk(KERN_INFO "vbrk: expanded by %ld bytes to 0x%lx\n", increment, (unsigned long)new_brk);
-		return new_brk;
+		printk(KERN_WARNING "vbrk: heap window exhausted (%ld bytes requested)\n", increment);
+		return NULL;
 	}
+	new_brk = brk + (unsigned long)increment;
+	new_mapped = (new_brk + PAGE_SIZE - 1) & PAGE_MASK;
 
-	/* 現在の領域を超える場合：新しい領域を追加で確保 */
-	expand_size = (unsigned long)new_brk - (unsigned long)vheap_end;
-	/* ページサイズに切り上げ */
-	expand_size = (expand_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-
-	new_region = vmalloc(expand_size);
-	if (new_region == NULL)
+	/* マップ済み範囲を超える分だけ物理ページを割り当てる */
+	if (new_mapped > (unsigned long)vheap_mapped && vbrk_map_until(new_mapped) != 0)
 	{
-		printk(KERN_WARNING "vbrk: failed to expand heap by %lu bytes\n", expand_size);
+		/* 失敗時は元のブレイクまで巻き戻す */
+		vbrk_unmap_from((brk + PAGE_SIZE - 1) & PAGE_MASK);
+		printk(KERN_WARNING "vbrk: failed to expand heap by %ld bytes\n", increment);
 		return NULL;
 	}
 
-	printk(KERN_INFO "vbrk: allocated additional region at 0x%lx (%lu bytes)\n", (unsigned long)new_region,
-		   expand_size);
+	vheap_brk = (void *)new_brk;
+	printk(KERN_INFO "vbrk: expanded by %ld bytes to 0x%lx\n", increment, new_brk);
+	return vheap_brk;
+}
 
-	/* ヒープ終端を更新（注意：追加領域は連続していない可能性がある） */
-	vheap_end = (void *)((unsigned long)vheap_end + expand_size);
-	vheap_brk = new_brk;
+/** 仮想メモリヒープの拡張する
+ * @param increment 増減サイズ（バイト単位）
+ * @return 新しいヒープ境界、失敗時はNULL
+ * @note Linux 2.6.11にはない独自関数（kbrk()の仮想メモリ版）
+ * @details
+ * - increment > 0: ヒープを拡張（必要なページだけをマップ）
+ * - increment < 0: ヒープを縮小（余剰がVBRK_TRIM_THRESHOLDを超えたらアンマップ）
+ * - increment == 0: 現在のヒープ境界を返す
+ * @note 縮小時のヒステリシスにより，ページ境界付近で伸縮を繰り返しても
+ *       マップ・アンマップを繰り返さない
+ */
+void *vbrk(long increment)
+{
+	void *ret;
 
-	printk(KERN_INFO "vbrk: expanded by %ld bytes to 0x%lx\n", increment, (unsigned long)new_brk);
-	return new_brk;
+	mutex_lock(&vbrk_mutex);
+	ret = __vbrk(increment);
+	mutex_unlock(&vbrk_mutex);
+	return ret;
 }
@@ -0,0 +1,214 @@
+/*
+ * test_smp.c - CPUごとのデータ領域（PDA）とCPU列挙のテスト
+ *
+ * 以下をテスト:
+ * - read_pda()/write_pda()とcurrent: %fsのPDAセグメント経由で自CPUのデータを読み書きする
+ * - smp_read_mpc(): MP Configuration TableからCPUとI/O APICを登録する
+ * - acpi_parse_madt(): ACPI MADTからCPUとI/O APICを登録する
+ */
+
+#include "../../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/acpi.h>
+#include <asm-i386/desc.h>
+#include <asm-i386/mpspec.h>
+#include <asm-i386/pda.h>
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/string.h>
+
+extern struct task_struct init_task;
+
+/* テーブルを組み立てるバッファ */
+static unsigned char table_buf[256] __attribute__((aligned(16)));
+
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	mp_reset_for_test();
+	memset(table_buf, 0, sizeof(table_buf));
+}
+
+static void teardown_test(void)
+{
+	mp_reset_for_test();
+}
+
+/* 全バイトの和が0になるようにチェックサムを埋める */
+static void fill_checksum(unsigned char *buf, int len, uint8_t *checksum)
+{
+	uint8_t sum = 0;
+	int i;
+
+	*checksum = 0;
+	for (i = 0; i < len; i++)
+	{
+		sum += buf[i];
+	}
+	*checksum = (uint8_t)-sum;
+}
+
+/* MP Configuration Tableのヘッダを書く（エントリはこの後ろに置く） */
+static struct mp_config_table *init_mpc(void)
+{
+	struct mp_config_table *mpc = (struct mp_config_table *)table_buf;
+
+	memcpy(mpc->mpc_signature, "PCMP", 4);
+	mpc->mpc_spec = 4;
+	mpc->mpc_lapic = 0xFEE00000;
+	return mpc;
+}
+
+/* MPテーブルにプロセッサエントリを追加する */
+static unsigned char *add_mp_processor(unsigned char *p, uint8_t apicid, uint8_t flags)
+{
+	struct mpc_config_processor *m = (struct mpc_config_processor *)p;
+
+	m->mpc_type = MP_PROCESSOR;
+	m->mpc_apicid = apicid;
+	m->mpc_cpuflag = flags;
+	return p + sizeof(*m);
+}
+
+/*
+ * テスト: BSPのPDA
+ * 検証: %fsが__KERNEL_PDAを指し，PDAの自己ポインタとCPU番号がBSPのものであること
+ */
+KFS_TEST(test_pda_is_boot_cpu)
+{
+	uint16_t fs;
+
+	__asm__ __volatile__("mov %%fs, %0" : "=r"(fs));
+	KFS_ASSERT_EQ(__KERNEL_PDA, fs);
+	KFS_ASSERT_TRUE(read_pda(_pda) == cpu_pda(0));
+	KFS_ASSERT_EQ(0, smp_processor_id());
+	KFS_ASSERT_TRUE(cpu_online(0));
+}
+
+/*
+ * テスト: currentはPDAから読む
+ * 検証: write_pda()でpcurrentを書き換えるとcurrentが変わること
+ */
+KFS_TEST(test_current_follows_pda)
+{
+	struct task_struct *saved = current;
+	static struct task_struct dummy;
+
+	KFS_ASSERT_TRUE(current == &init_task);
+
+	write_pda(pcurrent, &dummy);
+	KFS_ASSERT_TRUE(current == &dummy);
+	KFS_ASSERT_TRUE(cpu_pda(0)->pcurrent == &dummy);
+
+	write_pda(pcurrent, saved);
+	KFS_ASSERT_TRUE(current == saved);
+}
+
+/*
+ * テスト: smp_read_mpc - 使用可能なCPUとI/O APICを登録する
+ * 検証: 無効なCPUは無視し，未使用のエントリ（バス）は読み飛ばすこと
+ */
+KFS_TEST(test_smp_read_mpc_registers_enabled_cpus)
+{
+	struct mp_config_table *mpc = init_mpc();
+	unsigned char *p = (unsigned char *)(mpc + 1);
+	struct mpc_config_ioapic *io;
+
+	p = add_mp_processor(p, 0, CPU_ENABLED | CPU_BOOTPROCESSOR);
+	p = add_mp_processor(p, 1, CPU_ENABLED);
+	p = add_mp_processor(p, 2, 0); /* BIOSが無効化したCPU */
+	*p = MP_BUS;
+	p += 8;
+	io = (struct mpc_config_ioapic *)p;
+	io->mpc_type = MP_IOAPIC;
+	io->mpc_apicid = 3;
+	io->mpc_flags = MPC_APIC_USABLE;
+	io->mpc_apicaddr = 0xFEC00000;
+	p += sizeof(*io);
+
+	mpc->mpc_length = (uint16_t)(p - table_buf);
+	fill_checksum(table_buf, mpc->mpc_length, &mpc->mpc_checksum);
+
+	KFS_ASSERT_EQ(2, smp_read_mpc(mpc));
+	KFS_ASSERT_EQ(2, num_processors);
+	KFS_ASSERT_EQ(0, mp_lapic_ids[0]);
+	KFS_ASSERT_EQ(1, mp_lapic_ids[1]);
+	KFS_ASSERT_EQ(1, nr_ioapics);
+	KFS_ASSERT_EQ(3, mp_ioapics[0].id);
+	KFS_ASSERT_EQ(0xFEC00000, mp_ioapics[0].address);
+}
+
+/*
+ * テスト: smp_read_mpc - 壊れたテーブルを拒否する
+ * 検証: チェックサムが合わなければ-1を返し，何も登録しないこと
+ */
+KFS_TEST(test_smp_read_mpc_rejects_bad_checksum)
+{
+	struct mp_config_table *mpc = init_mpc();
+	unsigned char *p = (unsigned char *)(mpc + 1);
+
+	p = add_mp_processor(p, 0, CPU_ENABLED);
+	mpc->mpc_length = (uint16_t)(p - table_buf);
+	fill_checksum(table_buf, mpc->mpc_length, &mpc->mpc_checksum);
+	mpc->mpc_checksum++;
+
+	KFS_ASSERT_EQ(-1, smp_read_mpc(mpc));
+	KFS_ASSERT_EQ(0, num_processors);
+}
+
+/*
+ * テスト: acpi_parse_madt - Local APICとI/O APICを登録する
+ * 検証: 有効なCPUだけを登録し，同じAPIC IDを二重に登録しないこと
+ */
+KFS_TEST(test_acpi_parse_madt_registers_cpus)
+{
+	struct acpi_table_madt *madt = (struct acpi_table_madt *)table_buf;
+	unsigned char *p = (unsigned char *)(madt + 1);
+	struct acpi_madt_local_apic *lapic;
+	struct acpi_madt_io_apic *ioapic;
+	static const uint8_t ids[] = {0, 1, 1, 5};
+	static const uint32_t flags[] = {ACPI_MADT_ENABLED, ACPI_MADT_ENABLED, ACPI_MADT_ENABLED, 0};
+	unsigned int i;
+
+	memcpy(madt->header.signature, "APIC", 4);
+	madt->address = 0xFEE00000;
+	for (i = 0; i < sizeof(ids); i++)
+	{
+		lapic = (struct acpi_madt_local_apic *)p;
+		lapic->header.type = ACPI_MADT_TYPE_LOCAL_APIC;
+		lapic->header.length = sizeof(*lapic);
+		lapic->processor_id = i;
+		lapic->id = ids[i];
+		lapic->lapic_flags = flags[i];
+		p += sizeof(*lapic);
+	}
+	ioapic = (struct acpi_madt_io_apic *)p;
+	ioapic->header.type = ACPI_MADT_TYPE_IO_APIC;
+	ioapic->header.length = sizeof(*ioapic);
+	ioapic->id = 4;
+	ioapic->address = 0xFEC00000;
+	p += sizeof(*ioapic);
+
+	madt->header.length = (uint32_t)(p - table_buf);
+	fill_checksum(table_buf, madt->header.length, &madt->header.checksum);
+
+	KFS_ASSERT_EQ(2, acpi_parse_madt(madt));
+	KFS_ASSERT_EQ(0, mp_lapic_ids[0]);
+	KFS_ASSERT_EQ(1, mp_lapic_ids[1]);
+	KFS_ASSERT_EQ(1, nr_ioapics);
+	KFS_ASSERT_EQ(4, mp_ioapics[0].id);
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_pda_is_boot_cpu, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_current_follows_pda, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_smp_read_mpc_registers_enabled_cpus, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_smp_read_mpc_rejects_bad_checksum, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_acpi_parse_madt_registers_cpus, setup_test, teardown_test),
+};
+
+int register_unit_tests_smp(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,105 @@
+/*
+ * test_ioremap.c - デバイスメモリのマッピングのテスト
+ *
+ * arch/i386/mm/ioremap.c の以下の関数をテスト:
+ * - ioremap(): 物理アドレス範囲をキャッシュ属性付きでマップ
+ * - iounmap(): マッピングの解除
+ */
+
+#include "../../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/io.h>
+#include <asm-i386/page.h>
+#include <asm-i386/pgtable.h>
+#include <kfs/mm.h>
+
+#define TEST_VGA_PHYS 0xB8000
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	/* 必要なら後処理（現在は空） */
+}
+
+/*
+ * テスト: ioremap - UCマッピング
+ * 検証: 物理アドレスを指し，PCDとPWTが立っていること
+ */
+KFS_TEST(test_ioremap_uncached)
+{
+	void *addr = ioremap(TEST_VGA_PHYS, PAGE_SIZE, IOREMAP_UC);
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(addr != NULL);
+	pte = get_pte((unsigned long)addr);
+	KFS_ASSERT_TRUE(pte != NULL && pte_present(*pte));
+	KFS_ASSERT_EQ(TEST_VGA_PHYS, pte_page(*pte));
+	KFS_ASSERT_EQ(_PAGE_PCD | _PAGE_PWT, *pte & (_PAGE_PCD | _PAGE_PWT));
+
+	iounmap(addr);
+	KFS_ASSERT_TRUE(!pte_present(*pte));
+}
+
+/*
+ * テスト: ioremap - WTマッピング
+ * 検証: PWTのみが立っていること
+ */
+KFS_TEST(test_ioremap_write_through)
+{
+	void *addr = ioremap(TEST_VGA_PHYS, PAGE_SIZE, IOREMAP_WT);
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(addr != NULL);
+	pte = get_pte((unsigned long)addr);
+	KFS_ASSERT_EQ(_PAGE_PWT, *pte & (_PAGE_PCD | _PAGE_PWT | _PAGE_PAT));
+
+	iounmap(addr);
+}
+
+/*
+ * テスト: ioremap - ページ境界でないアドレス
+ * 検証: ページ内オフセットが保たれ，範囲をまたぐ分のページもマップされること
+ */
+KFS_TEST(test_ioremap_unaligned)
+{
+	unsigned long phys = TEST_VGA_PHYS + PAGE_SIZE - 2;
+	unsigned char *addr = (unsigned char *)ioremap(phys, 4, IOREMAP_UC);
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(addr != NULL);
+	KFS_ASSERT_EQ(phys & ~PAGE_MASK, (unsigned long)addr & ~PAGE_MASK);
+	pte = get_pte((unsigned long)addr + 2);
+	KFS_ASSERT_TRUE(pte != NULL && pte_present(*pte));
+	KFS_ASSERT_EQ(TEST_VGA_PHYS + PAGE_SIZE, pte_page(*pte));
+
+	iounmap(addr);
+}
+
+/*
+ * テスト: ioremap - 不正な引数
+ * 検証: サイズ0やアドレス空間の折り返しはNULLを返すこと
+ */
+KFS_TEST(test_ioremap_invalid)
+{
+	KFS_ASSERT_TRUE(ioremap(TEST_VGA_PHYS, 0, IOREMAP_UC) == NULL);
+	KFS_ASSERT_TRUE(ioremap(0xFFFFF000, 2 * PAGE_SIZE, IOREMAP_UC) == NULL);
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_ioremap_uncached, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ioremap_write_through, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ioremap_unaligned, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ioremap_invalid, setup_test, teardown_test),
+};
+
+int register_unit_tests_ioremap(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -8,6 +8,7 @@
 #include "unit_test_framework.h"
 #include <asm-i386/page.h>
 #include <asm-i386/pgtable.h>
+#include <kfs/gfp.h>
 #include <kfs/mm.h>
 
 /* 全テストで共通のセットアップ関数 */
@@ -503,6 +504,73 @@ KFS_TEST(test_clear_dirty_flag_functionality)
 	*pte = original;
 }
 
+/* テスト用のvmalloc領域アドレス（ページテーブルの境界に揃える） */
+#define TEST_PGTABLE_VADDR 0xE0000000UL
+
+extern unsigned long nr_free_pages;
+
+/*
+ * テスト: 空になったページテーブルの回収
+ * 検証: 最後のPTEをクリアするとPDEが外れること
+ */
+KFS_TEST(test_empty_page_table_reclaimed)
+{
+	struct page *page = alloc_pages(GFP_KERNEL, 0);
+	extern pde_t boot_page_directory[];
+	pde_t *pde = &boot_page_directory[pgd_index(TEST_PGTABLE_VADDR)];
+
+	KFS_ASSERT_TRUE(page != NULL);
+	KFS_ASSERT_EQ(0, map_page_vmalloc(TEST_PGTABLE_VADDR, (unsigned long)page, _PAGE_KERNEL));
+	KFS_ASSERT_EQ(0, map_page_vmalloc(TEST_PGTABLE_VADDR + PAGE_SIZE, (unsigned long)page, _PAGE_KERNEL));
+	KFS_ASSERT_TRUE(pde_present(*pde));
+
+	/* 1つ目を外してもページテーブルは残る */
+	KFS_ASSERT_EQ((unsigned long)page, pte_page(unmap_page_vmalloc(TEST_PGTABLE_VADDR)));
+	KFS_ASSERT_TRUE(pde_present(*pde));
+
+	/* 最後のPTEを外すとページテーブルが回収される */
+	KFS_ASSERT_TRUE(pte_present(unmap_page_vmalloc(TEST_PGTABLE_VADDR + PAGE_SIZE)));
+	KFS_ASSERT_TRUE(!pde_present(*pde));
+
+	/* マップされていないアドレスは0を返す */
+	KFS_ASSERT_EQ(0, unmap_page_vmalloc(TEST_PGTABLE_VADDR));
+
+	free_pages(page, 0);
+}
+
+/*
+ * テスト: ページテーブルのクイックリスト
+ * 検証: 回収したページテーブルがゼロクリア済みのまま再利用され，
+ *       ページアロケータから新しいページを取らないこと
+ */
+KFS_TEST(test_page_table_quicklist_reuse)
+{
+	struct page *page = alloc_pages(GFP_KERNEL, 0);
+	extern pde_t boot_page_directory[];
+	pde_t *pde = &boot_page_directory[pgd_index(TEST_PGTABLE_VADDR)];
+	unsigned long table;
+	unsigned long before;
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(page != NULL);
+	KFS_ASSERT_EQ(0, map_page_vmalloc(TEST_PGTABLE_VADDR, (unsigned long)page, _PAGE_KERNEL));
+	table = pde_page(*pde);
+	unmap_page_vmalloc(TEST_PGTABLE_VADDR);
+
+	before = nr_free_pages;
+	KFS_ASSERT_EQ(0, map_page_vmalloc(TEST_PGTABLE_VADDR + PGDIR_SIZE, (unsigned long)page, _PAGE_KERNEL));
+	KFS_ASSERT_EQ(before, nr_free_pages);
+	KFS_ASSERT_EQ(table, pde_page(boot_page_directory[pgd_index(TEST_PGTABLE_VADDR + PGDIR_SIZE)]));
+
+	/* リンクに使った先頭エントリもクリアされている */
+	pte = get_pte(TEST_PGTABLE_VADDR + PGDIR_SIZE);
+	KFS_ASSERT_TRUE(pte_present(*pte));
+	KFS_ASSERT_EQ(0, *(pte_t *)table);
+
+	unmap_page_vmalloc(TEST_PGTABLE_VADDR + PGDIR_SIZE);
+	free_pages(page, 0);
+}
+
 static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_page_kernel_flags, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_page_user_rw_flags, setup_test, teardown_test),
@@ -525,6 +593,8 @@ static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_cpu_sets_dirty_flag, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_clear_accessed_flag_functionality, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_clear_dirty_flag_functionality, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_empty_page_table_reclaimed, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_page_table_quicklist_reuse, setup_test, teardown_test),
 };
 
 int register_unit_tests_pgtable(struct kfs_test_case **out)
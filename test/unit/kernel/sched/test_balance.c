@@ -0,0 +1,221 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../support/sched_test_support.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/system.h>
+#include <kfs/errno.h>
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/string.h>
+
+/* テスト用タスク（スラブを使わず静的に確保） */
+static struct task_struct test_tasks[4];
+
+/** CPU 1のアイドルタスクの代わり
+ * @note TIF_POLLING_NRFLAGを立て，resched_curr()がIPIを送らないようにする
+ */
+static struct task_struct fake_idle;
+
+/* テスト前の起動済みCPU */
+static unsigned long saved_online_map;
+
+/* 全テストで共通のセットアップ関数（CPU 1を起動済みにする） */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	sched_init();
+	saved_online_map = cpu_online_map;
+	cpu_online_map = saved_online_map | 2UL;
+	memset(&fake_idle, 0, sizeof(fake_idle));
+	set_tsk_thread_flag(&fake_idle, TIF_POLLING_NRFLAG);
+	init_idle(&fake_idle, 1);
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	cpu_online_map = saved_online_map;
+	clear_tsk_need_resched(current);
+	sched_init();
+}
+
+/* テスト用タスクをCPU 0のCFSのタスクとして初期化する */
+static struct task_struct *init_test_task(int idx, int nice)
+{
+	return init_sched_test_task(&test_tasks[idx], 100 + idx, nice);
+}
+
+/* 割り込みを禁止し，this_rqのロックを持ってload_balance()を呼ぶ */
+static int run_load_balance(struct rq *this_rq, int idle)
+{
+	unsigned long flags;
+	int moved;
+
+	local_irq_save(flags);
+	spin_lock(&this_rq->lock);
+	moved = load_balance(this_rq, idle);
+	spin_unlock(&this_rq->lock);
+	local_irq_restore(flags);
+	return moved;
+}
+
+/**
+ * test_idle_balance_pulls_heaviest - アイドルのCPUが，最も負荷の大きいCPUから最も重いタスクを引き取ることを確認
+ *
+ * vruntimeはmin_vruntimeからの相対位置を保ったまま移し先に換算される
+ */
+static void test_idle_balance_pulls_heaviest(void)
+{
+	struct rq *rq0 = cpu_rq(0), *rq1 = cpu_rq(1);
+	struct task_struct *light = init_test_task(0, 5);
+	struct task_struct *heavy = init_test_task(1, -5);
+	struct task_struct *normal = init_test_task(2, 0);
+	struct sched_lb_stats st;
+
+	rq0->cfs.min_vruntime = 10000000;
+	rq1->cfs.min_vruntime = 3000000;
+	light->se.vruntime = 14000000;
+	heavy->se.vruntime = 12000000;
+	normal->se.vruntime = 14000000;
+	activate_task(rq0, light, 0);
+	activate_task(rq0, heavy, 0);
+	activate_task(rq0, normal, 0);
+
+	KFS_ASSERT_EQ(1, run_load_balance(rq1, 1));
+	KFS_ASSERT_EQ(1, task_cpu(heavy));
+	KFS_ASSERT_EQ(1, heavy->nr_migrations);
+	KFS_ASSERT_TRUE(heavy->se.vruntime == 5000000);
+	KFS_ASSERT_EQ(1, rq1->nr_running);
+	KFS_ASSERT_EQ(2, rq0->nr_running);
+	KFS_ASSERT_TRUE(test_tsk_need_resched(&fake_idle));
+
+	sched_get_lb_stats(1, &st);
+	KFS_ASSERT_EQ(1, st.lb_count);
+	KFS_ASSERT_EQ(1, st.lb_gained_idle);
+	KFS_ASSERT_EQ(0, st.lb_failed);
+	sched_get_lb_stats(0, &st);
+	KFS_ASSERT_EQ(1, st.lb_lost);
+}
+
+/**
+ * test_busy_balance_needs_imbalance - 忙しいCPUは，移した後も負荷が逆転しない場合だけ引き取ることを確認
+ *
+ * 2対1では移すと1対2になるだけなので移さず，3対1なら1つ移す
+ */
+static void test_busy_balance_needs_imbalance(void)
+{
+	struct rq *rq0 = cpu_rq(0), *rq1 = cpu_rq(1);
+	struct task_struct *a = init_test_task(0, 0);
+	struct task_struct *b = init_test_task(1, 0);
+	struct task_struct *c = init_test_task(2, 0);
+	struct task_struct *d = init_test_task(3, 0);
+	struct sched_lb_stats st;
+
+	d->cpu = 1;
+	activate_task(rq1, d, 0);
+	activate_task(rq0, a, 0);
+	activate_task(rq0, b, 0);
+	KFS_ASSERT_EQ(0, run_load_balance(rq1, 0));
+	KFS_ASSERT_EQ(1, rq1->nr_balance_failed);
+
+	activate_task(rq0, c, 0);
+	KFS_ASSERT_EQ(1, run_load_balance(rq1, 0));
+	KFS_ASSERT_EQ(2, rq1->nr_running);
+	KFS_ASSERT_EQ(2, rq0->nr_running);
+	KFS_ASSERT_EQ(0, rq1->nr_balance_failed);
+
+	sched_get_lb_stats(1, &st);
+	KFS_ASSERT_EQ(1, st.lb_gained_busy);
+}
+
+/**
+ * test_balance_respects_affinity - 移し先で実行を許されていないタスクと，実行中のタスクは移さないことを確認
+ */
+static void test_balance_respects_affinity(void)
+{
+	struct rq *rq0 = cpu_rq(0), *rq1 = cpu_rq(1);
+	struct task_struct *pinned = init_test_task(0, 0);
+	struct task_struct *running = init_test_task(1, 0);
+	struct sched_lb_stats st;
+
+	pinned->cpus_allowed = 1UL;
+	running->on_cpu = 1;
+	activate_task(rq0, pinned, 0);
+	activate_task(rq0, running, 0);
+
+	KFS_ASSERT_EQ(0, run_load_balance(rq1, 1));
+	KFS_ASSERT_EQ(0, task_cpu(pinned));
+	KFS_ASSERT_EQ(0, task_cpu(running));
+	KFS_ASSERT_EQ(2, rq0->nr_running);
+
+	sched_get_lb_stats(1, &st);
+	KFS_ASSERT_EQ(1, st.lb_failed);
+	KFS_ASSERT_EQ(1, rq1->nr_balance_failed);
+}
+
+/**
+ * test_select_task_rq - 前のCPUが空いていればそれを，埋まっていれば空いている許されたCPUを選ぶことを確認
+ */
+static void test_select_task_rq(void)
+{
+	struct rq *rq0 = cpu_rq(0);
+	struct task_struct *busy = init_test_task(0, 0);
+	struct task_struct *p = init_test_task(1, 0);
+
+	KFS_ASSERT_EQ(0, select_task_rq(p));
+	p->cpu = 1;
+	KFS_ASSERT_EQ(1, select_task_rq(p));
+
+	activate_task(rq0, busy, 0);
+	p->cpu = 0;
+	KFS_ASSERT_EQ(1, select_task_rq(p));
+
+	/* 許されたCPUが埋まっていれば前のCPUにとどまる */
+	p->cpus_allowed = 1UL;
+	KFS_ASSERT_EQ(0, select_task_rq(p));
+
+	/* 前のCPUが許されていなければ移す */
+	p->cpus_allowed = 2UL;
+	KFS_ASSERT_EQ(1, select_task_rq(p));
+}
+
+/**
+ * test_set_cpus_allowed - 待っているタスクは許されたCPUへすぐ移され，起動済みのCPUを含まないマスクは拒否されることを確認
+ */
+static void test_set_cpus_allowed(void)
+{
+	struct rq *rq0 = cpu_rq(0), *rq1 = cpu_rq(1);
+	struct task_struct *p = init_test_task(0, 0);
+	unsigned long mask = 0;
+
+	activate_task(rq0, p, 0);
+	KFS_ASSERT_EQ(-EINVAL, set_cpus_allowed(p, 1UL << 5));
+	KFS_ASSERT_TRUE(p->cpus_allowed == CPU_MASK_ALL);
+
+	KFS_ASSERT_EQ(0, set_cpus_allowed(p, 2UL));
+	KFS_ASSERT_EQ(1, task_cpu(p));
+	KFS_ASSERT_EQ(0, rq0->nr_running);
+	KFS_ASSERT_EQ(1, rq1->nr_running);
+
+	/* 今のCPUが許されたままなら移さない */
+	KFS_ASSERT_EQ(0, set_cpus_allowed(p, 3UL));
+	KFS_ASSERT_EQ(1, task_cpu(p));
+
+	KFS_ASSERT_EQ(0, sched_getaffinity(0, &mask));
+	KFS_ASSERT_TRUE(mask == cpu_online_map);
+	KFS_ASSERT_EQ(-ESRCH, sched_setaffinity(99999, 1UL));
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_idle_balance_pulls_heaviest, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_busy_balance_needs_imbalance, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_balance_respects_affinity, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_select_task_rq, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_set_cpus_allowed, setup_test, teardown_test),
+};
+
+int register_unit_tests_balance(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
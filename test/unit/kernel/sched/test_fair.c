@@ -0,0 +1,299 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../support/sched_test_support.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/div64.h>
+#include <asm-i386/param.h>
+#include <kfs/errno.h>
+#include <kfs/sched.h>
+
+extern struct task_struct init_task;
+
+/* テスト用タスク（スラブを使わず静的に確保） */
+static struct task_struct test_tasks[3];
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	sched_init();
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	/* 必要なら後処理（現在は空） */
+}
+
+/* テスト用タスクをCFSのタスクとして初期化する */
+static struct task_struct *init_test_task(int idx, uint64_t vruntime, unsigned long load)
+{
+	struct task_struct *p = init_sched_test_task(&test_tasks[idx], 100 + idx, 0);
+
+	/* 表にない重みも使うため，逆数は最初の計算で求めさせる */
+	p->se.load.weight = load;
+	p->se.load.inv_weight = 0;
+	p->se.vruntime = vruntime;
+	return p;
+}
+
+/**
+ * test_fair_pick_smallest_vruntime - 最小vruntimeのタスクが選ばれることを確認
+ */
+static void test_fair_pick_smallest_vruntime(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0, 300, NICE_0_LOAD);
+	struct task_struct *b = init_test_task(1, 100, NICE_0_LOAD);
+	struct task_struct *c = init_test_task(2, 200, NICE_0_LOAD);
+
+	activate_task(rq, a, 0);
+	activate_task(rq, b, 0);
+	activate_task(rq, c, 0);
+
+	KFS_ASSERT_EQ(3, rq->nr_running);
+	KFS_ASSERT_EQ(3, rq->cfs.nr_running);
+	KFS_ASSERT_EQ(3 * NICE_0_LOAD, rq->cfs.load);
+
+	/* 最左ノードがキャッシュされている */
+	KFS_ASSERT_TRUE(rb_first_cached(&rq->cfs.tasks_timeline) == &b->se.run_node);
+
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == b);
+	KFS_ASSERT_TRUE(rq->curr == b);
+	KFS_ASSERT_TRUE(rq->cfs.curr == &b->se);
+
+	/* 実行中のエンティティはrb-treeから外れる */
+	KFS_ASSERT_TRUE(rb_first_cached(&rq->cfs.tasks_timeline) == &c->se.run_node);
+
+	printk("fair pick smallest vruntime test passed\n");
+}
+
+/**
+ * test_fair_weight_scales_vruntime - 負荷重みに応じてvruntimeの進みが変わることを確認
+ *
+ * 重み2倍のタスクは同じ実行時間でvruntimeが半分しか進まない
+ */
+static void test_fair_weight_scales_vruntime(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *light = init_test_task(0, 0, NICE_0_LOAD);
+	struct task_struct *heavy = init_test_task(1, 0, 2 * NICE_0_LOAD);
+
+	activate_task(rq, light, 0);
+	activate_task(rq, heavy, 0);
+
+	/* 同じvruntimeなら先に登録したタスクが選ばれる */
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == light);
+	for (int i = 0; i < 10; i++)
+	{
+		scheduler_tick();
+	}
+
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == heavy);
+	for (int i = 0; i < 10; i++)
+	{
+		scheduler_tick();
+	}
+
+	KFS_ASSERT_TRUE(light->se.sum_exec_runtime == 10 * TICK_NSEC);
+	KFS_ASSERT_TRUE(heavy->se.sum_exec_runtime == 10 * TICK_NSEC);
+	KFS_ASSERT_TRUE(light->se.vruntime == 10 * TICK_NSEC);
+	KFS_ASSERT_TRUE(heavy->se.vruntime == 5 * TICK_NSEC);
+
+	/* vruntimeの小さいheavyが再び選ばれる */
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == heavy);
+
+	printk("fair weight scales vruntime test passed\n");
+}
+
+/**
+ * test_fair_dequeue - ランキューからの除去を確認
+ */
+static void test_fair_dequeue(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0, 100, NICE_0_LOAD);
+	struct task_struct *b = init_test_task(1, 200, 2 * NICE_0_LOAD);
+
+	activate_task(rq, a, 0);
+	activate_task(rq, b, 0);
+	deactivate_task(rq, a, DEQUEUE_SLEEP);
+
+	KFS_ASSERT_EQ(0, a->se.on_rq);
+	KFS_ASSERT_TRUE(RB_EMPTY_NODE(&a->se.run_node));
+	KFS_ASSERT_EQ(1, rq->nr_running);
+	KFS_ASSERT_EQ(2 * NICE_0_LOAD, rq->cfs.load);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == b);
+
+	/* 実行中のタスクを外すと，次はアイドルタスクが選ばれる */
+	deactivate_task(rq, b, DEQUEUE_SLEEP);
+	KFS_ASSERT_EQ(0, rq->nr_running);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == rq->idle);
+
+	printk("fair dequeue test passed\n");
+}
+
+/**
+ * test_fair_fork_inherits_vruntime - fork直後のvruntimeが親から引き継がれることを確認
+ */
+static void test_fair_fork_inherits_vruntime(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *parent = init_test_task(0, 0, NICE_0_LOAD);
+	struct task_struct *child = init_test_task(1, 0, NICE_0_LOAD);
+
+	activate_task(rq, parent, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == parent);
+	for (int i = 0; i < 3; i++)
+	{
+		scheduler_tick();
+	}
+
+	sched_fork(child);
+	KFS_ASSERT_TRUE(child->se.vruntime == parent->se.vruntime);
+	KFS_ASSERT_EQ(0, child->se.on_rq);
+
+	wake_up_new_task(child);
+	KFS_ASSERT_EQ(1, child->se.on_rq);
+	KFS_ASSERT_EQ(2, rq->nr_running);
+
+	printk("fair fork inherits vruntime test passed\n");
+}
+
+/**
+ * test_fair_nice_sets_weight - nice値から負荷重みと逆数が表引きで決まることを確認
+ *
+ * fork直後の子も親（自分にコピーされた）のnice値から重みを設定する
+ */
+static void test_fair_nice_sets_weight(void)
+{
+	struct task_struct *p = init_test_task(0, 0, NICE_0_LOAD);
+
+	set_user_nice(p, MIN_NICE);
+	KFS_ASSERT_EQ(MIN_NICE, task_nice(p));
+	KFS_ASSERT_EQ(88761, p->se.load.weight);
+	KFS_ASSERT_EQ(48388, p->se.load.inv_weight);
+
+	set_user_nice(p, MAX_NICE);
+	KFS_ASSERT_EQ(MAX_PRIO - 1, p->static_prio);
+	KFS_ASSERT_EQ(15, p->se.load.weight);
+
+	/* 範囲外は無視する */
+	set_user_nice(p, MAX_NICE + 1);
+	KFS_ASSERT_EQ(MAX_NICE, task_nice(p));
+
+	p->static_prio = NICE_TO_PRIO(10);
+	sched_fork(p);
+	KFS_ASSERT_EQ(110, p->se.load.weight);
+	KFS_ASSERT_EQ(39045157, p->se.load.inv_weight);
+
+	printk("fair nice sets weight test passed\n");
+}
+
+/**
+ * test_fair_inverse_weight_matches_division - 逆数による換算が除算と一致することを確認
+ *
+ * nice 5のタスクを10 tick実行し，vruntimeが実行時間 * NICE_0_LOAD / 335とほぼ等しい（1 tickあたり1ns以内）こと
+ */
+static void test_fair_inverse_weight_matches_division(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *p = init_test_task(0, 0, NICE_0_LOAD);
+	uint64_t expected = div_u64(10ULL * TICK_NSEC * NICE_0_LOAD, 335);
+	uint64_t diff;
+
+	set_user_nice(p, 5);
+	activate_task(rq, p, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == p);
+	for (int i = 0; i < 10; i++)
+	{
+		scheduler_tick();
+	}
+
+	KFS_ASSERT_TRUE(p->se.sum_exec_runtime == 10 * TICK_NSEC);
+	diff = p->se.vruntime > expected ? p->se.vruntime - expected : expected - p->se.vruntime;
+	KFS_ASSERT_TRUE(diff <= 10);
+
+	printk("fair inverse weight matches division test passed\n");
+}
+
+/**
+ * test_fair_renice_queued_task - ランキューに登録中のタスクのnice値を変えると負荷の合計が追従することを確認
+ *
+ * 実行中のタスクより重くなった待機中のタスクは，vruntimeが小さければ実行中のタスクを譲らせる
+ */
+static void test_fair_renice_queued_task(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0, 100, NICE_0_LOAD);
+	struct task_struct *b = init_test_task(1, 200, NICE_0_LOAD);
+
+	activate_task(rq, a, 0);
+	activate_task(rq, b, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == a);
+	clear_tsk_need_resched(a);
+
+	set_user_nice(b, 10);
+	KFS_ASSERT_EQ(NICE_0_LOAD + 110, rq->cfs.load);
+	KFS_ASSERT_EQ(2, rq->nr_running);
+	KFS_ASSERT_EQ(1, b->se.on_rq);
+	KFS_ASSERT_TRUE(!test_tsk_need_resched(a));
+
+	/* 実行中のタスクが軽くなれば再スケジュールを要求する */
+	set_user_nice(a, 5);
+	KFS_ASSERT_EQ(335 + 110, rq->cfs.load);
+	KFS_ASSERT_TRUE(test_tsk_need_resched(a));
+	KFS_ASSERT_TRUE(rq->cfs.curr == &a->se);
+
+	printk("fair renice queued task test passed\n");
+}
+
+/**
+ * test_setpriority_getpriority - setpriority()/getpriority()の値と権限を確認
+ */
+static void test_setpriority_getpriority(void)
+{
+	kernel_cap_t saved = init_task.cap_effective;
+
+	KFS_ASSERT_EQ(20, getpriority(PRIO_PROCESS, 0));
+	KFS_ASSERT_EQ(0, setpriority(PRIO_PROCESS, 0, 5));
+	KFS_ASSERT_EQ(15, getpriority(PRIO_PROCESS, 0));
+	KFS_ASSERT_EQ(335, init_task.se.load.weight);
+
+	/* 範囲外は丸める */
+	KFS_ASSERT_EQ(0, setpriority(PRIO_PROCESS, 0, 100));
+	KFS_ASSERT_EQ(MAX_NICE, task_nice(&init_task));
+
+	KFS_ASSERT_EQ(-EINVAL, setpriority(1, 0, 0));
+	KFS_ASSERT_EQ(-EINVAL, getpriority(1, 0));
+	KFS_ASSERT_EQ(-ESRCH, setpriority(PRIO_PROCESS, 4000, 0));
+	KFS_ASSERT_EQ(-ESRCH, getpriority(PRIO_PROCESS, 4000));
+
+	/* CAP_SYS_NICEがなければnice値を上げることしかできない */
+	init_task.cap_effective = CAP_EMPTY_SET;
+	KFS_ASSERT_EQ(-EACCES, setpriority(PRIO_PROCESS, 0, 0));
+	KFS_ASSERT_EQ(MAX_NICE, task_nice(&init_task));
+	init_task.cap_effective = saved;
+
+	KFS_ASSERT_EQ(0, setpriority(PRIO_PROCESS, 0, 0));
+	KFS_ASSERT_EQ(NICE_0_LOAD, init_task.se.load.weight);
+
+	printk("setpriority getpriority test passed\n");
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_pick_smallest_vruntime, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_weight_scales_vruntime, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_dequeue, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_fork_inherits_vruntime, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_nice_sets_weight, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_inverse_weight_matches_division, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fair_renice_queued_task, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_setpriority_getpriority, setup_test, teardown_test),
+};
+
+int register_unit_tests_fair(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
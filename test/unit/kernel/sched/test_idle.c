@@ -0,0 +1,166 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/processor.h>
+#include <kfs/cpuidle.h>
+#include <kfs/sched.h>
+#include <kfs/string.h>
+
+extern struct task_struct init_task;
+
+/* 仕事が呼ばれた順の記録 */
+static char work_log[16];
+static int work_log_len;
+
+/* work_aに残っている仕事の数 */
+static int work_a_left;
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	sched_init();
+	work_log_len = 0;
+	work_a_left = 0;
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	clear_tsk_need_resched(current);
+	sched_init();
+}
+
+/* 残りがある間だけ仕事をする */
+static int work_a_fn(void)
+{
+	work_log[work_log_len++] = 'a';
+	if (work_a_left == 0)
+	{
+		return 0;
+	}
+	work_a_left--;
+	return 1;
+}
+
+/* 仕事がない */
+static int work_b_fn(void)
+{
+	work_log[work_log_len++] = 'b';
+	return 0;
+}
+
+static struct idle_work work_a = {.name = "a", .fn = work_a_fn};
+static struct idle_work work_b = {.name = "b", .fn = work_b_fn};
+
+/**
+ * test_select_idle_routine - CPUIDがMONITOR/MWAITとC1のサブステートを報告するときだけMWAITを選ぶことを確認
+ */
+static void test_select_idle_routine(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	int expect_mwait = 0;
+
+	if (cpu_has_mwait)
+	{
+		cpuid(0, &eax, &ebx, &ecx, &edx);
+		if (eax >= CPUID_MWAIT_LEAF)
+		{
+			cpuid(CPUID_MWAIT_LEAF, &eax, &ebx, &ecx, &edx);
+			expect_mwait = MWAIT_C1_SUBSTATES(edx) != 0;
+		}
+	}
+
+	select_idle_routine();
+	KFS_ASSERT_TRUE(pm_idle != NULL);
+	KFS_ASSERT_EQ(0, strcmp(idle_routine_name(), expect_mwait ? "mwait" : "hlt"));
+}
+
+/**
+ * test_run_idle_work - 登録した順に1巡ずつ呼ばれ，仕事がなくなれば0を返すことを確認
+ *
+ * 再スケジュールを要求されていれば何も呼ばない
+ */
+static void test_run_idle_work(void)
+{
+	KFS_ASSERT_EQ(0, run_idle_work());
+
+	idle_work_register(&work_a);
+	idle_work_register(&work_b);
+	work_a_left = 2;
+
+	KFS_ASSERT_EQ(1, run_idle_work());
+	KFS_ASSERT_EQ(1, run_idle_work());
+	KFS_ASSERT_EQ(0, run_idle_work());
+	KFS_ASSERT_EQ(6, work_log_len);
+	KFS_ASSERT_EQ(0, strncmp(work_log, "ababab", 6));
+
+	work_a_left = 1;
+	set_tsk_need_resched(current);
+	KFS_ASSERT_EQ(0, run_idle_work());
+	KFS_ASSERT_EQ(6, work_log_len);
+	KFS_ASSERT_EQ(1, work_a_left);
+}
+
+/**
+ * test_cpuidle_residency - 休止の前後で回数と時間が計上されることを確認
+ */
+static void test_cpuidle_residency(void)
+{
+	struct cpuidle_stats st;
+
+	cpuidle_account_enter();
+	cpuidle_account_exit();
+	cpuidle_account_enter();
+	cpuidle_account_exit();
+
+	cpuidle_get_stats(0, &st);
+	KFS_ASSERT_EQ(2, st.usage);
+	KFS_ASSERT_TRUE(st.time_ns < 1000000000ULL);
+}
+
+/**
+ * test_cpuidle_wake_latency - アイドル中の再スケジュール要求からアイドルループを抜けるまでを数えることを確認
+ *
+ * アイドルタスク以外への要求と，抜ける前の2度目の要求は数えない
+ */
+static void test_cpuidle_wake_latency(void)
+{
+	struct rq *rq = this_rq();
+	struct cpuidle_stats st;
+	uint64_t stamp;
+
+	KFS_ASSERT_TRUE(rq->curr == &init_task);
+	resched_curr(rq);
+	cpuidle_get_stats(0, &st);
+	KFS_ASSERT_TRUE(st.wake_stamp != 0);
+	stamp = st.wake_stamp;
+
+	resched_curr(rq);
+	cpuidle_get_stats(0, &st);
+	KFS_ASSERT_TRUE(st.wake_stamp == stamp);
+
+	cpuidle_account_wakeup();
+	cpuidle_get_stats(0, &st);
+	KFS_ASSERT_EQ(1, st.nr_wakeups);
+	KFS_ASSERT_TRUE(st.wake_stamp == 0);
+	KFS_ASSERT_TRUE(st.max_wake_latency_ns <= st.wake_latency_ns);
+
+	/* 要求がなければ数えない */
+	cpuidle_account_wakeup();
+	cpuidle_get_stats(0, &st);
+	KFS_ASSERT_EQ(1, st.nr_wakeups);
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_select_idle_routine, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_run_idle_work, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_cpuidle_residency, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_cpuidle_wake_latency, setup_test, teardown_test),
+};
+
+int register_unit_tests_cpuidle(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,218 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../support/sched_test_support.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/param.h>
+#include <asm-i386/system.h>
+#include <kfs/pid.h>
+#include <kfs/preempt.h>
+#include <kfs/sched.h>
+#include <kfs/slab.h>
+
+extern void fork_init(void);
+extern struct task_struct init_task;
+
+/* テスト用タスク（スラブを使わず静的に確保） */
+static struct task_struct test_tasks[2];
+
+/* スレッドの実行記録 */
+static int kthread_ran;
+static int kthread_on_rq;
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	/* テスト用タスクをランキューから外し，init_taskへの再スケジュール要求を消す */
+	sched_init();
+}
+
+/* テスト用タスクをCFSのタスクとして初期化する */
+static struct task_struct *init_test_task(int idx, uint64_t vruntime)
+{
+	struct task_struct *p = init_sched_test_task(&test_tasks[idx], 100 + idx, 0);
+
+	p->se.vruntime = vruntime;
+	return p;
+}
+
+/* 実行されたことを記録して終了するスレッド */
+static int kthread_mark_ran(void *arg)
+{
+	(void)arg;
+	kthread_ran++;
+	return 0;
+}
+
+/* 眠りかけた状態でプリエンプトされ，ランキューに残るかを記録するスレッド */
+static int kthread_preempted_while_sleeping(void *arg)
+{
+	(void)arg;
+	current->__state = TASK_INTERRUPTIBLE;
+	set_tsk_need_resched(current);
+	preempt_disable();
+	preempt_enable();
+	kthread_on_rq = current->se.on_rq;
+	current->__state = TASK_RUNNING;
+	return 0;
+}
+
+/**
+ * test_preempt_enable_reschedules - 最も外側のpreempt_enable()で切り替わることを確認
+ */
+static void test_preempt_enable_reschedules(void)
+{
+	kthread_ran = 0;
+
+	preempt_disable();
+	KFS_ASSERT_TRUE(kernel_thread(kthread_mark_ran, NULL) > 0);
+
+	/* アイドルタスクは実行可能なタスクに譲る */
+	KFS_ASSERT_TRUE(need_resched());
+
+	/* 入れ子の内側では切り替わらない */
+	preempt_disable();
+	KFS_ASSERT_EQ(2, preempt_count());
+	preempt_enable();
+	KFS_ASSERT_EQ(1, preempt_count());
+	KFS_ASSERT_EQ(0, kthread_ran);
+
+	preempt_enable();
+	KFS_ASSERT_EQ(1, kthread_ran);
+	KFS_ASSERT_EQ(0, preempt_count());
+	KFS_ASSERT_EQ(0, need_resched());
+	KFS_ASSERT_TRUE(current == &init_task);
+
+	printk("preempt enable reschedules test passed\n");
+}
+
+/**
+ * test_preempt_enable_irqs_disabled - 割り込み禁止中はpreempt_enable()で切り替わらないことを確認
+ */
+static void test_preempt_enable_irqs_disabled(void)
+{
+	unsigned long flags;
+
+	kthread_ran = 0;
+	KFS_ASSERT_TRUE(kernel_thread(kthread_mark_ran, NULL) > 0);
+
+	local_irq_save(flags);
+	preempt_disable();
+	preempt_enable();
+	local_irq_restore(flags);
+	KFS_ASSERT_EQ(0, kthread_ran);
+	KFS_ASSERT_TRUE(need_resched());
+
+	/* 要求は残っているので次のプリエンプションポイントで切り替わる */
+	preempt_disable();
+	preempt_enable();
+	KFS_ASSERT_EQ(1, kthread_ran);
+
+	printk("preempt enable irqs disabled test passed\n");
+}
+
+/**
+ * test_preempt_keeps_sleeping_task - プリエンプトされたタスクは眠りかけていてもランキューに残ることを確認
+ */
+static void test_preempt_keeps_sleeping_task(void)
+{
+	kthread_on_rq = 0;
+	KFS_ASSERT_TRUE(kernel_thread(kthread_preempted_while_sleeping, NULL) > 0);
+
+	schedule();
+	KFS_ASSERT_EQ(1, kthread_on_rq);
+	KFS_ASSERT_TRUE(current == &init_task);
+
+	printk("preempt keeps sleeping task test passed\n");
+}
+
+/**
+ * test_tick_requests_resched - タイムスライスを使い切るとtickが再スケジュールを要求することを確認
+ */
+static void test_tick_requests_resched(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0, 0);
+	struct task_struct *b = init_test_task(1, 0);
+
+	/* 実行可能なタスクが1つだけなら切り替えない */
+	activate_task(rq, a, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == a);
+	scheduler_tick();
+	KFS_ASSERT_EQ(0, test_tsk_need_resched(a));
+
+	/* 2つならスライス（SCHED_LATENCY_NSの半分）は1 tickで尽きる */
+	activate_task(rq, b, 0);
+	scheduler_tick();
+	KFS_ASSERT_EQ(1, test_tsk_need_resched(a));
+
+	printk("tick requests resched test passed\n");
+}
+
+/**
+ * test_tick_idle_requests_resched - アイドル中に実行可能なタスクがあればtickが再スケジュールを要求することを確認
+ */
+static void test_tick_idle_requests_resched(void)
+{
+	struct rq *rq = this_rq();
+
+	scheduler_tick();
+	KFS_ASSERT_EQ(0, test_tsk_need_resched(&init_task));
+
+	activate_task(rq, init_test_task(0, 0), 0);
+	scheduler_tick();
+	KFS_ASSERT_EQ(1, test_tsk_need_resched(&init_task));
+
+	printk("tick idle requests resched test passed\n");
+}
+
+/**
+ * test_wakeup_preempts - vruntimeが十分小さいタスクの起床で再スケジュールが要求されることを確認
+ */
+static void test_wakeup_preempts(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *curr = init_test_task(0, 10000000);
+	struct task_struct *near = init_test_task(1, 9500000);
+
+	activate_task(rq, curr, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == curr);
+
+	/* 差が粒度（1ms）未満なら譲らない */
+	activate_task(rq, near, 0);
+	check_preempt_curr(rq, near);
+	KFS_ASSERT_EQ(0, test_tsk_need_resched(curr));
+
+	/* 差が粒度を超えれば譲る */
+	deactivate_task(rq, near, 0);
+	near->se.vruntime = 0;
+	activate_task(rq, near, 0);
+	check_preempt_curr(rq, near);
+	KFS_ASSERT_EQ(1, test_tsk_need_resched(curr));
+
+	printk("wakeup preempts test passed\n");
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_preempt_enable_reschedules, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_preempt_enable_irqs_disabled, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_preempt_keeps_sleeping_task, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_requests_resched, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_idle_requests_resched, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_wakeup_preempts, setup_test, teardown_test),
+};
+
+int register_unit_tests_preempt(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,306 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../support/sched_test_support.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/param.h>
+#include <kfs/errno.h>
+#include <kfs/pid.h>
+#include <kfs/sched.h>
+#include <kfs/slab.h>
+
+extern void fork_init(void);
+extern struct task_struct init_task;
+extern struct task_struct *find_task_by_pid(pid_t pid);
+
+/* テスト用タスク（スラブを使わず静的に確保） */
+static struct task_struct test_tasks[4];
+
+/* スレッドの実行順の記録 */
+static char run_log[8];
+static int run_log_len;
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+	run_log_len = 0;
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	sched_init();
+}
+
+/* テスト用タスクを初期化する（policyがSCHED_NORMALならCFSのタスク） */
+static struct task_struct *init_test_task(int idx, int policy, int rt_priority)
+{
+	struct task_struct *p = init_sched_test_task(&test_tasks[idx], 100 + idx, 0);
+
+	p->policy = (unsigned int)policy;
+	p->rt_priority = (unsigned int)rt_priority;
+	if (policy != SCHED_NORMAL)
+	{
+		p->prio = MAX_RT_PRIO - 1 - rt_priority;
+		p->sched_class = &rt_sched_class;
+		p->rt.time_slice = RR_TIMESLICE;
+	}
+	return p;
+}
+
+/* 実行されたことを記録して終了するスレッド */
+static int kthread_log_run(void *arg)
+{
+	run_log[run_log_len++] = *(char *)arg;
+	return 0;
+}
+
+/**
+ * test_rt_pick_highest_priority - 最も優先度の高いリストの先頭が選ばれることを確認
+ *
+ * 空でない優先度のビットだけが立ち，CFSのタスクより先に選ばれる
+ */
+static void test_rt_pick_highest_priority(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *fair = init_test_task(0, SCHED_NORMAL, 0);
+	struct task_struct *low = init_test_task(1, SCHED_FIFO, 10);
+	struct task_struct *high1 = init_test_task(2, SCHED_FIFO, 50);
+	struct task_struct *high2 = init_test_task(3, SCHED_RR, 50);
+
+	activate_task(rq, fair, 0);
+	activate_task(rq, low, 0);
+	activate_task(rq, high1, 0);
+	activate_task(rq, high2, 0);
+
+	KFS_ASSERT_EQ(4, rq->nr_running);
+	KFS_ASSERT_EQ(3, rq->rt.rt_nr_running);
+	KFS_ASSERT_TRUE(test_bit(49, rq->rt.active.bitmap));
+	KFS_ASSERT_TRUE(test_bit(89, rq->rt.active.bitmap));
+	KFS_ASSERT_EQ(49, sched_find_first_bit(rq->rt.active.bitmap));
+
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == high1);
+
+	/* 実行中のタスクはリストに残り，外すと同じ優先度の次のタスクが選ばれる */
+	KFS_ASSERT_EQ(1, high1->rt.on_rq);
+	deactivate_task(rq, high1, DEQUEUE_SLEEP);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == high2);
+	deactivate_task(rq, high2, DEQUEUE_SLEEP);
+	KFS_ASSERT_TRUE(!test_bit(49, rq->rt.active.bitmap));
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == low);
+	deactivate_task(rq, low, DEQUEUE_SLEEP);
+
+	/* リアルタイムタスクがいなくなればビットは番兵だけになる */
+	KFS_ASSERT_EQ(MAX_RT_PRIO, sched_find_first_bit(rq->rt.active.bitmap));
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == fair);
+}
+
+/**
+ * test_rt_preempts_fair - 実行可能になったリアルタイムタスクはCFSのタスクを譲らせることを確認
+ *
+ * 逆にCFSのタスクはリアルタイムタスクを譲らせない
+ */
+static void test_rt_preempts_fair(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *fair = init_test_task(0, SCHED_NORMAL, 0);
+	struct task_struct *rt = init_test_task(1, SCHED_FIFO, 1);
+	struct task_struct *fair2 = init_test_task(2, SCHED_NORMAL, 0);
+
+	activate_task(rq, fair, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == fair);
+	clear_tsk_need_resched(fair);
+
+	activate_task(rq, rt, ENQUEUE_WAKEUP);
+	check_preempt_curr(rq, rt);
+	KFS_ASSERT_TRUE(test_tsk_need_resched(fair));
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == rt);
+
+	activate_task(rq, fair2, ENQUEUE_WAKEUP);
+	check_preempt_curr(rq, fair2);
+	KFS_ASSERT_TRUE(!test_tsk_need_resched(rt));
+}
+
+/**
+ * test_rt_round_robin_time_slice - SCHED_RRはタイムスライスごとに同じ優先度のタスクと交代することを確認
+ *
+ * SCHED_FIFOはタイムスライスで交代しない
+ */
+static void test_rt_round_robin_time_slice(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0, SCHED_RR, 20);
+	struct task_struct *b = init_test_task(1, SCHED_RR, 20);
+	struct task_struct *fifo = init_test_task(2, SCHED_FIFO, 30);
+	struct task_struct *fifo2 = init_test_task(3, SCHED_FIFO, 30);
+
+	activate_task(rq, a, 0);
+	activate_task(rq, b, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == a);
+	clear_tsk_need_resched(a);
+
+	for (int i = 0; i < RR_TIMESLICE - 1; i++)
+	{
+		scheduler_tick();
+	}
+	KFS_ASSERT_TRUE(!test_tsk_need_resched(a));
+	KFS_ASSERT_EQ(1, a->rt.time_slice);
+
+	scheduler_tick();
+	KFS_ASSERT_TRUE(test_tsk_need_resched(a));
+	KFS_ASSERT_EQ(RR_TIMESLICE, a->rt.time_slice);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == b);
+	KFS_ASSERT_EQ((uint64_t)RR_TIMESLICE * TICK_NSEC, a->se.sum_exec_runtime);
+
+	activate_task(rq, fifo, 0);
+	activate_task(rq, fifo2, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == fifo);
+	clear_tsk_need_resched(fifo);
+	for (int i = 0; i < 2 * RR_TIMESLICE; i++)
+	{
+		scheduler_tick();
+	}
+	KFS_ASSERT_TRUE(!test_tsk_need_resched(fifo));
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == fifo);
+}
+
+/**
+ * test_rt_throttling - 周期内にRT_RUNTIME_NSを使い切ったリアルタイムタスクは周期の残りは選ばれないことを確認
+ *
+ * 周期が変わると実行時間が補充され，再びCFSのタスクより先に選ばれる
+ */
+static void test_rt_throttling(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *fair = init_test_task(0, SCHED_NORMAL, 0);
+	struct task_struct *hog = init_test_task(1, SCHED_FIFO, 99);
+	int runtime_ticks = (int)(RT_RUNTIME_NS / TICK_NSEC);
+	int period_ticks = (int)(RT_PERIOD_NS / TICK_NSEC);
+	int i;
+
+	activate_task(rq, fair, 0);
+	activate_task(rq, hog, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == hog);
+	clear_tsk_need_resched(hog);
+
+	for (i = 0; i < runtime_ticks; i++)
+	{
+		scheduler_tick();
+	}
+	KFS_ASSERT_EQ(0, rq->rt.rt_throttled);
+	KFS_ASSERT_TRUE(!test_tsk_need_resched(hog));
+
+	scheduler_tick();
+	i++;
+	KFS_ASSERT_EQ(1, rq->rt.rt_throttled);
+	KFS_ASSERT_TRUE(test_tsk_need_resched(hog));
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == fair);
+	clear_tsk_need_resched(fair);
+
+	for (; i < period_ticks - 1; i++)
+	{
+		scheduler_tick();
+	}
+	KFS_ASSERT_EQ(1, rq->rt.rt_throttled);
+
+	/* 周期の境界で補充され，CFSのタスクが譲らされる */
+	scheduler_tick();
+	KFS_ASSERT_EQ(0, rq->rt.rt_throttled);
+	KFS_ASSERT_TRUE(test_tsk_need_resched(fair));
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == hog);
+}
+
+/**
+ * test_sched_setscheduler - ポリシーの変更でクラスとランキューが移ることを確認
+ *
+ * 不正な引数と権限のない呼び出しは拒否する
+ */
+static void test_sched_setscheduler(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *p = init_test_task(0, SCHED_NORMAL, 0);
+	struct sched_param normal = {.sched_priority = 0};
+	struct sched_param fifo = {.sched_priority = 40};
+	struct sched_param bad = {.sched_priority = MAX_USER_RT_PRIO};
+	kernel_cap_t saved = init_task.cap_effective;
+
+	activate_task(rq, p, 0);
+	KFS_ASSERT_EQ(1, rq->cfs.nr_running);
+
+	KFS_ASSERT_EQ(-EINVAL, sched_setscheduler(p, 7, &normal));
+	KFS_ASSERT_EQ(-EINVAL, sched_setscheduler(p, SCHED_FIFO, &normal));
+	KFS_ASSERT_EQ(-EINVAL, sched_setscheduler(p, SCHED_NORMAL, &fifo));
+	KFS_ASSERT_EQ(-EINVAL, sched_setscheduler(p, SCHED_RR, &bad));
+	KFS_ASSERT_EQ(-EINVAL, sched_setscheduler(p, SCHED_RR, NULL));
+
+	init_task.cap_effective = CAP_EMPTY_SET;
+	KFS_ASSERT_EQ(-EPERM, sched_setscheduler(p, SCHED_FIFO, &fifo));
+	init_task.cap_effective = saved;
+	KFS_ASSERT_TRUE(p->sched_class == &fair_sched_class);
+
+	KFS_ASSERT_EQ(0, sched_setscheduler(p, SCHED_FIFO, &fifo));
+	KFS_ASSERT_TRUE(p->sched_class == &rt_sched_class);
+	KFS_ASSERT_TRUE(rt_task(p));
+	KFS_ASSERT_EQ(MAX_RT_PRIO - 1 - 40, p->prio);
+	KFS_ASSERT_EQ(0, rq->cfs.nr_running);
+	KFS_ASSERT_EQ(1, rq->rt.rt_nr_running);
+	KFS_ASSERT_EQ(1, rq->nr_running);
+	KFS_ASSERT_TRUE(test_tsk_need_resched(&init_task));
+
+	KFS_ASSERT_EQ(0, sched_setscheduler(p, SCHED_NORMAL, &normal));
+	KFS_ASSERT_TRUE(p->sched_class == &fair_sched_class);
+	KFS_ASSERT_EQ(DEFAULT_PRIO, p->prio);
+	KFS_ASSERT_EQ(1, rq->cfs.nr_running);
+	KFS_ASSERT_EQ(0, rq->rt.rt_nr_running);
+	KFS_ASSERT_TRUE(test_bit(MAX_RT_PRIO, rq->rt.active.bitmap));
+	KFS_ASSERT_EQ(MAX_RT_PRIO, sched_find_first_bit(rq->rt.active.bitmap));
+}
+
+/**
+ * test_rt_thread_runs_before_fair_thread - 後から作ってもリアルタイムのスレッドが先に実行されることを確認
+ *
+ * fork()した子はリアルタイムのポリシーを引き継ぐ
+ */
+static void test_rt_thread_runs_before_fair_thread(void)
+{
+	char fair = 'F';
+	char rt = 'R';
+	struct sched_param param = {.sched_priority = 10};
+	struct task_struct *p;
+
+	KFS_ASSERT_TRUE(kernel_thread(kthread_log_run, &fair) > 0);
+	p = find_task_by_pid(kernel_thread(kthread_log_run, &rt));
+	KFS_ASSERT_EQ(0, sched_setscheduler(p, SCHED_FIFO, &param));
+
+	schedule();
+	KFS_ASSERT_EQ(2, run_log_len);
+	KFS_ASSERT_EQ('R', run_log[0]);
+	KFS_ASSERT_EQ('F', run_log[1]);
+
+	/* リアルタイムの親からforkした子はリアルタイムのクラスに入る */
+	p = init_test_task(0, SCHED_RR, 5);
+	p->rt.time_slice = 1;
+	sched_fork(p);
+	KFS_ASSERT_TRUE(p->sched_class == &rt_sched_class);
+	KFS_ASSERT_EQ(RR_TIMESLICE, p->rt.time_slice);
+	KFS_ASSERT_EQ(0, p->on_rq);
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_rt_pick_highest_priority, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rt_preempts_fair, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rt_round_robin_time_slice, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rt_throttling, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_sched_setscheduler, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rt_thread_runs_before_fair_thread, setup_test, teardown_test),
+};
+
+int register_unit_tests_rt(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
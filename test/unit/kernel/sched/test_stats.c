@@ -0,0 +1,239 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../support/sched_test_support.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/param.h>
+#include <kfs/pid.h>
+#include <kfs/preempt.h>
+#include <kfs/sched.h>
+#include <kfs/semaphore.h>
+#include <kfs/slab.h>
+
+extern void fork_init(void);
+extern struct task_struct init_task;
+extern struct task_struct *find_task_by_pid(pid_t pid);
+
+/* テスト用タスク（スラブを使わず静的に確保） */
+static struct task_struct test_tasks[2];
+
+static DEFINE_SEMAPHORE(test_sem, 0);
+
+/* スレッドが記録した値 */
+static unsigned long recorded_nivcsw;
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+	sema_init(&test_sem, 0);
+	recorded_nivcsw = 0;
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	sched_init();
+}
+
+/* テスト用タスクをCFSのタスクとして初期化する */
+static struct task_struct *init_test_task(int idx)
+{
+	return init_sched_test_task(&test_tasks[idx], 100 + idx, 0);
+}
+
+/* セマフォを待ってから終了するスレッド（TASK_UNINTERRUPTIBLEで眠る） */
+static int kthread_wait_sem(void *arg)
+{
+	(void)arg;
+	down(&test_sem);
+	return 0;
+}
+
+/* 何もせず終了するスレッド */
+static int kthread_noop(void *arg)
+{
+	(void)arg;
+	return 0;
+}
+
+/** 優先度の高いスレッドを作ってCPUを譲り，自分の非自発的なスイッチの回数を記録するスレッド
+ * @note 子をリアルタイムにするまでは，子にプリエンプトされて子が先に終了しないようにする
+ */
+static int kthread_yield_to_rt(void *arg)
+{
+	struct sched_param param = {.sched_priority = 1};
+
+	(void)arg;
+	preempt_disable();
+	sched_setscheduler(find_task_by_pid(kernel_thread(kthread_noop, NULL)), SCHED_FIFO, &param);
+	preempt_enable_no_resched();
+	schedule();
+	recorded_nivcsw = current->nivcsw;
+	return 0;
+}
+
+/**
+ * test_sched_info_run_delay - 実行可能になってから選ばれるまでの時間がrun_delayに入ることを確認
+ *
+ * 眠って外れたタスクは待ちに数えない
+ */
+static void test_sched_info_run_delay(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0);
+	struct task_struct *b = init_test_task(1);
+	struct task_struct *first, *second;
+
+	rq->clock = TICK_NSEC;
+	activate_task(rq, a, 0);
+	activate_task(rq, b, 0);
+	KFS_ASSERT_EQ(TICK_NSEC, a->sched_info.last_queued);
+
+	rq->clock += 3 * TICK_NSEC;
+	first = __pick_next_task(rq);
+	second = first == a ? b : a;
+	KFS_ASSERT_EQ(1, first->sched_info.pcount);
+	KFS_ASSERT_EQ(3 * TICK_NSEC, first->sched_info.run_delay);
+	KFS_ASSERT_EQ(0, first->sched_info.last_queued);
+	KFS_ASSERT_EQ(4 * TICK_NSEC, first->sched_info.last_arrival);
+
+	scheduler_tick();
+	scheduler_tick();
+	deactivate_task(rq, first, DEQUEUE_SLEEP);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == second);
+	KFS_ASSERT_EQ(5 * TICK_NSEC, second->sched_info.run_delay);
+	KFS_ASSERT_EQ(3 * TICK_NSEC, first->sched_info.run_delay);
+	KFS_ASSERT_EQ(0, first->sched_info.last_queued);
+	KFS_ASSERT_EQ(2 * TICK_NSEC, first->se.sum_exec_runtime);
+}
+
+/**
+ * test_idle_time - アイドルタスクが実行していた時間がアイドル時間に入ることを確認
+ *
+ * nohzで止まっていたtickの分も含める
+ */
+static void test_idle_time(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *a = init_test_task(0);
+	int i;
+
+	for (i = 0; i < 5; i++)
+	{
+		scheduler_tick();
+	}
+	scheduler_idle_ticks(10);
+	KFS_ASSERT_EQ(0, rq->idle_time);
+	KFS_ASSERT_EQ(15 * TICK_NSEC, get_idle_time());
+	KFS_ASSERT_EQ(15 * TICK_NSEC, running_clock());
+
+	activate_task(rq, a, 0);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == a);
+	KFS_ASSERT_EQ(15 * TICK_NSEC, rq->idle_time);
+
+	scheduler_tick();
+	scheduler_tick();
+	KFS_ASSERT_EQ(15 * TICK_NSEC, get_idle_time());
+
+	deactivate_task(rq, a, DEQUEUE_SLEEP);
+	KFS_ASSERT_TRUE(__pick_next_task(rq) == &init_task);
+	scheduler_tick();
+	KFS_ASSERT_EQ(16 * TICK_NSEC, get_idle_time());
+	KFS_ASSERT_EQ(2 * TICK_NSEC, a->se.sum_exec_runtime);
+}
+
+/**
+ * test_context_switch_counts - 眠って手放すと自発的，実行可能なまま手放すと非自発的に数えることを確認
+ *
+ * ランキューのスイッチ回数はCPU上のタスクが変わるたびに増える
+ */
+static void test_context_switch_counts(void)
+{
+	pid_t pid = kernel_thread(kthread_wait_sem, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	schedule();
+	KFS_ASSERT_EQ(TASK_UNINTERRUPTIBLE, p->__state);
+	KFS_ASSERT_EQ(1, p->nvcsw);
+	KFS_ASSERT_EQ(0, p->nivcsw);
+	KFS_ASSERT_EQ(1, p->sched_info.pcount);
+	KFS_ASSERT_EQ(2, nr_context_switches());
+
+	up(&test_sem);
+	schedule();
+
+	kernel_thread(kthread_yield_to_rt, NULL);
+	schedule();
+	KFS_ASSERT_EQ(1, recorded_nivcsw);
+}
+
+/**
+ * test_loadavg - LOAD_FREQごとに実行可能なタスクとTASK_UNINTERRUPTIBLEのタスクを畳み込むことを確認
+ *
+ * 同じ数のタスクが続けば1分平均はその数にちょうど届く
+ */
+static void test_loadavg(void)
+{
+	struct rq *rq = this_rq();
+	unsigned long loads[3];
+	unsigned long expected;
+	pid_t pid;
+	int i;
+
+	activate_task(rq, init_test_task(0), 0);
+	activate_task(rq, init_test_task(1), 0);
+
+	for (i = 0; i < LOAD_FREQ - 1; i++)
+	{
+		scheduler_tick();
+	}
+	KFS_ASSERT_EQ(0, avenrun[0]);
+
+	scheduler_tick();
+	expected = (2 * FIXED_1 * (FIXED_1 - EXP_1) + FIXED_1 - 1) / FIXED_1;
+	KFS_ASSERT_EQ(expected, avenrun[0]);
+	KFS_ASSERT_TRUE(avenrun[1] < avenrun[0]);
+	KFS_ASSERT_TRUE(avenrun[2] < avenrun[1]);
+
+	scheduler_idle_ticks(200 * LOAD_FREQ);
+	KFS_ASSERT_EQ(2 * FIXED_1, avenrun[0]);
+	KFS_ASSERT_TRUE(avenrun[1] < avenrun[0]);
+	KFS_ASSERT_TRUE(avenrun[2] < avenrun[1]);
+
+	get_avenrun(loads, FIXED_1 / 200, 0);
+	KFS_ASSERT_EQ(2, LOAD_INT(loads[0]));
+	KFS_ASSERT_EQ(0, LOAD_FRAC(loads[0]));
+
+	/* TASK_UNINTERRUPTIBLEで眠っているタスクも負荷に数える */
+	deactivate_task(rq, &test_tasks[0], DEQUEUE_SLEEP);
+	deactivate_task(rq, &test_tasks[1], DEQUEUE_SLEEP);
+	pid = kernel_thread(kthread_wait_sem, NULL);
+	schedule();
+	KFS_ASSERT_EQ(0, rq->nr_running);
+	KFS_ASSERT_EQ(1, rq->nr_uninterruptible);
+	KFS_ASSERT_EQ(1, find_task_by_pid(pid)->sched_contributes_to_load);
+
+	scheduler_idle_ticks(200 * LOAD_FREQ);
+	KFS_ASSERT_EQ(FIXED_1, avenrun[0]);
+
+	up(&test_sem);
+	KFS_ASSERT_EQ(0, rq->nr_uninterruptible);
+	schedule();
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_sched_info_run_delay, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_idle_time, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_context_switch_counts, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_loadavg, setup_test, teardown_test),
+};
+
+int register_unit_tests_sched_stats(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
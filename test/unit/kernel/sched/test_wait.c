@@ -0,0 +1,238 @@
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <kfs/pid.h>
+#include <kfs/sched.h>
+#include <kfs/signal.h>
+#include <kfs/slab.h>
+#include <kfs/wait.h>
+
+extern void fork_init(void);
+extern struct task_struct init_task;
+extern struct task_struct *find_task_by_pid(pid_t pid);
+
+static DECLARE_WAIT_QUEUE_HEAD(test_wq);
+
+/* スレッドが待つ条件と実行記録 */
+static int wait_cond;
+static int wait_done;
+static int wait_ret;
+
+/* 起床関数の呼び出し記録 */
+static int wake_calls[3];
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+
+	init_waitqueue_head(&test_wq);
+	wait_cond = 0;
+	wait_done = 0;
+	wait_ret = 0;
+	wake_calls[0] = wake_calls[1] = wake_calls[2] = 0;
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	sched_init();
+}
+
+/* TASK_UNINTERRUPTIBLEで条件を待つスレッド */
+static int kthread_wait_event(void *arg)
+{
+	(void)arg;
+	wait_event(test_wq, wait_cond);
+	wait_done++;
+	return 0;
+}
+
+/* TASK_INTERRUPTIBLEで条件を待つスレッド */
+static int kthread_wait_event_interruptible(void *arg)
+{
+	(void)arg;
+	wait_ret = wait_event_interruptible(test_wq, wait_cond);
+	wait_done++;
+	return 0;
+}
+
+/* 呼び出された回数を記録する起床関数 */
+static int record_wake_function(struct wait_queue_entry *wq_entry, unsigned int mode)
+{
+	(void)mode;
+	wake_calls[(int)(long)wq_entry->private]++;
+	return 1;
+}
+
+/**
+ * test_wait_event_sleeps_until_woken - 条件が成立してwake_up()されるまで眠ることを確認
+ */
+static void test_wait_event_sleeps_until_woken(void)
+{
+	pid_t pid = kernel_thread(kthread_wait_event, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	/* スレッドは条件を満たさないので眠り，ランキューから外れる */
+	schedule();
+	KFS_ASSERT_EQ(0, wait_done);
+	KFS_ASSERT_EQ(TASK_UNINTERRUPTIBLE, p->__state);
+	KFS_ASSERT_EQ(0, p->se.on_rq);
+	KFS_ASSERT_TRUE(waitqueue_active(&test_wq));
+
+	/* 条件を満たさずに起こされても眠り直す */
+	wake_up(&test_wq);
+	KFS_ASSERT_EQ(TASK_RUNNING, p->__state);
+	schedule();
+	KFS_ASSERT_EQ(0, wait_done);
+	KFS_ASSERT_EQ(0, p->se.on_rq);
+
+	wait_cond = 1;
+	wake_up(&test_wq);
+	KFS_ASSERT_EQ(1, p->se.on_rq);
+	schedule();
+	KFS_ASSERT_EQ(1, wait_done);
+	KFS_ASSERT_EQ(0, waitqueue_active(&test_wq));
+	KFS_ASSERT_TRUE(current == &init_task);
+
+	printk("wait_event sleeps until woken test passed\n");
+}
+
+/**
+ * test_wait_event_condition_already_true - 条件が成立していれば眠らないことを確認
+ */
+static void test_wait_event_condition_already_true(void)
+{
+	wait_cond = 1;
+	KFS_ASSERT_TRUE(kernel_thread(kthread_wait_event, NULL) > 0);
+
+	schedule();
+	KFS_ASSERT_EQ(1, wait_done);
+	KFS_ASSERT_EQ(0, waitqueue_active(&test_wq));
+
+	printk("wait_event condition already true test passed\n");
+}
+
+/**
+ * test_wake_up_interruptible_skips_uninterruptible - TASK_UNINTERRUPTIBLEの待ち手はwake_up_interruptible()で起きないことを確認
+ */
+static void test_wake_up_interruptible_skips_uninterruptible(void)
+{
+	pid_t pid = kernel_thread(kthread_wait_event, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	schedule();
+	wait_cond = 1;
+	wake_up_interruptible(&test_wq);
+	KFS_ASSERT_EQ(TASK_UNINTERRUPTIBLE, p->__state);
+	KFS_ASSERT_EQ(0, p->se.on_rq);
+
+	wake_up(&test_wq);
+	schedule();
+	KFS_ASSERT_EQ(1, wait_done);
+
+	printk("wake_up_interruptible skips uninterruptible test passed\n");
+}
+
+/**
+ * test_wait_event_interruptible_signal - シグナルが保留されるとwait_event_interruptible()が中断されることを確認
+ */
+static void test_wait_event_interruptible_signal(void)
+{
+	pid_t pid = kernel_thread(kthread_wait_event_interruptible, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	schedule();
+	KFS_ASSERT_EQ(TASK_INTERRUPTIBLE, p->__state);
+
+	/* 眠っているスレッドにシグナルを送ると起こされる */
+	KFS_ASSERT_EQ(0, send_sig(SIGUSR1, p));
+	KFS_ASSERT_EQ(TASK_RUNNING, p->__state);
+	schedule();
+	KFS_ASSERT_EQ(1, wait_done);
+	KFS_ASSERT_EQ(-ERESTARTSYS, wait_ret);
+	KFS_ASSERT_EQ(0, waitqueue_active(&test_wq));
+
+	/* シグナルはスレッドにだけ保留され，送った側には届かない */
+	KFS_ASSERT_EQ(0, signal_pending());
+
+	printk("wait_event_interruptible signal test passed\n");
+}
+
+/**
+ * test_wake_up_exclusive - 排他的な待ち手はwake_up()で1つだけ起こされることを確認
+ */
+static void test_wake_up_exclusive(void)
+{
+	struct wait_queue_entry entries[3];
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		init_waitqueue_entry(&entries[i], NULL);
+		entries[i].private = (void *)(long)i;
+		entries[i].func = record_wake_function;
+	}
+	add_wait_queue_exclusive(&test_wq, &entries[0]);
+	add_wait_queue_exclusive(&test_wq, &entries[1]);
+	add_wait_queue(&test_wq, &entries[2]);
+
+	/* 排他的でない待ち手はすべて，排他的な待ち手は先頭の1つだけ */
+	wake_up(&test_wq);
+	KFS_ASSERT_EQ(1, wake_calls[0]);
+	KFS_ASSERT_EQ(0, wake_calls[1]);
+	KFS_ASSERT_EQ(1, wake_calls[2]);
+
+	wake_up_all(&test_wq);
+	KFS_ASSERT_EQ(2, wake_calls[0]);
+	KFS_ASSERT_EQ(1, wake_calls[1]);
+	KFS_ASSERT_EQ(2, wake_calls[2]);
+
+	for (i = 0; i < 3; i++)
+	{
+		remove_wait_queue(&test_wq, &entries[i]);
+	}
+	KFS_ASSERT_EQ(0, waitqueue_active(&test_wq));
+
+	printk("wake_up exclusive test passed\n");
+}
+
+/**
+ * test_wake_up_process_running_task - 実行可能なタスクを起こしても何も変わらないことを確認
+ */
+static void test_wake_up_process_running_task(void)
+{
+	pid_t pid = kernel_thread(kthread_wait_event, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	KFS_ASSERT_EQ(0, wake_up_process(p));
+	KFS_ASSERT_EQ(TASK_RUNNING, p->__state);
+	KFS_ASSERT_EQ(1, p->se.on_rq);
+
+	/* 後始末: スレッドを眠らせてから起こして終了させる */
+	schedule();
+	wait_cond = 1;
+	KFS_ASSERT_EQ(1, wake_up_process(p));
+	schedule();
+	KFS_ASSERT_EQ(1, wait_done);
+
+	printk("wake_up_process running task test passed\n");
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_wait_event_sleeps_until_woken, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_wait_event_condition_already_true, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_wake_up_interruptible_skips_uninterruptible, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_wait_event_interruptible_signal, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_wake_up_exclusive, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_wake_up_process_running_task, setup_test, teardown_test),
+};
+
+int register_unit_tests_wait(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,214 @@
+/*
+ * test_exit.c - タスクの終了と回収のテスト
+ *
+ * 以下をテスト:
+ * - do_exit(): init_taskの子はその場で回収され，PIDハッシュから消えてreaperに回る
+ * - do_wait(): 終了した子（EXIT_ZOMBIE）の終了コードを受け取って回収する，-ECHILD，WNOHANG，シグナルでの中断
+ * - 子の引き継ぎ: 親が終了すると子はinit_taskの子になる
+ * - reap_dead_tasks(): 溜まったタスクをまとめて解放し，fork/exitを繰り返してもtask_structとスタックを使い回す
+ */
+
+#include "../test_reset.h"
+#include "unit_test_framework.h"
+#include <kfs/errno.h>
+#include <kfs/pid.h>
+#include <kfs/sched.h>
+#include <kfs/semaphore.h>
+#include <kfs/signal.h>
+#include <kfs/slab.h>
+
+extern void fork_init(void);
+extern struct task_struct init_task;
+extern struct task_struct *find_task_by_pid(pid_t pid);
+
+static DEFINE_SEMAPHORE(test_sem, 0);
+
+/* スレッドの実行記録 */
+static pid_t child_pid;
+static struct task_struct *child_task;
+static int wait_status;
+static pid_t wait_ret;
+
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+
+	sema_init(&test_sem, 0);
+	child_pid = 0;
+	child_task = NULL;
+	wait_status = -1;
+	wait_ret = 0;
+}
+
+static void teardown_test(void)
+{
+	sched_init();
+}
+
+/* 終了コード42で終了するスレッド */
+static int kthread_exit_42(void *arg)
+{
+	(void)arg;
+	return 42;
+}
+
+/* セマフォを待ってから終了するスレッド */
+static int kthread_wait_sem(void *arg)
+{
+	(void)arg;
+	down(&test_sem);
+	return 0;
+}
+
+/* 子を作り，その終了を待って回収するスレッド */
+static int kthread_wait_child(void *arg)
+{
+	(void)arg;
+	child_pid = kernel_thread(kthread_exit_42, NULL);
+	wait_ret = do_wait(child_pid, &wait_status, 0);
+	return 0;
+}
+
+/* 眠ったままの子を作り，その終了を待つスレッド（シグナルで中断される） */
+static int kthread_wait_sleeping_child(void *arg)
+{
+	(void)arg;
+	child_pid = kernel_thread(kthread_wait_sem, NULL);
+	child_task = find_task_by_pid(child_pid);
+	wait_ret = do_wait(-1, NULL, 0);
+	return 0;
+}
+
+/*
+ * テスト: init_taskの子はwaitを待たずに回収される
+ * 検証: 終了するとEXIT_DEADでPIDハッシュから消え，reap_dead_tasks()で1つだけ解放されること
+ */
+KFS_TEST(test_exit_child_of_init_is_autoreaped)
+{
+	pid_t pid = kernel_thread(kthread_exit_42, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	KFS_ASSERT_TRUE(p != NULL);
+	KFS_ASSERT_EQ(2, atomic_read(&p->usage));
+
+	schedule();
+	KFS_ASSERT_EQ(TASK_DEAD, p->__state);
+	KFS_ASSERT_EQ(EXIT_DEAD, p->exit_state);
+	KFS_ASSERT_EQ(42, p->exit_code);
+	KFS_ASSERT_EQ(0, atomic_read(&p->usage));
+	KFS_ASSERT_TRUE(find_task_by_pid(pid) == NULL);
+	KFS_ASSERT_TRUE(list_empty(&init_task.children));
+
+	KFS_ASSERT_EQ(1, reap_dead_tasks());
+	KFS_ASSERT_EQ(0, reap_dead_tasks());
+}
+
+/*
+ * テスト: do_wait()は終了した子を回収する
+ * 検証: 子の終了コードとPIDを受け取り，子はPIDハッシュから消え，親子とも回収待ちになること
+ */
+KFS_TEST(test_do_wait_collects_zombie)
+{
+	kernel_thread(kthread_wait_child, NULL);
+
+	schedule();
+	KFS_ASSERT_TRUE(child_pid > 0);
+	KFS_ASSERT_EQ(child_pid, wait_ret);
+	KFS_ASSERT_EQ(42, wait_status);
+	KFS_ASSERT_TRUE(find_task_by_pid(child_pid) == NULL);
+	KFS_ASSERT_EQ(2, reap_dead_tasks());
+}
+
+/*
+ * テスト: 待つ子がいなければ-ECHILD，終了した子がいなければWNOHANGで0
+ * 検証: 子のいないinit_taskは-ECHILD，眠っている子だけならWNOHANGで0を返して回収しないこと
+ */
+KFS_TEST(test_do_wait_no_child_and_wnohang)
+{
+	pid_t pid;
+
+	KFS_ASSERT_EQ(-ECHILD, do_wait(-1, NULL, WNOHANG));
+	KFS_ASSERT_EQ(-ECHILD, do_wait(1234, NULL, 0));
+
+	pid = kernel_thread(kthread_wait_sem, NULL);
+	schedule();
+	KFS_ASSERT_EQ(0, do_wait(pid, NULL, WNOHANG));
+	KFS_ASSERT_TRUE(find_task_by_pid(pid) != NULL);
+
+	up(&test_sem);
+	schedule();
+	KFS_ASSERT_TRUE(find_task_by_pid(pid) == NULL);
+}
+
+/*
+ * テスト: 親が終了すると子はinit_taskに引き継がれる
+ * 検証: do_wait()はシグナルで-ERESTARTSYSを返し，親の終了後に子の親がinit_taskになり，子の終了でその場で回収されること
+ */
+KFS_TEST(test_exit_reparents_children_to_init)
+{
+	pid_t pid = kernel_thread(kthread_wait_sleeping_child, NULL);
+	struct task_struct *parent = find_task_by_pid(pid);
+
+	schedule();
+	KFS_ASSERT_EQ(TASK_INTERRUPTIBLE, parent->__state);
+	KFS_ASSERT_TRUE(child_task->parent == parent);
+
+	send_sig(SIGUSR1, parent);
+	schedule();
+	KFS_ASSERT_EQ(-ERESTARTSYS, wait_ret);
+	KFS_ASSERT_TRUE(find_task_by_pid(pid) == NULL);
+	KFS_ASSERT_TRUE(child_task->parent == &init_task);
+	KFS_ASSERT_TRUE(list_entry(init_task.children.next, struct task_struct, sibling) == child_task);
+
+	up(&test_sem);
+	schedule();
+	KFS_ASSERT_TRUE(find_task_by_pid(child_pid) == NULL);
+	KFS_ASSERT_TRUE(list_empty(&init_task.children));
+	KFS_ASSERT_EQ(2, reap_dead_tasks());
+}
+
+/*
+ * テスト: fork/exitを繰り返してもメモリは増えない
+ * 検証: 毎回1つずつ回収され，2回目以降のタスクは同じtask_structとカーネルスタックを使い回すこと
+ */
+KFS_TEST(test_fork_exit_churn_reuses_task_and_stack)
+{
+	struct task_struct *first = NULL;
+	void *first_stack = NULL;
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		pid_t pid = kernel_thread(kthread_exit_42, NULL);
+		struct task_struct *p = find_task_by_pid(pid);
+
+		if (first == NULL)
+		{
+			first = p;
+			first_stack = p->stack;
+		}
+		KFS_ASSERT_TRUE(p == first);
+		KFS_ASSERT_TRUE(p->stack == first_stack);
+
+		schedule();
+		KFS_ASSERT_EQ(1, reap_dead_tasks());
+	}
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_exit_child_of_init_is_autoreaped, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_do_wait_collects_zombie, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_do_wait_no_child_and_wnohang, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_exit_reparents_children_to_init, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fork_exit_churn_reuses_task_and_stack, setup_test, teardown_test),
+};
+
+int register_unit_tests_exit(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -1,8 +1,11 @@
 #include "../test_reset.h"
 #include "unit_test_framework.h"
+#include <asm-i386/page.h>
+#include <asm-i386/pgtable.h>
 #include <kfs/pid.h>
 #include <kfs/sched.h>
 #include <kfs/slab.h>
+#include <kfs/string.h>
 
 /* テスト対象関数（kernel/fork.c） */
 extern struct task_struct *copy_process(struct task_struct *orig);
@@ -11,7 +14,6 @@ extern void fork_init(void);
 
 /* テスト用ヘルパー（kernel/sched/core.c） */
 extern struct task_struct *find_task_by_pid(pid_t pid);
-extern struct task_struct *current;
 extern struct task_struct init_task;
 
 /* 初期化関数（PIDとスラブアロケータ） */
@@ -29,8 +31,9 @@ static void setup_test(void)
 	/* PID管理初期化 */
 	pid_init();
 
-	/* init_task初期化 */
+	/* init_task初期化とランキューのリセット */
 	init_idle_task();
+	sched_init();
 
 	/* fork初期化 */
 	fork_init();
@@ -153,7 +156,7 @@ KFS_TEST(test_do_fork_basic)
 	struct task_struct *child;
 
 	/* currentをinit_taskに設定 */
-	current = &init_task;
+	write_pda(pcurrent, &init_task);
 
 	/* do_fork()を実行 */
 	child_pid = do_fork();
@@ -171,6 +174,165 @@ KFS_TEST(test_do_fork_basic)
 	printk("do_fork basic test passed\n");
 }
 
+/* kernel_threadテスト用の状態 */
+static int kthread_value;
+static char kthread_log[8];
+static int kthread_log_len;
+
+/* 引数の値を記録して終了コード7で終わるスレッド */
+static int kthread_store_arg(void *arg)
+{
+	kthread_value = *(int *)arg;
+	return 7;
+}
+
+/* 引数の文字を記録してから自発的にCPUを譲るのを2回繰り返すスレッド */
+static int kthread_yield_twice(void *arg)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		kthread_log[kthread_log_len++] = *(char *)arg;
+		schedule();
+	}
+	return 0;
+}
+
+/** kernel_thread()で作ったスレッドがschedule()で実行されることを確認 */
+KFS_TEST(test_kernel_thread_runs)
+{
+	int value = 42;
+	pid_t pid;
+	struct task_struct *p;
+
+	kthread_value = 0;
+	pid = kernel_thread(kthread_store_arg, &value);
+	KFS_ASSERT_TRUE(pid > 0);
+
+	p = find_task_by_pid(pid);
+	KFS_ASSERT_TRUE(p != NULL);
+	KFS_ASSERT_TRUE(p->flags & PF_KTHREAD);
+	KFS_ASSERT_EQ(1, p->se.on_rq);
+
+	/* まだ実行されていない */
+	KFS_ASSERT_EQ(0, kthread_value);
+
+	/* アイドルタスク（init_task）からスレッドに切り替わり，終了すると戻ってくる */
+	schedule();
+
+	KFS_ASSERT_EQ(42, kthread_value);
+	KFS_ASSERT_TRUE(current == &init_task);
+	KFS_ASSERT_EQ(TASK_DEAD, p->__state);
+	KFS_ASSERT_EQ(7, p->exit_code);
+	KFS_ASSERT_EQ(0, p->se.on_rq);
+
+	printk("kernel_thread runs test passed\n");
+}
+
+/** 2つのスレッドがschedule()で交互に実行されることを確認
+ * @details レジスタとスタックが正しく保存・復元されていれば，
+ *          各スレッドはループの途中から再開され"ABAB"の順に記録される
+ */
+KFS_TEST(test_kernel_thread_switch_between_threads)
+{
+	char a = 'A';
+	char b = 'B';
+
+	kthread_log_len = 0;
+	KFS_ASSERT_TRUE(kernel_thread(kthread_yield_twice, &a) > 0);
+	KFS_ASSERT_TRUE(kernel_thread(kthread_yield_twice, &b) > 0);
+
+	schedule();
+
+	KFS_ASSERT_EQ(4, kthread_log_len);
+	KFS_ASSERT_EQ('A', kthread_log[0]);
+	KFS_ASSERT_EQ('B', kthread_log[1]);
+	KFS_ASSERT_EQ('A', kthread_log[2]);
+	KFS_ASSERT_EQ('B', kthread_log[3]);
+	KFS_ASSERT_TRUE(current == &init_task);
+
+	printk("kernel_thread switch between threads test passed\n");
+}
+
+/** カーネルスタックがページ境界に置かれ，直下にガードページがあることを確認 */
+KFS_TEST(test_copy_process_stack_guard_page)
+{
+	struct task_struct *child;
+	unsigned long stack;
+	pte_t *pte;
+
+	child = copy_process(&init_task);
+	KFS_ASSERT_TRUE(child != NULL);
+	stack = (unsigned long)child->stack;
+
+	/* vmalloc領域のページ境界 */
+	KFS_ASSERT_EQ(0, stack & (PAGE_SIZE - 1));
+	KFS_ASSERT_TRUE(stack >= 0xD0000000);
+
+	/* スタック全体がマップされている */
+	pte = get_pte(stack);
+	KFS_ASSERT_TRUE(pte != NULL && pte_present(*pte));
+	pte = get_pte(stack + THREAD_SIZE - PAGE_SIZE);
+	KFS_ASSERT_TRUE(pte != NULL && pte_present(*pte));
+
+	/* 直下のページはマップされていない */
+	pte = get_pte(stack - PAGE_SIZE);
+	KFS_ASSERT_TRUE(pte == NULL || !pte_present(*pte));
+
+	printk("copy_process stack guard page test passed\n");
+}
+
+/** 解放したタスクのスタックが次のforkで再利用されることを確認 */
+KFS_TEST(test_free_task_reuses_cached_stack)
+{
+	struct task_struct *child;
+	void *stack;
+
+	child = copy_process(&init_task);
+	KFS_ASSERT_TRUE(child != NULL);
+	stack = child->stack;
+
+	/* タスクリストとPIDハッシュから外してから解放する */
+	list_del(&child->tasks);
+	list_del(&child->sibling);
+	detach_pid(child, PIDTYPE_PID);
+	free_task(child);
+
+	child = copy_process(&init_task);
+	KFS_ASSERT_TRUE(child != NULL);
+	KFS_ASSERT_TRUE(child->stack == stack);
+
+	printk("free_task reuses cached stack test passed\n");
+}
+
+/** fork_idle()はPID 0のタスクを作り，タスクリストには載せない */
+KFS_TEST(test_fork_idle_creates_unlisted_idle_task)
+{
+	struct task_struct *idle;
+	int nr_tasks = 0;
+	struct task_struct *t;
+
+	list_for_each_entry(t, &task_list, tasks)
+	{
+		nr_tasks++;
+	}
+
+	idle = fork_idle(1);
+	KFS_ASSERT_TRUE(idle != NULL);
+	KFS_ASSERT_EQ(0, idle->pid);
+	KFS_ASSERT_TRUE(idle->mm == NULL);
+	KFS_ASSERT_TRUE(idle->stack != NULL && idle->stack != init_task.stack);
+	KFS_ASSERT_TRUE(strcmp(idle->comm, "swapper/1") == 0);
+	KFS_ASSERT_TRUE(find_task_by_pid(0) == &init_task);
+
+	list_for_each_entry(t, &task_list, tasks)
+	{
+		nr_tasks--;
+	}
+	KFS_ASSERT_EQ(0, nr_tasks);
+
+	free_task(idle);
+}
+
 static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_copy_process_basic, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_copy_process_mm, setup_test, teardown_test),
@@ -178,6 +340,11 @@ static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_find_task_by_pid_basic, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_find_task_by_pid_not_found, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_do_fork_basic, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_kernel_thread_runs, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_kernel_thread_switch_between_threads, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_copy_process_stack_guard_page, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_free_task_reuses_cached_stack, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_fork_idle_creates_unlisted_idle_task, setup_test, teardown_test),
 };
 
 int register_unit_tests_fork(struct kfs_test_case **out)
@@ -0,0 +1,256 @@
+/*
+ * test_mutex.c - ミューテックスと計数セマフォのテスト
+ *
+ * 以下をテスト:
+ * - mutex_lock/unlock(): 空いていればcmpxchgだけで取得・解放し，ownerに現在のタスクを記録する
+ * - 競合: 待ち手はMUTEX_FLAG_WAITERSを立てて眠り，解放で起こされて取得する
+ * - mutex_lock_interruptible(): シグナルで中断される
+ * - on_cpu: 楽観的スピンが参照する実行中フラグをコンテキストスイッチで付け替える
+ * - down/up(): countの増減，down_trylock()の戻り値，資源待ちで眠るタスクの起床
+ */
+
+#include "../test_reset.h"
+#include "unit_test_framework.h"
+#include <kfs/mutex.h>
+#include <kfs/pid.h>
+#include <kfs/sched.h>
+#include <kfs/semaphore.h>
+#include <kfs/signal.h>
+#include <kfs/slab.h>
+
+extern void fork_init(void);
+extern struct task_struct init_task;
+extern struct task_struct *find_task_by_pid(pid_t pid);
+
+static DEFINE_MUTEX(test_mutex);
+static DEFINE_SEMAPHORE(test_sem, 0);
+
+/* スレッドの実行記録 */
+static int thread_done;
+static int thread_ret;
+static struct task_struct *thread_owner; /* スレッドが取得した直後のmutex_owner() */
+static int thread_on_cpu;				 /* スレッド実行中の自分のon_cpu */
+static int init_on_cpu;					 /* スレッド実行中のinit_taskのon_cpu */
+
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+
+	mutex_init(&test_mutex);
+	sema_init(&test_sem, 0);
+	thread_done = 0;
+	thread_ret = 0;
+	thread_owner = NULL;
+	thread_on_cpu = -1;
+	init_on_cpu = -1;
+}
+
+static void teardown_test(void)
+{
+	sched_init();
+}
+
+/* ミューテックスを取得して記録し，解放するスレッド */
+static int kthread_mutex_lock(void *arg)
+{
+	(void)arg;
+	mutex_lock(&test_mutex);
+	thread_owner = mutex_owner(&test_mutex);
+	mutex_unlock(&test_mutex);
+	thread_done++;
+	return 0;
+}
+
+/* シグナルで中断できる取得を試みるスレッド */
+static int kthread_mutex_lock_interruptible(void *arg)
+{
+	(void)arg;
+	thread_ret = mutex_lock_interruptible(&test_mutex);
+	if (thread_ret == 0)
+	{
+		mutex_unlock(&test_mutex);
+	}
+	thread_done++;
+	return 0;
+}
+
+/* 実行中フラグを記録するスレッド */
+static int kthread_record_on_cpu(void *arg)
+{
+	(void)arg;
+	thread_on_cpu = current->on_cpu;
+	init_on_cpu = init_task.on_cpu;
+	thread_done++;
+	return 0;
+}
+
+/* セマフォの資源を1つ取得するスレッド */
+static int kthread_down(void *arg)
+{
+	(void)arg;
+	down(&test_sem);
+	thread_done++;
+	return 0;
+}
+
+/*
+ * テスト: 競合のない取得と解放
+ * 検証: ownerが現在のタスクそのもの（フラグなし）になり，保持中のtrylockは失敗し，解放で0に戻ること
+ */
+KFS_TEST(test_mutex_fast_path)
+{
+	KFS_ASSERT_TRUE(!mutex_is_locked(&test_mutex));
+
+	mutex_lock(&test_mutex);
+	KFS_ASSERT_EQ((int)current, atomic_read(&test_mutex.owner));
+	KFS_ASSERT_TRUE(mutex_owner(&test_mutex) == current);
+	KFS_ASSERT_TRUE(!mutex_trylock(&test_mutex));
+	mutex_unlock(&test_mutex);
+
+	KFS_ASSERT_EQ(0, atomic_read(&test_mutex.owner));
+	KFS_ASSERT_TRUE(mutex_trylock(&test_mutex));
+	KFS_ASSERT_TRUE(mutex_is_locked(&test_mutex));
+	mutex_unlock(&test_mutex);
+	KFS_ASSERT_TRUE(!mutex_is_locked(&test_mutex));
+}
+
+/*
+ * テスト: 保持中のミューテックスを待つタスクは眠り，解放で起こされる
+ * 検証: 待ち手は印を立ててTASK_UNINTERRUPTIBLEで眠り，解放後に自分をownerとして取得すること
+ */
+KFS_TEST(test_mutex_contended_sleeps_until_unlock)
+{
+	pid_t pid;
+	struct task_struct *p;
+
+	mutex_lock(&test_mutex);
+	pid = kernel_thread(kthread_mutex_lock, NULL);
+	p = find_task_by_pid(pid);
+
+	/* 保持者（init_task）は実行中でないため，スレッドは回らずに眠る */
+	schedule();
+	KFS_ASSERT_EQ(0, thread_done);
+	KFS_ASSERT_EQ(TASK_UNINTERRUPTIBLE, p->__state);
+	KFS_ASSERT_EQ(0, p->se.on_rq);
+	KFS_ASSERT_TRUE(atomic_read(&test_mutex.owner) & MUTEX_FLAG_WAITERS);
+	KFS_ASSERT_TRUE(mutex_owner(&test_mutex) == current);
+
+	mutex_unlock(&test_mutex);
+	KFS_ASSERT_EQ(0, atomic_read(&test_mutex.owner));
+	KFS_ASSERT_EQ(TASK_RUNNING, p->__state);
+
+	schedule();
+	KFS_ASSERT_EQ(1, thread_done);
+	KFS_ASSERT_TRUE(thread_owner == p);
+	KFS_ASSERT_TRUE(!mutex_is_locked(&test_mutex));
+	KFS_ASSERT_TRUE(!waitqueue_active(&test_mutex.wait));
+}
+
+/*
+ * テスト: mutex_lock_interruptible()はシグナルで中断される
+ * 検証: -EINTRを返して取得せず，待ちキューからも外れること
+ */
+KFS_TEST(test_mutex_lock_interruptible_signal)
+{
+	pid_t pid;
+	struct task_struct *p;
+
+	mutex_lock(&test_mutex);
+	pid = kernel_thread(kthread_mutex_lock_interruptible, NULL);
+	p = find_task_by_pid(pid);
+
+	schedule();
+	KFS_ASSERT_EQ(TASK_INTERRUPTIBLE, p->__state);
+
+	send_sig(SIGUSR1, p);
+	schedule();
+	KFS_ASSERT_EQ(1, thread_done);
+	KFS_ASSERT_EQ(-EINTR, thread_ret);
+	KFS_ASSERT_TRUE(mutex_owner(&test_mutex) == current);
+	KFS_ASSERT_TRUE(!waitqueue_active(&test_mutex.wait));
+
+	mutex_unlock(&test_mutex);
+	KFS_ASSERT_TRUE(!mutex_is_locked(&test_mutex));
+}
+
+/*
+ * テスト: on_cpuはCPU上で実行中のタスクだけが1になる
+ * 検証: 作られたばかりのタスクは0，切り替え後は切り替え先だけが1で，戻ると元に戻ること
+ */
+KFS_TEST(test_on_cpu_follows_context_switch)
+{
+	pid_t pid = kernel_thread(kthread_record_on_cpu, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	KFS_ASSERT_EQ(1, current->on_cpu);
+	KFS_ASSERT_EQ(0, p->on_cpu);
+
+	schedule();
+	KFS_ASSERT_EQ(1, thread_done);
+	KFS_ASSERT_EQ(1, thread_on_cpu);
+	KFS_ASSERT_EQ(0, init_on_cpu);
+	KFS_ASSERT_EQ(1, current->on_cpu);
+}
+
+/*
+ * テスト: down/upとdown_trylock
+ * 検証: countの分だけ取得でき，尽きたらdown_trylock()が1を返し，up()で再び取得できること
+ */
+KFS_TEST(test_semaphore_counts)
+{
+	sema_init(&test_sem, 2);
+
+	down(&test_sem);
+	KFS_ASSERT_EQ(1, atomic_read(&test_sem.count));
+	KFS_ASSERT_EQ(0, down_trylock(&test_sem));
+	KFS_ASSERT_EQ(0, atomic_read(&test_sem.count));
+	KFS_ASSERT_EQ(1, down_trylock(&test_sem));
+	KFS_ASSERT_EQ(0, atomic_read(&test_sem.count));
+
+	up(&test_sem);
+	KFS_ASSERT_EQ(0, down_interruptible(&test_sem));
+	up(&test_sem);
+	up(&test_sem);
+	KFS_ASSERT_EQ(2, atomic_read(&test_sem.count));
+}
+
+/*
+ * テスト: 資源が尽きたセマフォを待つタスクはup()で起こされる
+ * 検証: down()したスレッドは眠り，up()で起きて資源を1つ取得すること
+ */
+KFS_TEST(test_semaphore_down_sleeps_until_up)
+{
+	pid_t pid = kernel_thread(kthread_down, NULL);
+	struct task_struct *p = find_task_by_pid(pid);
+
+	schedule();
+	KFS_ASSERT_EQ(0, thread_done);
+	KFS_ASSERT_EQ(TASK_UNINTERRUPTIBLE, p->__state);
+	KFS_ASSERT_TRUE(waitqueue_active(&test_sem.wait));
+
+	up(&test_sem);
+	KFS_ASSERT_EQ(TASK_RUNNING, p->__state);
+	schedule();
+	KFS_ASSERT_EQ(1, thread_done);
+	KFS_ASSERT_EQ(0, atomic_read(&test_sem.count));
+	KFS_ASSERT_TRUE(!waitqueue_active(&test_sem.wait));
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_mutex_fast_path, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_mutex_contended_sleeps_until_unlock, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_mutex_lock_interruptible_signal, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_on_cpu_follows_context_switch, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_semaphore_counts, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_semaphore_down_sleeps_until_up, setup_test, teardown_test),
+};
+
+int register_unit_tests_mutex(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
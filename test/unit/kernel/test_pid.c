@@ -3,6 +3,11 @@
 #include <kfs/pid.h>
 #include <kfs/sched.h>
 
+extern struct task_struct init_task;
+
+/* attach_pid()用のテストタスク（スラブを使わず静的に確保） */
+static struct task_struct test_task;
+
 /* 全テストで共通のセットアップ関数 */
 static void setup_test(void)
 {
@@ -170,12 +175,161 @@ static void test_pid_structure_initialization(void)
 	printk("PID structure initialization test passed\n");
 }
 
+/**
+ * test_find_pid - PID番号からPID構造体を引けることを確認
+ *
+ * 割り当て中のPIDはfind_pid()で見つかり，解放後は見つからない
+ */
+static void test_find_pid(void)
+{
+	struct pid *pid1, *pid2;
+	pid_t nr1;
+
+	pid1 = alloc_pid();
+	pid2 = alloc_pid();
+	KFS_ASSERT_TRUE(pid1 != NULL && pid2 != NULL);
+	nr1 = pid1->nr;
+
+	KFS_ASSERT_TRUE(find_pid(pid1->nr) == pid1);
+	KFS_ASSERT_TRUE(find_pid(pid2->nr) == pid2);
+
+	/* 参照が残っている間は見つかる */
+	get_pid(pid1);
+	put_pid(pid1);
+	KFS_ASSERT_TRUE(find_pid(nr1) == pid1);
+
+	/* 最後の参照を解放すると見つからない */
+	put_pid(pid1);
+	KFS_ASSERT_TRUE(find_pid(nr1) == NULL);
+	KFS_ASSERT_TRUE(find_pid(pid2->nr) == pid2);
+
+	put_pid(pid2);
+
+	printk("find_pid test passed\n");
+}
+
+/**
+ * test_find_pid_same_bucket - 同じバケットに入るPIDを区別できることを確認
+ *
+ * ハッシュの衝突があってもチェーンをたどって正しいPIDを返す
+ */
+static void test_find_pid_same_bucket(void)
+{
+	static struct pid *pids[4100]; /* スタックに置くには大きいため静的に確保 */
+	struct pid *first;
+	int i;
+
+	/* PIDは連番なので，4096個以上割り当てれば同じバケットに複数入る */
+	for (i = 0; i < 4100; i++)
+	{
+		pids[i] = alloc_pid();
+		KFS_ASSERT_TRUE(pids[i] != NULL);
+	}
+	first = pids[0];
+	KFS_ASSERT_TRUE(pids[4096]->nr == first->nr + 4096);
+	KFS_ASSERT_TRUE(find_pid(first->nr) == first);
+	KFS_ASSERT_TRUE(find_pid(first->nr + 4096) == pids[4096]);
+
+	/* 一方を解放してももう一方は残る */
+	put_pid(pids[4096]);
+	KFS_ASSERT_TRUE(find_pid(first->nr + 4096) == NULL);
+	KFS_ASSERT_TRUE(find_pid(first->nr) == first);
+
+	for (i = 0; i < 4100; i++)
+	{
+		if (i != 4096)
+		{
+			put_pid(pids[i]);
+		}
+	}
+
+	printk("find_pid same bucket test passed\n");
+}
+
+/**
+ * test_find_task_by_pid_idle - PID 0でidleタスクが見つかることを確認
+ */
+static void test_find_task_by_pid_idle(void)
+{
+	KFS_ASSERT_TRUE(find_task_by_pid(0) == &init_task);
+	KFS_ASSERT_TRUE(task_pid(&init_task) == &init_struct_pid);
+
+	/* 使われていない番号では見つからない */
+	KFS_ASSERT_TRUE(find_task_by_pid(12345) == NULL);
+
+	printk("find_task_by_pid idle test passed\n");
+}
+
+/**
+ * test_attach_detach_pid - タスクをPIDにつなぎ，外せることを確認
+ *
+ * つないだタスクはfind_task_by_pid()で見つかり，外すとPIDごと解放される
+ */
+static void test_attach_detach_pid(void)
+{
+	struct pid *pid;
+	pid_t nr;
+
+	pid = alloc_pid();
+	KFS_ASSERT_TRUE(pid != NULL);
+	nr = pid->nr;
+
+	attach_pid(&test_task, PIDTYPE_PID, pid);
+	KFS_ASSERT_TRUE(task_pid(&test_task) == pid);
+	KFS_ASSERT_TRUE(pid_task(pid, PIDTYPE_PID) == &test_task);
+	KFS_ASSERT_TRUE(find_task_by_pid(nr) == &test_task);
+	KFS_ASSERT_TRUE(pid_task(pid, PIDTYPE_TGID) == NULL);
+
+	/* 参照をタスクに引き渡しているため，外すとPIDも解放される */
+	detach_pid(&test_task, PIDTYPE_PID);
+	KFS_ASSERT_TRUE(task_pid(&test_task) == NULL);
+	KFS_ASSERT_TRUE(find_task_by_pid(nr) == NULL);
+	KFS_ASSERT_TRUE(find_pid(nr) == NULL);
+
+	/* 2回目は何もしない */
+	detach_pid(&test_task, PIDTYPE_PID);
+
+	printk("attach/detach pid test passed\n");
+}
+
+/**
+ * test_find_get_task_by_pid - 見つけたタスクの参照を得ることを確認
+ *
+ * 見つからなければ参照数は変わらない
+ */
+static void test_find_get_task_by_pid(void)
+{
+	struct pid *pid;
+	pid_t nr;
+
+	pid = alloc_pid();
+	KFS_ASSERT_TRUE(pid != NULL);
+	nr = pid->nr;
+	atomic_set(&test_task.usage, 1);
+	attach_pid(&test_task, PIDTYPE_PID, pid);
+
+	KFS_ASSERT_TRUE(find_get_task_by_pid(nr) == &test_task);
+	KFS_ASSERT_EQ(2, atomic_read(&test_task.usage));
+	atomic_dec(&test_task.usage);
+
+	detach_pid(&test_task, PIDTYPE_PID);
+	KFS_ASSERT_TRUE(find_get_task_by_pid(nr) == NULL);
+	KFS_ASSERT_EQ(1, atomic_read(&test_task.usage));
+
+	printk("find_get_task_by_pid test passed\n");
+}
+
 static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_alloc_pid_basic, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_put_pid, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_pid_exhaustion, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_pid_reference_counting, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_pid_structure_initialization, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_find_pid, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_find_pid_same_bucket, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_find_task_by_pid_idle, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_attach_detach_pid, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_find_get_task_by_pid, setup_test, teardown_test),
 };
 
 int register_unit_tests_pid(struct kfs_test_case **out)
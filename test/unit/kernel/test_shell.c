@@ -1,6 +1,7 @@
 #include "../test_reset.h"
 #include "unit_test_framework.h"
 #include <kfs/keyboard.h>
+#include <kfs/sched.h>
 #include <kfs/shell.h>
 #include <kfs/string.h>
 
@@ -102,6 +103,20 @@ KFS_TEST(test_shell_execute_meminfo_command)
 	KFS_ASSERT_TRUE(1);
 }
 
+KFS_TEST(test_shell_execute_top_command)
+{
+	shell_init();
+	sched_init();
+
+	/* topコマンドを実行 */
+	shell_keyboard_handler('t');
+	shell_keyboard_handler('o');
+	shell_keyboard_handler('p');
+	shell_keyboard_handler('\n');
+
+	KFS_ASSERT_TRUE(1);
+}
+
 KFS_TEST(test_shell_execute_unknown_command)
 {
 	shell_init();
@@ -398,6 +413,7 @@ static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_shell_keyboard_handler_backspace, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_shell_execute_help_command, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_shell_execute_meminfo_command, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_shell_execute_top_command, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_shell_execute_unknown_command, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_shell_keyboard_handler_arrow_keys, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_shell_keyboard_handler_ctrl_c, setup_test, teardown_test),
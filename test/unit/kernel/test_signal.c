@@ -5,18 +5,33 @@
 
 #include "../test_reset.h"
 #include "../unit_test_framework.h"
+#include <kfs/pid.h>
+#include <kfs/sched.h>
 #include <kfs/signal.h>
+#include <kfs/slab.h>
+
+extern void fork_init(void);
+extern struct task_struct *find_task_by_pid(pid_t pid);
 
 /* テスト用のハンドラ呼び出し記録 */
 static int handler_called;
 static int handler_received_sig;
 
+/* 受け取ったシグナル番号の記録（順序の確認用） */
+static int received[8];
+static int nr_received;
+
+/* スレッドから見た状態の記録 */
+static int thread_pending;
+static sighandler_t thread_handler;
+
 /* 全テストで共通のセットアップ関数 */
 static void setup_test(void)
 {
 	reset_all_state_for_test();
 	handler_called = 0;
 	handler_received_sig = 0;
+	nr_received = 0;
 }
 
 /* 全テストで共通のクリーンアップ関数 */
@@ -28,6 +43,25 @@ static void teardown_test(void)
 	signal(SIGUSR1, SIG_DFL);
 }
 
+/* タスクを作るテスト用のセットアップ関数 */
+static void setup_task_test(void)
+{
+	setup_test();
+	kmem_cache_init();
+	pid_init();
+	sched_init();
+	fork_init();
+	thread_pending = 0;
+	thread_handler = SIG_ERR;
+}
+
+/* タスクを作るテスト用のクリーンアップ関数 */
+static void teardown_task_test(void)
+{
+	teardown_test();
+	sched_init();
+}
+
 /* テスト用シグナルハンドラ */
 static void test_handler(int sig)
 {
@@ -43,6 +77,26 @@ static void counting_handler(int sig)
 	handler_count++;
 }
 
+/* 受け取った順にシグナル番号を記録するハンドラ */
+static void recording_handler(int sig)
+{
+	if (nr_received < (int)(sizeof(received) / sizeof(received[0])))
+	{
+		received[nr_received] = sig;
+	}
+	nr_received++;
+}
+
+/* 自分の保留状態と引き継いだハンドラを記録し，保留シグナルを処理するスレッド */
+static int kthread_record_signal(void *arg)
+{
+	(void)arg;
+	thread_pending = signal_pending();
+	thread_handler = current->signal->action[SIGUSR1].sa_handler;
+	do_signal();
+	return 0;
+}
+
 /* signal()で有効なシグナルにハンドラを登録できることをテスト */
 KFS_TEST(test_signal_register_handler)
 {
@@ -217,6 +271,88 @@ KFS_TEST(test_signal_pending_reports_correctly)
 	KFS_ASSERT_EQ(0, signal_pending());
 }
 
+/* do_signal()は番号の小さいシグナルから処理することをテスト */
+KFS_TEST(test_do_signal_lowest_first)
+{
+	signal(SIGINT, recording_handler);
+	signal(SIGUSR1, recording_handler);
+	signal(SIGTERM, recording_handler);
+
+	/* 送った順とは逆の番号順に処理される */
+	raise(SIGTERM);
+	raise(SIGUSR1);
+	raise(SIGINT);
+	do_signal();
+
+	KFS_ASSERT_EQ(3, nr_received);
+	KFS_ASSERT_EQ(SIGINT, received[0]);
+	KFS_ASSERT_EQ(SIGUSR1, received[1]);
+	KFS_ASSERT_EQ(SIGTERM, received[2]);
+}
+
+/* 標準シグナルはまとめられ，リアルタイムシグナルは送った回数だけ処理されることをテスト */
+KFS_TEST(test_rt_signals_are_queued)
+{
+	signal(SIGINT, recording_handler);
+	signal(SIGRTMIN, recording_handler);
+	signal(SIGRTMAX, recording_handler);
+
+	raise(SIGINT);
+	raise(SIGINT);
+	raise(SIGRTMAX);
+	raise(SIGRTMIN);
+	raise(SIGRTMIN);
+	KFS_ASSERT_EQ(1, (int)!list_empty(&current->pending.list));
+	do_signal();
+
+	KFS_ASSERT_EQ(4, nr_received);
+	KFS_ASSERT_EQ(SIGINT, received[0]);
+	KFS_ASSERT_EQ(SIGRTMIN, received[1]);
+	KFS_ASSERT_EQ(SIGRTMIN, received[2]);
+	KFS_ASSERT_EQ(SIGRTMAX, received[3]);
+	KFS_ASSERT_EQ(0, signal_pending());
+	KFS_ASSERT_EQ(1, (int)list_empty(&current->pending.list));
+
+	signal(SIGRTMIN, SIG_DFL);
+	signal(SIGRTMAX, SIG_DFL);
+}
+
+/* kill_proc()は存在しないPIDを拒否することをテスト */
+KFS_TEST(test_kill_proc_unknown_pid)
+{
+	KFS_ASSERT_EQ(-1, kill_proc(12345, SIGINT));
+	KFS_ASSERT_EQ(0, signal_pending());
+}
+
+/* kill_proc()は送り先のタスクにだけ保留し，子はハンドラを引き継いで保留は引き継がないことをテスト */
+KFS_TEST(test_kill_proc_delivers_to_task)
+{
+	pid_t pid;
+
+	signal(SIGUSR1, recording_handler);
+	raise(SIGUSR2);
+
+	pid = kernel_thread(kthread_record_signal, NULL);
+	KFS_ASSERT_TRUE(pid > 0);
+	KFS_ASSERT_EQ(0, (int)find_task_by_pid(pid)->pending.signal);
+
+	KFS_ASSERT_EQ(0, kill_proc(pid, SIGUSR1));
+	schedule();
+
+	/* スレッドは自分宛てのSIGUSR1だけを見て，引き継いだハンドラで処理する */
+	KFS_ASSERT_EQ(1, thread_pending);
+	KFS_ASSERT_EQ((long)recording_handler, (long)thread_handler);
+	KFS_ASSERT_EQ(1, nr_received);
+	KFS_ASSERT_EQ(SIGUSR1, received[0]);
+
+	/* 送った側には自分で発生させたSIGUSR2だけが残っている */
+	KFS_ASSERT_EQ(1, signal_pending());
+	KFS_ASSERT_TRUE(current->pending.signal == sigmask(SIGUSR2));
+	signal(SIGUSR2, SIG_IGN);
+	do_signal();
+	signal(SIGUSR2, SIG_DFL);
+}
+
 /* テスト登録 */
 static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_signal_register_handler, setup_test, teardown_test),
@@ -229,6 +365,10 @@ static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_do_signal_handles_sig_dfl, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_do_signal_multiple_signals, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_signal_pending_reports_correctly, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_do_signal_lowest_first, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rt_signals_are_queued, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_kill_proc_unknown_pid, setup_task_test, teardown_task_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_kill_proc_delivers_to_task, setup_task_test, teardown_task_test),
 };
 
 int register_unit_tests_signal(struct kfs_test_case **out)
@@ -0,0 +1,243 @@
+/*
+ * test_spinlock.c - アトミック操作とスピンロックのテスト
+ *
+ * 以下をテスト:
+ * - atomic_*(): lockプレフィックス付きの加減算，dec_and_test，add_return，cmpxchg
+ * - arch_spin_*(): チケットの受け渡し，trylock，競合の検出，番号札のラップアラウンド
+ * - spin_lock*(): プリエンプションと割り込みの禁止・復元
+ * - CONFIG_LOCK_STAT: 保持CPUと取得回数の記録（ユニットテストは統計つきでビルドする）
+ */
+
+#include "../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/atomic.h>
+#include <asm-i386/system.h>
+#include <kfs/preempt.h>
+#include <kfs/spinlock.h>
+
+static DEFINE_SPINLOCK(test_lock);
+
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+}
+
+static void teardown_test(void)
+{
+}
+
+/*
+ * テスト: atomic_add/sub/inc/dec
+ * 検証: 各操作の後の値が期待どおりであること
+ */
+KFS_TEST(test_atomic_add_sub_inc_dec)
+{
+	atomic_t v = ATOMIC_INIT(5);
+
+	atomic_add(3, &v);
+	KFS_ASSERT_EQ(8, atomic_read(&v));
+	atomic_sub(2, &v);
+	KFS_ASSERT_EQ(6, atomic_read(&v));
+	atomic_inc(&v);
+	KFS_ASSERT_EQ(7, atomic_read(&v));
+	atomic_dec(&v);
+	KFS_ASSERT_EQ(6, atomic_read(&v));
+	atomic_set(&v, -1);
+	KFS_ASSERT_EQ(-1, atomic_read(&v));
+}
+
+/*
+ * テスト: atomic_dec_and_test/atomic_sub_and_test
+ * 検証: 0になった操作だけが真を返すこと
+ */
+KFS_TEST(test_atomic_dec_and_test)
+{
+	atomic_t v = ATOMIC_INIT(2);
+
+	KFS_ASSERT_TRUE(!atomic_dec_and_test(&v));
+	KFS_ASSERT_TRUE(atomic_dec_and_test(&v));
+	KFS_ASSERT_EQ(0, atomic_read(&v));
+
+	atomic_set(&v, 5);
+	KFS_ASSERT_TRUE(!atomic_sub_and_test(3, &v));
+	KFS_ASSERT_TRUE(atomic_sub_and_test(2, &v));
+}
+
+/*
+ * テスト: atomic_add_return/atomic_cmpxchg
+ * 検証: add_returnは加えた後の値を返し，cmpxchgは期待値と一致したときだけ置き換えること
+ */
+KFS_TEST(test_atomic_add_return_and_cmpxchg)
+{
+	atomic_t v = ATOMIC_INIT(1);
+
+	KFS_ASSERT_EQ(5, atomic_add_return(4, &v));
+	KFS_ASSERT_EQ(4, atomic_dec_return(&v));
+	KFS_ASSERT_EQ(5, atomic_inc_return(&v));
+
+	/* 期待値が違えば置き換えず，現在の値を返す */
+	KFS_ASSERT_EQ(5, atomic_cmpxchg(&v, 3, 9));
+	KFS_ASSERT_EQ(5, atomic_read(&v));
+
+	KFS_ASSERT_EQ(5, atomic_cmpxchg(&v, 5, 9));
+	KFS_ASSERT_EQ(9, atomic_read(&v));
+}
+
+/*
+ * テスト: チケットロックの取得と解放
+ * 検証: 取得でnextが，解放でownerが進み，保持中のtrylockは失敗して状態を変えないこと
+ */
+KFS_TEST(test_ticket_lock_hands_out_tickets)
+{
+	arch_spinlock_t lock = __ARCH_SPIN_LOCK_UNLOCKED;
+	uint32_t held;
+
+	KFS_ASSERT_TRUE(!arch_spin_is_locked(&lock));
+
+	arch_spin_lock(&lock);
+	KFS_ASSERT_EQ(0, lock.tickets.owner);
+	KFS_ASSERT_EQ(1, lock.tickets.next);
+	KFS_ASSERT_TRUE(arch_spin_is_locked(&lock));
+
+	held = lock.slock;
+	KFS_ASSERT_TRUE(!arch_spin_trylock(&lock));
+	KFS_ASSERT_EQ(held, lock.slock);
+
+	arch_spin_unlock(&lock);
+	KFS_ASSERT_EQ(1, lock.tickets.owner);
+	KFS_ASSERT_TRUE(!arch_spin_is_locked(&lock));
+
+	KFS_ASSERT_TRUE(arch_spin_trylock(&lock));
+	KFS_ASSERT_EQ(2, lock.tickets.next);
+	arch_spin_unlock(&lock);
+}
+
+/*
+ * テスト: 待ち手の検出と番号札のラップアラウンド
+ * 検証: 番号札を受け取った待ち手がいればcontendedになり，0xFFFFの次の番号札でも取得・解放できること
+ */
+KFS_TEST(test_ticket_lock_contention_and_wrap)
+{
+	arch_spinlock_t lock = __ARCH_SPIN_LOCK_UNLOCKED;
+
+	arch_spin_lock(&lock);
+	KFS_ASSERT_TRUE(!arch_spin_is_contended(&lock));
+
+	/* 他のCPUが番号札を受け取って待っている状態を作る */
+	lock.tickets.next++;
+	KFS_ASSERT_TRUE(arch_spin_is_contended(&lock));
+	lock.tickets.next--;
+	arch_spin_unlock(&lock);
+
+	lock.tickets.owner = 0xFFFF;
+	lock.tickets.next = 0xFFFF;
+	arch_spin_lock(&lock);
+	KFS_ASSERT_EQ(0, lock.tickets.next);
+	KFS_ASSERT_TRUE(arch_spin_is_locked(&lock));
+	arch_spin_unlock(&lock);
+	KFS_ASSERT_EQ(0, lock.tickets.owner);
+	KFS_ASSERT_TRUE(!arch_spin_is_locked(&lock));
+}
+
+/*
+ * テスト: spin_lockはプリエンプションを禁止する
+ * 検証: 保持中はpreempt_countが1増え，解放で元に戻ること．trylockの失敗では増えないこと
+ */
+KFS_TEST(test_spin_lock_disables_preemption)
+{
+	int count = preempt_count();
+
+	spin_lock(&test_lock);
+	KFS_ASSERT_EQ(count + 1, preempt_count());
+	KFS_ASSERT_TRUE(spin_is_locked(&test_lock));
+	KFS_ASSERT_TRUE(!spin_trylock(&test_lock));
+	KFS_ASSERT_EQ(count + 1, preempt_count());
+	spin_unlock(&test_lock);
+
+	KFS_ASSERT_EQ(count, preempt_count());
+	KFS_ASSERT_TRUE(!spin_is_locked(&test_lock));
+}
+
+/*
+ * テスト: spin_lock_irqsaveは割り込みを禁止し，解放で元のIFに戻す
+ * 検証: 割り込み許可・禁止のどちらの状態から取っても，解放後に元の状態に戻ること
+ */
+KFS_TEST(test_spin_lock_irqsave_restores_flags)
+{
+	unsigned long saved = local_save_flags();
+	unsigned long flags;
+
+	local_irq_enable();
+	spin_lock_irqsave(&test_lock, flags);
+	KFS_ASSERT_TRUE(irqs_disabled());
+	spin_unlock_irqrestore(&test_lock, flags);
+	KFS_ASSERT_TRUE(!irqs_disabled());
+
+	local_irq_disable();
+	spin_lock_irqsave(&test_lock, flags);
+	KFS_ASSERT_TRUE(irqs_disabled());
+	spin_unlock_irqrestore(&test_lock, flags);
+	KFS_ASSERT_TRUE(irqs_disabled());
+
+	local_irq_restore(saved);
+}
+
+/*
+ * テスト: ロック統計は保持CPUと取得回数を記録する
+ * 検証: 保持中はowner_cpuが自CPU，解放で-1に戻り，失敗したtrylockは取得回数に数えないこと
+ */
+KFS_TEST(test_lock_stat_records_owner)
+{
+	unsigned long acquired = test_lock.nr_acquired;
+	unsigned long contended = test_lock.nr_contended;
+
+	KFS_ASSERT_EQ(-1, test_lock.owner_cpu);
+
+	spin_lock(&test_lock);
+	KFS_ASSERT_EQ(0, test_lock.owner_cpu);
+	KFS_ASSERT_TRUE(test_lock.owner_ip != NULL);
+	KFS_ASSERT_TRUE(!spin_trylock(&test_lock));
+	spin_unlock(&test_lock);
+
+	KFS_ASSERT_EQ(-1, test_lock.owner_cpu);
+	KFS_ASSERT_EQ(acquired + 1, test_lock.nr_acquired);
+	KFS_ASSERT_EQ(contended, test_lock.nr_contended);
+	KFS_ASSERT_TRUE(!list_empty(&test_lock.stat_list));
+}
+
+/*
+ * テスト: spin_lock_initは無名の空きロックにする
+ * 検証: 統計の一覧には載らず，取得・解放できること
+ */
+KFS_TEST(test_spin_lock_init_anonymous)
+{
+	spinlock_t lock;
+
+	spin_lock_init(&lock);
+	KFS_ASSERT_TRUE(lock.name == NULL);
+	KFS_ASSERT_EQ(-1, lock.owner_cpu);
+	KFS_ASSERT_TRUE(!spin_is_locked(&lock));
+
+	spin_lock(&lock);
+	KFS_ASSERT_TRUE(spin_is_locked(&lock));
+	spin_unlock(&lock);
+	KFS_ASSERT_TRUE(list_empty(&lock.stat_list));
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_atomic_add_sub_inc_dec, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_atomic_dec_and_test, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_atomic_add_return_and_cmpxchg, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ticket_lock_hands_out_tickets, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ticket_lock_contention_and_wrap, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_spin_lock_disables_preemption, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_spin_lock_irqsave_restores_flags, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_lock_stat_records_owner, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_spin_lock_init_anonymous, setup_test, teardown_test),
+};
+
+int register_unit_tests_spinlock(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
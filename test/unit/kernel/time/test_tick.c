@@ -0,0 +1,289 @@
+#include "../../../../kernel/sched/sched.h"
+#include "../../../../kernel/time/tick-sched.h"
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <kfs/clockchips.h>
+#include <kfs/jiffies.h>
+#include <kfs/sched.h>
+#include <kfs/string.h>
+
+/* テスト用デバイスの周波数（1MHz: 1サイクル = 1マイクロ秒） */
+#define FAKE_FREQ 1000000
+
+/* テスト用デバイスの操作記録 */
+struct fake_clockevent
+{
+	struct clock_event_device dev;
+	int nr_periodic;			 /* set_state_periodicの呼び出し回数 */
+	int nr_shutdown;			 /* set_state_shutdownの呼び出し回数 */
+	unsigned long last_delta;	 /* 最後にset_next_eventで設定したサイクル数 */
+	unsigned long remaining;	 /* read_remainingが返すサイクル数 */
+};
+
+static struct fake_clockevent fakes[3];
+
+static int fake_set_periodic(struct clock_event_device *dev)
+{
+	container_of(dev, struct fake_clockevent, dev)->nr_periodic++;
+	return 0;
+}
+
+static int fake_set_oneshot(struct clock_event_device *dev)
+{
+	(void)dev;
+	return 0;
+}
+
+static int fake_shutdown(struct clock_event_device *dev)
+{
+	container_of(dev, struct fake_clockevent, dev)->nr_shutdown++;
+	return 0;
+}
+
+static int fake_next_event(unsigned long delta, struct clock_event_device *dev)
+{
+	container_of(dev, struct fake_clockevent, dev)->last_delta = delta;
+	return 0;
+}
+
+static unsigned long fake_read_remaining(struct clock_event_device *dev)
+{
+	return container_of(dev, struct fake_clockevent, dev)->remaining;
+}
+
+/* テスト用デバイスを初期化して返す（登録はしない） */
+static struct clock_event_device *init_fake(int idx, int rating, unsigned int features)
+{
+	struct fake_clockevent *fake = &fakes[idx];
+
+	memset(fake, 0, sizeof(*fake));
+	fake->dev.name = "fake";
+	fake->dev.rating = rating;
+	fake->dev.features = features;
+	fake->dev.min_delta_ticks = 1;
+	fake->dev.max_delta_ticks = 0x7FFFFFFF;
+	fake->dev.set_state_periodic = fake_set_periodic;
+	fake->dev.set_state_oneshot = fake_set_oneshot;
+	fake->dev.set_state_shutdown = fake_shutdown;
+	fake->dev.set_next_event = fake_next_event;
+	fake->dev.read_remaining = fake_read_remaining;
+	clockevents_config(&fake->dev, FAKE_FREQ);
+	return &fake->dev;
+}
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	sched_init();
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	tick_reset_for_test();
+}
+
+/**
+ * test_clockevents_ns_to_cycles - ナノ秒とサイクル数の変換を確認
+ */
+static void test_clockevents_ns_to_cycles(void)
+{
+	struct clock_event_device *dev = init_fake(0, 10, CLOCK_EVT_FEAT_ONESHOT);
+
+	/* 1MHz: mult = 2^32 / 1000 */
+	KFS_ASSERT_EQ(32, dev->shift);
+	KFS_ASSERT_EQ(4294967, dev->mult);
+
+	clockevents_switch_state(dev, CLOCK_EVT_STATE_ONESHOT);
+	KFS_ASSERT_EQ(0, clockevents_program_event(dev, 10000000ULL)); /* 10ms */
+	KFS_ASSERT_EQ(9999, fakes[0].last_delta);
+
+	/* 上限を超える時間はmax_delta_ticksに丸める */
+	KFS_ASSERT_EQ(0, clockevents_program_event(dev, ~0ULL));
+	KFS_ASSERT_TRUE(fakes[0].last_delta <= 0x7FFFFFFF);
+
+	/* ワンショットでなければ設定できない */
+	clockevents_switch_state(dev, CLOCK_EVT_STATE_SHUTDOWN);
+	KFS_ASSERT_EQ(-1, clockevents_program_event(dev, 10000000ULL));
+
+	printk("clockevents ns to cycles test passed\n");
+}
+
+/**
+ * test_tick_prefers_higher_rating - 優先度の高いデバイスがtickデバイスになることを確認
+ */
+static void test_tick_prefers_higher_rating(void)
+{
+	struct clock_event_device *low = init_fake(0, 10, CLOCK_EVT_FEAT_PERIODIC);
+	struct clock_event_device *high = init_fake(1, 20, CLOCK_EVT_FEAT_PERIODIC);
+	struct clock_event_device *lower = init_fake(2, 5, CLOCK_EVT_FEAT_PERIODIC);
+
+	clockevents_register_device(low);
+	KFS_ASSERT_TRUE(tick_get_device() == low);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_PERIODIC, low->state);
+
+	/* 置き換えられたデバイスは停止する */
+	clockevents_register_device(high);
+	KFS_ASSERT_TRUE(tick_get_device() == high);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_SHUTDOWN, low->state);
+	KFS_ASSERT_EQ(1, fakes[0].nr_shutdown);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_PERIODIC, high->state);
+
+	/* 優先度の低いデバイスは使われない */
+	clockevents_register_device(lower);
+	KFS_ASSERT_TRUE(tick_get_device() == high);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_DETACHED, lower->state);
+	KFS_ASSERT_EQ(0, fakes[2].nr_periodic);
+
+	printk("tick prefers higher rating test passed\n");
+}
+
+/**
+ * test_tick_periodic_advances_jiffies - 周期tickごとにjiffiesとランキュー時刻が進むことを確認
+ */
+static void test_tick_periodic_advances_jiffies(void)
+{
+	struct clock_event_device *dev = init_fake(0, 10, CLOCK_EVT_FEAT_PERIODIC);
+	unsigned long start;
+	uint64_t clock;
+
+	clockevents_register_device(dev);
+	start = jiffies;
+	clock = this_rq()->clock;
+
+	dev->event_handler(dev);
+	dev->event_handler(dev);
+
+	KFS_ASSERT_EQ(2, jiffies - start);
+	KFS_ASSERT_TRUE(this_rq()->clock == clock + 2 * TICK_NSEC);
+
+	printk("tick periodic advances jiffies test passed\n");
+}
+
+/**
+ * test_tick_oneshot_only_device - ワンショットしかないデバイスで周期tickを再現することを確認
+ */
+static void test_tick_oneshot_only_device(void)
+{
+	struct clock_event_device *dev = init_fake(0, 10, CLOCK_EVT_FEAT_ONESHOT);
+	unsigned long start;
+
+	clockevents_register_device(dev);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_ONESHOT, dev->state);
+	KFS_ASSERT_EQ(9999, fakes[0].last_delta);
+
+	start = jiffies;
+	fakes[0].last_delta = 0;
+	dev->event_handler(dev);
+
+	/* 割り込みのたびに次のtickを設定し直す */
+	KFS_ASSERT_EQ(1, jiffies - start);
+	KFS_ASSERT_EQ(9999, fakes[0].last_delta);
+
+	printk("tick oneshot only device test passed\n");
+}
+
+/**
+ * test_tick_nohz_expired - tickを止めている間にワンショットが満了した場合を確認
+ *
+ * 1秒分のtickがまとめてjiffiesに加わり，周期tickが再開する
+ */
+static void test_tick_nohz_expired(void)
+{
+	struct clock_event_device *dev = init_fake(0, 10, CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT);
+	struct tick_sched *ts = tick_get_tick_sched();
+	unsigned long start;
+
+	clockevents_register_device(dev);
+	start = jiffies;
+
+	tick_nohz_idle_enter();
+	KFS_ASSERT_EQ(1, ts->tick_stopped);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_ONESHOT, dev->state);
+	KFS_ASSERT_EQ(999999, fakes[0].last_delta);
+
+	/* 満了した割り込みではjiffiesを進めない */
+	dev->event_handler(dev);
+	KFS_ASSERT_EQ(0, jiffies - start);
+
+	tick_nohz_idle_exit();
+	KFS_ASSERT_EQ(HZ, jiffies - start);
+	KFS_ASSERT_EQ(0, ts->tick_stopped);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_PERIODIC, dev->state);
+	KFS_ASSERT_EQ(1, ts->idle_sleeps);
+
+	printk("tick nohz expired test passed\n");
+}
+
+/**
+ * test_tick_nohz_early_wakeup - 他の割り込みで早く起こされた場合を確認
+ *
+ * デバイスの残り時間から経過時間を求め，1 tick未満の端数は次回に繰り越す
+ */
+static void test_tick_nohz_early_wakeup(void)
+{
+	struct clock_event_device *dev = init_fake(0, 10, CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT);
+	struct tick_sched *ts = tick_get_tick_sched();
+	unsigned long start;
+
+	clockevents_register_device(dev);
+	start = jiffies;
+
+	tick_nohz_idle_enter();
+	/* 残り745000マイクロ秒 → 約255ミリ秒経過 */
+	fakes[0].remaining = 745000;
+	tick_nohz_idle_exit();
+
+	KFS_ASSERT_EQ(25, jiffies - start);
+	KFS_ASSERT_TRUE(ts->carry_ns > 0 && ts->carry_ns < TICK_NSEC);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_PERIODIC, dev->state);
+
+	printk("tick nohz early wakeup test passed\n");
+}
+
+/**
+ * test_tick_nohz_keeps_tick_when_runnable - 実行可能なタスクがあればtickを止めないことを確認
+ */
+static void test_tick_nohz_keeps_tick_when_runnable(void)
+{
+	static struct task_struct task;
+	struct clock_event_device *dev = init_fake(0, 10, CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT);
+	struct tick_sched *ts = tick_get_tick_sched();
+
+	memset(&task, 0, sizeof(task));
+	task.sched_class = &fair_sched_class;
+	task.se.load.weight = NICE_0_LOAD;
+	RB_CLEAR_NODE(&task.se.run_node);
+
+	clockevents_register_device(dev);
+	activate_task(this_rq(), &task, 0);
+
+	tick_nohz_idle_enter();
+	KFS_ASSERT_EQ(0, ts->tick_stopped);
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_PERIODIC, dev->state);
+	KFS_ASSERT_EQ(1, ts->idle_calls);
+	KFS_ASSERT_EQ(0, ts->idle_sleeps);
+
+	/* tickを止めていなければ何もしない */
+	tick_nohz_idle_exit();
+	KFS_ASSERT_EQ(CLOCK_EVT_STATE_PERIODIC, dev->state);
+
+	printk("tick nohz keeps tick when runnable test passed\n");
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_clockevents_ns_to_cycles, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_prefers_higher_rating, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_periodic_advances_jiffies, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_oneshot_only_device, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_nohz_expired, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_nohz_early_wakeup, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_tick_nohz_keeps_tick_when_runnable, setup_test, teardown_test),
+};
+
+int register_unit_tests_tick(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
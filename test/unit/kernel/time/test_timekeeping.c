@@ -0,0 +1,197 @@
+#include "../../test_reset.h"
+#include "unit_test_framework.h"
+#include <kfs/clocksource.h>
+#include <kfs/ktime.h>
+#include <kfs/math64.h>
+#include <kfs/sched.h>
+#include <kfs/seqlock.h>
+#include <kfs/time.h>
+
+/* テスト用クロックソースの周波数（1MHz: 1サイクル = 1マイクロ秒） */
+#define FAKE_FREQ 1000000
+
+/* テスト用クロックソースのカウンタ（テストが直接進める） */
+static uint64_t fake_cycles;
+
+static uint64_t fake_read(struct clocksource *cs)
+{
+	(void)cs;
+	return fake_cycles;
+}
+
+static struct clocksource fake_cs = {
+	.name = "fake",
+	.rating = 400,
+	.read = fake_read,
+	.mask = CLOCKSOURCE_MASK(32),
+};
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	fake_cycles = 0;
+	clocks_calc_mult_shift(&fake_cs.mult, &fake_cs.shift, FAKE_FREQ, NSEC_PER_SEC, 600);
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	clocksource_unregister(&fake_cs);
+}
+
+/**
+ * test_clocks_calc_mult_shift - mult/shiftの変換精度を確認
+ */
+static void test_clocks_calc_mult_shift(void)
+{
+	uint32_t mult, shift;
+
+	/* 1MHz -> ns: 1サイクル = 1000ns を誤差なく表せる */
+	clocks_calc_mult_shift(&mult, &shift, FAKE_FREQ, NSEC_PER_SEC, 600);
+	KFS_ASSERT_EQ(1000000000ULL, clocksource_cyc2ns(1000000, mult, shift));
+
+	/* 2.5GHz（kHz単位）-> ns: 1秒分のサイクルが誤差1マイクロ秒未満で1秒になる */
+	clocks_calc_mult_shift(&mult, &shift, 2500000, NSEC_PER_MSEC, 600 * MSEC_PER_SEC);
+	KFS_ASSERT_TRUE(1000000000ULL - clocksource_cyc2ns(2500000000ULL, mult, shift) < NSEC_PER_USEC);
+
+	/* maxsec（600秒）分のサイクル数でも桁あふれしない */
+	KFS_ASSERT_EQ(599ULL, div_u64(clocksource_cyc2ns(1500000000000ULL, mult, shift), NSEC_PER_SEC));
+
+	printk("clocks calc mult shift test passed\n");
+}
+
+/**
+ * test_mul_u64_u32_shr - 64ビットを超える中間値でも正しく計算できることを確認
+ */
+static void test_mul_u64_u32_shr(void)
+{
+	KFS_ASSERT_EQ(3ULL, mul_u64_u32_shr(6, 1, 1));
+	KFS_ASSERT_EQ(0x123456789ULL, mul_u64_u32_shr(0x123456789ULL, 1U << 31, 31));
+
+	/* (2^40 * 2^31) >> 32 = 2^39: 中間値は2^71 */
+	KFS_ASSERT_EQ(1ULL << 39, mul_u64_u32_shr(1ULL << 40, 1U << 31, 32));
+
+	printk("mul u64 u32 shr test passed\n");
+}
+
+/**
+ * test_seqcount_retry - 書き込みを挟んだ読み出しが読み直しになることを確認
+ */
+static void test_seqcount_retry(void)
+{
+	seqcount_t seq = SEQCNT_ZERO;
+	unsigned int start;
+
+	start = read_seqcount_begin(&seq);
+	KFS_ASSERT_EQ(0, read_seqcount_retry(&seq, start));
+
+	start = read_seqcount_begin(&seq);
+	write_seqcount_begin(&seq);
+	KFS_ASSERT_EQ(1, seq.sequence & 1);
+	write_seqcount_end(&seq);
+	KFS_ASSERT_TRUE(read_seqcount_retry(&seq, start));
+
+	/* 書き込みが終われば再び読める */
+	start = read_seqcount_begin(&seq);
+	KFS_ASSERT_EQ(0, read_seqcount_retry(&seq, start));
+
+	printk("seqcount retry test passed\n");
+}
+
+/**
+ * test_ktime_follows_clocksource - 優先度の高いクロックソースに切り替わり，その値で時刻が進むことを確認
+ */
+static void test_ktime_follows_clocksource(void)
+{
+	uint64_t t0;
+
+	fake_cycles = 5000;
+	clocksource_register(&fake_cs);
+	KFS_ASSERT_TRUE(timekeeping_get_clocksource() == &fake_cs);
+
+	/* 切り替え時点のカウンタ値が基準になる */
+	t0 = ktime_get_ns();
+	fake_cycles += 1000;
+	KFS_ASSERT_EQ(1000000ULL, ktime_get_ns() - t0);
+
+	/* 基準点を進めても時刻は変わらない */
+	update_wall_time();
+	KFS_ASSERT_EQ(1000000ULL, ktime_get_ns() - t0);
+	fake_cycles += 1;
+	KFS_ASSERT_EQ(1001000ULL, ktime_to_ns(ktime_get()) - t0);
+
+	printk("ktime follows clocksource test passed\n");
+}
+
+/**
+ * test_ktime_wraps_counter - カウンタのラップアラウンドを越えても時刻が進むことを確認
+ */
+static void test_ktime_wraps_counter(void)
+{
+	uint64_t t0;
+
+	fake_cycles = 0xFFFFFF00ULL;
+	clocksource_register(&fake_cs);
+	t0 = ktime_get_ns();
+
+	/* 32ビットのカウンタが0に戻る */
+	fake_cycles = 0x100;
+	KFS_ASSERT_EQ(0x200ULL * 1000, ktime_get_ns() - t0);
+
+	printk("ktime wraps counter test passed\n");
+}
+
+/**
+ * test_ktime_monotonic_on_switch - クロックソースを外しても時刻が戻らないことを確認
+ */
+static void test_ktime_monotonic_on_switch(void)
+{
+	uint64_t before;
+
+	clocksource_register(&fake_cs);
+	fake_cycles += 1000000; /* 1秒 */
+	before = ktime_get_ns();
+
+	clocksource_unregister(&fake_cs);
+	KFS_ASSERT_TRUE(timekeeping_get_clocksource() != &fake_cs);
+	KFS_ASSERT_TRUE(timekeeping_get_clocksource() != NULL);
+	KFS_ASSERT_TRUE(ktime_get_ns() >= before);
+
+	printk("ktime monotonic on switch test passed\n");
+}
+
+/**
+ * test_sched_clock_monotonic - sched_clock()が単調増加することを確認
+ */
+static void test_sched_clock_monotonic(void)
+{
+	uint64_t prev = sched_clock();
+	int i;
+
+	for (i = 0; i < 1000; i++)
+	{
+		uint64_t now = sched_clock();
+
+		KFS_ASSERT_TRUE(now >= prev);
+		prev = now;
+	}
+
+	printk("sched clock monotonic test passed\n");
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_clocks_calc_mult_shift, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_mul_u64_u32_shr, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_seqcount_retry, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ktime_follows_clocksource, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ktime_wraps_counter, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_ktime_monotonic_on_switch, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_sched_clock_monotonic, setup_test, teardown_test),
+};
+
+int register_unit_tests_timekeeping(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -0,0 +1,150 @@
+#include "../test_reset.h"
+#include "unit_test_framework.h"
+#include <kfs/bitmap.h>
+
+/* テスト用ビットマップ（3ワード + 半端な8ビット） */
+#define TEST_NBITS 104
+static DECLARE_BITMAP(test_map, TEST_NBITS);
+
+/* 全テストで共通のセットアップ関数 */
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+	bitmap_zero(test_map, TEST_NBITS);
+}
+
+/* 全テストで共通のクリーンアップ関数 */
+static void teardown_test(void)
+{
+	/* 必要なら後処理（現在は空） */
+}
+
+/**
+ * test_bitops_ffs_fls - bsf/bsrによるビット位置の計算を確認
+ */
+static void test_bitops_ffs_fls(void)
+{
+	KFS_ASSERT_EQ(0, __ffs(1UL));
+	KFS_ASSERT_EQ(4, __ffs(0x30UL));
+	KFS_ASSERT_EQ(31, __ffs(0x80000000UL));
+	KFS_ASSERT_EQ(0, __fls(1UL));
+	KFS_ASSERT_EQ(5, __fls(0x30UL));
+	KFS_ASSERT_EQ(31, __fls(0xffffffffUL));
+	KFS_ASSERT_EQ(0, ffz(0UL));
+	KFS_ASSERT_EQ(3, ffz(0x7UL));
+	KFS_ASSERT_EQ(0, hweight32(0));
+	KFS_ASSERT_EQ(8, hweight32(0xf0f00000));
+	KFS_ASSERT_EQ(32, hweight32(0xffffffff));
+
+	printk("bitops ffs/fls test passed\n");
+}
+
+/**
+ * test_find_next_bit - 立っているビットをワードをまたいで探せることを確認
+ */
+static void test_find_next_bit(void)
+{
+	/* 空なら見つからない */
+	KFS_ASSERT_EQ(TEST_NBITS, find_first_bit(test_map, TEST_NBITS));
+
+	__set_bit(5, test_map);
+	__set_bit(70, test_map);
+	__set_bit(103, test_map);
+
+	KFS_ASSERT_EQ(5, find_first_bit(test_map, TEST_NBITS));
+	KFS_ASSERT_EQ(5, find_next_bit(test_map, TEST_NBITS, 5));
+	KFS_ASSERT_EQ(70, find_next_bit(test_map, TEST_NBITS, 6));
+	KFS_ASSERT_EQ(103, find_next_bit(test_map, TEST_NBITS, 71));
+	KFS_ASSERT_EQ(TEST_NBITS, find_next_bit(test_map, TEST_NBITS, 104));
+
+	/* sizeより後ろのビットは見ない */
+	KFS_ASSERT_EQ(100, find_next_bit(test_map, 100, 71));
+
+	KFS_ASSERT_EQ(103, find_last_bit(test_map, TEST_NBITS));
+	KFS_ASSERT_EQ(70, find_last_bit(test_map, 100));
+	KFS_ASSERT_EQ(5, find_last_bit(test_map, 32));
+	KFS_ASSERT_EQ(4, find_last_bit(test_map, 4));
+
+	printk("find_next_bit test passed\n");
+}
+
+/**
+ * test_find_next_zero_bit - 落ちているビットを使用中のワードを読み飛ばして探せることを確認
+ */
+static void test_find_next_zero_bit(void)
+{
+	KFS_ASSERT_EQ(0, find_first_zero_bit(test_map, TEST_NBITS));
+
+	/* 先頭2ワードと3ワード目の一部を埋める */
+	bitmap_set(test_map, 0, 66);
+	KFS_ASSERT_EQ(66, find_first_zero_bit(test_map, TEST_NBITS));
+	KFS_ASSERT_EQ(66, find_next_zero_bit(test_map, TEST_NBITS, 10));
+	KFS_ASSERT_EQ(80, find_next_zero_bit(test_map, TEST_NBITS, 80));
+
+	/* 全部埋まっていれば見つからない（最後のワードの範囲外のビットは無視する） */
+	bitmap_set(test_map, 66, TEST_NBITS - 66);
+	KFS_ASSERT_EQ(TEST_NBITS, find_first_zero_bit(test_map, TEST_NBITS));
+
+	__clear_bit(33, test_map);
+	KFS_ASSERT_EQ(33, find_next_zero_bit(test_map, TEST_NBITS, 1));
+	KFS_ASSERT_EQ(TEST_NBITS, find_next_zero_bit(test_map, TEST_NBITS, 34));
+
+	printk("find_next_zero_bit test passed\n");
+}
+
+/**
+ * test_bitmap_set_clear - 範囲指定でビットを立て・落とせることを確認
+ */
+static void test_bitmap_set_clear(void)
+{
+	/* 1ワード内に収まる範囲 */
+	bitmap_set(test_map, 3, 4);
+	KFS_ASSERT_EQ(0x78UL, test_map[0]);
+
+	/* ワード境界をまたぐ範囲 */
+	bitmap_set(test_map, 30, 36);
+	KFS_ASSERT_EQ(0xc0000078UL, test_map[0]);
+	KFS_ASSERT_EQ(0xffffffffUL, test_map[1]);
+	KFS_ASSERT_EQ(0x3UL, test_map[2]);
+	KFS_ASSERT_EQ(4 + 36, bitmap_weight(test_map, TEST_NBITS));
+
+	bitmap_clear(test_map, 31, 34);
+	KFS_ASSERT_EQ(0x40000078UL, test_map[0]);
+	KFS_ASSERT_EQ(0UL, test_map[1]);
+	KFS_ASSERT_EQ(0x2UL, test_map[2]);
+	KFS_ASSERT_EQ(6, bitmap_weight(test_map, TEST_NBITS));
+
+	/* 長さ0は何もしない */
+	bitmap_set(test_map, 50, 0);
+	bitmap_clear(test_map, 3, 0);
+	KFS_ASSERT_EQ(6, bitmap_weight(test_map, TEST_NBITS));
+
+	printk("bitmap_set/clear test passed\n");
+}
+
+/**
+ * test_bitmap_weight_partial - 半端なワードはnbits未満だけ数えることを確認
+ */
+static void test_bitmap_weight_partial(void)
+{
+	bitmap_fill(test_map, TEST_NBITS);
+	KFS_ASSERT_EQ(TEST_NBITS, bitmap_weight(test_map, TEST_NBITS));
+	KFS_ASSERT_EQ(33, bitmap_weight(test_map, 33));
+	KFS_ASSERT_EQ(0, bitmap_weight(test_map, 0));
+
+	printk("bitmap_weight partial test passed\n");
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_bitops_ffs_fls, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_find_next_bit, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_find_next_zero_bit, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_bitmap_set_clear, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_bitmap_weight_partial, setup_test, teardown_test),
+};
+
+int register_unit_tests_bitmap(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
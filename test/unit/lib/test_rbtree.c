@@ -1,5 +1,6 @@
 #include "../test_reset.h"
 #include "unit_test_framework.h"
+#include <kfs/list.h>
 #include <kfs/rbtree.h>
 
 /* 全テストで共通のセットアップ関数 */
@@ -160,6 +161,182 @@ static void test_rb_parent_operations(void)
 	printk("rb_parent operations test passed\n");
 }
 
+/* 挿入・削除テスト用のノード */
+struct test_rb_item
+{
+	struct rb_node node;
+	int key;
+};
+
+#define TEST_RB_NR_ITEMS 64
+
+static struct test_rb_item rb_items[TEST_RB_NR_ITEMS];
+
+/* キー順にノードを挿入する（leftmostを計算してキャッシュ版で挿入） */
+static void test_rb_insert(struct rb_root_cached *root, struct test_rb_item *item)
+{
+	struct rb_node **link = &root->rb_root.rb_node;
+	struct rb_node *parent = NULL;
+	int leftmost = 1;
+
+	while (*link)
+	{
+		parent = *link;
+		if (item->key < rb_entry(parent, struct test_rb_item, node)->key)
+		{
+			link = &parent->rb_left;
+		}
+		else
+		{
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+	rb_link_node(&item->node, parent, link);
+	rb_insert_color_cached(&item->node, root, leftmost);
+}
+
+/** 赤黒木の性質を検証する
+ * @return 黒高さ，違反があれば-1
+ * @note 赤ノードの子は黒，すべての経路の黒ノード数が等しい，親ポインタが正しいことを確認する
+ */
+static int test_rb_validate(const struct rb_node *node, const struct rb_node *parent)
+{
+	int left, right;
+
+	if (!node)
+	{
+		return 1;
+	}
+	if (rb_parent(node) != parent)
+	{
+		return -1;
+	}
+	if (rb_is_red(node) && ((node->rb_left && rb_is_red(node->rb_left)) || (node->rb_right && rb_is_red(node->rb_right))))
+	{
+		return -1;
+	}
+	left = test_rb_validate(node->rb_left, node);
+	right = test_rb_validate(node->rb_right, node);
+	if (left < 0 || right < 0 || left != right)
+	{
+		return -1;
+	}
+	return left + rb_is_black(node);
+}
+
+/** 中順走査でキーが昇順に並んでいることを確認する
+ * @return ノード数，昇順でなければ-1
+ */
+static int test_rb_count_sorted(const struct rb_root *root)
+{
+	struct rb_node *node;
+	int count = 0;
+	int prev = -1;
+
+	for (node = rb_first(root); node; node = rb_next(node))
+	{
+		int key = rb_entry(node, struct test_rb_item, node)->key;
+		if (key < prev)
+		{
+			return -1;
+		}
+		prev = key;
+		count++;
+	}
+	return count;
+}
+
+/**
+ * test_rb_insert_balanced - rb_insert_color()のテスト
+ *
+ * 昇順に挿入しても（最悪ケース）赤黒木の性質が保たれ，根が黒であることを確認
+ */
+static void test_rb_insert_balanced(void)
+{
+	struct rb_root_cached root = RB_ROOT_CACHED;
+
+	for (int i = 0; i < TEST_RB_NR_ITEMS; i++)
+	{
+		rb_items[i].key = i;
+		test_rb_insert(&root, &rb_items[i]);
+		KFS_ASSERT_TRUE(test_rb_validate(root.rb_root.rb_node, NULL) > 0);
+	}
+
+	KFS_ASSERT_TRUE(rb_is_black(root.rb_root.rb_node));
+	KFS_ASSERT_EQ(TEST_RB_NR_ITEMS, test_rb_count_sorted(&root.rb_root));
+	/* 64ノードの赤黒木の高さは2*log2(65)未満 */
+	KFS_ASSERT_TRUE(test_rb_validate(root.rb_root.rb_node, NULL) <= 7);
+
+	printk("rb_insert balanced test passed\n");
+}
+
+/**
+ * test_rb_erase_two_children - rb_erase()のテスト
+ *
+ * 根（2つの子を持つ）と葉を交互に削除しても赤黒木の性質が保たれることを確認
+ */
+static void test_rb_erase_two_children(void)
+{
+	struct rb_root_cached root = RB_ROOT_CACHED;
+	int remaining = TEST_RB_NR_ITEMS;
+
+	for (int i = 0; i < TEST_RB_NR_ITEMS; i++)
+	{
+		/* 挿入順を散らす（37は64と互いに素） */
+		rb_items[i].key = (i * 37) % TEST_RB_NR_ITEMS;
+		test_rb_insert(&root, &rb_items[i]);
+	}
+
+	while (root.rb_root.rb_node)
+	{
+		struct rb_node *victim = root.rb_root.rb_node;
+
+		if ((remaining & 1) && rb_first(&root.rb_root))
+		{
+			victim = rb_first(&root.rb_root);
+		}
+		rb_erase_cached(victim, &root);
+		remaining--;
+
+		KFS_ASSERT_TRUE(test_rb_validate(root.rb_root.rb_node, NULL) > 0);
+		KFS_ASSERT_EQ(remaining, test_rb_count_sorted(&root.rb_root));
+	}
+	KFS_ASSERT_EQ(0, remaining);
+
+	printk("rb_erase two children test passed\n");
+}
+
+/**
+ * test_rb_cached_leftmost - rb_root_cachedの最左ノードキャッシュのテスト
+ *
+ * 挿入・削除のたびにrb_first_cached()がrb_first()と一致することを確認
+ */
+static void test_rb_cached_leftmost(void)
+{
+	struct rb_root_cached root = RB_ROOT_CACHED;
+
+	KFS_ASSERT_TRUE(rb_first_cached(&root) == NULL);
+
+	for (int i = 0; i < TEST_RB_NR_ITEMS; i++)
+	{
+		/* 降順に挿入すると毎回leftmostが更新される */
+		rb_items[i].key = TEST_RB_NR_ITEMS - i;
+		test_rb_insert(&root, &rb_items[i]);
+		KFS_ASSERT_TRUE(rb_first_cached(&root) == &rb_items[i].node);
+	}
+
+	for (int i = TEST_RB_NR_ITEMS - 1; i >= 0; i--)
+	{
+		rb_erase_cached(rb_first_cached(&root), &root);
+		KFS_ASSERT_TRUE(rb_first_cached(&root) == rb_first(&root.rb_root));
+	}
+	KFS_ASSERT_TRUE(rb_first_cached(&root) == NULL);
+	KFS_ASSERT_TRUE(root.rb_root.rb_node == NULL);
+
+	printk("rb cached leftmost test passed\n");
+}
+
 static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_rb_node_structure, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_rb_root_initialization, setup_test, teardown_test),
@@ -167,6 +344,9 @@ static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_rb_color_operations, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_rb_first, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_rb_parent_operations, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rb_insert_balanced, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rb_erase_two_children, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_rb_cached_leftmost, setup_test, teardown_test),
 };
 
 int register_unit_tests_rbtree(struct kfs_test_case **out)
@@ -0,0 +1,328 @@
+/*
+ * test_cow.c - プロセスごとのページディレクトリとCOW[Copy On Write]のテスト
+ *
+ * 以下の関数をテスト:
+ * - pgd_alloc()/pgd_free(): カーネル部分を共有したページディレクトリの作成と解放
+ * - copy_page_range(): fork時にユーザーページを読み取り専用で共有する
+ * - do_wp_page(): 共有ページへの書き込みでページをコピーする
+ * - CR0.WP: カーネルからの実際の書き込みでもCOWページがフォルトしてコピーされる
+ * - exit_mmap(): ユーザーページの参照を外してページテーブルを解放する
+ * - mmput()/mmgrab()/mmdrop(): 借りられているmmはユーザーページを解放してもページディレクトリを残す
+ */
+
+#include "../test_reset.h"
+#include "unit_test_framework.h"
+#include <asm-i386/page.h>
+#include <asm-i386/pgtable.h>
+#include <asm-i386/system.h>
+#include <kfs/gfp.h>
+#include <kfs/mm.h>
+#include <kfs/mm_types.h>
+#include <kfs/sched.h>
+#include <kfs/slab.h>
+#include <kfs/string.h>
+#include <kfs/vmalloc.h>
+
+extern pde_t boot_page_directory[];
+
+#define TEST_USER_ADDR 0x08048000UL
+#define TEST_MAGIC 0xC0FFEE42UL
+#define TEST_CHILD_MAGIC 0xDEADBEEFUL
+
+static void setup_test(void)
+{
+	reset_all_state_for_test();
+}
+
+static void teardown_test(void)
+{
+}
+
+/* mmのページテーブルからユーザーアドレスのPTEを読む（ページテーブルがなければ0） */
+static pte_t read_user_pte(struct mm_struct *mm, unsigned long vaddr)
+{
+	pte_t *table;
+
+	if (!pde_present(mm->pgd[pgd_index(vaddr)]))
+	{
+		return 0;
+	}
+	table = (pte_t *)__va(pde_page(mm->pgd[pgd_index(vaddr)]));
+	return table[pte_index(vaddr)];
+}
+
+/* 書き込み可能なユーザーページを1枚マップし，先頭にTEST_MAGICを書いておく（失敗時NULL） */
+static struct page *map_test_page(struct mm_struct *mm)
+{
+	struct page *page = alloc_pages(GFP_KERNEL, 0);
+
+	if (page == NULL)
+	{
+		return NULL;
+	}
+	*(unsigned long *)__va((unsigned long)page) = TEST_MAGIC;
+	if (map_user_page(mm, TEST_USER_ADDR, (unsigned long)page, _PAGE_USER_RW) < 0)
+	{
+		free_pages(page, 0);
+		return NULL;
+	}
+	return page;
+}
+
+/*
+ * テスト: pgd_alloc - カーネル部分だけを共有する
+ * 検証: カーネルと恒等マップのPDEはboot_page_directoryと同じで，ユーザー部分は空であること
+ */
+KFS_TEST(test_pgd_alloc_shares_kernel_half)
+{
+	struct mm_struct mm = {0};
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&mm));
+	KFS_ASSERT_TRUE(mm.pgd != NULL);
+
+	KFS_ASSERT_EQ(boot_page_directory[0], mm.pgd[0]);
+	KFS_ASSERT_EQ(boot_page_directory[pgd_index(PAGE_OFFSET)], mm.pgd[pgd_index(PAGE_OFFSET)]);
+	KFS_ASSERT_EQ(0, mm.pgd[pgd_index(TEST_USER_ADDR)]);
+	KFS_ASSERT_EQ(0, mm.pgd[USER_PTRS_PER_PGD - 1]);
+
+	pgd_free(&mm);
+	KFS_ASSERT_TRUE(mm.pgd == NULL);
+}
+
+/*
+ * テスト: pgd_alloc後に作られたvmallocのページテーブルも見えること
+ * 検証: 既存のmmのPDEがboot_page_directoryと同期されること
+ */
+KFS_TEST(test_vmalloc_pde_synced_to_pgd)
+{
+	struct mm_struct mm = {0};
+	unsigned long idx;
+	void *addr;
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&mm));
+
+	addr = vmalloc(PAGE_SIZE);
+	KFS_ASSERT_TRUE(addr != NULL);
+	idx = pgd_index((unsigned long)addr);
+	KFS_ASSERT_TRUE(pde_present(mm.pgd[idx]));
+	KFS_ASSERT_EQ(boot_page_directory[idx], mm.pgd[idx]);
+
+	vfree(addr);
+	KFS_ASSERT_EQ(boot_page_directory[idx], mm.pgd[idx]);
+
+	pgd_free(&mm);
+}
+
+/*
+ * テスト: copy_page_range - ページをコピーせずに共有する
+ * 検証: 親子のPTEが同じページを指し，両方とも読み取り専用かつ_PAGE_COWで，参照数が2になること
+ */
+KFS_TEST(test_copy_page_range_shares_pages_cow)
+{
+	struct mm_struct parent = {0};
+	struct mm_struct child = {0};
+	struct page *page;
+	pte_t ppte, cpte;
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&parent));
+	KFS_ASSERT_EQ(0, pgd_alloc(&child));
+	page = map_test_page(&parent);
+	KFS_ASSERT_TRUE(page != NULL);
+
+	KFS_ASSERT_EQ(0, copy_page_range(&child, &parent));
+
+	ppte = read_user_pte(&parent, TEST_USER_ADDR);
+	cpte = read_user_pte(&child, TEST_USER_ADDR);
+	KFS_ASSERT_EQ((unsigned long)page, pte_page(ppte));
+	KFS_ASSERT_EQ((unsigned long)page, pte_page(cpte));
+	KFS_ASSERT_TRUE(!pte_write(ppte) && (ppte & _PAGE_COW));
+	KFS_ASSERT_TRUE(!pte_write(cpte) && (cpte & _PAGE_COW));
+	KFS_ASSERT_EQ(2, page_count(page));
+
+	/* ページテーブル自体は親子で別 */
+	KFS_ASSERT_TRUE(pde_page(parent.pgd[pgd_index(TEST_USER_ADDR)]) !=
+					pde_page(child.pgd[pgd_index(TEST_USER_ADDR)]));
+
+	exit_mmap(&child);
+	exit_mmap(&parent);
+	pgd_free(&child);
+	pgd_free(&parent);
+}
+
+/*
+ * テスト: do_wp_page - 共有中は複製し，最後の1つは再利用する
+ * 検証: 先に書き込んだ子は中身をコピーした新しいページを得て，残った親は元のページをそのまま書き込み可能にすること
+ */
+KFS_TEST(test_do_wp_page_copies_then_reuses)
+{
+	struct mm_struct parent = {0};
+	struct mm_struct child = {0};
+	struct page *page;
+	pte_t ppte, cpte;
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&parent));
+	KFS_ASSERT_EQ(0, pgd_alloc(&child));
+	page = map_test_page(&parent);
+	KFS_ASSERT_TRUE(page != NULL);
+	KFS_ASSERT_EQ(0, copy_page_range(&child, &parent));
+
+	/* 子が書き込む: 共有中なのでコピーされる */
+	KFS_ASSERT_EQ(0, do_wp_page(&child, TEST_USER_ADDR));
+	cpte = read_user_pte(&child, TEST_USER_ADDR);
+	KFS_ASSERT_TRUE(pte_page(cpte) != (unsigned long)page);
+	KFS_ASSERT_TRUE(pte_write(cpte) && !(cpte & _PAGE_COW));
+	KFS_ASSERT_EQ(TEST_MAGIC, *(unsigned long *)__va(pte_page(cpte)));
+	KFS_ASSERT_EQ(1, page_count(page));
+
+	/* 親が書き込む: 参照は自分だけなのでコピーせず再利用する */
+	KFS_ASSERT_EQ(0, do_wp_page(&parent, TEST_USER_ADDR));
+	ppte = read_user_pte(&parent, TEST_USER_ADDR);
+	KFS_ASSERT_EQ((unsigned long)page, pte_page(ppte));
+	KFS_ASSERT_TRUE(pte_write(ppte) && !(ppte & _PAGE_COW));
+
+	exit_mmap(&child);
+	exit_mmap(&parent);
+	pgd_free(&child);
+	pgd_free(&parent);
+}
+
+/*
+ * テスト: CR0.WP - カーネルからの実際の書き込みでもCOWページがコピーされる
+ * 検証: 子のページディレクトリに切り替えて共有ページに書き込むと，ページフォルト経由で子だけが
+ *       新しいページを得て，親のページはTEST_MAGICのまま変わらないこと
+ */
+KFS_TEST(test_kernel_write_to_cow_page_faults)
+{
+	struct mm_struct parent = {0};
+	struct mm_struct child = {0};
+	struct mm_struct *old_mm;
+	unsigned long old_cr3;
+	unsigned long flags;
+	struct page *page;
+	pte_t cpte;
+
+	KFS_ASSERT_TRUE(read_cr0() & X86_CR0_WP);
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&parent));
+	KFS_ASSERT_EQ(0, pgd_alloc(&child));
+	page = map_test_page(&parent);
+	KFS_ASSERT_TRUE(page != NULL);
+	KFS_ASSERT_EQ(0, copy_page_range(&child, &parent));
+
+	/* 子のアドレス空間で書き込む（切り替え中にスケジュールされないよう割り込みを禁止する） */
+	local_irq_save(flags);
+	old_mm = current->mm;
+	old_cr3 = read_cr3();
+	current->mm = &child;
+	load_cr3(__pa(child.pgd));
+	*(volatile unsigned long *)TEST_USER_ADDR = TEST_CHILD_MAGIC;
+	load_cr3(old_cr3);
+	current->mm = old_mm;
+	local_irq_restore(flags);
+
+	cpte = read_user_pte(&child, TEST_USER_ADDR);
+	KFS_ASSERT_TRUE(pte_page(cpte) != (unsigned long)page);
+	KFS_ASSERT_TRUE(pte_write(cpte) && !(cpte & _PAGE_COW));
+	KFS_ASSERT_EQ(TEST_CHILD_MAGIC, *(unsigned long *)__va(pte_page(cpte)));
+	KFS_ASSERT_EQ(TEST_MAGIC, *(unsigned long *)__va((unsigned long)page));
+	KFS_ASSERT_EQ(1, page_count(page));
+
+	exit_mmap(&child);
+	exit_mmap(&parent);
+	pgd_free(&child);
+	pgd_free(&parent);
+}
+
+/*
+ * テスト: do_wp_page - COWページ以外は解決しない
+ * 検証: 未マップのアドレスや本当に読み取り専用のページでは-1を返すこと
+ */
+KFS_TEST(test_do_wp_page_rejects_non_cow)
+{
+	struct mm_struct mm = {0};
+	struct page *page;
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&mm));
+	KFS_ASSERT_EQ(-1, do_wp_page(&mm, TEST_USER_ADDR));
+
+	page = alloc_pages(GFP_KERNEL, 0);
+	KFS_ASSERT_EQ(0, map_user_page(&mm, TEST_USER_ADDR, (unsigned long)page, _PAGE_USER));
+	KFS_ASSERT_EQ(-1, do_wp_page(&mm, TEST_USER_ADDR));
+
+	exit_mmap(&mm);
+	pgd_free(&mm);
+}
+
+/*
+ * テスト: exit_mmap - 共有ページは最後の参照で解放される
+ * 検証: 子のexit_mmapでは参照数が減るだけで，親のexit_mmapで空きページに戻ること
+ */
+KFS_TEST(test_exit_mmap_drops_shared_references)
+{
+	struct mm_struct parent = {0};
+	struct mm_struct child = {0};
+	struct page *page;
+
+	KFS_ASSERT_EQ(0, pgd_alloc(&parent));
+	KFS_ASSERT_EQ(0, pgd_alloc(&child));
+	page = map_test_page(&parent);
+	KFS_ASSERT_TRUE(page != NULL);
+	KFS_ASSERT_EQ(0, copy_page_range(&child, &parent));
+
+	exit_mmap(&child);
+	KFS_ASSERT_EQ(1, page_count(page));
+	KFS_ASSERT_EQ(0, child.pgd[pgd_index(TEST_USER_ADDR)]);
+
+	exit_mmap(&parent);
+	KFS_ASSERT_EQ(0, page_count(page));
+
+	pgd_free(&child);
+	pgd_free(&parent);
+}
+
+/*
+ * テスト: mmput - 借りられているmmのページディレクトリは残す
+ * 検証: mmgrab()した参照がある間は，最後の利用者のmmput()でユーザーページだけが解放され，
+ *       ページディレクトリはmmdrop()まで残ること
+ */
+KFS_TEST(test_mmput_keeps_pgd_while_grabbed)
+{
+	struct mm_struct *mm = kmalloc(sizeof(*mm));
+	struct page *page;
+
+	KFS_ASSERT_TRUE(mm != NULL);
+	memset(mm, 0, sizeof(*mm));
+	atomic_set(&mm->mm_users, 1);
+	atomic_set(&mm->mm_count, 1);
+	KFS_ASSERT_EQ(0, pgd_alloc(mm));
+	page = map_test_page(mm);
+	KFS_ASSERT_TRUE(page != NULL);
+
+	/* カーネルスレッドが借りている状態で，最後の利用者が抜ける */
+	mmgrab(mm);
+	mmput(mm);
+	KFS_ASSERT_EQ(0, page_count(page));
+	KFS_ASSERT_TRUE(mm->pgd != NULL);
+	KFS_ASSERT_EQ(0, mm->pgd[pgd_index(TEST_USER_ADDR)]);
+	KFS_ASSERT_EQ(1, atomic_read(&mm->mm_count));
+
+	/* カーネルスレッドが返すとmmごと解放される */
+	mmdrop(mm);
+}
+
+static struct kfs_test_case cases[] = {
+	KFS_REGISTER_TEST_WITH_SETUP(test_pgd_alloc_shares_kernel_half, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_pde_synced_to_pgd, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_copy_page_range_shares_pages_cow, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_do_wp_page_copies_then_reuses, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_kernel_write_to_cow_page_faults, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_do_wp_page_rejects_non_cow, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_exit_mmap_drops_shared_references, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_mmput_keeps_pgd_while_grabbed, setup_test, teardown_test),
+};
+
+int register_unit_tests_cow(struct kfs_test_case **out)
+{
+	*out = cases;
+	return (int)(sizeof(cases) / sizeof(cases[0]));
+}
@@ -4,16 +4,28 @@
  * mm/vmalloc.c の以下の関数をテスト:
  * - vmalloc_init(): 仮想メモリアロケータの初期化
  * - vmalloc(): 仮想メモリ割り当て
- * - vfree(): 仮想メモリ解放
+ * - vfree(): 仮想メモリ解放（PTEのクリアと遅延パージ）
  * - vsize(): 割り当てサイズ取得
- * - vbrk(): ヒープブレイクポイント変更（スタブ）
+ * - vbrk(): ヒープブレイクポイント変更（予約窓への逐次マップ）
+ * - vmalloc_lazy() / vreserve(): 物理メモリを割り当てない仮想領域の確保
+ * - vmap() / vunmap(): 既存ページのマッピング
+ * - __do_page_fault(): デマンドページングVMAへのフォルト処理
  */
 
 #include "../test_reset.h"
 #include "unit_test_framework.h"
+#include <asm-i386/pgtable.h>
+#include <kfs/gfp.h>
+#include <kfs/mm.h>
 #include <kfs/stddef.h>
 #include <kfs/vmalloc.h>
 
+extern unsigned long nr_free_pages;
+
+/* ページフォルトのエラーコード（arch/i386/mm/fault.cと同じ値） */
+#define TEST_PF_PROT 0x1
+#define TEST_PF_WRITE 0x2
+
 /* 全テストで共通のセットアップ関数 */
 static void setup_test(void)
 {
@@ -472,6 +484,247 @@ KFS_TEST(test_vmalloc_vfree_partial)
 	vfree(ptr3);
 }
 
+/*
+ * テスト: vmalloc_lazy - 物理ページを割り当てないこと
+ * 検証: 確保直後は空きページ数が変わらず，PTEも存在しないこと
+ */
+KFS_TEST(test_vmalloc_lazy_no_commit)
+{
+	unsigned long before = nr_free_pages;
+	void *ptr = vmalloc_lazy(4 * PAGE_SIZE);
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(ptr != NULL);
+	KFS_ASSERT_EQ(4 * PAGE_SIZE, vsize(ptr));
+	KFS_ASSERT_EQ(before, nr_free_pages);
+
+	pte = get_pte((unsigned long)ptr);
+	KFS_ASSERT_TRUE(pte == NULL || !pte_present(*pte));
+
+	vfree(ptr);
+}
+
+/*
+ * テスト: __do_page_fault - デマンドページングによるゼロページ割り当て
+ * 検証: フォルトしたページだけがマップされ，ゼロクリアされていること
+ */
+KFS_TEST(test_vmalloc_lazy_fault_maps_zero_page)
+{
+	unsigned char *ptr = (unsigned char *)vmalloc_lazy(2 * PAGE_SIZE);
+	unsigned long addr = (unsigned long)ptr + PAGE_SIZE + 123;
+	unsigned long before;
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(ptr != NULL);
+
+	/* ページテーブル自体の割り当てを除外するため，1ページ目を先にフォルトさせる */
+	KFS_ASSERT_EQ(0, __do_page_fault(NULL, TEST_PF_WRITE, (unsigned long)ptr));
+	before = nr_free_pages;
+
+	KFS_ASSERT_EQ(0, __do_page_fault(NULL, TEST_PF_WRITE, addr));
+	KFS_ASSERT_EQ(before - 1, nr_free_pages);
+
+	pte = get_pte(addr);
+	KFS_ASSERT_TRUE(pte != NULL && pte_present(*pte));
+	KFS_ASSERT_EQ(0, ptr[PAGE_SIZE + 123]);
+
+	ptr[PAGE_SIZE + 123] = 0x5a;
+	KFS_ASSERT_EQ(0x5a, ptr[PAGE_SIZE + 123]);
+
+	/* 2回目のフォルトは新しいページを割り当てない */
+	KFS_ASSERT_EQ(0, __do_page_fault(NULL, 0, addr));
+	KFS_ASSERT_EQ(before - 1, nr_free_pages);
+	KFS_ASSERT_EQ(0x5a, ptr[PAGE_SIZE + 123]);
+
+	vfree(ptr);
+}
+
+/*
+ * テスト: vfree - 遅延割り当て領域の解放
+ * 検証: フォルトで割り当てたページがvfree()で返却されること
+ */
+KFS_TEST(test_vmalloc_lazy_vfree_releases_pages)
+{
+	void *ptr = vmalloc_lazy(3 * PAGE_SIZE);
+	unsigned long before;
+
+	KFS_ASSERT_TRUE(ptr != NULL);
+	KFS_ASSERT_EQ(0, __do_page_fault(NULL, TEST_PF_WRITE, (unsigned long)ptr));
+	before = nr_free_pages;
+	KFS_ASSERT_EQ(0, __do_page_fault(NULL, TEST_PF_WRITE, (unsigned long)ptr + 2 * PAGE_SIZE));
+	KFS_ASSERT_EQ(before - 1, nr_free_pages);
+
+	vfree(ptr);
+	KFS_ASSERT_EQ(before + 1, nr_free_pages);
+	KFS_ASSERT_EQ(0, vsize(ptr));
+}
+
+/*
+ * テスト: __do_page_fault - 解決できないフォルト
+ * 検証: 保護違反・VMA外・デマンドページングでない領域は-1を返すこと
+ */
+KFS_TEST(test_page_fault_unresolvable)
+{
+	void *eager = vmalloc(PAGE_SIZE);
+	void *lazy = vmalloc_lazy(PAGE_SIZE);
+	void *reserved = vreserve(PAGE_SIZE);
+
+	KFS_ASSERT_TRUE(eager != NULL && lazy != NULL && reserved != NULL);
+	KFS_ASSERT_EQ(-1, __do_page_fault(NULL, TEST_PF_WRITE, (unsigned long)eager));
+	KFS_ASSERT_EQ(-1, __do_page_fault(NULL, TEST_PF_PROT | TEST_PF_WRITE, (unsigned long)lazy));
+	KFS_ASSERT_EQ(-1, __do_page_fault(NULL, 0, (unsigned long)reserved));
+	KFS_ASSERT_EQ(-1, __do_page_fault(NULL, 0, 0x00001000));
+
+	vfree(eager);
+	vfree(lazy);
+	vfree(reserved);
+}
+
+/*
+ * テスト: vfree - PTEのクリア
+ * 検証: vfree()後は領域のPTEが存在しないこと
+ */
+KFS_TEST(test_vfree_clears_ptes)
+{
+	void *ptr = vmalloc(2 * PAGE_SIZE);
+	pte_t *pte;
+
+	KFS_ASSERT_TRUE(ptr != NULL);
+	pte = get_pte((unsigned long)ptr + PAGE_SIZE);
+	KFS_ASSERT_TRUE(pte != NULL && pte_present(*pte));
+
+	vfree(ptr);
+	KFS_ASSERT_TRUE(!pte_present(*pte));
+}
+
+/*
+ * テスト: vfree - 遅延パージ
+ * 検証: 遅延解放中のアドレス範囲はパージまで再利用されないこと
+ */
+KFS_TEST(test_vfree_lazy_purge_defers_reuse)
+{
+	void *ptr1, *ptr2, *ptr3;
+	unsigned long before;
+
+	ptr1 = vmalloc(PAGE_SIZE);
+	KFS_ASSERT_TRUE(ptr1 != NULL);
+	before = nr_free_pages;
+	vfree(ptr1);
+
+	/* 物理ページは即座に返却される */
+	KFS_ASSERT_EQ(before + 1, nr_free_pages);
+
+	/* パージ前は同じアドレスを再利用しない */
+	ptr2 = vmalloc(PAGE_SIZE);
+	KFS_ASSERT_TRUE(ptr2 != NULL);
+	KFS_ASSERT_TRUE(ptr1 != ptr2);
+
+	/* パージ後は再利用できる */
+	vm_unmap_aliases();
+	ptr3 = vmalloc(PAGE_SIZE);
+	KFS_ASSERT_TRUE(ptr3 == ptr1);
+
+	vfree(ptr2);
+	vfree(ptr3);
+}
+
+/*
+ * テスト: vbrk - 連続した仮想アドレス範囲
+ * 検証: 初期サイズを超えて拡張しても，ヒープ全体が書き込み可能な1つの範囲であること
+ */
+KFS_TEST(test_vbrk_contiguous_growth)
+{
+	unsigned char *start = (unsigned char *)vbrk(1);
+	unsigned char *end;
+
+	KFS_ASSERT_TRUE(start != NULL);
+	start -= 1;
+	end = (unsigned char *)vbrk(1536 * 1024);
+	KFS_ASSERT_TRUE(end != NULL);
+	KFS_ASSERT_EQ((unsigned long)start + 1 + 1536 * 1024, (unsigned long)end);
+
+	start[0] = 0x11;
+	start[1024 * 1024 + 1] = 0x22;
+	end[-1] = 0x33;
+	KFS_ASSERT_EQ(0x11, start[0]);
+	KFS_ASSERT_EQ(0x22, start[1024 * 1024 + 1]);
+	KFS_ASSERT_EQ(0x33, end[-1]);
+}
+
+/*
+ * テスト: vbrk - 縮小時のヒステリシス
+ * 検証: ページ境界付近の伸縮ではページを解放せず，大きく縮小したときだけ解放すること
+ */
+KFS_TEST(test_vbrk_shrink_hysteresis)
+{
+	unsigned long before;
+
+	KFS_ASSERT_TRUE(vbrk(PAGE_SIZE) != NULL);
+	before = nr_free_pages;
+
+	/* 1ページ境界をまたいで伸縮を繰り返す */
+	KFS_ASSERT_TRUE(vbrk(16) != NULL);
+	KFS_ASSERT_EQ(before - 1, nr_free_pages);
+	KFS_ASSERT_TRUE(vbrk(-32) != NULL);
+	KFS_ASSERT_TRUE(vbrk(32) != NULL);
+	KFS_ASSERT_EQ(before - 1, nr_free_pages);
+
+	/* 閾値を超えて縮小するとページが返却される */
+	KFS_ASSERT_TRUE(vbrk(8 * PAGE_SIZE) != NULL);
+	KFS_ASSERT_EQ(before - 9, nr_free_pages);
+	KFS_ASSERT_TRUE(vbrk(-(long)(8 * PAGE_SIZE + 16)) != NULL);
+	KFS_ASSERT_EQ(before, nr_free_pages);
+}
+
+/*
+ * テスト: vmap - 既存ページのマッピング
+ * 検証: 非連続の物理ページが連続した仮想アドレスで読み書きでき，
+ *       vunmap()で物理ページが解放されないこと
+ */
+KFS_TEST(test_vmap_existing_pages)
+{
+	struct page *pages[2];
+	unsigned char *vaddr;
+	unsigned long before;
+
+	pages[0] = alloc_pages(GFP_ZERO, 0);
+	pages[1] = alloc_pages(GFP_ZERO, 0);
+	KFS_ASSERT_TRUE(pages[0] != NULL && pages[1] != NULL);
+	((unsigned char *)pages[1])[7] = 0x42;
+
+	/* 逆順に並べて非連続にする */
+	{
+		struct page *tmp = pages[0];
+		pages[0] = pages[1];
+		pages[1] = tmp;
+	}
+
+	vaddr = (unsigned char *)vmap(pages, 2);
+	KFS_ASSERT_TRUE(vaddr != NULL);
+	KFS_ASSERT_EQ(0x42, vaddr[7]);
+	vaddr[PAGE_SIZE + 3] = 0x24;
+	KFS_ASSERT_EQ(0x24, ((unsigned char *)pages[1])[3]);
+
+	before = nr_free_pages;
+	vunmap(vaddr);
+	KFS_ASSERT_EQ(before, nr_free_pages);
+
+	free_pages(pages[0], 0);
+	free_pages(pages[1], 0);
+}
+
+/*
+ * テスト: vmap - 不正な引数
+ * 検証: NULLや0ページはNULLを返すこと
+ */
+KFS_TEST(test_vmap_invalid)
+{
+	struct page *page = NULL;
+
+	KFS_ASSERT_TRUE(vmap(NULL, 1) == NULL);
+	KFS_ASSERT_TRUE(vmap(&page, 0) == NULL);
+}
+
 static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_init, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_zero_size, setup_test, teardown_test),
@@ -494,6 +747,16 @@ static struct kfs_test_case cases[] = {
 	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_vfree_cycle, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_vfree_out_of_order, setup_test, teardown_test),
 	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_vfree_partial, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_lazy_no_commit, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_lazy_fault_maps_zero_page, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vmalloc_lazy_vfree_releases_pages, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_page_fault_unresolvable, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vfree_clears_ptes, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vfree_lazy_purge_defers_reuse, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vbrk_contiguous_growth, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vbrk_shrink_hysteresis, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vmap_existing_pages, setup_test, teardown_test),
+	KFS_REGISTER_TEST_WITH_SETUP(test_vmap_invalid, setup_test, teardown_test),
 };
 
 int register_unit_tests_vmalloc(struct kfs_test_case **out)
@@ -0,0 +1,37 @@
+/**
+ * sched_test_support.h - スケジューラのテストで共通に使うタスクの初期化
+ */
+#ifndef KFS_SCHED_TEST_SUPPORT_H
+#define KFS_SCHED_TEST_SUPPORT_H
+
+#include "../../../kernel/sched/sched.h"
+#include <kfs/sched.h>
+#include <kfs/smp.h>
+#include <kfs/string.h>
+
+/** テスト用タスクをCFSのタスクとして初期化する
+ * @param p    初期化するタスク（スラブを使わず静的に確保したもの）
+ * @param pid  PID（PIDハッシュには登録しない）
+ * @param nice nice値
+ * @return p
+ * @details sched_fork()が初期化するスケジューラのフィールドをすべて設定し，
+ *          CPU 0で実行可能で，どのCPUでも実行してよいSCHED_NORMALのタスクにする（ランキューには登録しない）
+ */
+static inline struct task_struct *init_sched_test_task(struct task_struct *p, pid_t pid, int nice)
+{
+	memset(p, 0, sizeof(*p));
+	p->pid = pid;
+	p->__state = TASK_RUNNING;
+	p->sched_class = &fair_sched_class;
+	p->policy = SCHED_NORMAL;
+	p->static_prio = NICE_TO_PRIO(nice);
+	p->prio = p->static_prio;
+	p->se.load.weight = sched_prio_to_weight[p->static_prio - MAX_RT_PRIO];
+	p->se.load.inv_weight = sched_prio_to_wmult[p->static_prio - MAX_RT_PRIO];
+	RB_CLEAR_NODE(&p->se.run_node);
+	INIT_LIST_HEAD(&p->rt.run_list);
+	p->cpus_allowed = CPU_MASK_ALL;
+	return p;
+}
+
+#endif /* KFS_SCHED_TEST_SUPPORT_H */
@@ -22,8 +22,24 @@ int register_unit_tests_sched_core(struct kfs_test_case **out);
 int register_unit_tests_pid(struct kfs_test_case **out);
 int register_unit_tests_rbtree(struct kfs_test_case **out);
 int register_unit_tests_fork(struct kfs_test_case **out);
+int register_unit_tests_ioremap(struct kfs_test_case **out);
+int register_unit_tests_fair(struct kfs_test_case **out);
+int register_unit_tests_tick(struct kfs_test_case **out);
+int register_unit_tests_timekeeping(struct kfs_test_case **out);
+int register_unit_tests_preempt(struct kfs_test_case **out);
+int register_unit_tests_wait(struct kfs_test_case **out);
+int register_unit_tests_bitmap(struct kfs_test_case **out);
+int register_unit_tests_cow(struct kfs_test_case **out);
+int register_unit_tests_smp(struct kfs_test_case **out);
+int register_unit_tests_spinlock(struct kfs_test_case **out);
+int register_unit_tests_mutex(struct kfs_test_case **out);
+int register_unit_tests_exit(struct kfs_test_case **out);
+int register_unit_tests_rt(struct kfs_test_case **out);
+int register_unit_tests_sched_stats(struct kfs_test_case **out);
+int register_unit_tests_cpuidle(struct kfs_test_case **out);
+int register_unit_tests_balance(struct kfs_test_case **out);
 
-#define KFS_MAX_TESTS 256
+#define KFS_MAX_TESTS 512
 
 // すべてのテストケースを一つにまとめる
 static struct kfs_test_case *all_cases = 0;
@@ -76,6 +92,38 @@ int register_unit_tests(struct kfs_test_case **out)
 		int count_rbtree = register_unit_tests_rbtree(&cases_rbtree);
 		struct kfs_test_case *cases_fork = 0;
 		int count_fork = register_unit_tests_fork(&cases_fork);
+		struct kfs_test_case *cases_ioremap = 0;
+		int count_ioremap = register_unit_tests_ioremap(&cases_ioremap);
+		struct kfs_test_case *cases_fair = 0;
+		int count_fair = register_unit_tests_fair(&cases_fair);
+		struct kfs_test_case *cases_tick = 0;
+		int count_tick = register_unit_tests_tick(&cases_tick);
+		struct kfs_test_case *cases_timekeeping = 0;
+		int count_timekeeping = register_unit_tests_timekeeping(&cases_timekeeping);
+		struct kfs_test_case *cases_preempt = 0;
+		int count_preempt = register_unit_tests_preempt(&cases_preempt);
+		struct kfs_test_case *cases_wait = 0;
+		int count_wait = register_unit_tests_wait(&cases_wait);
+		struct kfs_test_case *cases_bitmap = 0;
+		int count_bitmap = register_unit_tests_bitmap(&cases_bitmap);
+		struct kfs_test_case *cases_cow = 0;
+		int count_cow = register_unit_tests_cow(&cases_cow);
+		struct kfs_test_case *cases_smp = 0;
+		int count_smp = register_unit_tests_smp(&cases_smp);
+		struct kfs_test_case *cases_spinlock = 0;
+		int count_spinlock = register_unit_tests_spinlock(&cases_spinlock);
+		struct kfs_test_case *cases_mutex = 0;
+		int count_mutex = register_unit_tests_mutex(&cases_mutex);
+		struct kfs_test_case *cases_exit = 0;
+		int count_exit = register_unit_tests_exit(&cases_exit);
+		struct kfs_test_case *cases_rt = 0;
+		int count_rt = register_unit_tests_rt(&cases_rt);
+		struct kfs_test_case *cases_sched_stats = 0;
+		int count_sched_stats = register_unit_tests_sched_stats(&cases_sched_stats);
+		struct kfs_test_case *cases_cpuidle = 0;
+		int count_cpuidle = register_unit_tests_cpuidle(&cases_cpuidle);
+		struct kfs_test_case *cases_balance = 0;
+		int count_balance = register_unit_tests_balance(&cases_balance);
 		// 動的確保は避け、静的最大数 (今は少数) を想定してスタック上に置けないので静的配列
 		static struct kfs_test_case merged[KFS_MAX_TESTS];
 		int idx = 0;
@@ -163,6 +211,70 @@ int register_unit_tests(struct kfs_test_case **out)
 		{
 			merged[idx++] = cases_fork[i];
 		}
+		for (int i = 0; i < count_ioremap && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_ioremap[i];
+		}
+		for (int i = 0; i < count_fair && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_fair[i];
+		}
+		for (int i = 0; i < count_tick && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_tick[i];
+		}
+		for (int i = 0; i < count_timekeeping && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_timekeeping[i];
+		}
+		for (int i = 0; i < count_preempt && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_preempt[i];
+		}
+		for (int i = 0; i < count_wait && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_wait[i];
+		}
+		for (int i = 0; i < count_bitmap && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_bitmap[i];
+		}
+		for (int i = 0; i < count_cow && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_cow[i];
+		}
+		for (int i = 0; i < count_smp && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_smp[i];
+		}
+		for (int i = 0; i < count_spinlock && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_spinlock[i];
+		}
+		for (int i = 0; i < count_mutex && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_mutex[i];
+		}
+		for (int i = 0; i < count_exit && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_exit[i];
+		}
+		for (int i = 0; i < count_rt && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_rt[i];
+		}
+		for (int i = 0; i < count_sched_stats && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_sched_stats[i];
+		}
+		for (int i = 0; i < count_cpuidle && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_cpuidle[i];
+		}
+		for (int i = 0; i < count_balance && idx < KFS_MAX_TESTS; i++)
+		{
+			merged[idx++] = cases_balance[i];
+		}
 		all_cases = merged;
 		all_count = idx;
 	}
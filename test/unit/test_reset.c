@@ -4,7 +4,12 @@
  * 全テストの独立性を保証するために、各テスト前に呼び出すリセット関数を提供する。
  */
 
+#include <kfs/clockchips.h>
+#include <kfs/cpuidle.h>
 #include <kfs/mm.h>
+#include <kfs/pid.h>
+#include <kfs/sched.h>
+#include <kfs/signal.h>
 #include <kfs/slab.h>
 #include <kfs/vmalloc.h>
 
@@ -15,13 +20,21 @@
  * テストの独立性を保証するために、各テスト前に呼び出す。
  *
  * リセット対象:
+ * - tickデバイス（Local APICのMMIOマップが消える前に止める）
  * - 仮想メモリ領域（VMA）
  * - ページアロケータ
  * - Slabアロケータ
  * - vmallocアロケータ
+ * - PIDビットマップとPIDハッシュ
+ * - sigqueueのキャッシュと現在のタスクの保留シグナル
+ * - タスクリストと回収待ちのタスク
+ * - アイドル中の仕事と休止の統計
  */
 void reset_all_state_for_test(void)
 {
+	/* tickを止める（タイマー割り込みでテスト中のランキューが変化しないように） */
+	tick_reset_for_test();
+
 	/* VMAをリセット（依存関係: Slabの前にクリア） */
 	vm_reset_for_test();
 
@@ -33,4 +46,16 @@ void reset_all_state_for_test(void)
 
 	/* vmallocアロケータを初期化（Slabアロケータに依存） */
 	vmalloc_init();
+
+	/* PIDハッシュを空にする（struct pidはSlab上にあるため，Slabのリセットで無効になる） */
+	pid_init();
+
+	/* 保留シグナルを空にする（積まれたsigqueueはSlab上にあるため，Slabのリセットで無効になる） */
+	signals_init();
+
+	/* タスクリストを空にする（つながっているtask_structはSlab上にあるため，Slabのリセットで無効になる） */
+	exit_reset_for_test();
+
+	/* アイドル中の仕事と休止の統計を消す */
+	cpuidle_reset_for_test();
 }